@@ -0,0 +1,708 @@
+#include "vulkan.h"
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "mirv_ext.h"
+#include "util.h"
+
+// --
+
+static const char* gFilter = nullptr;
+
+template<typename F>
+static void
+Bench(const char* const name, const uint32_t iters, const F& fn)
+{
+    if (gFilter && !strstr(name, gFilter))
+        return;
+
+    fn(); // Warm up.
+
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iters; i++) {
+        fn();
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    const auto ns = std::chrono::duration<double, std::nano>(end - start).count();
+    printf("%-48s %12.1f ns/iter  (%u iters)\n", name, ns / iters, iters);
+}
+
+// --
+
+// layout(local_size_x = 64) in;
+// layout(push_constant) uniform PC { uint add; };
+// shared uint s[64];
+// void main() {
+//     const uint i = gl_LocalInvocationID.x;
+//     s[i] = i + add;
+//     barrier();
+//     s[i] = s[63 - i];
+// }
+static const uint32_t kLocalShader[] = {
+    0x07230203, 0x00010000, 0x00000000, 0x0000001f, 0x00000000, 0x00020011,
+    0x00000001, 0x0003000e, 0x00000000, 0x00000001, 0x0006000f, 0x00000005,
+    0x00000001, 0x6e69616d, 0x00000000, 0x00000002, 0x00060010, 0x00000001,
+    0x00000011, 0x00000040, 0x00000001, 0x00000001, 0x00040047, 0x00000002,
+    0x0000000b, 0x0000001b, 0x00050048, 0x00000003, 0x00000000, 0x00000023,
+    0x00000000, 0x00030047, 0x00000003, 0x00000002, 0x00020013, 0x00000004,
+    0x00030021, 0x00000005, 0x00000004, 0x00040015, 0x00000006, 0x00000020,
+    0x00000000, 0x00040017, 0x00000007, 0x00000006, 0x00000003, 0x00040020,
+    0x00000008, 0x00000001, 0x00000007, 0x0004003b, 0x00000008, 0x00000002,
+    0x00000001, 0x0004002b, 0x00000006, 0x00000009, 0x00000000, 0x0004002b,
+    0x00000006, 0x0000000a, 0x00000002, 0x0004002b, 0x00000006, 0x0000000b,
+    0x0000003f, 0x0004002b, 0x00000006, 0x0000000c, 0x00000040, 0x0004002b,
+    0x00000006, 0x0000000d, 0x00000108, 0x0004001c, 0x0000000e, 0x00000006,
+    0x0000000c, 0x00040020, 0x0000000f, 0x00000004, 0x0000000e, 0x0004003b,
+    0x0000000f, 0x00000010, 0x00000004, 0x00040020, 0x00000011, 0x00000004,
+    0x00000006, 0x0003001e, 0x00000003, 0x00000006, 0x00040020, 0x00000012,
+    0x00000009, 0x00000003, 0x0004003b, 0x00000012, 0x00000013, 0x00000009,
+    0x00040020, 0x00000014, 0x00000009, 0x00000006, 0x00050036, 0x00000004,
+    0x00000001, 0x00000000, 0x00000005, 0x000200f8, 0x00000015, 0x0004003d,
+    0x00000007, 0x00000016, 0x00000002, 0x00050051, 0x00000006, 0x00000017,
+    0x00000016, 0x00000000, 0x00050041, 0x00000014, 0x00000018, 0x00000013,
+    0x00000009, 0x0004003d, 0x00000006, 0x00000019, 0x00000018, 0x00050080,
+    0x00000006, 0x0000001a, 0x00000017, 0x00000019, 0x00050041, 0x00000011,
+    0x0000001b, 0x00000010, 0x00000017, 0x0003003e, 0x0000001b, 0x0000001a,
+    0x000400e0, 0x0000000a, 0x0000000a, 0x0000000d, 0x00050082, 0x00000006,
+    0x0000001c, 0x0000000b, 0x00000017, 0x00050041, 0x00000011, 0x0000001d,
+    0x00000010, 0x0000001c, 0x0004003d, 0x00000006, 0x0000001e, 0x0000001d,
+    0x0003003e, 0x0000001b, 0x0000001e, 0x000100fd, 0x00010038,
+};
+
+// --
+
+static const VkApplicationInfo kAppInfo = {
+    VK_STRUCTURE_TYPE_APPLICATION_INFO, nullptr,
+    "bench_vulkan", 1,
+    nullptr, 0,
+    VK_API_VERSION_1_0
+};
+
+static const VkInstanceCreateInfo kInstCreateInfo = {
+    VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO, nullptr, 0,
+    &kAppInfo,
+    0, nullptr,
+    0, nullptr
+};
+
+static VkPhysicalDevice
+FirstPhysDev(const VkInstance inst)
+{
+    uint32_t count = 1;
+    VkPhysicalDevice physDev = 0;
+    (void)vkEnumeratePhysicalDevices(inst, &count, &physDev);
+    CHECK(physDev)
+    return physDev;
+}
+
+static VkDevice
+CreateDevice(const VkPhysicalDevice physDev)
+{
+    const float priorities[] = { 0.5f };
+    const VkDeviceQueueCreateInfo queueInfo = {
+        VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO, nullptr, 0,
+        0, 1,
+        priorities
+    };
+    const char* const extensionNames[] = { VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME };
+    const VkDeviceCreateInfo deviceInfo = {
+        VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO, nullptr, 0,
+        1, &queueInfo,
+        0, nullptr,
+        1, extensionNames,
+        nullptr
+    };
+
+    VkDevice dev = 0;
+    const auto res = vkCreateDevice(physDev, &deviceInfo, nullptr, &dev);
+    CHECK(res == VK_SUCCESS)
+    return dev;
+}
+
+static const char* const kDeviceProcNames[] = {
+    "vkGetDeviceQueue",
+    "vkDestroyDevice",
+    "vkCreateCommandPool",
+    "vkGetDeviceProcAddr",
+    "vkCreateGraphicsPipelines", // Misses are lookups too.
+    "vkCmdDraw",
+};
+
+// Each thread records into its own pool, so throughput should scale with threads.
+// Pools are trimmed after every pass, so chunks also round-trip through the device.
+static void
+BenchParallelRecording(const VkDevice dev)
+{
+    static const char kName[] = "parallel vkCmdPushConstants(16B)";
+    if (gFilter && !strstr(kName, gFilter))
+        return;
+
+    const uint32_t kCmdsPerPass = 10000;
+    const uint32_t kPasses = 200;
+
+    const auto maxThreads = std::max(2u, std::min(32u, std::thread::hardware_concurrency()));
+    for (uint32_t threadCount = 1; threadCount <= maxThreads; threadCount *= 2) {
+        const auto record = [&]() {
+            const VkCommandPoolCreateInfo poolInfo = {
+                VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, nullptr, 0,
+                0
+            };
+            VkCommandPool pool;
+            (void)vkCreateCommandPool(dev, &poolInfo, nullptr, &pool);
+            const VkCommandBufferAllocateInfo cbInfo = {
+                VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, nullptr,
+                pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1
+            };
+            VkCommandBuffer cb;
+            (void)vkAllocateCommandBuffers(dev, &cbInfo, &cb);
+
+            const VkCommandBufferBeginInfo beginInfo = {
+                VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr, 0, nullptr
+            };
+            const uint32_t constants[4] = {};
+            for (uint32_t pass = 0; pass < kPasses; pass++) {
+                (void)vkBeginCommandBuffer(cb, &beginInfo);
+                for (uint32_t i = 0; i < kCmdsPerPass; i++) {
+                    vkCmdPushConstants(cb, VK_NULL_HANDLE, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                                       sizeof(constants), constants);
+                }
+                (void)vkEndCommandBuffer(cb);
+                (void)vkResetCommandPool(dev, pool,
+                                         VK_COMMAND_POOL_RESET_RELEASE_RESOURCES_BIT);
+            }
+            vkDestroyCommandPool(dev, pool, nullptr);
+        };
+
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (uint32_t i = 0; i < threadCount; i++) {
+            threads.push_back(std::thread(record));
+        }
+        for (auto& x : threads) {
+            x.join();
+        }
+        const auto end = std::chrono::steady_clock::now();
+
+        const auto ns = std::chrono::duration<double, std::nano>(end - start).count();
+        const double cmds = double(threadCount) * kPasses * kCmdsPerPass;
+        printf("%-36s x%-2u %12.1f Mcmd/s  (%.1f ns/cmd/thread)\n", kName, threadCount,
+               cmds / ns * 1000.0, ns / (cmds / threadCount));
+    }
+}
+
+// --
+
+int
+main(const int argc, const char* const argv[])
+{
+    if (argc > 1) {
+        gFilter = argv[1];
+    }
+
+    Bench("vkCreateInstance+vkDestroyInstance", 1000, []() {
+        VkInstance inst;
+        const auto res = vkCreateInstance(&kInstCreateInfo, nullptr, &inst);
+        CHECK(res == VK_SUCCESS)
+        vkDestroyInstance(inst, nullptr);
+    });
+
+    Bench("vkCreateInstance+FirstPhysDev+vkDestroyInstance", 1000, []() {
+        VkInstance inst;
+        const auto res = vkCreateInstance(&kInstCreateInfo, nullptr, &inst);
+        CHECK(res == VK_SUCCESS)
+        (void)FirstPhysDev(inst);
+        vkDestroyInstance(inst, nullptr);
+    });
+
+    VkInstance inst;
+    auto res = vkCreateInstance(&kInstCreateInfo, nullptr, &inst);
+    CHECK(res == VK_SUCCESS)
+
+    Bench("vkEnumeratePhysicalDevices", 100000, [&]() {
+        uint32_t count = 0;
+        (void)vkEnumeratePhysicalDevices(inst, &count, nullptr);
+        std::vector<VkPhysicalDevice> physDevs(count);
+        (void)vkEnumeratePhysicalDevices(inst, &count, physDevs.data());
+    });
+
+    const auto physDev = FirstPhysDev(inst);
+
+    Bench("vkGetPhysicalDeviceProperties", 100000, [&]() {
+        VkPhysicalDeviceProperties props;
+        vkGetPhysicalDeviceProperties(physDev, &props);
+    });
+
+    Bench("vkGetInstanceProcAddr", 1000000, [&]() {
+        for (const auto& name : kDeviceProcNames) {
+            (void)vkGetInstanceProcAddr(inst, name);
+        }
+    });
+
+    Bench("vkCreateDevice+vkDestroyDevice", 100, [&]() {
+        vkDestroyDevice(CreateDevice(physDev), nullptr);
+    });
+
+    const auto dev = CreateDevice(physDev);
+
+    Bench("vkGetDeviceProcAddr", 1000000, [&]() {
+        for (const auto& name : kDeviceProcNames) {
+            (void)vkGetDeviceProcAddr(dev, name);
+        }
+    });
+
+    Bench("vkCreateCommandPool+vkDestroyCommandPool", 100000, [&]() {
+        const VkCommandPoolCreateInfo poolInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, nullptr, 0,
+            0
+        };
+        VkCommandPool pool;
+        (void)vkCreateCommandPool(dev, &poolInfo, nullptr, &pool);
+        vkDestroyCommandPool(dev, pool, nullptr);
+    });
+
+    const auto allocFree = [&](const VkDeviceSize size) {
+        const VkMemoryAllocateInfo info = {
+            VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, nullptr,
+            size, 0
+        };
+        VkDeviceMemory mem;
+        (void)vkAllocateMemory(dev, &info, nullptr, &mem);
+        vkFreeMemory(dev, mem, nullptr);
+    };
+    Bench("vkAllocateMemory+vkFreeMemory(256)", 100000, [&]() {
+        allocFree(256);
+    });
+    Bench("vkAllocateMemory+vkFreeMemory(64K)", 100000, [&]() {
+        allocFree(64 * 1024);
+    });
+    Bench("vkAllocateMemory+vkFreeMemory(1000x256)", 100, [&]() {
+        VkDeviceMemory mems[1000];
+        const VkMemoryAllocateInfo info = {
+            VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, nullptr,
+            256, 0
+        };
+        for (auto& mem : mems) {
+            (void)vkAllocateMemory(dev, &info, nullptr, &mem);
+        }
+        for (const auto& mem : mems) {
+            vkFreeMemory(dev, mem, nullptr);
+        }
+    });
+
+    {
+        const VkMemoryAllocateInfo info = {
+            VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, nullptr,
+            64 * 1024, 0
+        };
+        VkDeviceMemory mem;
+        (void)vkAllocateMemory(dev, &info, nullptr, &mem);
+
+        Bench("vkMapMemory+vkUnmapMemory", 1000000, [&]() {
+            void* ptr;
+            (void)vkMapMemory(dev, mem, 0, VK_WHOLE_SIZE, 0, &ptr);
+            vkUnmapMemory(dev, mem);
+        });
+
+        const VkMappedMemoryRange range = {
+            VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, nullptr, mem, 0, VK_WHOLE_SIZE
+        };
+        Bench("vkFlushMappedMemoryRanges", 1000000, [&]() {
+            (void)vkFlushMappedMemoryRanges(dev, 1, &range);
+        });
+
+        vkFreeMemory(dev, mem, nullptr);
+    }
+
+    {
+        const VkCommandPoolCreateInfo poolInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, nullptr, 0,
+            0
+        };
+        VkCommandPool pool;
+        (void)vkCreateCommandPool(dev, &poolInfo, nullptr, &pool);
+
+        const VkCommandBufferAllocateInfo cbInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, nullptr,
+            pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1
+        };
+        Bench("vkAllocateCommandBuffers+vkFreeCommandBuffers", 100000, [&]() {
+            VkCommandBuffer cb;
+            (void)vkAllocateCommandBuffers(dev, &cbInfo, &cb);
+            vkFreeCommandBuffers(dev, pool, 1, &cb);
+        });
+
+        VkCommandBuffer cb;
+        (void)vkAllocateCommandBuffers(dev, &cbInfo, &cb);
+        const VkCommandBufferBeginInfo beginInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr, 0, nullptr
+        };
+        const uint32_t constants[4] = {};
+        Bench("10000x vkCmdPushConstants(16B)", 1000, [&]() {
+            (void)vkBeginCommandBuffer(cb, &beginInfo);
+            for (uint32_t i = 0; i < 10000; i++) {
+                vkCmdPushConstants(cb, VK_NULL_HANDLE, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                                   sizeof(constants), constants);
+            }
+            (void)vkEndCommandBuffer(cb);
+            (void)vkResetCommandPool(dev, pool, 0);
+        });
+
+        VkQueue queue;
+        vkGetDeviceQueue(dev, 0, 0, &queue);
+        (void)vkBeginCommandBuffer(cb, &beginInfo);
+        (void)vkEndCommandBuffer(cb);
+        const VkSubmitInfo submitInfo = {
+            VK_STRUCTURE_TYPE_SUBMIT_INFO, nullptr,
+            0, nullptr, nullptr,
+            1, &cb,
+            0, nullptr
+        };
+        // Just the submitting thread's side.
+        Bench("vkQueueSubmit", 100000, [&]() {
+            (void)vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+        });
+        (void)vkQueueWaitIdle(queue);
+
+        // Round trips through the queue thread.
+        Bench("vkQueueSubmit+vkQueueWaitIdle", 10000, [&]() {
+            (void)vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+            (void)vkQueueWaitIdle(queue);
+        });
+        const VkFenceCreateInfo fenceInfo = {
+            VK_STRUCTURE_TYPE_FENCE_CREATE_INFO, nullptr, 0
+        };
+        VkFence fence;
+        (void)vkCreateFence(dev, &fenceInfo, nullptr, &fence);
+        Bench("vkQueueSubmit+vkWaitForFences+vkResetFences", 10000, [&]() {
+            (void)vkQueueSubmit(queue, 1, &submitInfo, fence);
+            (void)vkWaitForFences(dev, 1, &fence, VK_TRUE, UINT64_MAX);
+            (void)vkResetFences(dev, 1, &fence);
+        });
+        vkDestroyFence(dev, fence, nullptr);
+
+        // Pure scheduling cost, with no pipeline bound to run per group.
+        const uint32_t gridSizes[][2] = { {1, 10000}, {1024, 10000}, {1024 * 1024, 1000} };
+        for (const auto& grid : gridSizes) {
+            (void)vkResetCommandPool(dev, pool, 0);
+            (void)vkBeginCommandBuffer(cb, &beginInfo);
+            vkCmdDispatch(cb, grid[0], 1, 1);
+            (void)vkEndCommandBuffer(cb);
+
+            char name[64];
+            snprintf(name, sizeof(name), "vkCmdDispatch(%u groups)+vkQueueWaitIdle", grid[0]);
+            Bench(name, grid[1], [&]() {
+                (void)vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+                (void)vkQueueWaitIdle(queue);
+            });
+        }
+
+        // Staging uploads: small ones stay cached, big ones stream over every thread.
+        {
+            const uint64_t kSize = 64 << 20;
+            const VkBufferCreateInfo bufferInfo = {
+                VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, nullptr, 0,
+                kSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_SHARING_MODE_EXCLUSIVE, 0, nullptr
+            };
+            VkBuffer src, dst;
+            (void)vkCreateBuffer(dev, &bufferInfo, nullptr, &src);
+            (void)vkCreateBuffer(dev, &bufferInfo, nullptr, &dst);
+            const VkMemoryAllocateInfo memInfo = {
+                VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, nullptr,
+                2 * kSize, 0
+            };
+            VkDeviceMemory mem;
+            (void)vkAllocateMemory(dev, &memInfo, nullptr, &mem);
+            (void)vkBindBufferMemory(dev, src, mem, 0);
+            (void)vkBindBufferMemory(dev, dst, mem, kSize);
+
+            const auto copyBench = [&](const char* const name, const uint32_t iters,
+                                       const std::vector<VkBufferCopy>& regions) {
+                (void)vkResetCommandPool(dev, pool, 0);
+                (void)vkBeginCommandBuffer(cb, &beginInfo);
+                vkCmdCopyBuffer(cb, src, dst, uint32_t(regions.size()), regions.data());
+                (void)vkEndCommandBuffer(cb);
+                Bench(name, iters, [&]() {
+                    (void)vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+                    (void)vkQueueWaitIdle(queue);
+                });
+            };
+            copyBench("vkCmdCopyBuffer(64K)+vkQueueWaitIdle", 10000, { { 0, 0, 64 << 10 } });
+            copyBench("vkCmdCopyBuffer(64M)+vkQueueWaitIdle", 20, { { 0, 0, kSize } });
+            std::vector<VkBufferCopy> regions;
+            for (uint32_t i = 0; i < 1024; i++) {
+                regions.push_back({ i * 4096, i * 4096, 4096 });
+            }
+            copyBench("vkCmdCopyBuffer(1024 abutting 4K regions)+vkQueueWaitIdle", 1000,
+                      regions);
+
+            (void)vkResetCommandPool(dev, pool, 0);
+            (void)vkBeginCommandBuffer(cb, &beginInfo);
+            vkCmdFillBuffer(cb, dst, 0, VK_WHOLE_SIZE, 0);
+            (void)vkEndCommandBuffer(cb);
+            Bench("vkCmdFillBuffer(64M)+vkQueueWaitIdle", 20, [&]() {
+                (void)vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+                (void)vkQueueWaitIdle(queue);
+            });
+
+            // RGBA8 uploads are straight copies; RGB8 ones pad every texel.
+            for (const auto format : { VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_R8G8B8_UNORM }) {
+                const VkImageCreateInfo imageInfo = {
+                    VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO, nullptr, 0, VK_IMAGE_TYPE_2D,
+                    format, { 2048, 2048, 1 }, 1, 1, VK_SAMPLE_COUNT_1_BIT,
+                    VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                    VK_SHARING_MODE_EXCLUSIVE, 0, nullptr, VK_IMAGE_LAYOUT_UNDEFINED
+                };
+                VkImage image;
+                (void)vkCreateImage(dev, &imageInfo, nullptr, &image);
+                (void)vkBindImageMemory(dev, image, mem, kSize);
+                const VkBufferImageCopy region = {
+                    0, 0, 0, { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 }, { 0, 0, 0 },
+                    { 2048, 2048, 1 }
+                };
+                (void)vkResetCommandPool(dev, pool, 0);
+                (void)vkBeginCommandBuffer(cb, &beginInfo);
+                vkCmdCopyBufferToImage(cb, src, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+                                       &region);
+                (void)vkEndCommandBuffer(cb);
+                Bench(format == VK_FORMAT_R8G8B8_UNORM
+                          ? "vkCmdCopyBufferToImage(RGB8 2048x2048)+vkQueueWaitIdle"
+                          : "vkCmdCopyBufferToImage(RGBA8 2048x2048)+vkQueueWaitIdle",
+                      50, [&]() {
+                    (void)vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+                    (void)vkQueueWaitIdle(queue);
+                });
+                vkDestroyImage(dev, image, nullptr);
+            }
+
+            // A blit per level fuses into passes over several; two regions per level don't.
+            for (const bool fused : { true, false }) {
+                const VkImageCreateInfo imageInfo = {
+                    VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO, nullptr, 0, VK_IMAGE_TYPE_2D,
+                    VK_FORMAT_R8G8B8A8_UNORM, { 2048, 2048, 1 }, 12, 1, VK_SAMPLE_COUNT_1_BIT,
+                    VK_IMAGE_TILING_OPTIMAL,
+                    VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                    VK_SHARING_MODE_EXCLUSIVE, 0, nullptr, VK_IMAGE_LAYOUT_UNDEFINED
+                };
+                VkImage image;
+                (void)vkCreateImage(dev, &imageInfo, nullptr, &image);
+                (void)vkBindImageMemory(dev, image, mem, kSize);
+                const auto layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+                (void)vkResetCommandPool(dev, pool, 0);
+                (void)vkBeginCommandBuffer(cb, &beginInfo);
+                for (uint32_t level = 1; level < 12; level++) {
+                    const int32_t size = 2048 >> level;
+                    VkImageBlit regions[2] = {};
+                    for (auto& x : regions) {
+                        x.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1 };
+                        x.srcOffsets[1] = { size * 2, size * 2, 1 };
+                        x.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+                        x.dstOffsets[1] = { size, size, 1 };
+                    }
+                    if (!fused && size > 1) {
+                        regions[0].srcOffsets[1].y = regions[1].srcOffsets[0].y = size;
+                        regions[0].dstOffsets[1].y = regions[1].dstOffsets[0].y = size / 2;
+                    }
+                    vkCmdBlitImage(cb, image, layout, image, layout, fused ? 1 : 2, regions,
+                                   VK_FILTER_LINEAR);
+                }
+                (void)vkEndCommandBuffer(cb);
+                Bench(fused ? "vkCmdBlitImage(RGBA8 2048x2048 mips)+vkQueueWaitIdle"
+                            : "vkCmdBlitImage(RGBA8 2048x2048 mips, unfused)+vkQueueWaitIdle",
+                      20, [&]() {
+                    (void)vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+                    (void)vkQueueWaitIdle(queue);
+                });
+                vkDestroyImage(dev, image, nullptr);
+            }
+
+            vkDestroyBuffer(dev, src, nullptr);
+            vkDestroyBuffer(dev, dst, nullptr);
+            vkFreeMemory(dev, mem, nullptr);
+        }
+
+        const VkShaderModuleCreateInfo moduleInfo = {
+            VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, nullptr, 0,
+            sizeof(kLocalShader), kLocalShader
+        };
+        VkShaderModule module;
+        (void)vkCreateShaderModule(dev, &moduleInfo, nullptr, &module);
+        Bench("vkCreateShaderModule(shared)+vkDestroyShaderModule", 100000, [&]() {
+            VkShaderModule twin;
+            (void)vkCreateShaderModule(dev, &moduleInfo, nullptr, &twin);
+            vkDestroyShaderModule(dev, twin, nullptr);
+        });
+        const VkPushConstantRange pushRange = { VK_SHADER_STAGE_COMPUTE_BIT, 0, 4 };
+        const VkPipelineLayoutCreateInfo layoutInfo = {
+            VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO, nullptr, 0,
+            0, nullptr,
+            1, &pushRange
+        };
+        VkPipelineLayout layout;
+        (void)vkCreatePipelineLayout(dev, &layoutInfo, nullptr, &layout);
+        VkComputePipelineCreateInfo pipelineInfo = {};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = module;
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.layout = layout;
+        Bench("vkCreateComputePipelines+vkDestroyPipeline", 10000, [&]() {
+            VkPipeline pipeline;
+            (void)vkCreateComputePipelines(dev, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr,
+                                           &pipeline);
+            vkDestroyPipeline(dev, pipeline, nullptr);
+        });
+        std::vector<VkComputePipelineCreateInfo> batchInfos(64, pipelineInfo);
+        std::vector<VkPipeline> batch(batchInfos.size());
+        Bench("64x vkCreateComputePipelines+vkDestroyPipeline", 100, [&]() {
+            (void)vkCreateComputePipelines(dev, VK_NULL_HANDLE, uint32_t(batch.size()),
+                                           batchInfos.data(), nullptr, batch.data());
+            for (const auto& x : batch) {
+                vkDestroyPipeline(dev, x, nullptr);
+            }
+        });
+        const VkPipelineCacheCreateInfo cacheInfo = {
+            VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO, nullptr, 0,
+            0, nullptr
+        };
+        VkPipelineCache cache;
+        (void)vkCreatePipelineCache(dev, &cacheInfo, nullptr, &cache);
+        Bench("vkCreateComputePipelines(hit)+vkDestroyPipeline", 100000, [&]() {
+            VkPipeline pipeline;
+            (void)vkCreateComputePipelines(dev, cache, 1, &pipelineInfo, nullptr, &pipeline);
+            vkDestroyPipeline(dev, pipeline, nullptr);
+        });
+        vkDestroyPipelineCache(dev, cache, nullptr);
+
+        // 64 invocations per group, with a barrier in the middle.
+        VkPipeline pipeline;
+        (void)vkCreateComputePipelines(dev, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr,
+                                       &pipeline);
+        (void)vkResetCommandPool(dev, pool, 0);
+        (void)vkBeginCommandBuffer(cb, &beginInfo);
+        vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+        vkCmdDispatch(cb, 1024, 1, 1);
+        (void)vkEndCommandBuffer(cb);
+        Bench("vkCmdDispatch(1024 groups, shader)+vkQueueWaitIdle", 100, [&]() {
+            (void)vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+            (void)vkQueueWaitIdle(queue);
+        });
+
+        vkDestroyPipeline(dev, pipeline, nullptr);
+        vkDestroyPipelineLayout(dev, layout, nullptr);
+        vkDestroyShaderModule(dev, module, nullptr);
+        vkDestroyCommandPool(dev, pool, nullptr);
+    }
+
+    {
+        const VkDescriptorSetLayoutBinding bindings[] = {
+            { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+            { 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+        };
+        const VkDescriptorSetLayoutCreateInfo setLayoutInfo = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO, nullptr, 0,
+            2, bindings
+        };
+        VkDescriptorSetLayout setLayout;
+        (void)vkCreateDescriptorSetLayout(dev, &setLayoutInfo, nullptr, &setLayout);
+
+        const uint32_t kSets = 50000;
+        const VkDescriptorPoolSize poolSizes[] = {
+            { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 * kSets },
+            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, kSets },
+        };
+        const VkDescriptorPoolCreateInfo poolInfo = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO, nullptr, 0,
+            kSets, 2, poolSizes
+        };
+        VkDescriptorPool pool;
+        (void)vkCreateDescriptorPool(dev, &poolInfo, nullptr, &pool);
+        const VkDescriptorSetAllocateInfo allocInfo = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, nullptr,
+            pool, 1, &setLayout
+        };
+        Bench("50000x vkAllocateDescriptorSets+vkResetDescriptorPool", 100, [&]() {
+            VkDescriptorSet set;
+            for (uint32_t i = 0; i < kSets; i++) {
+                (void)vkAllocateDescriptorSets(dev, &allocInfo, &set);
+            }
+            (void)vkResetDescriptorPool(dev, pool, 0);
+        });
+
+        const VkBufferCreateInfo bufferInfo = {
+            VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, nullptr, 0,
+            4096, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VK_SHARING_MODE_EXCLUSIVE, 0, nullptr
+        };
+        VkBuffer buffer;
+        (void)vkCreateBuffer(dev, &bufferInfo, nullptr, &buffer);
+        VkDescriptorSet sets[2];
+        (void)vkAllocateDescriptorSets(dev, &allocInfo, &sets[0]);
+        (void)vkAllocateDescriptorSets(dev, &allocInfo, &sets[1]);
+        const VkDescriptorBufferInfo bufferInfos[] = {
+            { buffer, 0, 1024 }, { buffer, 1024, 1024 }, { buffer, 2048, VK_WHOLE_SIZE },
+        };
+        VkWriteDescriptorSet writes[2] = {};
+        for (auto& x : writes) {
+            x.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            x.dstSet = sets[0];
+        }
+        writes[0].descriptorCount = 2;
+        writes[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[0].pBufferInfo = bufferInfos;
+        writes[1].dstBinding = 1;
+        writes[1].descriptorCount = 1;
+        writes[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        writes[1].pBufferInfo = bufferInfos + 2;
+        VkCopyDescriptorSet copy = {};
+        copy.sType = VK_STRUCTURE_TYPE_COPY_DESCRIPTOR_SET;
+        copy.srcSet = sets[0];
+        copy.dstSet = sets[1];
+        copy.descriptorCount = 2;
+        Bench("vkUpdateDescriptorSets(2 writes, 1 copy)", 100000, [&]() {
+            vkUpdateDescriptorSets(dev, 2, writes, 1, &copy);
+        });
+
+        // The same three descriptors from one struct, as one merged copy.
+        const auto createTemplate = (PFN_vkCreateDescriptorUpdateTemplateKHR)
+            vkGetDeviceProcAddr(dev, "vkCreateDescriptorUpdateTemplateKHR");
+        const auto destroyTemplate = (PFN_vkDestroyDescriptorUpdateTemplateKHR)
+            vkGetDeviceProcAddr(dev, "vkDestroyDescriptorUpdateTemplateKHR");
+        const auto updateWithTemplate = (PFN_vkUpdateDescriptorSetWithTemplateKHR)
+            vkGetDeviceProcAddr(dev, "vkUpdateDescriptorSetWithTemplateKHR");
+        const VkDescriptorUpdateTemplateEntryKHR entries[] = {
+            { 0, 0, 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, sizeof(bufferInfos[0]) },
+            { 1, 0, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2 * sizeof(bufferInfos[0]), 0 },
+        };
+        VkDescriptorUpdateTemplateCreateInfoKHR templateInfo = {};
+        templateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO_KHR;
+        templateInfo.descriptorUpdateEntryCount = 2;
+        templateInfo.pDescriptorUpdateEntries = entries;
+        templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET_KHR;
+        templateInfo.descriptorSetLayout = setLayout;
+        VkDescriptorUpdateTemplateKHR updateTemplate;
+        (void)createTemplate(dev, &templateInfo, nullptr, &updateTemplate);
+        Bench("vkUpdateDescriptorSetWithTemplateKHR(3 buffers)", 100000, [&]() {
+            updateWithTemplate(dev, sets[0], updateTemplate, bufferInfos);
+        });
+        destroyTemplate(dev, updateTemplate, nullptr);
+        vkDestroyBuffer(dev, buffer, nullptr);
+        vkDestroyDescriptorPool(dev, pool, nullptr);
+        vkDestroyDescriptorSetLayout(dev, setLayout, nullptr);
+    }
+
+    BenchParallelRecording(dev);
+
+    vkDestroyDevice(dev, nullptr);
+    vkDestroyInstance(inst, nullptr);
+    return 0;
+}
@@ -4,26 +4,20 @@
 #include <mutex>
 
 std::mutex MirvInstance::gMutex;
-std::set<rp<MirvInstance>> MirvInstance::gInstances;
+std::set<rp<MirvInstance>, std::less<>> MirvInstance::gInstances;
 
-MirvInstance::MirvInstance()
-    : MirvObject(MirvObjectType::Instance)
+MirvInstance::MirvInstance(const VkAllocationCallbacks& allocator)
+    : MirvDispatchableObject(MirvObjectType::Instance)
+    , mAllocator(allocator)
 {
-#ifdef HAS_D3D12
-    AddPhysDevs<Backends::D3D12>();
-#endif
-#ifdef HAS_METAL
-    AddPhysDevs<Backends::Metal>();
-#endif
-#ifdef HAS_VULKAN
-    AddPhysDevs<Backends::Vulkan>();
-#endif
+    mDispatch.Init(MirvProcLevel::Global, MirvProcLevel::Device);
 }
 
 MirvInstance::~MirvInstance() = default;
 
 /*static*/ VkResult
 MirvInstance::vkCreateInstance(const VkInstanceCreateInfo& createInfo,
+                               const VkAllocationCallbacks* const allocator,
                                MirvInstance** const out)
 {
     ASSERT(!createInfo.pNext)
@@ -33,10 +27,14 @@ MirvInstance::vkCreateInstance(const VkInstanceCreateInfo& createInfo,
     if (appInfo) {
         ASSERT(!appInfo->pNext)
 
+        // The loader passes the app's version through, patch number and all.
         const auto& apiVersion = appInfo->apiVersion;
         if (apiVersion) {
-            if (apiVersion != VK_API_VERSION_1_0)
+            if (VK_VERSION_MAJOR(apiVersion) != 1 ||
+                VK_VERSION_MINOR(apiVersion) != 0)
+            {
                 return VK_ERROR_INCOMPATIBLE_DRIVER;
+            }
         }
     }
 
@@ -45,7 +43,11 @@ MirvInstance::vkCreateInstance(const VkInstanceCreateInfo& createInfo,
     if (createInfo.enabledExtensionCount)
         return VK_ERROR_EXTENSION_NOT_PRESENT;
 
-    const auto& inst = new MirvInstance;
+    const auto& instAllocator = allocator ? *allocator : MirvHeapCallbacks();
+    const auto& inst = new (instAllocator, VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE)
+                           MirvInstance(instAllocator);
+    if (!inst)
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
     {
         const mutex_guard guard(gMutex);
         gInstances.insert(inst);
@@ -54,51 +56,134 @@ MirvInstance::vkCreateInstance(const VkInstanceCreateInfo& createInfo,
     return VK_SUCCESS;
 }
 
+void
+MirvInstance::EnsurePhysDevs()
+{
+    std::call_once(mPhysDevsOnce, [&]() {
+#ifdef HAS_CPU
+        AddPhysDevs<Backends::CPU>();
+#endif
+#ifdef HAS_D3D12
+        AddPhysDevs<Backends::D3D12>();
+#endif
+#ifdef HAS_METAL
+        AddPhysDevs<Backends::Metal>();
+#endif
+#ifdef HAS_VULKAN
+        AddPhysDevs<Backends::Vulkan>();
+#endif
+
+        mPhysDevHandles.reserve(mPhysDevs.size());
+        for (const auto& x : mPhysDevs) {
+            mPhysDevHandles.push_back(x->Handle());
+        }
+    });
+}
+
 VkResult
-MirvInstance::vkEnumeratePhysicalDevices(const VkInstance handle,
-                                         uint32_t* const out_physicalDeviceCount,
-                                         MirvPhysicalDevice** const out_physicalDevices) const
+MirvInstance::vkEnumeratePhysicalDevices(uint32_t* const out_physicalDeviceCount,
+                                         VkPhysicalDevice* const out_physicalDevices)
 {
-    std::vector<MirvPhysicalDevice*> ret;
-    ret.reserve(mPhysDevs.size());
-    for (const auto& x : mPhysDevs) {
-        ret.push_back(x.get());
-    }
-    return VulkanArrayCopyMeme(ret, out_physicalDeviceCount, out_physicalDevices);
+    EnsurePhysDevs();
+    return VulkanArrayCopyMeme(mPhysDevHandles, out_physicalDeviceCount,
+                               out_physicalDevices);
 }
 
 void
 MirvInstance::vkDestroyInstance()
 {
     const mutex_guard guard(gMutex);
-    gInstances.erase(this);
+    gInstances.erase(gInstances.find(this));
 }
 
 // --
 
+static const std::vector<VkExtensionProperties> kDeviceExtensions = {
+    { VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME,
+      VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_SPEC_VERSION },
+};
+
+VkResult
+MirvPhysicalDevice::vkEnumerateDeviceExtensionProperties(const char* const layerName,
+                                                         uint32_t* const out_count,
+                                                         VkExtensionProperties* const out) const
+{
+    if (layerName)
+        return VK_ERROR_LAYER_NOT_PRESENT;
+    return VulkanArrayCopyMeme(kDeviceExtensions, out_count, out);
+}
+
 VkResult
 MirvPhysicalDevice::vkCreateDevice(const VkDeviceCreateInfo& createInfo,
+                                   const VkAllocationCallbacks* const allocator,
                                    MirvDevice** const out)
 {
+    // Every extension's entrypoints are always there; enabling one changes nothing.
+    for (const auto& name : Range(createInfo.ppEnabledExtensionNames,
+                                  createInfo.enabledExtensionCount)) {
+        const auto itr = std::find_if(kDeviceExtensions.begin(), kDeviceExtensions.end(),
+                                      [&](const VkExtensionProperties& x) {
+                                          return strcmp(x.extensionName, name) == 0;
+                                      });
+        if (itr == kDeviceExtensions.end())
+            return VK_ERROR_EXTENSION_NOT_PRESENT;
+    }
+
     rp<MirvDevice> dev;
-    const auto res = CreateDevice(createInfo, &dev);
+    const auto res = CreateDevice(createInfo, allocator, &dev);
     if (dev) {
-        const mutex_guard guard(mMutex);
-        mDevices.insert(dev);
+        const mutex_guard guard(mDevicesMutex);
+        *out = dev.get();
+        mDevices.insert(std::move(dev));
     }
-    *out = dev.get();
     return res;
 }
 
+void
+MirvPhysicalDevice::RemoveDevice(MirvDevice* const dev)
+{
+    const mutex_guard guard(mDevicesMutex);
+    mDevices.erase(mDevices.find(dev));
+}
+
 // --
 
-MirvDevice::MirvDevice(MirvPhysicalDevice& physDev)
-    : MirvObject(MirvObjectType::Device)
+MirvDevice::MirvDevice(MirvPhysicalDevice& physDev,
+                       const VkAllocationCallbacks* const allocator)
+    : MirvDispatchableObject(MirvObjectType::Device)
     , mPhysDev(physDev)
-{ }
+    , mAllocator(allocator ? *allocator : mArena.Callbacks())
+    , mCmdChunks(mAllocator)
+    , mFenceEpoch(0)
+    , mFenceEpochWaiters(0)
+    , mHandles(mAllocator)
+{
+    mDispatch.Init(MirvProcLevel::Device, MirvProcLevel::Device);
+    for (auto& x : mHeapUsage) {
+        x.store(0, std::memory_order_relaxed);
+    }
+
+    mHasNonCoherentMemory = false;
+    const auto& memProps = mPhysDev.mMemoryProperties;
+    for (const auto& type : Range(memProps.memoryTypes, memProps.memoryTypeCount)) {
+        const auto& flags = type.propertyFlags;
+        if ((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) &&
+            !(flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+        {
+            mHasNonCoherentMemory = true;
+        }
+    }
+}
 
 MirvDevice::~MirvDevice() = default;
 
+void
+MirvDevice::vkDestroyDevice()
+{
+    mBackgroundCompiles.WaitForZero();
+    mPhysDev.RemoveDevice(this); // Probably our last reference.
+}
+
 
 void
 MirvDevice::vkGetDeviceQueue(const uint32_t queueFamilyIndex, const uint32_t queueIndex,
@@ -108,7 +193,7 @@ MirvDevice::vkGetDeviceQueue(const uint32_t queueFamilyIndex, const uint32_t que
     ASSERT(itr != mQueuesByFamily.end())
     const auto& queues = itr->second;
 
-    ASSERT(queueIndex >= queues.size())
+    ASSERT(queueIndex < queues.size())
     *out = queues[queueIndex].get();
 }
 
@@ -125,6 +210,8 @@ MirvDevice::AddAllQueues(const VkDeviceCreateInfo& createInfo)
         if (familyIndex >= mPhysDev.mQueueFamilyProperties.size())
             return VK_ERROR_INITIALIZATION_FAILED;
         const auto& familyInfo = mPhysDev.mQueueFamilyProperties[familyIndex];
+        if (!info.queueCount || info.queueCount > familyInfo.queueCount)
+            return VK_ERROR_INITIALIZATION_FAILED;
 
         const auto res = mQueuesByFamily.insert({familyIndex,
                                                  std::vector<rp<MirvQueue>>()});
@@ -132,6 +219,7 @@ MirvDevice::AddAllQueues(const VkDeviceCreateInfo& createInfo)
         if (!didInsert)
             return VK_ERROR_INITIALIZATION_FAILED;
         auto& queues = res.first->second;
+        queues.reserve(info.queueCount);
 
         const auto vkRes = AddQueues(info, familyInfo, &queues);
         if (vkRes != VK_SUCCESS)
@@ -140,16 +228,620 @@ MirvDevice::AddAllQueues(const VkDeviceCreateInfo& createInfo)
     return VK_SUCCESS;
 }
 
+// --
+
+VkResult
+MirvDevice::NewBlock(const uint32_t typeIndex, const uint64_t size,
+                     rp<MirvMemoryBlock>* const out)
+{
+    const auto& heapIndex = mPhysDev.mMemoryProperties.memoryTypes[typeIndex].heapIndex;
+    const auto& heapSize = mPhysDev.mMemoryProperties.memoryHeaps[heapIndex].size;
+    auto& usage = mHeapUsage[heapIndex];
+    if (usage.fetch_add(size) + size > heapSize) {
+        usage -= size;
+        return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+    }
+
+    const auto res = AllocBlock(typeIndex, size, out);
+    if (res != VK_SUCCESS) {
+        usage -= size;
+    }
+    return res;
+}
+
+void
+MirvDevice::DropHeapUsage(const MirvMemoryBlock* const block)
+{
+    const auto& heapIndex = mPhysDev.mMemoryProperties.memoryTypes[block->mTypeIndex].heapIndex;
+    mHeapUsage[heapIndex] -= block->mSize;
+}
+
+VkResult
+MirvDevice::Suballocate(const uint32_t typeIndex, const uint64_t size,
+                        rp<MirvMemoryBlock>* const out_block, uint64_t* const out_offset)
+{
+    auto& pool = mMemoryPools[typeIndex];
+    const mutex_guard guard(pool.mMutex);
+
+    // Newest blocks are the least fragmented, so try them first.
+    for (auto itr = pool.mBlocks.rbegin(); itr != pool.mBlocks.rend(); ++itr) {
+        const auto& block = *itr;
+        if (block->mBuddy->Alloc(size, out_offset)) {
+            *out_block = block;
+            return VK_SUCCESS;
+        }
+    }
+
+    rp<MirvMemoryBlock> block;
+    const auto res = NewBlock(typeIndex, kMemoryBlockSize, &block);
+    if (res != VK_SUCCESS)
+        return res;
+    block->mBuddy.reset(new (mAllocator, VK_SYSTEM_ALLOCATION_SCOPE_DEVICE)
+                        MirvBuddyAllocator(kMemoryBlockSize));
+    if (!block->mBuddy) {
+        DropHeapUsage(block.get());
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+    ALWAYS_TRUE( block->mBuddy->Alloc(size, out_offset) )
+
+    *out_block = block;
+    pool.mBlocks.push_back(std::move(block));
+    return VK_SUCCESS;
+}
+
+void
+MirvDevice::FreeMemoryRange(MirvMemoryBlock* const block, const uint64_t offset,
+                            const uint64_t size)
+{
+    if (!block->mBuddy) {
+        DropHeapUsage(block); // Dedicated, so the block dies with its MirvDeviceMemory.
+        return;
+    }
+
+    auto& pool = mMemoryPools[block->mTypeIndex];
+    const mutex_guard guard(pool.mMutex);
+
+    block->mBuddy->Free(offset, size);
+    if (block->mBuddy->Used() || pool.mBlocks.size() == 1)
+        return;
+
+    // Keep one block around, so alloc/free churn doesn't thrash the backend.
+    const auto itr = std::find_if(pool.mBlocks.begin(), pool.mBlocks.end(),
+                                  [&](const rp<MirvMemoryBlock>& x) {
+                                      return x.get() == block;
+                                  });
+    ASSERT(itr != pool.mBlocks.end())
+    DropHeapUsage(block);
+    pool.mBlocks.erase(itr); // The caller still holds a ref.
+}
+
+VkResult
+MirvDevice::vkAllocateMemory(const VkMemoryAllocateInfo& info,
+                             const VkAllocationCallbacks* const allocator,
+                             MirvDeviceMemory** const out)
+{
+    ASSERT(!info.pNext)
+    ASSERT(info.allocationSize)
+    if (info.memoryTypeIndex >= mPhysDev.mMemoryProperties.memoryTypeCount)
+        return VK_ERROR_INITIALIZATION_FAILED;
+
+    rp<MirvMemoryBlock> block;
+    uint64_t offset = 0;
+    VkResult res;
+    if (info.allocationSize <= kMaxSuballocSize) {
+        res = Suballocate(info.memoryTypeIndex, info.allocationSize, &block, &offset);
+    } else {
+        res = NewBlock(info.memoryTypeIndex, info.allocationSize, &block);
+    }
+    if (res != VK_SUCCESS)
+        return res;
+
+    const auto& mem = new (ChildAllocator(allocator), VK_SYSTEM_ALLOCATION_SCOPE_OBJECT)
+                          MirvDeviceMemory(*this, block.get(), offset, info.allocationSize);
+    if (!mem) {
+        FreeMemoryRange(block.get(), offset, info.allocationSize);
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+    return AddHandle(mem, out);
+}
+
+void
+MirvDevice::vkFreeMemory(const VkDeviceMemory handle)
+{
+    RemoveHandle<MirvDeviceMemory>(handle);
+}
+
+// Every block is mapped for its whole life, so mapping is just pointer math.
+VkResult
+MirvDevice::vkMapMemory(MirvDeviceMemory* const mem, const VkDeviceSize offset,
+                        const VkDeviceSize size, const VkMemoryMapFlags flags,
+                        void** const out_data) const
+{
+    ASSERT(!flags)
+    ASSERT(!mem->mMapped)
+    ASSERT(offset < mem->mSize)
+    ASSERT(size == VK_WHOLE_SIZE || offset + size <= mem->mSize)
+    (void)size;
+    (void)flags;
+
+    const auto hostPtr = mem->HostPtr();
+    if (!hostPtr)
+        return VK_ERROR_MEMORY_MAP_FAILED;
+    mem->mMapped = true;
+    *out_data = hostPtr + offset;
+    return VK_SUCCESS;
+}
+
+void
+MirvDevice::vkUnmapMemory(MirvDeviceMemory* const mem) const
+{
+    ASSERT(mem->mMapped)
+    mem->mMapped = false;
+}
+
+// Coalesces the non-coherent ranges by block, and calls fn(block, ranges) once per block.
+// Coherent memory needs neither flushes nor invalidates, so it never gets this far.
+template<typename F>
+void
+MirvDevice::ForEachNonCoherentBlock(const uint32_t count, const VkMappedMemoryRange* const ranges,
+                                    const F& fn) const
+{
+    struct BlockRange final {
+        MirvMemoryBlock* mBlock;
+        MirvMemoryBlock::Range mRange;
+
+        bool operator <(const BlockRange& x) const {
+            if (mBlock != x.mBlock)
+                return mBlock < x.mBlock;
+            return mRange.mBegin < x.mRange.mBegin;
+        }
+    };
+
+    if (!mHasNonCoherentMemory)
+        return;
+
+    std::vector<BlockRange> sorted;
+    for (const auto& x : Range(ranges, count)) {
+        ASSERT(!x.pNext)
+        const auto& mem = MirvDeviceMemory::For(*this, x.memory);
+        if (mem->mCoherent)
+            continue;
+
+        const auto size = (x.size == VK_WHOLE_SIZE ? mem->mSize - x.offset : x.size);
+        const auto begin = mem->mOffset + x.offset;
+        sorted.push_back({ mem->mBlock.get(), { begin, begin + size } });
+    }
+    if (sorted.empty())
+        return;
+    std::sort(sorted.begin(), sorted.end());
+
+    std::vector<MirvMemoryBlock::Range> merged;
+    for (size_t i = 0; i < sorted.size(); ) {
+        const auto& block = sorted[i].mBlock;
+        merged.clear();
+        for (; i < sorted.size() && sorted[i].mBlock == block; i++) {
+            const auto& cur = sorted[i].mRange;
+            if (!merged.empty() && cur.mBegin <= merged.back().mEnd) {
+                merged.back().mEnd = std::max(merged.back().mEnd, cur.mEnd);
+                continue;
+            }
+            merged.push_back(cur);
+        }
+        fn(block, merged);
+    }
+}
+
+VkResult
+MirvDevice::vkFlushMappedMemoryRanges(const uint32_t count,
+                                      const VkMappedMemoryRange* const ranges) const
+{
+    ForEachNonCoherentBlock(count, ranges,
+                            [](MirvMemoryBlock* const block,
+                               const std::vector<MirvMemoryBlock::Range>& blockRanges)
+                            {
+                                block->FlushRanges(blockRanges);
+                            });
+    return VK_SUCCESS;
+}
+
+VkResult
+MirvDevice::vkInvalidateMappedMemoryRanges(const uint32_t count,
+                                           const VkMappedMemoryRange* const ranges) const
+{
+    ForEachNonCoherentBlock(count, ranges,
+                            [](MirvMemoryBlock* const block,
+                               const std::vector<MirvMemoryBlock::Range>& blockRanges)
+                            {
+                                block->InvalidateRanges(blockRanges);
+                            });
+    return VK_SUCCESS;
+}
+
+// --
+
+MirvDeviceMemory::MirvDeviceMemory(MirvDevice& device, MirvMemoryBlock* const block,
+                                   const uint64_t offset, const uint64_t size)
+    : MirvNonDispatchableObject(device)
+    , mBlock(block)
+    , mOffset(offset)
+    , mSize(size)
+    , mCoherent(device.mPhysDev.mMemoryProperties.memoryTypes[block->mTypeIndex].propertyFlags &
+                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+    , mMapped(false)
+{ }
+
+MirvDeviceMemory::~MirvDeviceMemory()
+{
+    mDevice.FreeMemoryRange(mBlock.get(), mOffset, mSize);
+}
+
+// --
+
+MirvBuffer::MirvBuffer(MirvDevice& device, const VkBufferCreateInfo& info)
+    : MirvNonDispatchableObject(device)
+    , mSize(info.size)
+    , mUsage(info.usage)
+    , mBlockOffset(0)
+{ }
+
+VkResult
+MirvDevice::vkCreateBuffer(const VkBufferCreateInfo& createInfo,
+                           const VkAllocationCallbacks* const allocator,
+                           MirvBuffer** const out)
+{
+    ASSERT(!createInfo.pNext)
+    ASSERT(!createInfo.flags) // No sparse.
+    ASSERT(createInfo.size)
+    const auto& buffer = new (ChildAllocator(allocator), VK_SYSTEM_ALLOCATION_SCOPE_OBJECT)
+                             MirvBuffer(*this, createInfo);
+    return AddHandle(buffer, out);
+}
+
+void
+MirvDevice::vkDestroyBuffer(const VkBuffer handle)
+{
+    RemoveHandle<MirvBuffer>(handle);
+}
+
+void
+MirvDevice::vkGetBufferMemoryRequirements(const MirvBuffer* const buffer,
+                                          VkMemoryRequirements* const out) const
+{
+    const auto& limits = mPhysDev.mLimits;
+    const auto alignment = std::max({ VkDeviceSize(16),
+                                      limits.minTexelBufferOffsetAlignment,
+                                      limits.minUniformBufferOffsetAlignment,
+                                      limits.minStorageBufferOffsetAlignment });
+    out->size = (buffer->mSize + alignment - 1) / alignment * alignment;
+    out->alignment = alignment;
+    // Buffers are just offsets into memory blocks, so any type will do.
+    out->memoryTypeBits = (1u << mPhysDev.mMemoryProperties.memoryTypeCount) - 1;
+}
+
+VkResult
+MirvDevice::vkBindBufferMemory(MirvBuffer* const buffer, const MirvDeviceMemory* const mem,
+                               const VkDeviceSize offset) const
+{
+    ASSERT(!buffer->mBlock)
+    ASSERT(offset + buffer->mSize <= mem->mSize)
+    buffer->mBlock = mem->mBlock;
+    buffer->mBlockOffset = mem->mOffset + offset;
+    return VK_SUCCESS;
+}
+
+// --
+
+VkResult
+MirvDevice::vkCreateShaderModule(const VkShaderModuleCreateInfo& createInfo,
+                                 const VkAllocationCallbacks* const allocator,
+                                 MirvShaderModule** const out)
+{
+    ASSERT(!createInfo.pNext)
+    ASSERT(createInfo.codeSize % 4 == 0)
+    const auto& module = new (ChildAllocator(allocator), VK_SYSTEM_ALLOCATION_SCOPE_OBJECT)
+                             MirvShaderModule(*this, createInfo);
+    return AddHandle(module, out);
+}
+
+void
+MirvDevice::vkDestroyShaderModule(const VkShaderModule handle)
+{
+    RemoveHandle<MirvShaderModule>(handle);
+}
+
+VkResult
+MirvDevice::vkCreatePipelineCache(const VkPipelineCacheCreateInfo& createInfo,
+                                  const VkAllocationCallbacks* const allocator,
+                                  MirvPipelineCache** const out)
+{
+    ASSERT(!createInfo.pNext)
+    const auto& cache = new (ChildAllocator(allocator), VK_SYSTEM_ALLOCATION_SCOPE_OBJECT)
+                            MirvPipelineCache(*this, createInfo, ChildAllocator(allocator));
+    return AddHandle(cache, out);
+}
+
+void
+MirvDevice::vkDestroyPipelineCache(const VkPipelineCache handle)
+{
+    RemoveHandle<MirvPipelineCache>(handle);
+}
+
+VkResult
+MirvDevice::vkGetPipelineCacheData(const MirvPipelineCache* const cache,
+                                   size_t* const inout_size, void* const out_data) const
+{
+    return cache->GetData(inout_size, out_data);
+}
+
+VkResult
+MirvDevice::vkMergePipelineCaches(MirvPipelineCache* const dst, const uint32_t srcCount,
+                                  const VkPipelineCache* const srcs) const
+{
+    for (const auto& handle : Range(srcs, srcCount)) {
+        dst->MergeFrom(*MirvPipelineCache::For(*this, handle));
+    }
+    return VK_SUCCESS;
+}
+
+VkResult
+MirvDevice::vkCreateDescriptorSetLayout(const VkDescriptorSetLayoutCreateInfo& createInfo,
+                                        const VkAllocationCallbacks* const allocator,
+                                        MirvDescriptorSetLayout** const out)
+{
+    ASSERT(!createInfo.pNext)
+    const auto& layout = new (ChildAllocator(allocator), VK_SYSTEM_ALLOCATION_SCOPE_OBJECT)
+                             MirvDescriptorSetLayout(*this, createInfo);
+    return AddHandle(layout, out);
+}
+
+void
+MirvDevice::vkDestroyDescriptorSetLayout(const VkDescriptorSetLayout handle)
+{
+    RemoveHandle<MirvDescriptorSetLayout>(handle);
+}
+
+VkResult
+MirvDevice::vkCreateDescriptorPool(const VkDescriptorPoolCreateInfo& createInfo,
+                                   const VkAllocationCallbacks* const allocator,
+                                   MirvDescriptorPool** const out)
+{
+    ASSERT(!createInfo.pNext)
+    const auto& pool = new (ChildAllocator(allocator), VK_SYSTEM_ALLOCATION_SCOPE_OBJECT)
+                           MirvDescriptorPool(*this, createInfo, ChildAllocator(allocator));
+    if (pool && !pool->mStorage) {
+        delete pool; // Still unreferenced.
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+    return AddHandle(pool, out);
+}
+
+void
+MirvDevice::vkDestroyDescriptorPool(const VkDescriptorPool handle)
+{
+    RemoveHandle<MirvDescriptorPool>(handle);
+}
+
+VkResult
+MirvDevice::vkCreateDescriptorUpdateTemplateKHR(
+    const VkDescriptorUpdateTemplateCreateInfoKHR& createInfo,
+    const VkAllocationCallbacks* const allocator, MirvDescriptorUpdateTemplate** const out)
+{
+    ASSERT(!createInfo.pNext)
+    const auto& tmpl = new (ChildAllocator(allocator), VK_SYSTEM_ALLOCATION_SCOPE_OBJECT)
+                           MirvDescriptorUpdateTemplate(*this, createInfo);
+    return AddHandle(tmpl, out);
+}
+
+void
+MirvDevice::vkDestroyDescriptorUpdateTemplateKHR(const VkDescriptorUpdateTemplateKHR handle)
+{
+    RemoveHandle<MirvDescriptorUpdateTemplate>(handle);
+}
+
+VkResult
+MirvDevice::vkCreatePipelineLayout(const VkPipelineLayoutCreateInfo& createInfo,
+                                   const VkAllocationCallbacks* const allocator,
+                                   MirvPipelineLayout** const out)
+{
+    ASSERT(!createInfo.pNext)
+    const auto& layout = new (ChildAllocator(allocator), VK_SYSTEM_ALLOCATION_SCOPE_OBJECT)
+                             MirvPipelineLayout(*this, createInfo);
+    return AddHandle(layout, out);
+}
+
+void
+MirvDevice::vkDestroyPipelineLayout(const VkPipelineLayout handle)
+{
+    RemoveHandle<MirvPipelineLayout>(handle);
+}
+
+// Like every vkCreate*Pipelines, failures leave null handles, and we return the first
+// failure once we've tried them all.
+VkResult
+MirvDevice::vkCreateComputePipelines(const VkPipelineCache cacheHandle,
+                                     const uint32_t count,
+                                     const VkComputePipelineCreateInfo* const createInfos,
+                                     const VkAllocationCallbacks* const allocator,
+                                     VkPipeline* const out)
+{
+    const auto cache = cacheHandle ? MirvPipelineCache::For(*this, cacheHandle) : nullptr;
+    // Handles go out first, since async compiles outlive this call.
+    std::vector<MirvPipeline*> pipelines(count);
+    std::vector<VkResult> results(count);
+    for (uint32_t i = 0; i < count; i++) {
+        const auto& info = createInfos[i];
+        ASSERT(!info.pNext)
+        ASSERT(info.stage.stage == VK_SHADER_STAGE_COMPUTE_BIT)
+        const auto& layout = MirvPipelineLayout::For(*this, info.layout);
+        const auto& pipeline = new (ChildAllocator(allocator), VK_SYSTEM_ALLOCATION_SCOPE_OBJECT)
+                                   MirvPipeline(*this, VK_PIPELINE_BIND_POINT_COMPUTE, layout);
+        results[i] = AddHandle(pipeline, &pipelines[i]);
+        if (results[i] != VK_SUCCESS) {
+            pipelines[i] = nullptr;
+        }
+    }
+
+    const auto waited = CompileComputePipelines(cache, count, createInfos, pipelines.data());
+    VkResult ret = VK_SUCCESS;
+    for (uint32_t i = 0; i < count; i++) {
+        const auto& pipeline = pipelines[i];
+        out[i] = VK_NULL_HANDLE;
+        // Async compiles can still fail early, for SPIR-V that never got as far as one.
+        if (pipeline && (waited || pipeline->IsCompiled()) && !pipeline->Shader()) {
+            RemoveHandle<MirvPipeline>(pipeline->Handle());
+            results[i] = VK_ERROR_NOT_IMPLEMENTED;
+        }
+        if (results[i] == VK_SUCCESS) {
+            out[i] = pipeline->Handle();
+        } else if (ret == VK_SUCCESS) {
+            ret = results[i];
+        }
+    }
+    return ret;
+}
+
+void
+MirvDevice::vkDestroyPipeline(const VkPipeline handle)
+{
+    if (!handle)
+        return;
+    (void)MirvPipeline::For(*this, handle)->Shader(); // Its compile may still be running.
+    RemoveHandle<MirvPipeline>(handle);
+}
+
+// --
+
 VkResult
 MirvDevice::vkCreateCommandPool(const VkCommandPoolCreateInfo& createInfo,
-                                MirvCommandPool** const out) const
+                                const VkAllocationCallbacks* const allocator,
+                                MirvCommandPool** const out)
 {
-    const auto& itr = mQueuesByFamily.find(createInfo.queueFamilyIndex);
-    ASSERT(itr != mQueuesByFamily.end())
-    const auto& queues = itr->second;
+    if (!mQueuesByFamily.count(createInfo.queueFamilyIndex))
+        return VK_ERROR_INITIALIZATION_FAILED;
+
+    const auto& pool = new (ChildAllocator(allocator), VK_SYSTEM_ALLOCATION_SCOPE_OBJECT)
+                           MirvCommandPool(*this, createInfo, allocator);
+    return AddHandle(pool, out);
+}
+
+void
+MirvDevice::vkDestroyCommandPool(const VkCommandPool handle)
+{
+    RemoveHandle<MirvCommandPool>(handle);
+}
 
-    ASSERT(!queues.size())
-    const auto& someQueue = queues[0];
-    const auto& family = someQueue->mFamily;
-    return VK_ERROR_NOT_IMPLEMENTED;
-}
\ No newline at end of file
+// --
+
+VkResult
+MirvDevice::vkCreateFence(const VkFenceCreateInfo& createInfo,
+                          const VkAllocationCallbacks* const allocator,
+                          MirvFence** const out)
+{
+    ASSERT(!createInfo.pNext)
+    const auto& fence = new (ChildAllocator(allocator), VK_SYSTEM_ALLOCATION_SCOPE_OBJECT)
+                            MirvFence(*this, createInfo);
+    return AddHandle(fence, out);
+}
+
+void
+MirvDevice::vkDestroyFence(const VkFence handle)
+{
+    RemoveHandle<MirvFence>(handle);
+}
+
+VkResult
+MirvDevice::vkResetFences(const uint32_t count, const VkFence* const handles) const
+{
+    for (const auto& handle : Range(handles, count)) {
+        MirvFence::For(*this, handle)->mSignaled.Reset();
+    }
+    return VK_SUCCESS;
+}
+
+VkResult
+MirvDevice::vkGetFenceStatus(const MirvFence* const fence) const
+{
+    return fence->mSignaled.IsSet() ? VK_SUCCESS : VK_NOT_READY;
+}
+
+void
+MirvDevice::SignalFence(MirvFence* const fence)
+{
+    fence->mSignaled.Set();
+    // Pairs with vkWaitForFences's mFenceEpochWaiters bump.
+    mFenceEpoch.fetch_add(1, std::memory_order_seq_cst);
+    if (mFenceEpochWaiters.load(std::memory_order_seq_cst)) {
+        MirvFutexWakeAll(mFenceEpoch);
+    }
+}
+
+VkResult
+MirvDevice::vkWaitForFences(const uint32_t count, const VkFence* const handles,
+                            const VkBool32 waitAll, const uint64_t timeout)
+{
+    auto deadline = kMirvInfiniteTimeout;
+    if (timeout != UINT64_MAX) {
+        const auto now = MirvNowNs();
+        if (timeout < kMirvInfiniteTimeout - now) {
+            deadline = now + timeout;
+        }
+    }
+
+    // Waiting for all of them is just waiting for each in turn.
+    if (waitAll || count == 1) {
+        for (const auto& handle : Range(handles, count)) {
+            if (!MirvFence::For(*this, handle)->mSignaled.WaitUntil(deadline))
+                return VK_TIMEOUT;
+        }
+        return VK_SUCCESS;
+    }
+
+    // For any of them, sleep until any fence on the device is signaled, then re-check.
+    while (true) {
+        const auto epoch = mFenceEpoch.load(std::memory_order_acquire);
+        for (const auto& handle : Range(handles, count)) {
+            if (MirvFence::For(*this, handle)->mSignaled.IsSet())
+                return VK_SUCCESS;
+        }
+
+        auto remaining = kMirvInfiniteTimeout;
+        if (deadline != kMirvInfiniteTimeout) {
+            const auto now = MirvNowNs();
+            if (now >= deadline)
+                return VK_TIMEOUT;
+            remaining = deadline - now;
+        }
+        mFenceEpochWaiters.fetch_add(1, std::memory_order_seq_cst);
+        (void)MirvFutexWait(mFenceEpoch, epoch, remaining);
+        mFenceEpochWaiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+VkResult
+MirvDevice::vkCreateSemaphore(const VkSemaphoreCreateInfo& createInfo,
+                              const VkAllocationCallbacks* const allocator,
+                              MirvSemaphore** const out)
+{
+    ASSERT(!createInfo.pNext)
+    ASSERT(!createInfo.flags)
+    const auto& sem = new (ChildAllocator(allocator), VK_SYSTEM_ALLOCATION_SCOPE_OBJECT)
+                          MirvSemaphore(*this);
+    return AddHandle(sem, out);
+}
+
+void
+MirvDevice::vkDestroySemaphore(const VkSemaphore handle)
+{
+    RemoveHandle<MirvSemaphore>(handle);
+}
+
+VkResult
+MirvDevice::vkDeviceWaitIdle() const
+{
+    for (const auto& family : mQueuesByFamily) {
+        for (const auto& queue : family.second) {
+            queue->vkQueueWaitIdle();
+        }
+    }
+    return VK_SUCCESS;
+}
@@ -1,18 +1,28 @@
 #pragma once
 
 #include "vulkan.h"
+#include "mirv_ext.h"
 
 #include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <cstddef>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <set>
 #include <stack>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
+#include "mirv_alloc.h"
+#include "mirv_cmd.h"
+#include "mirv_dispatch.h"
+#include "mirv_handles.h"
+#include "mirv_memory.h"
+#include "mirv_shader.h"
+#include "mirv_sync.h"
 #include "util.h"
 
 #define VK_ERROR_NOT_IMPLEMENTED VkResult(-2000*1000*1000)
@@ -42,26 +52,53 @@ using mutex_guard = std::lock_guard<std::mutex>;
 
 // -------------------------------------
 
-class RefCounted
+// Refcount policies for RefCountedT.
+
+// For objects any thread may hold. Taking a ref never needs to order anything; dropping
+// one must see every other holder's writes before we delete.
+class AtomicRefCount final
 {
-    mutable std::atomic<size_t> mRefCount;
+    std::atomic<size_t> mCount;
 
-protected:
-    RefCounted()
-        : mRefCount(0)
-    {}
+public:
+    AtomicRefCount() : mCount(0) {}
+
+    size_t Inc() { return mCount.fetch_add(1, std::memory_order_relaxed) + 1; }
+    size_t Dec() { return mCount.fetch_sub(1, std::memory_order_acq_rel) - 1; }
+};
+
+// For objects the app must externally synchronize, like command buffers and everything
+// they hold, so refs are only ever taken and dropped by one thread at a time.
+class LocalRefCount final
+{
+    size_t mCount;
+
+public:
+    LocalRefCount() : mCount(0) {}
+
+    size_t Inc() { return ++mCount; }
+    size_t Dec() { return --mCount; }
+};
 
-    virtual ~RefCounted() {}
+template<typename RefCountT>
+class RefCountedT
+{
+    mutable RefCountT mRefCount;
+
+protected:
+    RefCountedT() = default;
+    virtual ~RefCountedT() {}
 
 public:
     void AddRef() const {
-        const auto res = ++mRefCount;
+        const auto res = mRefCount.Inc();
         //printf("%p: AddRef => %u\n", this, res);
         ASSERT(res > 0)
+        (void)res;
     }
 
     void Release() const {
-        const auto res = --mRefCount;
+        const auto res = mRefCount.Dec();
         //printf("%p: Release => %u\n", this, res);
         ASSERT(res < SIZE_MAX/2)
         if (res > 0)
@@ -71,6 +108,9 @@ public:
     }
 };
 
+typedef RefCountedT<AtomicRefCount> RefCounted;
+typedef RefCountedT<LocalRefCount> LocalRefCounted;
+
 //#define SPEW_RP
 
 template<typename T>
@@ -100,7 +140,7 @@ public:
         : mPtr(nullptr)
     { }
 
-    rp(nullptr_t)
+    rp(std::nullptr_t)
         : mPtr(nullptr)
     { }
 
@@ -109,7 +149,8 @@ public:
     {
         Swap(x.mPtr);
     }
-    rp(rp<T>&& x)
+    // noexcept, so std::vector grows by moving rather than copying.
+    rp(rp<T>&& x) noexcept
         : mPtr(x.mPtr)
     {
         x.mPtr = nullptr;
@@ -128,14 +169,15 @@ public:
     {
         Swap(x.mPtr);
     }
-    /*
+
+    // Moves, including upcasts, hand the ref over without touching the count.
     template<typename U>
-    explicit rp(rp<U>&& x)
+    rp(rp<U>&& x) noexcept
+        : mPtr(x.mPtr)
     {
-        mPtr = x.mPtr;
         x.mPtr = nullptr;
     }
-    */
+
     ////
 
     ~rp()
@@ -165,12 +207,24 @@ public:
         Swap(x.mPtr);
         return *this;
     }
-    rp<T>& operator =(rp<T>&& x)
+    rp<T>& operator =(rp<T>&& x) noexcept
     {
         std::swap(mPtr, x.mPtr);
         return *this;
     }
 
+    template<typename U>
+    rp<T>& operator =(rp<U>&& x)
+    {
+        const auto was = mPtr;
+        mPtr = x.mPtr;
+        x.mPtr = nullptr;
+        if (was) {
+            was->Release();
+        }
+        return *this;
+    }
+
     ////
 
     T* get() const { return mPtr; }
@@ -193,6 +247,11 @@ public:
         return mPtr < x.mPtr;
     }
 
+    // With std::less<>, sets of rp<T> can be searched by raw pointer, without
+    // materializing (and refcounting) a temporary rp<T>.
+    friend bool operator <(const rp<T>& a, const T* const b) { return a.mPtr < b; }
+    friend bool operator <(const T* const a, const rp<T>& b) { return a < b.mPtr; }
+
     template<typename U>
     bool operator ==(const rp<U>& x) const {
         return mPtr == x.mPtr;
@@ -208,6 +267,7 @@ AsRP(T* const x) {
     return rp<T>(x);
 }
 
+#ifdef _WIN32
 template<typename T>
 struct QI final
 {
@@ -218,6 +278,7 @@ struct QI final
         return ret;
     }
 };
+#endif
 
 // -------------------------------------
 
@@ -226,9 +287,24 @@ enum class MirvObjectType {
     PhysicalDevice,
     Device,
     Queue,
+    DeviceMemory,
+    CommandPool,
+    CommandBuffer,
+    Fence,
+    Semaphore,
+    Buffer,
+    Image,
+    ShaderModule,
+    PipelineCache,
+    DescriptorSetLayout,
+    DescriptorPool,
+    DescriptorUpdateTemplate,
+    PipelineLayout,
+    Pipeline,
 };
 
 enum class Backends {
+    CPU,
     D3D12,
     Metal,
     Vulkan,
@@ -236,21 +312,21 @@ enum class Backends {
 
 // --
 
-template<typename DerivedT, typename DerivedHandleT>
-struct MirvObject : public RefCounted
+// Mirv objects only come from VkAllocationCallbacks.
+template<typename DerivedT, typename DerivedHandleT, typename RefCountT = AtomicRefCount>
+struct MirvObject : public RefCountedT<RefCountT>, public MirvAllocated
 {
     typedef DerivedHandleT HandleT;
-    typedef MirvObject<DerivedT,DerivedHandleT> ObjectT;
+    typedef MirvObject<DerivedT,DerivedHandleT,RefCountT> ObjectT;
 
     const MirvObjectType mType;
-    mutable std::mutex mMutex;
 
     explicit MirvObject(const MirvObjectType type)
         : mType(type)
     { }
 
     HandleT Handle() const {
-        return reinterpret_cast<HandleT>(this);
+        return reinterpret_cast<HandleT>(const_cast<MirvObject*>(this));
     }
 
     static DerivedT* For(const HandleT handle) {
@@ -259,133 +335,1013 @@ struct MirvObject : public RefCounted
     }
 };
 
+// --
+
+// From the loader's vk_icd.h.
+#define ICD_LOADER_MAGIC 0x01CDC0DE
+
+// The loader requires dispatchable handles to point at a pointer-sized slot it can
+// overwrite with its own dispatch table. Our vtable pointer is in the first word of the
+// object, so handles point at this instead.
+struct MirvLoaderData final
+{
+    uintptr_t mLoaderMagic;
+    void* mObject;
+};
+
+template<typename DerivedT, typename DerivedHandleT, typename RefCountT = AtomicRefCount>
+struct MirvDispatchableObject : public MirvObject<DerivedT, DerivedHandleT, RefCountT>
+{
+    typedef DerivedHandleT HandleT;
+
+    MirvLoaderData mLoaderData;
+
+    explicit MirvDispatchableObject(const MirvObjectType type)
+        : MirvObject<DerivedT, DerivedHandleT, RefCountT>(type)
+    {
+        mLoaderData.mLoaderMagic = ICD_LOADER_MAGIC;
+        mLoaderData.mObject = this;
+    }
+
+    HandleT Handle() const {
+        return reinterpret_cast<HandleT>(const_cast<MirvLoaderData*>(&mLoaderData));
+    }
+
+    static DerivedT* For(const HandleT handle) {
+        ASSERT(handle)
+        const auto& loaderData = reinterpret_cast<const MirvLoaderData*>(handle);
+        const auto& base = static_cast<MirvDispatchableObject*>(loaderData->mObject);
+        return static_cast<DerivedT*>(base);
+    }
+};
+
 // -------------------------------------
 
 class MirvPhysicalDevice;
 
 class MirvInstance
-    : public MirvObject<MirvInstance, VkInstance>
+    : public MirvDispatchableObject<MirvInstance, VkInstance>
 {
     static std::mutex gMutex;
-    static std::set<rp<MirvInstance>> gInstances;
+    static std::set<rp<MirvInstance>, std::less<>> gInstances;
 
+    std::once_flag mPhysDevsOnce;
     std::vector<rp<MirvPhysicalDevice>> mPhysDevs;
+    std::vector<VkPhysicalDevice> mPhysDevHandles;
+
+public:
+    // For allocations that live as long as the instance.
+    const VkAllocationCallbacks mAllocator;
+    MirvDispatchTable mDispatch;
 
-    MirvInstance();
+private:
+    explicit MirvInstance(const VkAllocationCallbacks& allocator);
     ~MirvInstance();
 
 public:
     static VkResult vkCreateInstance(const VkInstanceCreateInfo& createInfo,
+                                     const VkAllocationCallbacks* allocator,
                                      MirvInstance** out);
-    VkResult vkEnumeratePhysicalDevices(VkInstance handle,
-                                        uint32_t* out_physicalDeviceCount,
-                                        MirvPhysicalDevice** out_physicalDevices) const;
+    VkResult vkEnumeratePhysicalDevices(uint32_t* out_physicalDeviceCount,
+                                        VkPhysicalDevice* out_physicalDevices);
     void vkDestroyInstance();
 
 private:
+    // Deferred to the first vkEnumeratePhysicalDevices, then reused by every later one.
+    void EnsurePhysDevs();
+
     template<Backends B>
     void AddPhysDevs();
 };
 
 // --
 
-class MirvDevice;
-
-class MirvPhysicalDevice
-    : public MirvObject<MirvPhysicalDevice, VkPhysicalDevice>
+// What a backend probed about one adapter. Probing can be expensive, so backends keep
+// these in a process-wide cache that every MirvInstance's physical devices share.
+class MirvAdapter : public RefCounted
 {
 public:
-    MirvInstance& mInstance;
+    const Backends mBackend;
 
     VkPhysicalDeviceProperties mProperties;
     VkPhysicalDeviceLimits mLimits;
     std::vector<VkQueueFamilyProperties> mQueueFamilyProperties;
+    VkPhysicalDeviceMemoryProperties mMemoryProperties;
 
 protected:
-    std::set<rp<MirvDevice>> mDevices;
-
-    MirvPhysicalDevice(MirvInstance& instance)
-        : MirvObject(MirvObjectType::PhysicalDevice)
-        , mInstance(instance)
+    explicit MirvAdapter(const Backends backend)
+        : mBackend(backend)
     {
         Zero(&mProperties);
         Zero(&mLimits);
+        Zero(&mMemoryProperties);
         mProperties.apiVersion = VK_API_VERSION_1_0;
     }
+};
+
+// --
+
+class MirvDevice;
+
+// Non-dispatchable handles index their device's MirvHandleTable.
+// DerivedT must declare `static const MirvObjectType kType`.
+template<typename DerivedT, typename DerivedHandleT>
+struct MirvNonDispatchableObject : public MirvObject<DerivedT, DerivedHandleT>
+{
+    typedef DerivedHandleT HandleT;
+
+    MirvDevice& mDevice;
+    uint64_t mHandleBits; // Set once MirvDevice::AddHandle publishes us.
+
+    explicit MirvNonDispatchableObject(MirvDevice& device)
+        : MirvObject<DerivedT, DerivedHandleT>(DerivedT::kType)
+        , mDevice(device)
+        , mHandleBits(0)
+    { }
+
+    HandleT Handle() const {
+        return FromHandleBits<HandleT>(mHandleBits);
+    }
+
+    static DerivedT* For(const MirvDevice& device, HandleT handle);
+};
+
+// --
+
+class MirvPhysicalDevice
+    : public MirvDispatchableObject<MirvPhysicalDevice, VkPhysicalDevice>
+{
+public:
+    MirvInstance& mInstance;
+    const rp<MirvAdapter> mAdapter;
+
+    const VkPhysicalDeviceProperties& mProperties;
+    const VkPhysicalDeviceLimits& mLimits;
+    const std::vector<VkQueueFamilyProperties>& mQueueFamilyProperties;
+    const VkPhysicalDeviceMemoryProperties& mMemoryProperties;
+
+protected:
+    std::mutex mDevicesMutex;
+    std::set<rp<MirvDevice>, std::less<>> mDevices;
+
+    MirvPhysicalDevice(MirvInstance& instance, MirvAdapter* const adapter)
+        : MirvDispatchableObject(MirvObjectType::PhysicalDevice)
+        , mInstance(instance)
+        , mAdapter(adapter)
+        , mProperties(adapter->mProperties)
+        , mLimits(adapter->mLimits)
+        , mQueueFamilyProperties(adapter->mQueueFamilyProperties)
+        , mMemoryProperties(adapter->mMemoryProperties)
+    { }
 
+    // `allocator` is the app's, and may be null.
     virtual VkResult CreateDevice(const VkDeviceCreateInfo& createInfo,
+                                  const VkAllocationCallbacks* allocator,
                                   rp<MirvDevice>* out) = 0;
 
 public:
+    VkResult vkEnumerateDeviceExtensionProperties(const char* layerName, uint32_t* out_count,
+                                                  VkExtensionProperties* out) const;
     VkResult vkCreateDevice(const VkDeviceCreateInfo& createInfo,
+                            const VkAllocationCallbacks* allocator,
                             MirvDevice** out);
+    void RemoveDevice(MirvDevice* dev);
+};
+
+// --
+
+// Backend memory that MirvDeviceMemory objects are carved out of.
+class MirvMemoryBlock : public RefCounted, public MirvAllocated
+{
+public:
+    const uint32_t mTypeIndex;
+    const uint64_t mSize;
+    // Only host-visible types are mapped, and they stay mapped until we free them.
+    uint8_t* const mHostPtr;
+
+    // Null for dedicated blocks. Guarded by the owning MirvMemoryPool's mutex.
+    std::unique_ptr<MirvBuddyAllocator> mBuddy;
+
+    // [begin, end) in block offsets.
+    struct Range final {
+        uint64_t mBegin;
+        uint64_t mEnd;
+    };
+    // Only called for non-coherent types, with sorted, disjoint ranges, once per block
+    // per vkFlush/vkInvalidateMappedMemoryRanges call.
+    virtual void FlushRanges(const std::vector<Range>&) {}
+    virtual void InvalidateRanges(const std::vector<Range>&) {}
+
+protected:
+    MirvMemoryBlock(const uint32_t typeIndex, const uint64_t size, uint8_t* const hostPtr)
+        : mTypeIndex(typeIndex)
+        , mSize(size)
+        , mHostPtr(hostPtr)
+    { }
+};
+
+// Per memory type: the blocks that small allocations share.
+struct MirvMemoryPool final
+{
+    std::mutex mMutex;
+    std::vector<rp<MirvMemoryBlock>> mBlocks;
 };
 
 // --
 
 class MirvQueue;
+class MirvDeviceMemory;
 class MirvCommandPool;
+class MirvFence;
+class MirvSemaphore;
+class MirvBuffer;
+class MirvImage;
+class MirvShaderModule;
+class MirvPipelineCache;
+class MirvCompiledShader;
+class MirvDescriptorSetLayout;
+class MirvDescriptorPool;
+class MirvDescriptorUpdateTemplate;
+class MirvPipelineLayout;
+class MirvPipeline;
 
 class MirvDevice
-    : public MirvObject<MirvDevice, VkDevice>
+    : public MirvDispatchableObject<MirvDevice, VkDevice>
 {
 public:
     MirvPhysicalDevice& mPhysDev;
 
+    // Must outlive everything allocated from it, so it goes first.
+    MirvArena mArena;
+    // For allocations that live as long as the device: The app's, else mArena's.
+    const VkAllocationCallbacks mAllocator;
+
     std::map< uint32_t, std::vector<rp<MirvQueue>> > mQueuesByFamily;
+    MirvDispatchTable mDispatch;
 
-    explicit MirvDevice(MirvPhysicalDevice& physDev);
+    // Allocations up to kMaxSuballocSize share kMemoryBlockSize blocks. Bigger ones get
+    // dedicated blocks.
+    static const uint64_t kMemoryBlockSize = 16 * 1024 * 1024;
+    static const uint64_t kMaxSuballocSize = kMemoryBlockSize / 8;
+    MirvMemoryPool mMemoryPools[VK_MAX_MEMORY_TYPES];
+    std::atomic<uint64_t> mHeapUsage[VK_MAX_MEMORY_HEAPS];
+    // If every host-visible type is coherent, flushes and invalidates are no-ops.
+    bool mHasNonCoherentMemory;
+
+    // Shared by every command pool without its own allocator.
+    MirvCmdChunkCache mCmdChunks;
+
+    // Bumped whenever any fence is signaled, so vkWaitForFences can sleep until any of
+    // its fences might be.
+    std::atomic<uint32_t> mFenceEpoch;
+    std::atomic<uint32_t> mFenceEpochWaiters;
+
+    // Background compiles can outlive their pipelines' handles, but not us.
+    MirvPendingCount mBackgroundCompiles;
+
+    // Objects here can hold memory blocks, so this must die before mMemoryPools.
+    MirvHandleTable mHandles;
+
+    MirvDevice(MirvPhysicalDevice& physDev, const VkAllocationCallbacks* allocator);
     ~MirvDevice() override;
 
+    // For device children: The app's callbacks if it passed any, else mArena's.
+    const VkAllocationCallbacks& ChildAllocator(const VkAllocationCallbacks* const app) const {
+        return app ? *app : mArena.Callbacks();
+    }
+
 public:
     void vkGetDeviceQueue(uint32_t queueFamilyIndex, uint32_t queueIndex,
                           MirvQueue** out) const;
+    VkResult vkAllocateMemory(const VkMemoryAllocateInfo& info,
+                              const VkAllocationCallbacks* allocator,
+                              MirvDeviceMemory** out);
+    void vkFreeMemory(VkDeviceMemory handle);
+    VkResult vkMapMemory(MirvDeviceMemory* mem, VkDeviceSize offset, VkDeviceSize size,
+                         VkMemoryMapFlags flags, void** out_data) const;
+    void vkUnmapMemory(MirvDeviceMemory* mem) const;
+    VkResult vkFlushMappedMemoryRanges(uint32_t count,
+                                       const VkMappedMemoryRange* ranges) const;
+    VkResult vkInvalidateMappedMemoryRanges(uint32_t count,
+                                            const VkMappedMemoryRange* ranges) const;
+    VkResult vkCreateBuffer(const VkBufferCreateInfo& createInfo,
+                            const VkAllocationCallbacks* allocator, MirvBuffer** out);
+    void vkDestroyBuffer(VkBuffer handle);
+    void vkGetBufferMemoryRequirements(const MirvBuffer* buffer,
+                                       VkMemoryRequirements* out) const;
+    VkResult vkBindBufferMemory(MirvBuffer* buffer, const MirvDeviceMemory* mem,
+                                VkDeviceSize offset) const;
+    VkResult vkCreateImage(const VkImageCreateInfo& createInfo,
+                           const VkAllocationCallbacks* allocator, MirvImage** out);
+    void vkDestroyImage(VkImage handle);
+    void vkGetImageMemoryRequirements(const MirvImage* image,
+                                      VkMemoryRequirements* out) const;
+    VkResult vkBindImageMemory(MirvImage* image, const MirvDeviceMemory* mem,
+                               VkDeviceSize offset) const;
+    void vkGetImageSubresourceLayout(const MirvImage* image,
+                                     const VkImageSubresource& subresource,
+                                     VkSubresourceLayout* out) const;
+    VkResult vkCreateShaderModule(const VkShaderModuleCreateInfo& createInfo,
+                                  const VkAllocationCallbacks* allocator,
+                                  MirvShaderModule** out);
+    void vkDestroyShaderModule(VkShaderModule handle);
+    VkResult vkCreatePipelineCache(const VkPipelineCacheCreateInfo& createInfo,
+                                   const VkAllocationCallbacks* allocator,
+                                   MirvPipelineCache** out);
+    void vkDestroyPipelineCache(VkPipelineCache handle);
+    VkResult vkGetPipelineCacheData(const MirvPipelineCache* cache, size_t* inout_size,
+                                    void* out_data) const;
+    VkResult vkMergePipelineCaches(MirvPipelineCache* dst, uint32_t srcCount,
+                                   const VkPipelineCache* srcs) const;
+    VkResult vkCreateDescriptorSetLayout(const VkDescriptorSetLayoutCreateInfo& createInfo,
+                                         const VkAllocationCallbacks* allocator,
+                                         MirvDescriptorSetLayout** out);
+    void vkDestroyDescriptorSetLayout(VkDescriptorSetLayout handle);
+    VkResult vkCreateDescriptorPool(const VkDescriptorPoolCreateInfo& createInfo,
+                                    const VkAllocationCallbacks* allocator,
+                                    MirvDescriptorPool** out);
+    void vkDestroyDescriptorPool(VkDescriptorPool handle);
+    VkResult vkCreateDescriptorUpdateTemplateKHR(
+        const VkDescriptorUpdateTemplateCreateInfoKHR& createInfo,
+        const VkAllocationCallbacks* allocator, MirvDescriptorUpdateTemplate** out);
+    void vkDestroyDescriptorUpdateTemplateKHR(VkDescriptorUpdateTemplateKHR handle);
+    void vkUpdateDescriptorSets(uint32_t writeCount, const VkWriteDescriptorSet* writes,
+                                uint32_t copyCount, const VkCopyDescriptorSet* copies) const;
+    VkResult vkCreatePipelineLayout(const VkPipelineLayoutCreateInfo& createInfo,
+                                    const VkAllocationCallbacks* allocator,
+                                    MirvPipelineLayout** out);
+    void vkDestroyPipelineLayout(VkPipelineLayout handle);
+    VkResult vkCreateComputePipelines(VkPipelineCache cache, uint32_t count,
+                                      const VkComputePipelineCreateInfo* createInfos,
+                                      const VkAllocationCallbacks* allocator,
+                                      VkPipeline* out);
+    void vkDestroyPipeline(VkPipeline handle);
     VkResult vkCreateCommandPool(const VkCommandPoolCreateInfo& createInfo,
-                                 MirvCommandPool** out) const;
-    void vkDestroyDevice() { }
+                                 const VkAllocationCallbacks* allocator,
+                                 MirvCommandPool** out);
+    void vkDestroyCommandPool(VkCommandPool handle);
+    VkResult vkCreateFence(const VkFenceCreateInfo& createInfo,
+                           const VkAllocationCallbacks* allocator, MirvFence** out);
+    void vkDestroyFence(VkFence handle);
+    VkResult vkResetFences(uint32_t count, const VkFence* handles) const;
+    VkResult vkGetFenceStatus(const MirvFence* fence) const;
+    VkResult vkWaitForFences(uint32_t count, const VkFence* handles, VkBool32 waitAll,
+                             uint64_t timeout);
+    VkResult vkCreateSemaphore(const VkSemaphoreCreateInfo& createInfo,
+                               const VkAllocationCallbacks* allocator,
+                               MirvSemaphore** out);
+    void vkDestroySemaphore(VkSemaphore handle);
+    VkResult vkDeviceWaitIdle() const;
+    void vkDestroyDevice();
+
+    // Publishes a handle for `obj`, which the handle table keeps alive until RemoveHandle.
+    template<typename T>
+    VkResult AddHandle(T* const obj, T** const out) {
+        if (!obj)
+            return VK_ERROR_OUT_OF_HOST_MEMORY;
+        obj->mHandleBits = mHandles.Insert(obj, T::kType);
+        if (!obj->mHandleBits) {
+            delete obj; // Still unreferenced.
+            return VK_ERROR_OUT_OF_HOST_MEMORY;
+        }
+        *out = obj;
+        return VK_SUCCESS;
+    }
+
+    template<typename T>
+    void RemoveHandle(const typename T::HandleT handle) {
+        if (!handle)
+            return;
+        mHandles.Remove(HandleBits(handle), T::kType);
+    }
 
     VkResult AddAllQueues(const VkDeviceCreateInfo& info);
 
+    // From queue threads.
+    void SignalFence(MirvFence* fence);
+
+    // For ~MirvDeviceMemory.
+    void FreeMemoryRange(MirvMemoryBlock* block, uint64_t offset, uint64_t size);
+
 protected:
     virtual VkResult AddQueues(const VkDeviceQueueCreateInfo& info,
                                const VkQueueFamilyProperties& familyInfo,
                                std::vector<rp<MirvQueue>>* out) = 0;
+    // Backends supply the actual memory.
+    virtual VkResult AllocBlock(uint32_t typeIndex, uint64_t size,
+                                rp<MirvMemoryBlock>* out) = 0;
+
+private:
+    VkResult NewBlock(uint32_t typeIndex, uint64_t size, rp<MirvMemoryBlock>* out);
+    void DropHeapUsage(const MirvMemoryBlock* block);
+    VkResult Suballocate(uint32_t typeIndex, uint64_t size, rp<MirvMemoryBlock>* out_block,
+                         uint64_t* out_offset);
+    // Compiles every non-null pipeline's shader on the process's compiler threads, and
+    // with MIRV_ASYNC_PIPELINES, leaves them to it. Returns false if it didn't wait.
+    bool CompileComputePipelines(MirvPipelineCache* cache, uint32_t count,
+                                 const VkComputePipelineCreateInfo* infos,
+                                 MirvPipeline* const* pipelines);
+    template<typename F>
+    void ForEachNonCoherentBlock(uint32_t count, const VkMappedMemoryRange* ranges,
+                                 const F& fn) const;
 };
 
 // --
 
+class MirvCommandBuffer;
+
+// Every queue is a thread, so families offer only a few.
+const uint32_t kMirvMaxQueuesPerFamily = 16;
+
+// vkQueueSubmit only pushes onto a lock-free queue and returns. Each MirvQueue has its
+// own thread, which runs submissions in order: It waits on semaphores, executes command
+// buffers, and signals semaphores and fences.
 class MirvQueue
-    : public MirvObject<MirvQueue, VkQueue>
+    : public MirvDispatchableObject<MirvQueue, VkQueue>
 {
 public:
     MirvDevice& mDevice;
     const VkQueueFamilyProperties& mFamily;
 
-    MirvQueue(MirvDevice& device, const VkQueueFamilyProperties& family)
-        : MirvObject(MirvObjectType::Queue)
-        , mDevice(device)
-        , mFamily(family)
-    { }
+private:
+    struct Submission;
+
+    MirvMpscQueue mPending;
+    // Counts vkQueueSubmit calls, and the ones the thread has finished.
+    std::atomic<uint32_t> mSubmitCount;
+    std::atomic<uint32_t> mDoneCount;
+    std::atomic<uint32_t> mIdleWaiters;
+    // The thread sleeps on this. Submitters only bump it, and wake it, if it's asleep.
+    std::atomic<uint32_t> mWakeSeq;
+    std::atomic<uint32_t> mSleeping;
+    std::atomic<bool> mExiting;
+    std::thread mThread;
+
+protected:
+    MirvQueue(MirvDevice& device, const VkQueueFamilyProperties& family);
+
+    // Backends call these once they're fully constructed, and before they destruct, since
+    // the thread calls Execute. Stop runs everything still pending first.
+    void Start();
+    void Stop();
+
+    // On the queue thread. The command buffer is Executable, and stays so until we
+    // return.
+    virtual void Execute(const MirvCommandBuffer& cb) = 0;
+
+public:
+    ~MirvQueue() override;
+
+    VkResult vkQueueSubmit(uint32_t count, const VkSubmitInfo* submits, VkFence fence);
+    VkResult vkQueueWaitIdle();
+
+private:
+    void ThreadMain();
+    void Run(Submission* sub);
+};
+
+// --
+
+class MirvDeviceMemory
+    : public MirvNonDispatchableObject<MirvDeviceMemory, VkDeviceMemory>
+{
+public:
+    static const MirvObjectType kType = MirvObjectType::DeviceMemory;
+
+    const rp<MirvMemoryBlock> mBlock;
+    const uint64_t mOffset;
+    const uint64_t mSize;
+    const bool mCoherent;
+    bool mMapped; // Host access to memory is externally synchronized.
+
+    MirvDeviceMemory(MirvDevice& device, MirvMemoryBlock* block, uint64_t offset,
+                     uint64_t size);
+    ~MirvDeviceMemory() override;
+
+    uint8_t* HostPtr() const {
+        return mBlock->mHostPtr ? mBlock->mHostPtr + mOffset : nullptr;
+    }
+};
+
+// --
+
+class MirvBuffer
+    : public MirvNonDispatchableObject<MirvBuffer, VkBuffer>
+{
+public:
+    static const MirvObjectType kType = MirvObjectType::Buffer;
+
+    const uint64_t mSize;
+    const VkBufferUsageFlags mUsage;
+    // Set once, by vkBindBufferMemory.
+    rp<MirvMemoryBlock> mBlock;
+    uint64_t mBlockOffset;
+
+    MirvBuffer(MirvDevice& device, const VkBufferCreateInfo& info);
+
+    uint8_t* HostPtr() const {
+        return (mBlock && mBlock->mHostPtr) ? mBlock->mHostPtr + mBlockOffset : nullptr;
+    }
+};
+
+// --
+
+// Where one mip level's texels are, from the image's start. Rows are rows of blocks, or
+// of tiles in tiled images.
+struct MirvImageLevel final
+{
+    VkExtent3D mExtent; // In texels.
+    uint64_t mOffset;
+    uint64_t mRowPitch;
+    uint64_t mDepthPitch; // Between z slices.
+    uint64_t mArrayPitch; // Between layers.
+};
+
+// Images are level by level, and each level layer by layer. OPTIMAL images tile each
+// slice as in MirvTileRect; LINEAR ones, which the app can address, are row-major.
+class MirvImage
+    : public MirvNonDispatchableObject<MirvImage, VkImage>
+{
+public:
+    static const MirvObjectType kType = MirvObjectType::Image;
+
+    const VkImageType mImageType;
+    const VkFormat mFormat;
+    // What texels are kept as, which transfers convert to and from mFormat. It differs
+    // where mFormat is awkward to address: 24 and 48-bit texels get an alpha component.
+    const VkFormat mStorageFormat;
+    const VkImageTiling mTiling;
+    // MirvTileShift of the storage format's blocks, or 0 for row-major.
+    const uint32_t mTileShift;
+    const VkExtent3D mExtent;
+    const uint32_t mMipLevels;
+    const uint32_t mArrayLayers;
+    std::vector<MirvImageLevel> mLevels;
+    uint64_t mSize;
+    // Set once, by vkBindImageMemory.
+    rp<MirvMemoryBlock> mBlock;
+    uint64_t mBlockOffset;
+
+    MirvImage(MirvDevice& device, const VkImageCreateInfo& info);
+
+    uint8_t* HostPtr() const {
+        return (mBlock && mBlock->mHostPtr) ? mBlock->mHostPtr + mBlockOffset : nullptr;
+    }
+};
+
+// --
+
+// SPIR-V and what parsing it found, shared by every module in the process with the
+// same words. Background compiles hold on to it after the modules are gone.
+class MirvShaderCode final : public RefCounted
+{
+public:
+    const std::vector<uint32_t> mWords;
+    const Hash128 mHash;
+    const std::unique_ptr<const MirvSpirvModule> mModule; // Null if we can't parse it.
+
+private:
+    MirvShaderCode(const uint32_t* words, size_t wordCount, const Hash128& hash);
+
+public:
+    // Each Share needs an Unshare once the module is gone.
+    static rp<const MirvShaderCode> Share(const uint32_t* words, size_t wordCount);
+    static void Unshare(const MirvShaderCode* code);
+};
+
+class MirvShaderModule
+    : public MirvNonDispatchableObject<MirvShaderModule, VkShaderModule>
+{
+public:
+    static const MirvObjectType kType = MirvObjectType::ShaderModule;
+
+    // Only compiled once a pipeline picks an entry point and specialization.
+    const rp<const MirvShaderCode> mCode;
+
+    MirvShaderModule(MirvDevice& device, const VkShaderModuleCreateInfo& info);
+    ~MirvShaderModule();
+};
+
+// Immutable once built, so pipelines and pipeline caches share them freely.
+class MirvCompiledShader final : public RefCounted, public MirvAllocated
+{
+public:
+    MirvShaderProgram mProgram;
+};
+
+// Compiled shaders keyed by a hash of everything that went into compiling them.
+// Lookups, inserts, and merges are all lock-free: Buckets are singly linked lists of
+// immutable entries that only ever grow at the head, until the cache dies.
+class MirvPipelineCache
+    : public MirvNonDispatchableObject<MirvPipelineCache, VkPipelineCache>
+{
+public:
+    static const MirvObjectType kType = MirvObjectType::PipelineCache;
+
+private:
+    struct Entry final : public MirvAllocated {
+        const Entry* mNext;
+        Hash128 mKey;
+        rp<const MirvCompiledShader> mShader;
+
+        Entry(const Hash128& key, const MirvCompiledShader* const shader)
+            : mNext(nullptr)
+            , mKey(key)
+            , mShader(shader)
+        { }
+    };
+
+    // For our entries. Shaders outlive us, so they come from the device's.
+    const VkAllocationCallbacks mAllocator;
+
+    static const uint32_t kBucketCount = 1024;
+    std::atomic<const Entry*> mBuckets[kBucketCount];
+
+public:
+    // Background compiles that will insert into us. Anything that reads us whole, or
+    // destroys us, waits for them first.
+    mutable MirvPendingCount mPendingInserts;
+
+    // Data that doesn't match our header is ignored, as the spec requires.
+    MirvPipelineCache(MirvDevice& device, const VkPipelineCacheCreateInfo& info,
+                      const VkAllocationCallbacks& allocator);
+    ~MirvPipelineCache() override;
+
+    rp<const MirvCompiledShader> Find(const Hash128& key) const;
+    // Returns whichever shader ends up cached under `key`: If another thread got there
+    // first, theirs, else `shader`, which stays uncached if we're out of memory.
+    rp<const MirvCompiledShader> Insert(const Hash128& key, const MirvCompiledShader* shader);
+
+    VkResult GetData(size_t* inout_size, void* out_data) const;
+    void MergeFrom(const MirvPipelineCache& src);
+
+private:
+    template<typename F>
+    void ForEachEntry(const F& fn) const;
+};
+
+// --
+
+class MirvDescriptorSetLayout
+    : public MirvNonDispatchableObject<MirvDescriptorSetLayout, VkDescriptorSetLayout>
+{
+public:
+    static const MirvObjectType kType = MirvObjectType::DescriptorSetLayout;
+
+    // Where a binding's descriptors live in every set of this layout. Sets hold
+    // descriptors in binding order, so writes that run off the end of one binding carry
+    // on into the next.
+    struct Binding final {
+        VkDescriptorType mType;
+        uint32_t mCount;        // 0 for numbers nothing is bound at.
+        uint32_t mFirst;        // Index into the set's descriptors.
+        uint32_t mFirstDynamic; // Dynamic buffers: Index into the set's dynamic offsets.
+    };
+
+    // By binding number. No immutable samplers, since we have no samplers.
+    std::vector<Binding> mBindings;
+    uint32_t mDescriptorCount;
+    uint32_t mDynamicCount;
+
+    MirvDescriptorSetLayout(MirvDevice& device, const VkDescriptorSetLayoutCreateInfo& info);
+
+    const Binding* Find(const uint32_t binding) const {
+        if (binding >= mBindings.size() || !mBindings[binding].mCount)
+            return nullptr;
+        return &mBindings[binding];
+    }
+};
+
+// Exactly what the app wrote, handles and all, so writes, copies, and templates are
+// all memcpys. Buffers are looked up when a dispatch uses them.
+union MirvDescriptor final
+{
+    VkDescriptorBufferInfo mBuffer;
+    VkDescriptorImageInfo mImage;
+    VkBufferView mTexelBuffer;
+};
+
+// Lives in its pool's storage, directly followed by its descriptors. Sets come and go
+// tens of thousands of times a frame, so unlike other non-dispatchable objects they
+// have no handle table entry or refcount: Their handles point straight at them.
+struct MirvDescriptorSet final
+{
+    // Only read while the app is updating us, when it must keep the layout alive.
+    const MirvDescriptorSetLayout* mLayout;
+    uint64_t mBytes; // Including us.
+
+    MirvDescriptor* Descriptors() { return reinterpret_cast<MirvDescriptor*>(this + 1); }
+    const MirvDescriptor* Descriptors() const {
+        return reinterpret_cast<const MirvDescriptor*>(this + 1);
+    }
+
+    VkDescriptorSet Handle() const {
+        return FromHandleBits<VkDescriptorSet>(uint64_t(uintptr_t(this)));
+    }
+    static MirvDescriptorSet* For(const VkDescriptorSet handle) {
+        ASSERT(handle)
+        return reinterpret_cast<MirvDescriptorSet*>(uintptr_t(HandleBits(handle)));
+    }
+};
+
+// Sets are carved out of one block sized for maxSets and the pool sizes. Without
+// FREE_DESCRIPTOR_SET_BIT, allocation is a bump of mUsed, and reset just zeroes it.
+// With it, freed sets' ranges are kept for reuse, coalesced by offset.
+class MirvDescriptorPool
+    : public MirvNonDispatchableObject<MirvDescriptorPool, VkDescriptorPool>
+{
+public:
+    static const MirvObjectType kType = MirvObjectType::DescriptorPool;
+
+    const VkDescriptorPoolCreateFlags mFlags;
+
+private:
+    const VkAllocationCallbacks mAllocator;
+    const size_t mCapacity; // In bytes.
+
+public:
+    uint8_t* const mStorage; // Null if we couldn't allocate it.
+
+private:
+    size_t mUsed; // Everything from here up is free.
+    std::map<size_t, size_t> mFreeRanges; // By offset, their sizes. All below mUsed.
+
+public:
+    MirvDescriptorPool(MirvDevice& device, const VkDescriptorPoolCreateInfo& info,
+                       const VkAllocationCallbacks& allocator);
+    ~MirvDescriptorPool() override;
+
+    VkResult vkAllocateDescriptorSets(const VkDescriptorSetAllocateInfo& info,
+                                      VkDescriptorSet* out);
+    VkResult vkFreeDescriptorSets(uint32_t count, const VkDescriptorSet* handles);
+    VkResult vkResetDescriptorPool(VkDescriptorPoolResetFlags flags);
+
+private:
+    void FreeRange(size_t offset, size_t size);
+};
+
+// Compiled at creation to byte copies from the app's data into a set's descriptors, so
+// an update is one tight loop. Adjacent entries and array elements are merged into
+// single copies wherever both sides are contiguous.
+class MirvDescriptorUpdateTemplate
+    : public MirvNonDispatchableObject<MirvDescriptorUpdateTemplate,
+                                       VkDescriptorUpdateTemplateKHR>
+{
+public:
+    static const MirvObjectType kType = MirvObjectType::DescriptorUpdateTemplate;
+
+    struct Copy final {
+        size_t mSrcOffset; // Into the app's data.
+        uint32_t mDstOffset; // Into the set's descriptors.
+        uint32_t mSize;
+    };
+
+    std::vector<Copy> mCopies;
+    uint32_t mDescriptorCount; // That the set's layout must have, at least.
+
+    MirvDescriptorUpdateTemplate(MirvDevice& device,
+                                 const VkDescriptorUpdateTemplateCreateInfoKHR& info);
+
+    void vkUpdateDescriptorSetWithTemplateKHR(VkDescriptorSet set, const void* data) const;
+};
+
+// Holds its set layouts, which the app may destroy first.
+class MirvPipelineLayout
+    : public MirvNonDispatchableObject<MirvPipelineLayout, VkPipelineLayout>
+{
+public:
+    static const MirvObjectType kType = MirvObjectType::PipelineLayout;
+
+    std::vector<rp<MirvDescriptorSetLayout>> mSetLayouts;
+    std::vector<VkPushConstantRange> mPushConstantRanges;
+
+    MirvPipelineLayout(MirvDevice& device, const VkPipelineLayoutCreateInfo& info);
+};
+
+// Compute only, for now.
+class MirvPipeline
+    : public MirvNonDispatchableObject<MirvPipeline, VkPipeline>
+{
+public:
+    static const MirvObjectType kType = MirvObjectType::Pipeline;
+
+    const VkPipelineBindPoint mBindPoint;
+    const rp<MirvPipelineLayout> mLayout;
+
+private:
+    // Set once, by whichever thread compiles us.
+    rp<const MirvCompiledShader> mShader;
+    mutable MirvFutexFlag mCompiled;
+
+public:
+    MirvPipeline(MirvDevice& device, VkPipelineBindPoint bindPoint,
+                 MirvPipelineLayout* layout);
+
+    // The compiler's last touch of us, so we may be destroyed as soon as it's called.
+    void SetShader(rp<const MirvCompiledShader> shader) {
+        mShader = std::move(shader);
+        mCompiled.Set();
+    }
+    bool IsCompiled() const { return mCompiled.IsSet(); }
+    // Waits for the compile, if it's still running. Null if it failed.
+    const MirvCompiledShader* Shader() const {
+        mCompiled.WaitUntil(kMirvInfiniteTimeout);
+        return mShader.get();
+    }
 };
 
 // --
 
 class MirvCommandPool
-    : public MirvObject<MirvCommandPool, VkCommandPool>
+    : public MirvNonDispatchableObject<MirvCommandPool, VkCommandPool>
+{
+public:
+    static const MirvObjectType kType = MirvObjectType::CommandPool;
+
+    const VkCommandPoolCreateFlags mFlags;
+    const uint32_t mQueueFamilyIndex;
+    // For our command buffers and their chunks.
+    const VkAllocationCallbacks mAllocator;
+    // Only used if the app gave us our own allocator. Otherwise we share the device's.
+    MirvCmdChunkCache mOwnChunkCache;
+    MirvCmdChunkPool mChunks;
+
+private:
+    // Command buffers return their chunks to mChunks as they die, so these go first.
+    std::vector<rp<MirvCommandBuffer>> mBuffers;
+
+public:
+    // `allocator` is the app's, and may be null.
+    MirvCommandPool(MirvDevice& device, const VkCommandPoolCreateInfo& info,
+                    const VkAllocationCallbacks* allocator);
+    ~MirvCommandPool() override;
+
+    VkResult vkAllocateCommandBuffers(const VkCommandBufferAllocateInfo& info,
+                                      VkCommandBuffer* out);
+    void vkFreeCommandBuffers(uint32_t count, const VkCommandBuffer* handles);
+    VkResult vkResetCommandPool(VkCommandPoolResetFlags flags);
+};
+
+// --
+
+// Like their pool, command buffers are externally synchronized, so their refcounts
+// needn't be atomic.
+class MirvCommandBuffer
+    : public MirvDispatchableObject<MirvCommandBuffer, VkCommandBuffer, LocalRefCount>
+{
+public:
+    enum class State {
+        Initial,
+        Recording,
+        Executable,
+    };
+
+    MirvCommandPool& mPool;
+    const VkCommandBufferLevel mLevel;
+    size_t mPoolIndex; // In mPool.mBuffers.
+
+    State mState;
+    VkCommandBufferUsageFlags mUsage;
+    MirvCmdStream mStream;
+    // The GenerateMips that the next blit down its chain may extend.
+    MirvCmd_GenerateMips* mMipChain;
+
+    MirvCommandBuffer(MirvCommandPool& pool, VkCommandBufferLevel level);
+
+    void Reset();
+
+    VkResult vkBeginCommandBuffer(const VkCommandBufferBeginInfo& info);
+    VkResult vkEndCommandBuffer();
+    VkResult vkResetCommandBuffer(VkCommandBufferResetFlags flags);
+
+    void vkCmdPushConstants(VkPipelineLayout layout, VkShaderStageFlags stageFlags,
+                            uint32_t offset, uint32_t size, const void* values);
+    void vkCmdBindPipeline(VkPipelineBindPoint bindPoint, VkPipeline pipeline);
+    void vkCmdBindDescriptorSets(VkPipelineBindPoint bindPoint, VkPipelineLayout layout,
+                                 uint32_t firstSet, uint32_t setCount,
+                                 const VkDescriptorSet* sets, uint32_t dynamicOffsetCount,
+                                 const uint32_t* dynamicOffsets);
+    void vkCmdDispatch(uint32_t x, uint32_t y, uint32_t z);
+    void vkCmdDispatchIndirect(VkBuffer buffer, VkDeviceSize offset);
+    void vkCmdCopyBuffer(VkBuffer src, VkBuffer dst, uint32_t regionCount,
+                         const VkBufferCopy* regions);
+    void vkCmdFillBuffer(VkBuffer dst, VkDeviceSize offset, VkDeviceSize size, uint32_t data);
+    void vkCmdUpdateBuffer(VkBuffer dst, VkDeviceSize offset, VkDeviceSize size,
+                           const void* data);
+    void vkCmdCopyBufferToImage(VkBuffer src, VkImage dst, VkImageLayout dstLayout,
+                                uint32_t regionCount, const VkBufferImageCopy* regions);
+    void vkCmdCopyImageToBuffer(VkImage src, VkImageLayout srcLayout, VkBuffer dst,
+                                uint32_t regionCount, const VkBufferImageCopy* regions);
+    void vkCmdBlitImage(VkImage src, VkImageLayout srcLayout, VkImage dst,
+                        VkImageLayout dstLayout, uint32_t regionCount,
+                        const VkImageBlit* regions, VkFilter filter);
+    void vkCmdPipelineBarrier(VkPipelineStageFlags srcStageMask,
+                              VkPipelineStageFlags dstStageMask,
+                              VkDependencyFlags dependencyFlags, uint32_t memoryBarrierCount,
+                              const VkMemoryBarrier* memoryBarriers,
+                              uint32_t bufferBarrierCount,
+                              const VkBufferMemoryBarrier* bufferBarriers,
+                              uint32_t imageBarrierCount,
+                              const VkImageMemoryBarrier* imageBarriers);
+};
+
+// --
+
+class MirvFence
+    : public MirvNonDispatchableObject<MirvFence, VkFence>
+{
+public:
+    static const MirvObjectType kType = MirvObjectType::Fence;
+
+    MirvFutexFlag mSignaled;
+
+    MirvFence(MirvDevice& device, const VkFenceCreateInfo& info);
+};
+
+// Binary, and only ever waited on by queue threads, which reset it once their wait is
+// satisfied.
+class MirvSemaphore
+    : public MirvNonDispatchableObject<MirvSemaphore, VkSemaphore>
 {
+public:
+    static const MirvObjectType kType = MirvObjectType::Semaphore;
+
+    MirvFutexFlag mSignaled;
+
+    explicit MirvSemaphore(MirvDevice& device);
 };
 
 // -----------------
 
+template<typename DerivedT, typename DerivedHandleT>
+/*static*/ DerivedT*
+MirvNonDispatchableObject<DerivedT, DerivedHandleT>::For(const MirvDevice& device,
+                                                         const HandleT handle)
+{
+    ASSERT(handle)
+    const auto& obj = device.mHandles.Lookup(HandleBits(handle), DerivedT::kType);
+    return static_cast<DerivedT*>(obj);
+}
+
+// -----------------
+
+// Lets entrypoints pass a VkFoo* out-var where a MirvFoo** is expected. The handle is
+// written back at the end of the full-expression.
+template<typename T>
+class HandleOut final
+{
+    typename T::HandleT* mOut;
+    T* mObj;
+
+public:
+    explicit HandleOut(typename T::HandleT* const out)
+        : mOut(out)
+        , mObj(nullptr)
+    { }
+
+    HandleOut(HandleOut&& x)
+        : mOut(x.mOut)
+        , mObj(x.mObj)
+    {
+        x.mOut = nullptr;
+    }
+
+    ~HandleOut() {
+        if (mOut && mObj) {
+            *mOut = mObj->Handle();
+        }
+    }
+
+    operator T**() { return &mObj; }
+};
+
 template<typename T, typename U>
 inline U MapHandle(const rp<T>& x) { return MapHandle(x.get()); }
 
-#define _(X) constexpr X* MapHandle(const X::HandleT h) { return (X*)h; } \
-             constexpr X** MapHandle(X::HandleT* const out_h) { return (X**)out_h; } \
-             constexpr X::HandleT MapHandle(const X* const x) { return (X::HandleT)x; }
+#define _(X) inline X* MapHandle(const X::HandleT h) { return X::For(h); } \
+             inline HandleOut<X> MapHandle(X::HandleT* const out_h) { return HandleOut<X>(out_h); } \
+             inline X::HandleT MapHandle(const X* const x) { return x->Handle(); }
 _(MirvInstance)
 _(MirvPhysicalDevice)
 _(MirvDevice)
 _(MirvQueue)
+_(MirvCommandBuffer)
+#undef _
+
+#define _(X) inline X* MapHandle(const MirvDevice* const dev, const X::HandleT h) { return X::For(*dev, h); } \
+             inline HandleOut<X> MapHandle(X::HandleT* const out_h) { return HandleOut<X>(out_h); } \
+             inline X::HandleT MapHandle(const X* const x) { return x->Handle(); }
+_(MirvDeviceMemory)
 _(MirvCommandPool)
+_(MirvFence)
+_(MirvSemaphore)
+_(MirvBuffer)
+_(MirvImage)
+_(MirvShaderModule)
+_(MirvPipelineCache)
+_(MirvDescriptorSetLayout)
+_(MirvDescriptorPool)
+_(MirvDescriptorUpdateTemplate)
+_(MirvPipelineLayout)
+_(MirvPipeline)
 #undef _
@@ -0,0 +1,299 @@
+#include "mirv_alloc.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "mirv.h"
+
+// -------------------------------------
+// Global heap
+
+namespace {
+
+// Stored just below every aligned heap allocation.
+struct HeapPrefix final
+{
+    void* mBase;
+    size_t mSize;
+};
+
+void*
+HeapAlloc(size_t size, size_t align)
+{
+    align = std::max(align, alignof(HeapPrefix));
+    const auto base = malloc(size + align + sizeof(HeapPrefix));
+    if (!base)
+        return nullptr;
+
+    auto ret = uintptr_t(base) + sizeof(HeapPrefix);
+    ret = (ret + align - 1) & ~uintptr_t(align - 1);
+
+    const auto prefix = (HeapPrefix*)ret - 1;
+    prefix->mBase = base;
+    prefix->mSize = size;
+    return (void*)ret;
+}
+
+void
+HeapFree(void* const p)
+{
+    if (!p)
+        return;
+    const auto prefix = (HeapPrefix*)p - 1;
+    free(prefix->mBase);
+}
+
+size_t
+HeapSize(void* const p)
+{
+    const auto prefix = (HeapPrefix*)p - 1;
+    return prefix->mSize;
+}
+
+VKAPI_ATTR void* VKAPI_CALL
+Heap_Alloc(void*, const size_t size, const size_t align, VkSystemAllocationScope)
+{
+    return HeapAlloc(size, align);
+}
+
+VKAPI_ATTR void* VKAPI_CALL
+Heap_Realloc(void*, void* const p, const size_t size, const size_t align,
+             VkSystemAllocationScope)
+{
+    const auto ret = HeapAlloc(size, align);
+    if (ret && p) {
+        memcpy(ret, p, std::min(size, HeapSize(p)));
+        HeapFree(p);
+    }
+    return ret;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+Heap_Free(void*, void* const p)
+{
+    HeapFree(p);
+}
+
+} // namespace
+
+const VkAllocationCallbacks&
+MirvHeapCallbacks()
+{
+    static const VkAllocationCallbacks kCallbacks = {
+        nullptr,
+        &Heap_Alloc,
+        &Heap_Realloc,
+        &Heap_Free,
+        nullptr,
+        nullptr,
+    };
+    return kCallbacks;
+}
+
+// -------------------------------------
+// Objects
+
+namespace {
+
+struct alignas(kMirvObjectAlign) ObjectPrefix final
+{
+    VkAllocationCallbacks mAllocator;
+};
+
+// From the start of the allocation to the object, whose prefix is just below it.
+size_t
+ObjectOffset(const size_t align)
+{
+    ASSERT(align && !(align & (align - 1)))
+    const auto objectAlign = std::max(align, alignof(ObjectPrefix));
+    return (sizeof(ObjectPrefix) + objectAlign - 1) & ~(objectAlign - 1);
+}
+
+} // namespace
+
+void*
+MirvAllocObject(const size_t size, const VkAllocationCallbacks& allocator,
+                const VkSystemAllocationScope scope, const size_t align)
+{
+    const auto offset = ObjectOffset(align);
+    const auto mem = (uint8_t*)allocator.pfnAllocation(allocator.pUserData, offset + size,
+                                                       std::max(align, alignof(ObjectPrefix)),
+                                                       scope);
+    if (!mem)
+        return nullptr;
+
+    const auto prefix = (ObjectPrefix*)(mem + offset) - 1;
+    prefix->mAllocator = allocator;
+    return prefix + 1;
+}
+
+void
+MirvFreeObject(void* const p, const size_t align)
+{
+    if (!p)
+        return;
+    const auto prefix = (ObjectPrefix*)p - 1;
+    const auto allocator = prefix->mAllocator;
+    allocator.pfnFree(allocator.pUserData, (uint8_t*)p - ObjectOffset(align));
+}
+
+// -------------------------------------
+// Arena
+
+namespace {
+
+// Arena allocations start with this, kPrefixSize bytes before the returned pointer.
+struct ArenaPrefix final
+{
+    size_t mClassIndex; // kClassCount for oversized allocations, which go to the heap.
+    size_t mSize;
+};
+
+VKAPI_ATTR void* VKAPI_CALL
+Arena_Alloc(void* const arena, const size_t size, const size_t align,
+            VkSystemAllocationScope)
+{
+    return ((MirvArena*)arena)->Alloc(size, align);
+}
+
+VKAPI_ATTR void* VKAPI_CALL
+Arena_Realloc(void* const arena, void* const p, const size_t size, const size_t align,
+              VkSystemAllocationScope)
+{
+    return ((MirvArena*)arena)->Realloc(p, size, align);
+}
+
+VKAPI_ATTR void VKAPI_CALL
+Arena_Free(void* const arena, void* const p)
+{
+    ((MirvArena*)arena)->Free(p);
+}
+
+} // namespace
+
+MirvArena::MirvArena()
+{
+    static_assert(sizeof(ArenaPrefix) <= kPrefixSize, "kPrefixSize too small.");
+
+    mCallbacks.pUserData = this;
+    mCallbacks.pfnAllocation = &Arena_Alloc;
+    mCallbacks.pfnReallocation = &Arena_Realloc;
+    mCallbacks.pfnFree = &Arena_Free;
+    mCallbacks.pfnInternalAllocation = nullptr;
+    mCallbacks.pfnInternalFree = nullptr;
+
+    for (auto& x : mClasses) {
+        x.mFree = nullptr;
+        x.mBumpCur = nullptr;
+        x.mBumpEnd = nullptr;
+    }
+}
+
+MirvArena::~MirvArena()
+{
+    for (const auto& x : mSlabs) {
+        HeapFree(x);
+    }
+}
+
+void*
+MirvArena::AllocFromClass(const size_t classIndex)
+{
+    auto& sizeClass = mClasses[classIndex];
+    const auto size = ClassSize(classIndex);
+
+    const mutex_guard guard(sizeClass.mMutex);
+    if (sizeClass.mFree) {
+        const auto ret = sizeClass.mFree;
+        sizeClass.mFree = ret->mNext;
+        return ret;
+    }
+
+    if (sizeClass.mBumpCur + size > sizeClass.mBumpEnd) {
+        const auto slab = (uint8_t*)HeapAlloc(kSlabSize, kMinClassSize);
+        if (!slab)
+            return nullptr;
+        {
+            const mutex_guard slabsGuard(mSlabsMutex);
+            mSlabs.push_back(slab);
+        }
+        sizeClass.mBumpCur = slab;
+        sizeClass.mBumpEnd = slab + kSlabSize;
+    }
+
+    const auto ret = sizeClass.mBumpCur;
+    sizeClass.mBumpCur += size;
+    return ret;
+}
+
+void*
+MirvArena::Alloc(const size_t size, const size_t align)
+{
+    const auto total = kPrefixSize + size;
+
+    size_t classIndex = kClassCount;
+    if (align <= kPrefixSize) {
+        for (size_t i = 0; i < kClassCount; i++) {
+            if (total <= ClassSize(i)) {
+                classIndex = i;
+                break;
+            }
+        }
+    }
+
+    uint8_t* mem;
+    if (classIndex < kClassCount) {
+        mem = (uint8_t*)AllocFromClass(classIndex);
+    } else {
+        // Oversized: [heap ptr][ArenaPrefix][data], with data at the requested alignment.
+        const auto padding = std::max(align, 2 * kPrefixSize);
+        const auto heapAlign = std::max(align, size_t(kMinClassSize));
+        const auto heap = (uint8_t*)HeapAlloc(padding + size, heapAlign);
+        if (!heap)
+            return nullptr;
+        mem = heap + padding - kPrefixSize;
+        ((void**)mem)[-1] = heap;
+    }
+    if (!mem)
+        return nullptr;
+
+    const auto prefix = (ArenaPrefix*)mem;
+    prefix->mClassIndex = classIndex;
+    prefix->mSize = size;
+    return mem + kPrefixSize;
+}
+
+void*
+MirvArena::Realloc(void* const p, const size_t size, const size_t align)
+{
+    const auto ret = Alloc(size, align);
+    if (ret && p) {
+        const auto prefix = (ArenaPrefix*)((uint8_t*)p - kPrefixSize);
+        memcpy(ret, p, std::min(size, prefix->mSize));
+        Free(p);
+    }
+    return ret;
+}
+
+void
+MirvArena::Free(void* const p)
+{
+    if (!p)
+        return;
+
+    const auto mem = (uint8_t*)p - kPrefixSize;
+    const auto prefix = (ArenaPrefix*)mem;
+    const auto classIndex = prefix->mClassIndex;
+    if (classIndex == kClassCount) {
+        HeapFree(((void**)mem)[-1]);
+        return;
+    }
+
+    auto& sizeClass = mClasses[classIndex];
+    const auto node = (FreeNode*)mem;
+
+    const mutex_guard guard(sizeClass.mMutex);
+    node->mNext = sizeClass.mFree;
+    sizeClass.mFree = node;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "vulkan.h"
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+// Every allocation we make goes through a VkAllocationCallbacks: the app's, the device
+// arena's, or the global heap's.
+
+const VkAllocationCallbacks& MirvHeapCallbacks();
+
+const size_t kMirvObjectAlign = 16;
+
+// Mirv objects carry a copy of the callbacks that allocated them, so whoever drops the
+// last reference can free them. Frees must pass the same power-of-two `align`.
+void* MirvAllocObject(size_t size, const VkAllocationCallbacks& allocator,
+                      VkSystemAllocationScope scope, size_t align = kMirvObjectAlign);
+void MirvFreeObject(void* p, size_t align = kMirvObjectAlign);
+
+// Gives a class Mirv objects' `new (allocator, scope)` and `delete`, for state that isn't
+// a Vulkan object but should still come from the callbacks. On failure, `new` yields null.
+// Pre-C++17 `new` doesn't pass alignment along, so over-aligned classes say it here.
+template<size_t Align = kMirvObjectAlign>
+struct MirvAllocatedT
+{
+    static void* operator new(const size_t size, const VkAllocationCallbacks& allocator,
+                              const VkSystemAllocationScope scope) noexcept
+    {
+        return MirvAllocObject(size, allocator, scope, Align);
+    }
+    static void* operator new[](const size_t size, const VkAllocationCallbacks& allocator,
+                                const VkSystemAllocationScope scope) noexcept
+    {
+        return MirvAllocObject(size, allocator, scope, Align);
+    }
+    static void operator delete(void* const p, const VkAllocationCallbacks&,
+                                VkSystemAllocationScope)
+    {
+        MirvFreeObject(p, Align);
+    }
+    static void operator delete[](void* const p, const VkAllocationCallbacks&,
+                                  VkSystemAllocationScope)
+    {
+        MirvFreeObject(p, Align);
+    }
+    static void operator delete(void* const p) {
+        MirvFreeObject(p, Align);
+    }
+    static void operator delete[](void* const p) {
+        MirvFreeObject(p, Align);
+    }
+};
+
+typedef MirvAllocatedT<> MirvAllocated;
+
+// --
+
+// Default allocator for device children when the app passes no callbacks.
+// Small allocations come from per-size-class free lists carved out of 64KiB slabs, so
+// object churn only contends on this device's locks, never the global heap's.
+// Slabs are only returned to the heap when the arena dies.
+class MirvArena final
+{
+    static const size_t kSlabSize = 64 * 1024;
+    static const size_t kMinClassSize = 16;
+    static const size_t kClassCount = 8; // 16, 32, ..., 2048
+    static const size_t kPrefixSize = 16;
+
+    struct FreeNode {
+        FreeNode* mNext;
+    };
+
+    struct SizeClass {
+        std::mutex mMutex;
+        FreeNode* mFree;
+        uint8_t* mBumpCur;
+        uint8_t* mBumpEnd;
+    };
+
+    VkAllocationCallbacks mCallbacks;
+    SizeClass mClasses[kClassCount];
+
+    std::mutex mSlabsMutex;
+    std::vector<void*> mSlabs;
+
+public:
+    MirvArena();
+    ~MirvArena();
+
+    const VkAllocationCallbacks& Callbacks() const { return mCallbacks; }
+
+    void* Alloc(size_t size, size_t align);
+    void* Realloc(void* p, size_t size, size_t align);
+    void Free(void* p);
+
+private:
+    static size_t ClassSize(size_t classIndex) { return kMinClassSize << classIndex; }
+    void* AllocFromClass(size_t classIndex);
+};
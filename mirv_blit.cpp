@@ -0,0 +1,614 @@
+#include "mirv_blit.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "mirv.h"
+#include "mirv_transfer.h"
+
+#ifdef MIRV_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// So MirvMipPass blocks are at most kMirvBlitJobSize on a side.
+const uint32_t kMaxFusedLevels = 6;
+// Filtered rows a linear blit job keeps: both rows it blends, in both slices.
+const uint32_t kCachedRows = 4;
+
+// Where a destination texel samples along one axis: Two source texels, and their
+// weights. Nearest samples use just mI0.
+struct Tap final
+{
+    uint32_t mI0;
+    uint32_t mI1;
+    float mW0;
+    float mW1;
+};
+
+// Per thread, and reused by every job that thread runs.
+struct Scratch final
+{
+    std::vector<Tap> mTaps;
+    std::vector<uint8_t> mSrcBytes;
+    std::vector<uint8_t> mGathered;
+    std::vector<uint8_t> mDstBytes;
+    std::vector<MirvTexel> mSrcTexels;
+    std::vector<MirvTexel> mDstTexels;
+    std::vector<MirvTexel> mRows;
+};
+
+thread_local Scratch tScratch;
+
+template<typename T>
+T*
+Reserve(std::vector<T>* const vec, const size_t count)
+{
+    if (vec->size() < count) {
+        vec->resize(count);
+    }
+    return vec->data();
+}
+
+uint8_t*
+SlicePtr(const MirvImage& image, const uint32_t mip, const uint32_t layer, const uint32_t z)
+{
+    const auto& level = image.mLevels[mip];
+    return image.HostPtr() + level.mOffset + layer * level.mArrayPitch +
+           z * level.mDepthPitch;
+}
+
+// Rectangles of a slice's blocks, to and from row-major memory.
+void
+ReadRect(const MirvImage& image, const MirvImageLevel& level, const uint32_t blockBytes,
+         const uint8_t* const slice, const uint32_t x, const uint32_t y,
+         const uint32_t width, const uint32_t height, uint8_t* const dst,
+         const size_t dstPitch)
+{
+    if (image.mTileShift) {
+        MirvUntileRect(dst, dstPitch, slice, size_t(level.mRowPitch), blockBytes, x, y, width,
+                       height);
+        return;
+    }
+    for (uint32_t row = 0; row < height; row++) {
+        memcpy(dst + row * dstPitch, slice + (y + row) * level.mRowPitch + x * blockBytes,
+               width * blockBytes);
+    }
+}
+
+void
+WriteRect(const MirvImage& image, const MirvImageLevel& level, const uint32_t blockBytes,
+          uint8_t* const slice, const uint32_t x, const uint32_t y, const uint32_t width,
+          const uint32_t height, const uint8_t* const src, const size_t srcPitch)
+{
+    if (image.mTileShift) {
+        MirvTileRect(slice, size_t(level.mRowPitch), blockBytes, x, y, src, srcPitch, width,
+                     height, false);
+        return;
+    }
+    for (uint32_t row = 0; row < height; row++) {
+        memcpy(slice + (y + row) * level.mRowPitch + x * blockBytes, src + row * srcPitch,
+               width * blockBytes);
+    }
+}
+
+// `count` blocks of row `y`, from `x`. Row-major images' rows are read in place.
+const uint8_t*
+SourceRow(const MirvImage& image, const MirvImageLevel& level, const uint32_t blockBytes,
+          const uint8_t* const slice, const uint32_t x, const uint32_t y,
+          const uint32_t count, std::vector<uint8_t>* const scratch)
+{
+    if (!image.mTileShift)
+        return slice + y * level.mRowPitch + x * blockBytes;
+    const auto ret = Reserve(scratch, size_t(count) * blockBytes);
+    MirvUntileRect(ret, size_t(count) * blockBytes, slice, size_t(level.mRowPitch),
+                   blockBytes, x, y, count, 1);
+    return ret;
+}
+
+// -------------------------------------
+// Filtering. Every weighted sum is Blend, so a MirvMipPass rounds exactly as the blits
+// it stands in for.
+
+inline void
+Blend(const MirvTexel& a, const float wa, const MirvTexel& b, const float wb,
+      MirvTexel* const out)
+{
+#ifdef MIRV_SSE2
+    const auto x = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(a.mF), _mm_set1_ps(wa)),
+                              _mm_mul_ps(_mm_loadu_ps(b.mF), _mm_set1_ps(wb)));
+    _mm_storeu_ps(out->mF, x);
+#else
+    for (uint32_t i = 0; i < 4; i++) {
+        out->mF[i] = a.mF[i] * wa + b.mF[i] * wb;
+    }
+#endif
+}
+
+inline uint32_t
+ClampIndex(const float i, const uint32_t size)
+{
+    if (i <= 0.0f)
+        return 0;
+    if (i >= float(size - 1))
+        return size - 1;
+    return uint32_t(i);
+}
+
+// For destination texel `i` from the region's edge, whose center maps to u in the source.
+Tap
+GetTap(const MirvBlit::Axis& axis, const uint32_t i, const bool linear)
+{
+    const auto u = axis.mSrc0 + (float(i) + 0.5f) * axis.mScale;
+    if (!linear) {
+        const auto x = ClampIndex(std::floor(u), axis.mSrcSize);
+        return { x, x, 1.0f, 0.0f };
+    }
+    // Between the two nearest texel centers.
+    const auto base = std::floor(u - 0.5f);
+    const auto f = (u - 0.5f) - base;
+    return { ClampIndex(base, axis.mSrcSize), ClampIndex(base + 1.0f, axis.mSrcSize),
+             1.0f - f, f };
+}
+
+// Blocks to and from MirvTexels, for blits from `src` to `dst`. Between two of the same
+// format of four 8-bit UNorm components, channels stay in memory order, rather than
+// being shuffled into RGBA and back, since filters treat every channel alike.
+class Codec final
+{
+    const MirvFormatInfo& mSrc;
+    const MirvFormatInfo& mDst;
+    const bool mUNorm8x4;
+
+    static bool IsUNorm8x4(const MirvFormatInfo& x) {
+        return x.mLayout == MirvFormatLayout::Array && x.mNumeric == MirvNumeric::UNorm &&
+               x.mComponentCount == 4 && x.mBlockBytes == 4;
+    }
+
+public:
+    Codec(const VkFormat src, const VkFormat dst)
+        : mSrc(MirvGetFormatInfo(src))
+        , mDst(MirvGetFormatInfo(dst))
+        , mUNorm8x4(src == dst && IsUNorm8x4(mSrc))
+    { }
+
+    void Decode(const uint8_t* src, uint32_t count, MirvTexel* out) const;
+    void Encode(const MirvTexel* src, uint32_t count, uint8_t* out) const;
+};
+
+void
+Codec::Decode(const uint8_t* const src, const uint32_t count, MirvTexel* const out) const
+{
+    if (!mUNorm8x4) {
+        MirvDecodeTexels(mSrc, src, count, out);
+        return;
+    }
+    uint32_t i = 0;
+#ifdef MIRV_SSE2
+    const auto scale = _mm_set1_ps(1.0f / 255.0f);
+    const auto zero = _mm_setzero_si128();
+    for (; i + 4 <= count; i += 4) {
+        const auto x = _mm_loadu_si128((const __m128i*)(src + i * 4));
+        const auto lo = _mm_unpacklo_epi8(x, zero);
+        const auto hi = _mm_unpackhi_epi8(x, zero);
+        const __m128i texels[4] = {
+            _mm_unpacklo_epi16(lo, zero), _mm_unpackhi_epi16(lo, zero),
+            _mm_unpacklo_epi16(hi, zero), _mm_unpackhi_epi16(hi, zero),
+        };
+        for (uint32_t k = 0; k < 4; k++) {
+            _mm_storeu_ps(out[i + k].mF, _mm_mul_ps(_mm_cvtepi32_ps(texels[k]), scale));
+        }
+    }
+#endif
+    for (; i < count; i++) {
+        for (uint32_t k = 0; k < 4; k++) {
+            out[i].mF[k] = float(src[i * 4 + k]) * (1.0f / 255.0f);
+        }
+    }
+}
+
+#ifdef MIRV_SSE2
+// To [0, 255] in each lane, rounding, with NaN as 0 like the scalar path.
+inline __m128i
+Quantize(const __m128 x)
+{
+    const auto clamped = _mm_min_ps(_mm_max_ps(x, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(clamped, _mm_set1_ps(255.0f)),
+                                       _mm_set1_ps(0.5f)));
+}
+#endif
+
+void
+Codec::Encode(const MirvTexel* const src, const uint32_t count, uint8_t* const out) const
+{
+    if (!mUNorm8x4) {
+        MirvEncodeTexels(mDst, src, count, out);
+        return;
+    }
+    uint32_t i = 0;
+#ifdef MIRV_SSE2
+    for (; i + 4 <= count; i += 4) {
+        const auto a = _mm_packs_epi32(Quantize(_mm_loadu_ps(src[i].mF)),
+                                       Quantize(_mm_loadu_ps(src[i + 1].mF)));
+        const auto b = _mm_packs_epi32(Quantize(_mm_loadu_ps(src[i + 2].mF)),
+                                       Quantize(_mm_loadu_ps(src[i + 3].mF)));
+        _mm_storeu_si128((__m128i*)(out + i * 4), _mm_packus_epi16(a, b));
+    }
+#endif
+    for (; i < count; i++) {
+        for (uint32_t k = 0; k < 4; k++) {
+            const auto f = src[i].mF[k];
+            const auto clamped = f > 0.0f ? std::min(f, 1.0f) : 0.0f;
+            out[i * 4 + k] = uint8_t(clamped * 255.0f + 0.5f);
+        }
+    }
+}
+
+// -------------------------------------
+// Nearest blits gather blocks as stored.
+
+template<size_t B>
+void
+GatherBlocks(uint8_t* const dst, const uint8_t* const src, const Tap* const taps,
+             const uint32_t lo, const uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        memcpy(dst + i * B, src + (taps[i].mI0 - lo) * B, B);
+    }
+}
+
+// `src` holds blocks from `lo` on.
+void
+Gather(uint8_t* const dst, const uint8_t* const src, const Tap* const taps,
+       const uint32_t lo, const uint32_t count, const uint32_t blockBytes)
+{
+    switch (blockBytes) {
+#define _(B) \
+    case B: \
+        GatherBlocks<B>(dst, src, taps, lo, count); \
+        break;
+    _(1)
+    _(2)
+    _(4)
+    _(8)
+    _(16)
+#undef _
+    default:
+        for (uint32_t i = 0; i < count; i++) {
+            memcpy(dst + i * blockBytes, src + (taps[i].mI0 - lo) * blockBytes, blockBytes);
+        }
+        break;
+    }
+}
+
+// [begin, end) of the destination, from the region's edge, in job `j` along `axis`.
+void
+JobSpan(const MirvBlit::Axis& axis, const uint32_t j, uint32_t* const out_begin,
+        uint32_t* const out_end)
+{
+    const auto dst0 = uint32_t(axis.mDst0);
+    const auto begin = (axis.mJob0 + j) * kMirvBlitJobSize;
+    *out_begin = std::max(begin, dst0) - dst0;
+    *out_end = std::min(begin + kMirvBlitJobSize, dst0 + axis.mDstSize) - dst0;
+}
+
+inline bool
+CanFilter(const MirvFormatInfo& x)
+{
+    return (x.mLayout == MirvFormatLayout::Array || x.mLayout == MirvFormatLayout::Packed ||
+            x.mLayout == MirvFormatLayout::SharedExponent) &&
+           x.mNumeric != MirvNumeric::UInt && x.mNumeric != MirvNumeric::SInt;
+}
+
+int32_t
+Component(const VkOffset3D& offset, const uint32_t axis)
+{
+    return axis == 0 ? offset.x : axis == 1 ? offset.y : offset.z;
+}
+
+} // namespace
+
+// -------------------------------------
+
+MirvBlit::MirvBlit(const MirvImage& src, const MirvImage& dst, const VkImageBlit& r,
+                   const VkFilter filter)
+    : mSrc(src)
+    , mDst(dst)
+    , mSrcLevel(src.mLevels[r.srcSubresource.mipLevel])
+    , mDstLevel(dst.mLevels[r.dstSubresource.mipLevel])
+    , mSrcMip(r.srcSubresource.mipLevel)
+    , mDstMip(r.dstSubresource.mipLevel)
+    , mSrcLayer(r.srcSubresource.baseArrayLayer)
+    , mDstLayer(r.dstSubresource.baseArrayLayer)
+    , mLayerCount(r.srcSubresource.layerCount)
+    , mLinear(filter == VK_FILTER_LINEAR)
+    , mConversion(MirvFindConversion(dst.mStorageFormat, src.mStorageFormat))
+{
+    ASSERT(r.srcSubresource.layerCount == r.dstSubresource.layerCount)
+    ASSERT(src.HostPtr() && dst.HostPtr())
+    const auto& srcFormat = *mConversion.mSrc;
+    const auto& dstFormat = *mConversion.mDst;
+    ASSERT(srcFormat.mLayout != MirvFormatLayout::Compressed &&
+           dstFormat.mLayout != MirvFormatLayout::Compressed)
+    ASSERT(!mLinear || (CanFilter(srcFormat) && CanFilter(dstFormat)))
+    // Depth/stencil blits are nearest, between the same format, and of both aspects.
+    ASSERT((srcFormat.mLayout != MirvFormatLayout::DepthStencil &&
+            dstFormat.mLayout != MirvFormatLayout::DepthStencil) ||
+           (src.mStorageFormat == dst.mStorageFormat &&
+            r.srcSubresource.aspectMask ==
+            (VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT)))
+    (void)srcFormat;
+    (void)dstFormat;
+
+    const auto& extent = mSrcLevel.mExtent;
+    const uint32_t srcSizes[3] = { extent.width, extent.height, extent.depth };
+    for (uint32_t i = 0; i < 3; i++) {
+        auto s0 = Component(r.srcOffsets[0], i);
+        auto s1 = Component(r.srcOffsets[1], i);
+        auto d0 = Component(r.dstOffsets[0], i);
+        auto d1 = Component(r.dstOffsets[1], i);
+        // Mirroring is all in the scale.
+        if (d1 < d0) {
+            std::swap(d0, d1);
+            std::swap(s0, s1);
+        }
+        auto& axis = mAxes[i];
+        axis.mDst0 = d0;
+        axis.mDstSize = uint32_t(d1 - d0);
+        axis.mJob0 = uint32_t(d0) / kMirvBlitJobSize;
+        axis.mSrc0 = float(s0);
+        axis.mScale = axis.mDstSize ? float(s1 - s0) / float(d1 - d0) : 0.0f;
+        axis.mSrcSize = srcSizes[i];
+    }
+    const auto jobs = [](const Axis& axis) {
+        if (!axis.mDstSize)
+            return 0u;
+        return (uint32_t(axis.mDst0) + axis.mDstSize - 1) / kMirvBlitJobSize - axis.mJob0 + 1;
+    };
+    mJobsX = jobs(mAxes[0]);
+    mJobsY = jobs(mAxes[1]);
+}
+
+void
+MirvBlit::Run(uint32_t job) const
+{
+    const auto jx = job % mJobsX;
+    job /= mJobsX;
+    const auto jy = job % mJobsY;
+    job /= mJobsY;
+    const auto z = job % mAxes[2].mDstSize;
+    const auto layer = job / mAxes[2].mDstSize;
+
+    uint32_t x0, x1, y0, y1;
+    JobSpan(mAxes[0], jx, &x0, &x1);
+    JobSpan(mAxes[1], jy, &y0, &y1);
+    const auto width = x1 - x0;
+    const auto height = y1 - y0;
+    const uint32_t srcBytes = mConversion.mSrc->mBlockBytes;
+    const uint32_t dstBytes = mConversion.mDst->mBlockBytes;
+    auto& scratch = tScratch;
+
+    // The source columns this job reads are [lo, lo + span).
+    const auto taps = Reserve(&scratch.mTaps, width);
+    uint32_t lo = UINT_MAX;
+    uint32_t hi = 0;
+    for (uint32_t i = 0; i < width; i++) {
+        const auto& tap = taps[i] = GetTap(mAxes[0], x0 + i, mLinear);
+        lo = std::min(lo, std::min(tap.mI0, tap.mI1));
+        hi = std::max(hi, std::max(tap.mI0, tap.mI1));
+    }
+    const auto span = hi - lo + 1;
+
+    const auto zTap = GetTap(mAxes[2], z, mLinear);
+    const auto srcLayer = mSrcLayer + layer;
+    const auto dstPitch = size_t(width) * dstBytes;
+    const auto out = Reserve(&scratch.mDstBytes, dstPitch * height);
+
+    if (!mLinear) {
+        const auto slice = SlicePtr(mSrc, mSrcMip, srcLayer, zTap.mI0);
+        const auto copy = mConversion.IsCopy();
+        const auto gathered = copy ? nullptr
+                                   : Reserve(&scratch.mGathered, size_t(width) * srcBytes);
+        for (uint32_t y = 0; y < height; y++) {
+            const auto row = GetTap(mAxes[1], y0 + y, false).mI0;
+            const auto src = SourceRow(mSrc, mSrcLevel, srcBytes, slice, lo, row, span,
+                                       &scratch.mSrcBytes);
+            const auto dstRow = out + y * dstPitch;
+            if (copy) {
+                Gather(dstRow, src, taps, lo, width, srcBytes);
+            } else {
+                Gather(gathered, src, taps, lo, width, srcBytes);
+                mConversion.Run(dstRow, gathered, width);
+            }
+        }
+    } else {
+        // 2D images' single slice has zTap.mW1 == 0.
+        const auto sliceCount = (zTap.mW1 != 0.0f) ? 2u : 1u;
+        const uint8_t* const slices[2] = {
+            SlicePtr(mSrc, mSrcMip, srcLayer, zTap.mI0),
+            SlicePtr(mSrc, mSrcMip, srcLayer, zTap.mI1),
+        };
+        const uint32_t sliceZs[2] = { zTap.mI0, zTap.mI1 };
+        const Codec codec(mSrc.mStorageFormat, mDst.mStorageFormat);
+        const auto texels = Reserve(&scratch.mSrcTexels, span);
+        const auto rows = Reserve(&scratch.mRows, kCachedRows * width);
+        const auto blended = Reserve(&scratch.mDstTexels, 2 * width);
+        uint64_t keys[kCachedRows]; // z << 32 | row
+        std::fill(keys, keys + kCachedRows, UINT64_MAX);
+
+        for (uint32_t y = 0; y < height; y++) {
+            const auto yTap = GetTap(mAxes[1], y0 + y, true);
+            const auto needCount = 2 * sliceCount;
+            uint64_t need[kCachedRows];
+            const MirvTexel* got[kCachedRows];
+            for (uint32_t s = 0; s < sliceCount; s++) {
+                need[2 * s] = uint64_t(sliceZs[s]) << 32 | yTap.mI0;
+                need[2 * s + 1] = uint64_t(sliceZs[s]) << 32 | yTap.mI1;
+            }
+            for (uint32_t n = 0; n < needCount; n++) {
+                const auto hit = std::find(keys, keys + kCachedRows, need[n]);
+                if (hit != keys + kCachedRows) {
+                    got[n] = rows + (hit - keys) * width;
+                    continue;
+                }
+                // Evict a row this one doesn't need. There's always one, with four slots.
+                uint32_t slot = 0;
+                while (std::find(need, need + needCount, keys[slot]) != need + needCount) {
+                    slot++;
+                }
+                keys[slot] = need[n];
+                const auto row = rows + slot * width;
+                const auto src = SourceRow(mSrc, mSrcLevel, srcBytes, slices[n / 2], lo,
+                                           uint32_t(need[n]), span, &scratch.mSrcBytes);
+                codec.Decode(src, span, texels);
+                for (uint32_t i = 0; i < width; i++) {
+                    const auto& tap = taps[i];
+                    Blend(texels[tap.mI0 - lo], tap.mW0, texels[tap.mI1 - lo], tap.mW1,
+                          &row[i]);
+                }
+                got[n] = row;
+            }
+
+            for (uint32_t s = 0; s < sliceCount; s++) {
+                const auto a = got[2 * s];
+                const auto b = got[2 * s + 1];
+                for (uint32_t i = 0; i < width; i++) {
+                    Blend(a[i], yTap.mW0, b[i], yTap.mW1, &blended[s * width + i]);
+                }
+            }
+            if (sliceCount == 2) {
+                for (uint32_t i = 0; i < width; i++) {
+                    Blend(blended[i], zTap.mW0, blended[width + i], zTap.mW1, &blended[i]);
+                }
+            }
+            codec.Encode(blended, width, out + y * dstPitch);
+        }
+    }
+
+    const auto dstSlice = SlicePtr(mDst, mDstMip, mDstLayer + layer,
+                                   uint32_t(mAxes[2].mDst0) + z);
+    WriteRect(mDst, mDstLevel, dstBytes, dstSlice, uint32_t(mAxes[0].mDst0) + x0,
+              uint32_t(mAxes[1].mDst0) + y0, width, height, out, dstPitch);
+}
+
+// -------------------------------------
+
+MirvMipPass::MirvMipPass(const MirvImage& image, const uint32_t level,
+                         const uint32_t levelCount, const uint32_t baseLayer,
+                         const uint32_t layerCount, const VkFilter filter)
+    : mImage(image)
+    , mLevel(level)
+    , mLevelCount(levelCount)
+    , mBaseLayer(baseLayer)
+    , mLayerCount(layerCount)
+    , mLinear(filter == VK_FILTER_LINEAR)
+{
+    ASSERT(levelCount && levelCount <= kMaxFusedLevels &&
+           level + levelCount < image.mMipLevels)
+    ASSERT(image.HostPtr())
+    ASSERT(!mLinear || CanFilter(MirvGetFormatInfo(image.mStorageFormat)))
+    // Axes that halve every level are cut into blocks that make one texel of the last.
+    // Any others are 2^k texels, down to 1 by the last level, so take them whole.
+    const auto& extent = image.mLevels[level].mExtent;
+    mBlockWidth = std::min(1u << levelCount, extent.width);
+    mBlockHeight = std::min(1u << levelCount, extent.height);
+    mBlocksX = extent.width / mBlockWidth;
+    mBlocksY = extent.height / mBlockHeight;
+}
+
+void
+MirvMipPass::Run(uint32_t job) const
+{
+    const auto bx = job % mBlocksX;
+    job /= mBlocksX;
+    const auto by = job % mBlocksY;
+    const auto layer = mBaseLayer + job / mBlocksY;
+
+    const uint32_t blockBytes = MirvGetFormatInfo(mImage.mStorageFormat).mBlockBytes;
+    const Codec codec(mImage.mStorageFormat, mImage.mStorageFormat);
+    auto& scratch = tScratch;
+    auto w = mBlockWidth;
+    auto h = mBlockHeight;
+    auto x = bx * w;
+    auto y = by * h;
+    const auto texelCount = size_t(w) * h;
+    auto cur = Reserve(&scratch.mSrcBytes, texelCount * blockBytes);
+    auto next = Reserve(&scratch.mDstBytes, texelCount * blockBytes);
+    const auto curTexels = mLinear ? Reserve(&scratch.mSrcTexels, texelCount) : nullptr;
+    const auto nextTexels = mLinear ? Reserve(&scratch.mDstTexels, texelCount) : nullptr;
+
+    ReadRect(mImage, mImage.mLevels[mLevel], blockBytes, SlicePtr(mImage, mLevel, layer, 0),
+             x, y, w, h, cur, w * blockBytes);
+    if (mLinear) {
+        codec.Decode(cur, w * h, curTexels);
+    }
+    for (uint32_t i = 1; i <= mLevelCount; i++) {
+        // As a linear blit samples: texels 2x and 2x+1 of axes that halve, or texel 0
+        // with all the weight of axes that stay 1. Nearest ones take 2x+1.
+        const auto dx = (w > 1) ? 1u : 0u;
+        const auto dy = (h > 1) ? 1u : 0u;
+        const auto wx = (w > 1) ? 0.5f : 0.0f;
+        const auto wy = (h > 1) ? 0.5f : 0.0f;
+        const auto nw = w >> dx;
+        const auto nh = h >> dy;
+        x >>= dx;
+        y >>= dy;
+        for (uint32_t ny = 0; ny < nh; ny++) {
+            const auto r0 = (ny << dy) * w;
+            const auto r1 = r0 + dy * w;
+            for (uint32_t nx = 0; nx < nw; nx++) {
+                const auto c0 = nx << dx;
+                const auto c1 = c0 + dx;
+                if (mLinear) {
+                    MirvTexel a, b;
+                    Blend(curTexels[r0 + c0], 1.0f - wx, curTexels[r0 + c1], wx, &a);
+                    Blend(curTexels[r1 + c0], 1.0f - wx, curTexels[r1 + c1], wx, &b);
+                    Blend(a, 1.0f - wy, b, wy, &nextTexels[ny * nw + nx]);
+                } else {
+                    memcpy(next + (ny * nw + nx) * blockBytes, cur + (r1 + c1) * blockBytes,
+                           blockBytes);
+                }
+            }
+        }
+        if (mLinear) {
+            codec.Encode(nextTexels, nw * nh, next);
+        }
+        const auto level = mLevel + i;
+        WriteRect(mImage, mImage.mLevels[level], blockBytes,
+                  SlicePtr(mImage, level, layer, 0), x, y, nw, nh, next, nw * blockBytes);
+        w = nw;
+        h = nh;
+        // The next level comes from this one as stored, like a blit would read it.
+        if (mLinear) {
+            if (i < mLevelCount) {
+                codec.Decode(next, w * h, curTexels);
+            }
+        } else {
+            std::swap(cur, next);
+        }
+    }
+}
+
+uint32_t
+MirvMipPassLevels(const MirvImage& image, const uint32_t level, const uint32_t maxLevels)
+{
+    if (image.mImageType != VK_IMAGE_TYPE_2D)
+        return 0;
+    const auto halves = [](const uint32_t from, const uint32_t to) {
+        return to * 2 == from || (from == 1 && to == 1);
+    };
+    const auto limit = std::min(std::min(maxLevels, kMaxFusedLevels),
+                                image.mMipLevels - 1 - level);
+    uint32_t count = 0;
+    for (; count < limit; count++) {
+        const auto& from = image.mLevels[level + count].mExtent;
+        const auto& to = image.mLevels[level + count + 1].mExtent;
+        if (!halves(from.width, to.width) || !halves(from.height, to.height))
+            break;
+    }
+    return count;
+}
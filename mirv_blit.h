@@ -0,0 +1,90 @@
+#pragma once
+
+#include "vulkan.h"
+
+#include <cstdint>
+
+#include "mirv_format.h"
+
+// Blits between images' mapped memory. Both kinds of work here are cut into jobs that
+// may run on any thread, in any order, as MirvGridJob items: JobCount() of them, each
+// run by Run(job).
+
+class MirvImage;
+struct MirvImageLevel;
+
+const uint32_t kMirvBlitJobSize = 64; // A multiple of every tile size.
+
+// One region of vkCmdBlitImage. A job is one square of the destination, kMirvBlitJobSize
+// texels on a side and aligned to multiples of it, in one layer or z slice.
+// Nearest blits move source texels as stored, converting if the formats differ. Linear
+// ones decode to MirvTexels and filter separably: along source rows, into a cache of
+// filtered rows, then between rows, and between slices for 3D images. Samples outside
+// the source clamp to its edge.
+class MirvBlit final
+{
+public:
+    // The source, along one axis of the destination.
+    struct Axis final {
+        int32_t mDst0; // mDst0 + 0.5 samples the source at mSrc0.
+        uint32_t mDstSize;
+        uint32_t mJob0; // mDst0 / kMirvBlitJobSize
+        float mSrc0;
+        float mScale; // Source texels per destination texel. Negative if mirrored.
+        uint32_t mSrcSize;
+    };
+
+private:
+    const MirvImage& mSrc;
+    const MirvImage& mDst;
+    const MirvImageLevel& mSrcLevel;
+    const MirvImageLevel& mDstLevel;
+    const uint32_t mSrcMip;
+    const uint32_t mDstMip;
+    const uint32_t mSrcLayer;
+    const uint32_t mDstLayer;
+    const uint32_t mLayerCount;
+    const bool mLinear;
+    const MirvConversion mConversion; // Nearest only.
+    Axis mAxes[3];
+    uint32_t mJobsX;
+    uint32_t mJobsY;
+
+public:
+    MirvBlit(const MirvImage& src, const MirvImage& dst, const VkImageBlit& region,
+             VkFilter filter);
+
+    uint32_t JobCount() const { return mLayerCount * mAxes[2].mDstSize * mJobsY * mJobsX; }
+    void Run(uint32_t job) const;
+};
+
+// Whole-level blits from each level to the next, down one 2D image's mip chain, as
+// successive vkCmdBlitImages would make them, but several levels per pass over the
+// source level: A job reads one block of `level` and makes what of every later level
+// comes from it, without the levels in between leaving its cache. That only works for
+// levels that exactly halve, or stay 1, along each axis, so every texel comes from the
+// 2x2 below it. MirvMipPassLevels counts those. Results match the blits bit for bit.
+class MirvMipPass final
+{
+    const MirvImage& mImage;
+    const uint32_t mLevel;
+    const uint32_t mLevelCount;
+    const uint32_t mBaseLayer;
+    const uint32_t mLayerCount;
+    const bool mLinear;
+    uint32_t mBlockWidth; // In mLevel's texels.
+    uint32_t mBlockHeight;
+    uint32_t mBlocksX;
+    uint32_t mBlocksY;
+
+public:
+    MirvMipPass(const MirvImage& image, uint32_t level, uint32_t levelCount,
+                uint32_t baseLayer, uint32_t layerCount, VkFilter filter);
+
+    uint32_t JobCount() const { return mLayerCount * mBlocksY * mBlocksX; }
+    void Run(uint32_t job) const;
+};
+
+// How many of the levels after `level`, up to `maxLevels`, one MirvMipPass can make.
+// 0 if the next level doesn't halve.
+uint32_t MirvMipPassLevels(const MirvImage& image, uint32_t level, uint32_t maxLevels);
@@ -0,0 +1,565 @@
+#include "mirv_cmd.h"
+
+#include "mirv.h"
+
+#include <algorithm>
+
+MirvCmdChunkCache::MirvCmdChunkCache(const VkAllocationCallbacks& allocator)
+    : mAllocator(allocator)
+    , mHead(0)
+{ }
+
+MirvCmdChunkCache::~MirvCmdChunkCache()
+{
+    auto itr = (FreeChunk*)(mHead.load(std::memory_order_relaxed) & ~kTagMask);
+    while (itr) {
+        const auto next = itr->mNext.load(std::memory_order_relaxed);
+        mAllocator.pfnFree(mAllocator.pUserData, itr);
+        itr = next;
+    }
+}
+
+uint8_t*
+MirvCmdChunkCache::Get(const size_t size)
+{
+    if (size == kMirvCmdChunkSize) {
+        auto head = mHead.load(std::memory_order_acquire);
+        while (true) {
+            const auto chunk = (FreeChunk*)(head & ~kTagMask);
+            if (!chunk)
+                break;
+
+            // Another thread may have already popped `chunk` and be recording into it,
+            // in which case mNext is stale, but then the tag won't match either.
+            const auto next = uintptr_t(chunk->mNext.load(std::memory_order_relaxed));
+            const auto newHead = next | ((head + 1) & kTagMask);
+            if (mHead.compare_exchange_weak(head, newHead, std::memory_order_acquire,
+                                            std::memory_order_acquire))
+            {
+                return (uint8_t*)chunk;
+            }
+        }
+    }
+    return (uint8_t*)mAllocator.pfnAllocation(mAllocator.pUserData, size, kChunkAlign,
+                                              VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+}
+
+void
+MirvCmdChunkCache::Put(uint8_t* const chunk, const size_t size)
+{
+    if (size != kMirvCmdChunkSize) {
+        mAllocator.pfnFree(mAllocator.pUserData, chunk);
+        return;
+    }
+
+    const auto node = (FreeChunk*)chunk;
+    auto head = mHead.load(std::memory_order_relaxed);
+    while (true) {
+        node->mNext.store((FreeChunk*)(head & ~kTagMask), std::memory_order_relaxed);
+        const auto newHead = uintptr_t(node) | ((head + 1) & kTagMask);
+        if (mHead.compare_exchange_weak(head, newHead, std::memory_order_release,
+                                        std::memory_order_relaxed))
+        {
+            return;
+        }
+    }
+}
+
+// -------------------------------------
+
+MirvCmdChunkPool::MirvCmdChunkPool(MirvCmdChunkCache& cache)
+    : mCache(cache)
+{ }
+
+MirvCmdChunkPool::~MirvCmdChunkPool()
+{
+    Trim();
+}
+
+uint8_t*
+MirvCmdChunkPool::Get(const size_t size)
+{
+    ASSERT(size >= kMirvCmdChunkSize)
+    if (size == kMirvCmdChunkSize && !mFree.empty()) {
+        const auto ret = mFree.back();
+        mFree.pop_back();
+        return ret;
+    }
+    return mCache.Get(size);
+}
+
+void
+MirvCmdChunkPool::Put(uint8_t* const chunk, const size_t size)
+{
+    if (size == kMirvCmdChunkSize) {
+        mFree.push_back(chunk);
+        return;
+    }
+    mCache.Put(chunk, size);
+}
+
+void
+MirvCmdChunkPool::Trim()
+{
+    for (const auto& x : mFree) {
+        mCache.Put(x, kMirvCmdChunkSize);
+    }
+    mFree.clear();
+    mFree.shrink_to_fit();
+}
+
+// -------------------------------------
+
+MirvCmdStream::MirvCmdStream(MirvCmdChunkPool& pool)
+    : mPool(pool)
+    , mCur(nullptr)
+    , mEnd(nullptr)
+    , mOutOfMemory(false)
+{ }
+
+MirvCmdStream::~MirvCmdStream()
+{
+    Reset();
+}
+
+uint8_t*
+MirvCmdStream::NextChunk(const size_t size)
+{
+    if (mOutOfMemory)
+        return nullptr;
+
+    const auto chunkSize = std::max(kMirvCmdChunkSize,
+                                    kMirvCmdChunkHeaderSize + size + sizeof(MirvCmd));
+    const auto chunk = mPool.Get(chunkSize);
+    if (!chunk) {
+        mOutOfMemory = true;
+        return nullptr;
+    }
+
+    Finish();
+    mChunks.push_back({ chunk, chunkSize });
+    mCur = chunk + kMirvCmdChunkHeaderSize;
+    mEnd = chunk + chunkSize - sizeof(MirvCmd);
+    return mCur;
+}
+
+void
+MirvCmdStream::Finish()
+{
+    if (!mCur)
+        return;
+    const auto cmd = (MirvCmd*)mCur;
+    cmd->mOp = MirvCmdOp::EndOfChunk;
+    cmd->mSize = sizeof(MirvCmd);
+}
+
+void
+MirvCmdStream::Reset()
+{
+    for (const auto& x : mChunks) {
+        mPool.Put(x.mData, x.mSize);
+    }
+    mChunks.clear();
+    mCur = nullptr;
+    mEnd = nullptr;
+    mOutOfMemory = false;
+}
+
+// -------------------------------------
+
+MirvCommandPool::MirvCommandPool(MirvDevice& device, const VkCommandPoolCreateInfo& info,
+                                 const VkAllocationCallbacks* const allocator)
+    : MirvNonDispatchableObject(device)
+    , mFlags(info.flags)
+    , mQueueFamilyIndex(info.queueFamilyIndex)
+    , mAllocator(device.ChildAllocator(allocator))
+    , mOwnChunkCache(mAllocator)
+    , mChunks(allocator ? mOwnChunkCache : device.mCmdChunks)
+{ }
+
+MirvCommandPool::~MirvCommandPool() = default;
+
+VkResult
+MirvCommandPool::vkAllocateCommandBuffers(const VkCommandBufferAllocateInfo& info,
+                                          VkCommandBuffer* const out)
+{
+    ASSERT(!info.pNext)
+
+    const auto firstIndex = mBuffers.size();
+    mBuffers.reserve(firstIndex + info.commandBufferCount);
+    for (uint32_t i = 0; i < info.commandBufferCount; i++) {
+        const auto& cb = new (mAllocator, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT)
+                             MirvCommandBuffer(*this, info.level);
+        if (!cb) {
+            // All or nothing.
+            while (mBuffers.size() > firstIndex) {
+                mBuffers.pop_back();
+            }
+            for (auto& x : Range(out, info.commandBufferCount)) {
+                x = VK_NULL_HANDLE;
+            }
+            return VK_ERROR_OUT_OF_HOST_MEMORY;
+        }
+        cb->mPoolIndex = mBuffers.size();
+        mBuffers.push_back(cb);
+        out[i] = cb->Handle();
+    }
+    return VK_SUCCESS;
+}
+
+void
+MirvCommandPool::vkFreeCommandBuffers(const uint32_t count,
+                                      const VkCommandBuffer* const handles)
+{
+    for (const auto& handle : Range(handles, count)) {
+        if (!handle)
+            continue;
+        const auto& cb = MirvCommandBuffer::For(handle);
+        ASSERT(&cb->mPool == this)
+
+        // Swap-remove.
+        const auto index = cb->mPoolIndex;
+        if (index + 1 != mBuffers.size()) {
+            mBuffers.back()->mPoolIndex = index;
+            std::swap(mBuffers[index], mBuffers.back());
+        }
+        mBuffers.pop_back();
+    }
+}
+
+VkResult
+MirvCommandPool::vkResetCommandPool(const VkCommandPoolResetFlags flags)
+{
+    for (const auto& x : mBuffers) {
+        x->Reset();
+    }
+    if (flags & VK_COMMAND_POOL_RESET_RELEASE_RESOURCES_BIT) {
+        mChunks.Trim();
+    }
+    return VK_SUCCESS;
+}
+
+// -------------------------------------
+
+MirvCommandBuffer::MirvCommandBuffer(MirvCommandPool& pool, const VkCommandBufferLevel level)
+    : MirvDispatchableObject(MirvObjectType::CommandBuffer)
+    , mPool(pool)
+    , mLevel(level)
+    , mPoolIndex(0)
+    , mState(State::Initial)
+    , mUsage(0)
+    , mStream(pool.mChunks)
+    , mMipChain(nullptr)
+{ }
+
+void
+MirvCommandBuffer::Reset()
+{
+    mStream.Reset();
+    mMipChain = nullptr;
+    mState = State::Initial;
+}
+
+VkResult
+MirvCommandBuffer::vkBeginCommandBuffer(const VkCommandBufferBeginInfo& info)
+{
+    ASSERT(!info.pNext)
+    ASSERT(mState != State::Recording)
+    if (mState != State::Initial) {
+        ASSERT(mPool.mFlags & VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT)
+        Reset();
+    }
+    mUsage = info.flags;
+    mState = State::Recording;
+    return VK_SUCCESS;
+}
+
+VkResult
+MirvCommandBuffer::vkEndCommandBuffer()
+{
+    ASSERT(mState == State::Recording)
+    if (mStream.OutOfMemory())
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    mStream.Finish();
+    mState = State::Executable;
+    return VK_SUCCESS;
+}
+
+VkResult
+MirvCommandBuffer::vkResetCommandBuffer(VkCommandBufferResetFlags)
+{
+    ASSERT(mPool.mFlags & VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT)
+    Reset();
+    return VK_SUCCESS;
+}
+
+void
+MirvCommandBuffer::vkCmdPushConstants(const VkPipelineLayout layout,
+                                      const VkShaderStageFlags stageFlags,
+                                      const uint32_t offset, const uint32_t size,
+                                      const void* const values)
+{
+    ASSERT(mState == State::Recording)
+    const auto cmd = mStream.Push<MirvCmd_PushConstants>(size);
+    if (!cmd)
+        return;
+    cmd->mLayout = HandleBits(layout);
+    cmd->mStageFlags = stageFlags;
+    cmd->mOffset = offset;
+    cmd->mDataSize = size;
+    memcpy(cmd + 1, values, size);
+}
+
+void
+MirvCommandBuffer::vkCmdBindPipeline(const VkPipelineBindPoint bindPoint,
+                                     const VkPipeline pipeline)
+{
+    ASSERT(mState == State::Recording)
+    ASSERT(bindPoint == VK_PIPELINE_BIND_POINT_COMPUTE)
+    const auto cmd = mStream.Push<MirvCmd_BindPipeline>();
+    if (!cmd)
+        return;
+    cmd->mPipeline = MirvPipeline::For(mPool.mDevice, pipeline);
+}
+
+// Dynamic offsets are split up by set now, while we still have the layout.
+void
+MirvCommandBuffer::vkCmdBindDescriptorSets(const VkPipelineBindPoint bindPoint,
+                                           const VkPipelineLayout layout,
+                                           const uint32_t firstSet, const uint32_t setCount,
+                                           const VkDescriptorSet* const sets,
+                                           const uint32_t dynamicOffsetCount,
+                                           const uint32_t* const dynamicOffsets)
+{
+    ASSERT(mState == State::Recording)
+    ASSERT(bindPoint == VK_PIPELINE_BIND_POINT_COMPUTE)
+    ASSERT(firstSet + setCount <= kMirvMaxBoundDescriptorSets)
+    const auto cmd = mStream.Push<MirvCmd_BindDescriptorSets>(
+        setCount * sizeof(MirvBoundDescriptorSet));
+    if (!cmd)
+        return;
+    cmd->mFirstSet = firstSet;
+    cmd->mSetCount = setCount;
+
+    const auto& setLayouts = MirvPipelineLayout::For(mPool.mDevice, layout)->mSetLayouts;
+    uint32_t nextOffset = 0;
+    for (uint32_t i = 0; i < setCount; i++) {
+        auto& bound = cmd->Sets()[i];
+        bound.mSet = MirvDescriptorSet::For(sets[i]);
+        const auto dynamicCount = setLayouts[firstSet + i]->mDynamicCount;
+        ASSERT(nextOffset + dynamicCount <= dynamicOffsetCount)
+        memcpy(bound.mDynamicOffsets, dynamicOffsets + nextOffset,
+               dynamicCount * sizeof(uint32_t));
+        nextOffset += dynamicCount;
+    }
+    (void)dynamicOffsetCount;
+}
+
+void
+MirvCommandBuffer::vkCmdDispatch(const uint32_t x, const uint32_t y, const uint32_t z)
+{
+    ASSERT(mState == State::Recording)
+    const auto cmd = mStream.Push<MirvCmd_Dispatch>();
+    if (!cmd)
+        return;
+    cmd->mGroupCount[0] = x;
+    cmd->mGroupCount[1] = y;
+    cmd->mGroupCount[2] = z;
+}
+
+void
+MirvCommandBuffer::vkCmdDispatchIndirect(const VkBuffer buffer, const VkDeviceSize offset)
+{
+    ASSERT(mState == State::Recording)
+    ASSERT(offset % 4 == 0)
+    const auto cmd = mStream.Push<MirvCmd_DispatchIndirect>();
+    if (!cmd)
+        return;
+    cmd->mBuffer = MirvBuffer::For(mPool.mDevice, buffer);
+    cmd->mOffset = offset;
+}
+
+// Regions are sorted and merged now, so execution sees as few, as large, copies as it
+// can. Many apps upload one region per resource, back to back in both buffers.
+void
+MirvCommandBuffer::vkCmdCopyBuffer(const VkBuffer src, const VkBuffer dst,
+                                   const uint32_t regionCount,
+                                   const VkBufferCopy* const regions)
+{
+    ASSERT(mState == State::Recording)
+    const auto cmd = mStream.Push<MirvCmd_CopyBuffer>(regionCount * sizeof(VkBufferCopy));
+    if (!cmd)
+        return;
+    cmd->mSrc = MirvBuffer::For(mPool.mDevice, src);
+    cmd->mDst = MirvBuffer::For(mPool.mDevice, dst);
+
+    const auto out = cmd->Regions();
+    std::copy_n(regions, regionCount, out);
+    std::sort(out, out + regionCount, [](const VkBufferCopy& a, const VkBufferCopy& b) {
+        return a.srcOffset < b.srcOffset;
+    });
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < regionCount; i++) {
+        const auto& x = out[i];
+        ASSERT(x.srcOffset + x.size <= cmd->mSrc->mSize &&
+               x.dstOffset + x.size <= cmd->mDst->mSize)
+        if (count) {
+            auto& prev = out[count - 1];
+            if (prev.srcOffset + prev.size == x.srcOffset &&
+                prev.dstOffset + prev.size == x.dstOffset)
+            {
+                prev.size += x.size;
+                continue;
+            }
+        }
+        out[count++] = x;
+    }
+    cmd->mRegionCount = count;
+}
+
+void
+MirvCommandBuffer::vkCmdFillBuffer(const VkBuffer dst, const VkDeviceSize offset,
+                                   const VkDeviceSize size, const uint32_t data)
+{
+    ASSERT(mState == State::Recording)
+    ASSERT(offset % 4 == 0)
+    const auto cmd = mStream.Push<MirvCmd_FillBuffer>();
+    if (!cmd)
+        return;
+    cmd->mDst = MirvBuffer::For(mPool.mDevice, dst);
+    cmd->mOffset = offset;
+    // Whole-size fills round down to a multiple of 4.
+    cmd->mBytes = (size == VK_WHOLE_SIZE) ? (cmd->mDst->mSize - offset) & ~uint64_t(3) : size;
+    cmd->mData = data;
+    ASSERT(cmd->mBytes % 4 == 0 && offset + cmd->mBytes <= cmd->mDst->mSize)
+}
+
+void
+MirvCommandBuffer::vkCmdUpdateBuffer(const VkBuffer dst, const VkDeviceSize offset,
+                                     const VkDeviceSize size, const void* const data)
+{
+    ASSERT(mState == State::Recording)
+    ASSERT(offset % 4 == 0 && size % 4 == 0 && size <= 65536)
+    const auto cmd = mStream.Push<MirvCmd_UpdateBuffer>(size_t(size));
+    if (!cmd)
+        return;
+    cmd->mDst = MirvBuffer::For(mPool.mDevice, dst);
+    cmd->mOffset = offset;
+    cmd->mDataSize = uint32_t(size);
+    memcpy(cmd + 1, data, size_t(size));
+    ASSERT(offset + size <= cmd->mDst->mSize)
+}
+
+// Images only ever have the one layout, so layouts are ignored.
+void
+MirvCommandBuffer::vkCmdCopyBufferToImage(const VkBuffer src, const VkImage dst,
+                                          VkImageLayout, const uint32_t regionCount,
+                                          const VkBufferImageCopy* const regions)
+{
+    ASSERT(mState == State::Recording)
+    const auto cmd = mStream.Push<MirvCmd_CopyBufferToImage>(regionCount *
+                                                             sizeof(VkBufferImageCopy));
+    if (!cmd)
+        return;
+    cmd->mBuffer = MirvBuffer::For(mPool.mDevice, src);
+    cmd->mImage = MirvImage::For(mPool.mDevice, dst);
+    cmd->mRegionCount = regionCount;
+    memcpy(cmd + 1, regions, regionCount * sizeof(*regions));
+}
+
+void
+MirvCommandBuffer::vkCmdCopyImageToBuffer(const VkImage src, VkImageLayout,
+                                          const VkBuffer dst, const uint32_t regionCount,
+                                          const VkBufferImageCopy* const regions)
+{
+    ASSERT(mState == State::Recording)
+    const auto cmd = mStream.Push<MirvCmd_CopyImageToBuffer>(regionCount *
+                                                             sizeof(VkBufferImageCopy));
+    if (!cmd)
+        return;
+    cmd->mBuffer = MirvBuffer::For(mPool.mDevice, dst);
+    cmd->mImage = MirvImage::For(mPool.mDevice, src);
+    cmd->mRegionCount = regionCount;
+    memcpy(cmd + 1, regions, regionCount * sizeof(*regions));
+}
+
+// Whether `r` blits the whole of one level of 2D `image` to the whole of the next.
+static bool
+IsMipStep(const MirvImage& image, const VkImageBlit& r)
+{
+    const auto& src = r.srcSubresource;
+    const auto& dst = r.dstSubresource;
+    if (image.mImageType != VK_IMAGE_TYPE_2D ||
+        src.aspectMask != VK_IMAGE_ASPECT_COLOR_BIT ||
+        dst.aspectMask != VK_IMAGE_ASPECT_COLOR_BIT ||
+        dst.mipLevel != src.mipLevel + 1 ||
+        dst.baseArrayLayer != src.baseArrayLayer ||
+        dst.layerCount != src.layerCount)
+    {
+        return false;
+    }
+    const auto whole = [](const VkOffset3D* const offsets, const VkExtent3D& extent) {
+        return offsets[0].x == 0 && offsets[0].y == 0 && offsets[0].z == 0 &&
+               offsets[1].x == int32_t(extent.width) &&
+               offsets[1].y == int32_t(extent.height) && offsets[1].z == 1;
+    };
+    return whole(r.srcOffsets, image.mLevels[src.mipLevel].mExtent) &&
+           whole(r.dstOffsets, image.mLevels[dst.mipLevel].mExtent);
+}
+
+// Apps make mip chains with a blit per level, each from the last one's destination.
+// Runs of those, with nothing but barriers between, record as one GenerateMips, which
+// can make several levels per pass over the level they start from.
+void
+MirvCommandBuffer::vkCmdBlitImage(const VkImage src, VkImageLayout, const VkImage dst,
+                                  VkImageLayout, const uint32_t regionCount,
+                                  const VkImageBlit* const regions, const VkFilter filter)
+{
+    ASSERT(mState == State::Recording)
+    const auto srcImage = MirvImage::For(mPool.mDevice, src);
+    const auto dstImage = MirvImage::For(mPool.mDevice, dst);
+    if (regionCount == 1 && srcImage == dstImage && IsMipStep(*srcImage, regions[0])) {
+        const auto& sub = regions[0].srcSubresource;
+        const auto chain = mMipChain;
+        if (chain && mStream.IsLast(*chain) && chain->mImage == srcImage &&
+            chain->mFilter == filter &&
+            chain->mBaseLevel + chain->mLevelCount == sub.mipLevel &&
+            chain->mBaseLayer == sub.baseArrayLayer && chain->mLayerCount == sub.layerCount)
+        {
+            chain->mLevelCount++;
+            return;
+        }
+        const auto cmd = mStream.Push<MirvCmd_GenerateMips>();
+        if (!cmd)
+            return;
+        cmd->mImage = srcImage;
+        cmd->mFilter = filter;
+        cmd->mBaseLevel = sub.mipLevel;
+        cmd->mLevelCount = 1;
+        cmd->mBaseLayer = sub.baseArrayLayer;
+        cmd->mLayerCount = sub.layerCount;
+        mMipChain = cmd;
+        return;
+    }
+
+    const auto cmd = mStream.Push<MirvCmd_BlitImage>(regionCount * sizeof(VkImageBlit));
+    if (!cmd)
+        return;
+    cmd->mSrc = srcImage;
+    cmd->mDst = dstImage;
+    cmd->mFilter = filter;
+    cmd->mRegionCount = regionCount;
+    memcpy(cmd + 1, regions, regionCount * sizeof(*regions));
+}
+
+// Commands already run one at a time, in order, each finished before the next starts,
+// and images have just the one layout, so barriers have nothing to do. Recording
+// nothing also leaves a mip chain's blits either side of one back to back.
+void
+MirvCommandBuffer::vkCmdPipelineBarrier(VkPipelineStageFlags, VkPipelineStageFlags,
+                                        VkDependencyFlags, uint32_t, const VkMemoryBarrier*,
+                                        uint32_t, const VkBufferMemoryBarrier*, uint32_t,
+                                        const VkImageMemoryBarrier*)
+{
+    ASSERT(mState == State::Recording)
+}
@@ -0,0 +1,299 @@
+#pragma once
+
+#include "vulkan.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "util.h"
+
+// Recorded commands are packed back to back into chunks, each command starting with a
+// MirvCmd header, 8-byte aligned. Every chunk ends with an EndOfChunk.
+
+class MirvBuffer;
+class MirvImage;
+class MirvPipeline;
+struct MirvDescriptorSet;
+
+const uint32_t kMirvMaxBoundDescriptorSets = 8; // maxBoundDescriptorSets
+// maxDescriptorSetUniformBuffersDynamic + maxDescriptorSetStorageBuffersDynamic
+const uint32_t kMirvMaxDynamicBuffers = 8 + 4;
+
+enum class MirvCmdOp : uint32_t {
+    EndOfChunk,
+    PushConstants,
+    BindPipeline,
+    BindDescriptorSets,
+    Dispatch,
+    DispatchIndirect,
+    CopyBuffer,
+    FillBuffer,
+    UpdateBuffer,
+    CopyBufferToImage,
+    CopyImageToBuffer,
+    BlitImage,
+    GenerateMips,
+};
+
+struct MirvCmd
+{
+    MirvCmdOp mOp;
+    uint32_t mSize; // Including this header.
+};
+
+struct MirvCmd_PushConstants final : public MirvCmd
+{
+    static const MirvCmdOp kOp = MirvCmdOp::PushConstants;
+
+    uint64_t mLayout; // Handle bits.
+    VkShaderStageFlags mStageFlags;
+    uint32_t mOffset;
+    uint32_t mDataSize;
+    // uint8_t data[mDataSize];
+
+    const uint8_t* Data() const { return (const uint8_t*)(this + 1); }
+};
+
+struct MirvCmd_BindPipeline final : public MirvCmd
+{
+    static const MirvCmdOp kOp = MirvCmdOp::BindPipeline;
+
+    const MirvPipeline* mPipeline;
+};
+
+struct MirvBoundDescriptorSet final
+{
+    const MirvDescriptorSet* mSet; // Read at execution, not recording.
+    uint32_t mDynamicOffsets[kMirvMaxDynamicBuffers]; // Just this set's.
+};
+
+struct MirvCmd_BindDescriptorSets final : public MirvCmd
+{
+    static const MirvCmdOp kOp = MirvCmdOp::BindDescriptorSets;
+
+    uint32_t mFirstSet;
+    uint32_t mSetCount;
+    // MirvBoundDescriptorSet sets[mSetCount];
+
+    MirvBoundDescriptorSet* Sets() { return (MirvBoundDescriptorSet*)(this + 1); }
+    const MirvBoundDescriptorSet* Sets() const {
+        return (const MirvBoundDescriptorSet*)(this + 1);
+    }
+};
+
+struct MirvCmd_Dispatch final : public MirvCmd
+{
+    static const MirvCmdOp kOp = MirvCmdOp::Dispatch;
+
+    uint32_t mGroupCount[3];
+};
+
+struct MirvCmd_DispatchIndirect final : public MirvCmd
+{
+    static const MirvCmdOp kOp = MirvCmdOp::DispatchIndirect;
+
+    const MirvBuffer* mBuffer; // Read at execution, not recording.
+    uint64_t mOffset;
+};
+
+// Buffers' memory is looked up at execution, since it's bound by then.
+struct MirvCmd_CopyBuffer final : public MirvCmd
+{
+    static const MirvCmdOp kOp = MirvCmdOp::CopyBuffer;
+
+    const MirvBuffer* mSrc;
+    const MirvBuffer* mDst;
+    uint32_t mRegionCount;
+    // VkBufferCopy regions[mRegionCount]; Sorted, and merged where they abut.
+
+    VkBufferCopy* Regions() { return (VkBufferCopy*)(this + 1); }
+    const VkBufferCopy* Regions() const { return (const VkBufferCopy*)(this + 1); }
+};
+
+struct MirvCmd_FillBuffer final : public MirvCmd
+{
+    static const MirvCmdOp kOp = MirvCmdOp::FillBuffer;
+
+    const MirvBuffer* mDst;
+    uint64_t mOffset;
+    uint64_t mBytes; // VK_WHOLE_SIZE already resolved.
+    uint32_t mData;
+};
+
+struct MirvCmd_UpdateBuffer final : public MirvCmd
+{
+    static const MirvCmdOp kOp = MirvCmdOp::UpdateBuffer;
+
+    const MirvBuffer* mDst;
+    uint64_t mOffset;
+    uint32_t mDataSize;
+    // uint8_t data[mDataSize];
+
+    const uint8_t* Data() const { return (const uint8_t*)(this + 1); }
+};
+
+struct MirvCmd_CopyBufferToImage final : public MirvCmd
+{
+    static const MirvCmdOp kOp = MirvCmdOp::CopyBufferToImage;
+
+    const MirvBuffer* mBuffer;
+    const MirvImage* mImage;
+    uint32_t mRegionCount;
+    // VkBufferImageCopy regions[mRegionCount];
+
+    const VkBufferImageCopy* Regions() const { return (const VkBufferImageCopy*)(this + 1); }
+};
+
+struct MirvCmd_CopyImageToBuffer final : public MirvCmd
+{
+    static const MirvCmdOp kOp = MirvCmdOp::CopyImageToBuffer;
+
+    const MirvBuffer* mBuffer;
+    const MirvImage* mImage;
+    uint32_t mRegionCount;
+    // VkBufferImageCopy regions[mRegionCount];
+
+    const VkBufferImageCopy* Regions() const { return (const VkBufferImageCopy*)(this + 1); }
+};
+
+struct MirvCmd_BlitImage final : public MirvCmd
+{
+    static const MirvCmdOp kOp = MirvCmdOp::BlitImage;
+
+    const MirvImage* mSrc;
+    const MirvImage* mDst;
+    VkFilter mFilter;
+    uint32_t mRegionCount;
+    // VkImageBlit regions[mRegionCount];
+
+    const VkImageBlit* Regions() const { return (const VkImageBlit*)(this + 1); }
+};
+
+// Back-to-back blits of one image's whole levels, each to the next, recorded as one.
+struct MirvCmd_GenerateMips final : public MirvCmd
+{
+    static const MirvCmdOp kOp = MirvCmdOp::GenerateMips;
+
+    const MirvImage* mImage;
+    VkFilter mFilter;
+    uint32_t mBaseLevel; // The first blit's source.
+    uint32_t mLevelCount; // Blits, so levels made.
+    uint32_t mBaseLayer;
+    uint32_t mLayerCount;
+};
+
+// --
+
+const size_t kMirvCmdChunkSize = 64 * 1024;
+// Commands start this far into a chunk. The header is only ever touched atomically, so
+// MirvCmdChunkCache can read it from chunks that other threads are recording into.
+const size_t kMirvCmdChunkHeaderSize = 16;
+
+// Device-wide stack of free kMirvCmdChunkSize chunks, shared by command pools on every
+// thread, so it's lock-free. Chunks are kChunkAlign-aligned, and the head keeps an ABA tag
+// in the low bits. Other sizes go straight to and from the allocator.
+class MirvCmdChunkCache final
+{
+    static const size_t kChunkAlign = 4096;
+    static const uintptr_t kTagMask = kChunkAlign - 1;
+
+    struct FreeChunk final {
+        std::atomic<FreeChunk*> mNext;
+    };
+
+    const VkAllocationCallbacks& mAllocator;
+    std::atomic<uintptr_t> mHead;
+
+public:
+    explicit MirvCmdChunkCache(const VkAllocationCallbacks& allocator);
+    ~MirvCmdChunkCache();
+
+    uint8_t* Get(size_t size);
+    void Put(uint8_t* chunk, size_t size);
+};
+
+// Per-MirvCommandPool, so it's externally synchronized by the app, like the pool.
+// Command buffer resets recycle chunks here, and pool trims hand them back to the cache.
+class MirvCmdChunkPool final
+{
+    MirvCmdChunkCache& mCache;
+    std::vector<uint8_t*> mFree;
+
+public:
+    explicit MirvCmdChunkPool(MirvCmdChunkCache& cache);
+    ~MirvCmdChunkPool();
+
+    // `size` is at least kMirvCmdChunkSize. Only kMirvCmdChunkSize chunks are recycled.
+    uint8_t* Get(size_t size);
+    void Put(uint8_t* chunk, size_t size);
+    void Trim();
+};
+
+// --
+
+class MirvCmdStream final
+{
+    struct Chunk final {
+        uint8_t* mData;
+        size_t mSize;
+    };
+
+    MirvCmdChunkPool& mPool;
+    std::vector<Chunk> mChunks;
+    uint8_t* mCur;
+    uint8_t* mEnd; // Short of the chunk's end by room for an EndOfChunk.
+    bool mOutOfMemory;
+
+public:
+    explicit MirvCmdStream(MirvCmdChunkPool& pool);
+    ~MirvCmdStream();
+
+    bool OutOfMemory() const { return mOutOfMemory; }
+
+    // Null if we're out of memory, in which case recording should just stop.
+    template<typename T>
+    T* Push(const size_t extraBytes = 0) {
+        const auto size = (sizeof(T) + extraBytes + 7) & ~size_t(7);
+        auto mem = mCur;
+        if (size_t(mEnd - mCur) < size) {
+            mem = NextChunk(size);
+            if (!mem)
+                return nullptr;
+        }
+        mCur = mem + size;
+
+        const auto cmd = (T*)mem;
+        cmd->mOp = T::kOp;
+        cmd->mSize = uint32_t(size);
+        return cmd;
+    }
+
+    // Whether `cmd` is the last command pushed.
+    bool IsLast(const MirvCmd& cmd) const {
+        return (const uint8_t*)&cmd + cmd.mSize == mCur;
+    }
+
+    // Terminates the last chunk. Call before ForEach.
+    void Finish();
+    // Returns every chunk to the pool.
+    void Reset();
+
+    template<typename F>
+    void ForEach(const F& fn) const {
+        for (const auto& chunk : mChunks) {
+            auto itr = chunk.mData + kMirvCmdChunkHeaderSize;
+            while (true) {
+                const auto& cmd = *(const MirvCmd*)itr;
+                if (cmd.mOp == MirvCmdOp::EndOfChunk)
+                    break;
+                fn(cmd);
+                itr += cmd.mSize;
+            }
+        }
+    }
+
+private:
+    uint8_t* NextChunk(size_t size);
+};
@@ -0,0 +1,996 @@
+#include "mirv_cpu.h"
+
+#include <cstdlib>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "mirv_blit.h"
+#include "mirv_format.h"
+#include "mirv_transfer.h"
+
+// --
+
+static uint32_t
+CpuThreadCount()
+{
+    const auto env = getenv("MIRV_CPU_THREADS");
+    if (env) {
+        const auto count = (uint32_t)strtoul(env, nullptr, 10);
+        if (count)
+            return count;
+    }
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+static uint64_t
+CpuMemorySize()
+{
+#ifdef _WIN32
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    if (!GlobalMemoryStatusEx(&status))
+        return 0;
+    return status.ullTotalPhys;
+#else
+    const auto pages = sysconf(_SC_PHYS_PAGES);
+    const auto pageSize = sysconf(_SC_PAGE_SIZE);
+    if (pages < 0 || pageSize < 0)
+        return 0;
+    return uint64_t(pages) * uint64_t(pageSize);
+#endif
+}
+
+// Fills `cpus` with the CPUs we may run on, grouped by NUMA node, and `nodes` with their
+// nodes.
+static void
+CpuTopology(std::vector<uint32_t>* const cpus, std::vector<uint32_t>* const nodes)
+{
+#ifdef __linux__
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed))
+        return;
+
+    std::vector<std::pair<uint32_t, uint32_t>> byNode; // (node, cpu)
+    for (uint32_t cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed))
+            continue;
+
+        // sysfs lists a cpu's node as a nodeN link in its directory.
+        uint32_t node = 0;
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u", cpu);
+        if (const auto dir = opendir(path)) {
+            while (const auto entry = readdir(dir)) {
+                if (sscanf(entry->d_name, "node%u", &node) == 1)
+                    break;
+            }
+            closedir(dir);
+        }
+        byNode.push_back({node, cpu});
+    }
+    std::sort(byNode.begin(), byNode.end());
+
+    for (const auto& x : byNode) {
+        nodes->push_back(x.first);
+        cpus->push_back(x.second);
+    }
+#else
+    (void)cpus;
+    (void)nodes;
+#endif
+}
+
+static inline void
+CpuRelax()
+{
+#if defined(_MSC_VER)
+    YieldProcessor();
+#elif defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#else
+    std::this_thread::yield();
+#endif
+}
+
+template<>
+void
+MirvInstance::AddPhysDevs<Backends::CPU>()
+{
+    // Nothing we probe about the CPU changes at runtime, so probe once per process.
+    static const rp<MirvAdapter_CPU> sAdapter = new MirvAdapter_CPU;
+
+    const auto& pd = new (mAllocator, VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE)
+                         MirvPhysicalDevice_CPU(*this, sAdapter.get());
+    if (!pd)
+        return;
+    mPhysDevs.push_back(pd);
+}
+
+// -------------------------------------
+
+static uint64_t
+PackRange(const uint32_t begin, const uint32_t end)
+{
+    return uint64_t(begin) | (uint64_t(end) << 32);
+}
+
+// Chunks are small enough to balance well, but big enough that taking one is cheap next
+// to running it.
+static const uint32_t kChunksPerThread = 16;
+static const uint32_t kMaxGrain = 1024;
+// Dispatches tend to come back to back, so helpers spin briefly before sleeping.
+static const uint32_t kHelperSpins = 2000;
+
+MirvWorkerPool::MirvWorkerPool(const VkAllocationCallbacks& allocator,
+                               const uint32_t threadCount,
+                               const std::vector<uint32_t>& cpus,
+                               const std::vector<uint32_t>& cpuNodes)
+    : mThreadCount(std::max(1u, threadCount))
+    , mSlots(new (allocator, VK_SYSTEM_ALLOCATION_SCOPE_DEVICE) Slot[mThreadCount])
+    , mVictims(mThreadCount)
+    , mGrain(1)
+    , mRemaining(0)
+    , mSeq(0)
+    , mInside(0)
+    , mSleepers(0)
+    , mExiting(false)
+{
+    if (!mSlots)
+        return;
+    ASSERT(uintptr_t(mSlots.get()) % alignof(Slot) == 0)
+    for (uint32_t i = 0; i < mThreadCount; i++) {
+        mSlots[i].mRange.store(0, std::memory_order_relaxed);
+    }
+
+    // Helper i runs on cpus[i], leaving cpus[0] to whoever calls Run. Only pin if
+    // there's a CPU for everyone.
+    const bool pin = (!cpus.empty() && mThreadCount <= cpus.size());
+    const auto NodeOf = [&](const uint32_t self) -> uint32_t {
+        return pin ? cpuNodes[self] : 0;
+    };
+
+    // Steal from our own node first, in ring order from ourselves, then from the rest.
+    for (uint32_t self = 0; self < mThreadCount; self++) {
+        auto& victims = mVictims[self];
+        for (const bool sameNode : { true, false }) {
+            for (uint32_t i = 1; i < mThreadCount; i++) {
+                const auto other = (self + i) % mThreadCount;
+                if ((NodeOf(other) == NodeOf(self)) == sameNode) {
+                    victims.push_back(other);
+                }
+            }
+        }
+    }
+
+    mHelpers.reserve(mThreadCount - 1);
+    for (uint32_t self = 1; self < mThreadCount; self++) {
+        mHelpers.push_back(std::thread(&MirvWorkerPool::HelperMain, this, self));
+#ifdef __linux__
+        if (pin) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpus[self], &set);
+            (void)pthread_setaffinity_np(mHelpers.back().native_handle(), sizeof(set), &set);
+        }
+#endif
+    }
+}
+
+MirvWorkerPool::~MirvWorkerPool()
+{
+    mExiting.store(true, std::memory_order_seq_cst);
+    mSeq.fetch_add(2, std::memory_order_seq_cst); // Keeps it even.
+    MirvFutexWakeAll(mSeq);
+    for (auto& x : mHelpers) {
+        x.join();
+    }
+}
+
+void
+MirvWorkerPool::Run(const MirvGridJob& job)
+{
+    if (!job.mCount)
+        return;
+    if (mHelpers.empty() || job.mCount == 1) {
+        job.mFn(job.mCtx, 0, job.mCount);
+        return;
+    }
+
+    const mutex_guard guard(mRunMutex);
+    mJob = job;
+    const auto parts = std::min(mThreadCount, job.mCount);
+    mGrain = std::max(1u, std::min(kMaxGrain, job.mCount / (parts * kChunksPerThread)));
+    for (uint32_t i = 0; i < mThreadCount; i++) {
+        uint64_t range = 0;
+        if (i < parts) {
+            const auto begin = uint32_t(uint64_t(job.mCount) * i / parts);
+            const auto end = uint32_t(uint64_t(job.mCount) * (i + 1) / parts);
+            range = PackRange(begin, end);
+        }
+        mSlots[i].mRange.store(range, std::memory_order_relaxed);
+    }
+    mRemaining.store(job.mCount, std::memory_order_relaxed);
+    mDone.Reset();
+
+    // Open the job. Pairs with HelperMain's mSleepers bump.
+    mSeq.fetch_add(1, std::memory_order_seq_cst);
+    if (mSleepers.load(std::memory_order_seq_cst)) {
+        MirvFutexWakeAll(mSeq);
+    }
+
+    Work(0);
+    // Helpers may still be running their last chunks.
+    mDone.WaitUntil(kMirvInfiniteTimeout);
+
+    // Close it. Pairs with HelperMain's mInside bump: Either we see it, or it sees this.
+    mSeq.fetch_add(1, std::memory_order_seq_cst);
+    while (mInside.load(std::memory_order_seq_cst)) {
+        std::this_thread::yield(); // Helpers are on their way out.
+    }
+}
+
+void
+MirvWorkerPool::HelperMain(const uint32_t self)
+{
+    uint32_t seen = 0;
+    while (true) {
+        uint32_t seq;
+        uint32_t spins = 0;
+        while ((seq = mSeq.load(std::memory_order_acquire)) == seen) {
+            if (spins < kHelperSpins) {
+                spins++;
+                CpuRelax();
+                continue;
+            }
+            mSleepers.fetch_add(1, std::memory_order_seq_cst);
+            (void)MirvFutexWait(mSeq, seen, kMirvInfiniteTimeout);
+            mSleepers.fetch_sub(1, std::memory_order_relaxed);
+        }
+        seen = seq;
+        if (mExiting.load(std::memory_order_acquire))
+            return;
+        if (!(seq & 1))
+            continue; // Closed before we got here.
+
+        mInside.fetch_add(1, std::memory_order_seq_cst);
+        if (mSeq.load(std::memory_order_seq_cst) == seq) {
+            Work(self);
+        }
+        mInside.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+void
+MirvWorkerPool::Work(const uint32_t self)
+{
+    uint32_t begin, end;
+    while (TakeChunk(self, &begin, &end) || Steal(self, &begin, &end)) {
+        mJob.mFn(mJob.mCtx, begin, end);
+
+        const auto count = end - begin;
+        const auto was = mRemaining.fetch_sub(count, std::memory_order_acq_rel);
+        ASSERT(was >= count) // Otherwise some workgroups ran twice.
+        if (was == count) {
+            mDone.Set();
+        }
+    }
+}
+
+bool
+MirvWorkerPool::TakeChunk(const uint32_t self, uint32_t* const out_begin,
+                          uint32_t* const out_end)
+{
+    auto& range = mSlots[self].mRange;
+    auto cur = range.load(std::memory_order_relaxed);
+    while (true) {
+        const auto begin = uint32_t(cur);
+        const auto end = uint32_t(cur >> 32);
+        if (begin >= end)
+            return false;
+
+        const auto take = std::min(mGrain, end - begin);
+        if (range.compare_exchange_weak(cur, PackRange(begin + take, end),
+                                        std::memory_order_acquire, std::memory_order_relaxed))
+        {
+            *out_begin = begin;
+            *out_end = begin + take;
+            return true;
+        }
+    }
+}
+
+bool
+MirvWorkerPool::Steal(const uint32_t self, uint32_t* const out_begin,
+                      uint32_t* const out_end)
+{
+    for (const auto& victim : mVictims[self]) {
+        auto& range = mSlots[victim].mRange;
+        auto cur = range.load(std::memory_order_acquire);
+        while (true) {
+            const auto begin = uint32_t(cur);
+            const auto end = uint32_t(cur >> 32);
+            if (begin >= end)
+                break;
+
+            // The back half, or all of it if there's only one left.
+            const auto mid = begin + (end - begin) / 2;
+            if (!range.compare_exchange_weak(cur, PackRange(begin, mid),
+                                             std::memory_order_acquire,
+                                             std::memory_order_acquire))
+            {
+                continue;
+            }
+
+            // Run the first chunk now, and put the rest up for grabs in our own slot,
+            // which is empty, so no one else is touching it.
+            const auto take = std::min(mGrain, end - mid);
+            mSlots[self].mRange.store(PackRange(mid + take, end), std::memory_order_release);
+            *out_begin = mid;
+            *out_end = mid + take;
+            return true;
+        }
+    }
+    return false;
+}
+
+// -------------------------------------
+
+MirvAdapter_CPU::MirvAdapter_CPU()
+    : MirvAdapter(Backends::CPU)
+    , mThreadCount(CpuThreadCount())
+{
+    CpuTopology(&mCpus, &mCpuNodes);
+
+    mProperties.deviceType = VK_PHYSICAL_DEVICE_TYPE_CPU;
+    snprintf(mProperties.deviceName, VK_MAX_PHYSICAL_DEVICE_NAME_SIZE,
+             "mirv CPU (%u threads)", mThreadCount);
+    // Saved pipeline caches hold programs, so they're only good for the same format.
+    const uint32_t uuid[VK_UUID_SIZE / 4] = {
+        0x7672696d, 0x75706320, // "mirv cpu"
+        kMirvShaderProgramVersion,
+        kMirvLaneStep << 16 | kMirvMaxBatchLanes,
+    };
+    memcpy(mProperties.pipelineCacheUUID, uuid, VK_UUID_SIZE);
+
+    ////
+
+    mLimits.maxImageDimension1D = 16384;
+    mLimits.maxImageDimension2D = 16384;
+    mLimits.maxImageDimension3D = 2048;
+    mLimits.maxImageDimensionCube = 16384;
+    mLimits.maxImageArrayLayers = 2048;
+    mLimits.maxTexelBufferElements = 1 << 27;
+    mLimits.maxUniformBufferRange = 1 << 16;
+    mLimits.maxStorageBufferRange = UINT32_MAX;
+    mLimits.maxPushConstantsSize = kMirvPushConstantsSize;
+    mLimits.maxMemoryAllocationCount = UINT32_MAX;
+    mLimits.maxSamplerAllocationCount = UINT32_MAX;
+    mLimits.bufferImageGranularity = 1;
+    mLimits.maxBoundDescriptorSets = 8;
+    mLimits.maxDescriptorSetUniformBuffersDynamic = 8;
+    mLimits.maxDescriptorSetStorageBuffersDynamic = 4;
+    mLimits.maxComputeSharedMemorySize = 32768;
+    mLimits.maxComputeWorkGroupCount[0] = UINT16_MAX;
+    mLimits.maxComputeWorkGroupCount[1] = UINT16_MAX;
+    mLimits.maxComputeWorkGroupCount[2] = UINT16_MAX;
+    mLimits.maxComputeWorkGroupInvocations = 1024;
+    mLimits.maxComputeWorkGroupSize[0] = 1024;
+    mLimits.maxComputeWorkGroupSize[1] = 1024;
+    mLimits.maxComputeWorkGroupSize[2] = 64;
+    mLimits.minMemoryMapAlignment = 64;
+    mLimits.minTexelBufferOffsetAlignment = 16;
+    mLimits.minUniformBufferOffsetAlignment = 16;
+    mLimits.minStorageBufferOffsetAlignment = 16;
+    mLimits.optimalBufferCopyOffsetAlignment = 16;
+    mLimits.optimalBufferCopyRowPitchAlignment = 16;
+    mLimits.nonCoherentAtomSize = 64;
+    mProperties.limits = mLimits;
+
+    ////
+
+    VkQueueFamilyProperties queueFamily = {};
+    queueFamily.queueCount = kMirvMaxQueuesPerFamily;
+    queueFamily.timestampValidBits = 0; // 0 means unsupported
+    queueFamily.minImageTransferGranularity = {1,1,1};
+
+    // No rasterizer, so no VK_QUEUE_GRAPHICS_BIT.
+    queueFamily.queueFlags = (VK_QUEUE_COMPUTE_BIT |
+                              VK_QUEUE_TRANSFER_BIT);
+    mQueueFamilyProperties.push_back(queueFamily);
+
+    queueFamily.queueFlags = VK_QUEUE_TRANSFER_BIT;
+    mQueueFamilyProperties.push_back(queueFamily);
+
+    ////
+
+    // It's all just system memory.
+    auto& heap = mMemoryProperties.memoryHeaps[0];
+    heap.size = CpuMemorySize();
+    heap.flags = VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+    mMemoryProperties.memoryHeapCount = 1;
+
+    // Coherent or not, flushes and invalidates are no-ops, but offering a non-coherent
+    // type runs apps' (and our) batched flush paths. Its flags are a subset of the
+    // coherent type's, so the spec puts it first.
+    auto& nonCoherent = mMemoryProperties.memoryTypes[0];
+    nonCoherent.propertyFlags = (VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                 VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+    nonCoherent.heapIndex = 0;
+
+    auto& coherent = mMemoryProperties.memoryTypes[1];
+    coherent.propertyFlags = (nonCoherent.propertyFlags |
+                              VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    coherent.heapIndex = 0;
+    mMemoryProperties.memoryTypeCount = 2;
+}
+
+MirvAdapter_CPU::~MirvAdapter_CPU() = default;
+
+// -------------------------------------
+
+MirvPhysicalDevice_CPU::MirvPhysicalDevice_CPU(MirvInstance& instance,
+                                               MirvAdapter_CPU* const adapter)
+    : MirvPhysicalDevice(instance, adapter)
+    , mAdapter_CPU(adapter)
+{ }
+
+MirvPhysicalDevice_CPU::~MirvPhysicalDevice_CPU() = default;
+
+VkResult
+MirvPhysicalDevice_CPU::CreateDevice(const VkDeviceCreateInfo& createInfo,
+                                     const VkAllocationCallbacks* const allocator,
+                                     rp<MirvDevice>* const out_device)
+{
+    const auto& callbacks = (allocator ? *allocator : MirvHeapCallbacks());
+    const rp<MirvWorkerPool> workers = new (callbacks, VK_SYSTEM_ALLOCATION_SCOPE_DEVICE)
+                                           MirvWorkerPool(callbacks,
+                                                          mAdapter_CPU->mThreadCount,
+                                                          mAdapter_CPU->mCpus,
+                                                          mAdapter_CPU->mCpuNodes);
+    if (!workers || !workers->Valid())
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+
+    rp<MirvDevice_CPU> dev = new (callbacks, VK_SYSTEM_ALLOCATION_SCOPE_DEVICE)
+                                 MirvDevice_CPU(*this, allocator, workers.get());
+    if (!dev)
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+
+    const auto res = dev->AddAllQueues(createInfo);
+    if (res != VK_SUCCESS)
+        return res;
+
+    *out_device = std::move(dev);
+    return VK_SUCCESS;
+}
+
+// -------------------------------------
+
+MirvDevice_CPU::MirvDevice_CPU(MirvPhysicalDevice_CPU& physDev,
+                               const VkAllocationCallbacks* const allocator,
+                               MirvWorkerPool* const workers)
+    : MirvDevice(physDev, allocator)
+    , mWorkers(workers)
+{ }
+
+MirvDevice_CPU::~MirvDevice_CPU()
+{
+    // Queue threads may still be using us, so stop them first.
+    mQueuesByFamily.clear();
+}
+
+VkResult
+MirvDevice_CPU::AddQueues(const VkDeviceQueueCreateInfo& info,
+                          const VkQueueFamilyProperties& familyInfo,
+                          std::vector<rp<MirvQueue>>* const out)
+{
+    for (uint32_t i = 0; i < info.queueCount; i++) {
+        const auto& mirvQueue = new (mAllocator, VK_SYSTEM_ALLOCATION_SCOPE_DEVICE)
+                                    MirvQueue_CPU(*this, familyInfo);
+        if (!mirvQueue)
+            return VK_ERROR_OUT_OF_HOST_MEMORY;
+        out->push_back(mirvQueue);
+    }
+    return VK_SUCCESS;
+}
+
+VkResult
+MirvDevice_CPU::AllocBlock(const uint32_t typeIndex, const uint64_t size,
+                           rp<MirvMemoryBlock>* const out)
+{
+    if (size > SIZE_MAX)
+        return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+
+    const auto& heap = MirvHeapCallbacks();
+    const auto mem = (uint8_t*)heap.pfnAllocation(heap.pUserData, size_t(size),
+                                                  kMemoryAlignment,
+                                                  VK_SYSTEM_ALLOCATION_SCOPE_DEVICE);
+    if (!mem)
+        return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+
+    *out = new (mAllocator, VK_SYSTEM_ALLOCATION_SCOPE_DEVICE)
+        MirvMemoryBlock_CPU(typeIndex, size, mem);
+    if (!*out) {
+        heap.pfnFree(heap.pUserData, mem);
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+    return VK_SUCCESS;
+}
+
+// -------------------------------------
+
+MirvMemoryBlock_CPU::MirvMemoryBlock_CPU(const uint32_t typeIndex, const uint64_t size,
+                                         uint8_t* const mem)
+    : MirvMemoryBlock(typeIndex, size, mem)
+{ }
+
+MirvMemoryBlock_CPU::~MirvMemoryBlock_CPU()
+{
+    const auto& heap = MirvHeapCallbacks();
+    heap.pfnFree(heap.pUserData, mHostPtr);
+}
+
+void
+MirvMemoryBlock_CPU::CheckRanges(const std::vector<Range>& ranges) const
+{
+    ASSERT(!ranges.empty())
+    const Range* prev = nullptr;
+    for (const auto& x : ranges) {
+        ASSERT(x.mBegin < x.mEnd && x.mEnd <= mSize)
+        ASSERT(!prev || prev->mEnd < x.mBegin) // Sorted, and merged if they touch.
+        prev = &x;
+    }
+    (void)prev;
+}
+
+// -------------------------------------
+
+MirvQueue_CPU::MirvQueue_CPU(MirvDevice_CPU& device,
+                             const VkQueueFamilyProperties& family)
+    : MirvQueue(device, family)
+    , mWorkers(*device.mWorkers.get())
+    , mPipeline(nullptr)
+    , mTransferBytes(0)
+{
+    Zero(&mPushConstants);
+    Start();
+}
+
+MirvQueue_CPU::~MirvQueue_CPU()
+{
+    Stop();
+}
+
+void
+MirvQueue_CPU::Execute(const MirvCommandBuffer& cb)
+{
+    mPipeline = nullptr;
+    Zero(&mSets);
+    cb.mStream.ForEach([&](const MirvCmd& cmd) {
+        switch (cmd.mOp) {
+        case MirvCmdOp::EndOfChunk:
+            break;
+
+        case MirvCmdOp::PushConstants: {
+            const auto& x = static_cast<const MirvCmd_PushConstants&>(cmd);
+            ASSERT(x.mOffset + x.mDataSize <= sizeof(mPushConstants))
+            memcpy(mPushConstants + x.mOffset, x.Data(), x.mDataSize);
+            break;
+        }
+
+        case MirvCmdOp::BindPipeline:
+            mPipeline = static_cast<const MirvCmd_BindPipeline&>(cmd).mPipeline;
+            (void)mPipeline->Shader(); // Async pipelines may still be compiling.
+            break;
+
+        case MirvCmdOp::BindDescriptorSets: {
+            const auto& x = static_cast<const MirvCmd_BindDescriptorSets&>(cmd);
+            memcpy(mSets + x.mFirstSet, x.Sets(), x.mSetCount * sizeof(*mSets));
+            break;
+        }
+
+        case MirvCmdOp::Dispatch: {
+            const auto& x = static_cast<const MirvCmd_Dispatch&>(cmd);
+            Dispatch(x.mGroupCount[0], x.mGroupCount[1], x.mGroupCount[2]);
+            break;
+        }
+
+        case MirvCmdOp::DispatchIndirect: {
+            const auto& x = static_cast<const MirvCmd_DispatchIndirect&>(cmd);
+            const auto hostPtr = x.mBuffer->HostPtr();
+            ASSERT(hostPtr)
+            VkDispatchIndirectCommand args;
+            memcpy(&args, hostPtr + x.mOffset, sizeof(args));
+            Dispatch(args.x, args.y, args.z);
+            break;
+        }
+
+        case MirvCmdOp::CopyBuffer: {
+            const auto& x = static_cast<const MirvCmd_CopyBuffer&>(cmd);
+            const auto src = x.mSrc->HostPtr();
+            const auto dst = x.mDst->HostPtr();
+            ASSERT(src && dst)
+            for (const auto& r : Range(x.Regions(), x.mRegionCount)) {
+                AddTransfer(dst + r.dstOffset, src + r.srcOffset, r.size);
+            }
+            RunTransfer(0);
+            break;
+        }
+
+        case MirvCmdOp::FillBuffer: {
+            const auto& x = static_cast<const MirvCmd_FillBuffer&>(cmd);
+            const auto dst = x.mDst->HostPtr();
+            ASSERT(dst)
+            AddTransfer(dst + x.mOffset, nullptr, x.mBytes);
+            RunTransfer(x.mData);
+            break;
+        }
+
+        case MirvCmdOp::UpdateBuffer: {
+            // At most 64KiB, so not worth threads.
+            const auto& x = static_cast<const MirvCmd_UpdateBuffer&>(cmd);
+            const auto dst = x.mDst->HostPtr();
+            ASSERT(dst)
+            memcpy(dst + x.mOffset, x.Data(), x.mDataSize);
+            break;
+        }
+
+        case MirvCmdOp::CopyBufferToImage: {
+            const auto& x = static_cast<const MirvCmd_CopyBufferToImage&>(cmd);
+            for (const auto& r : Range(x.Regions(), x.mRegionCount)) {
+                CopyBufferImage(*x.mBuffer, *x.mImage, r, true);
+            }
+            break;
+        }
+
+        case MirvCmdOp::CopyImageToBuffer: {
+            const auto& x = static_cast<const MirvCmd_CopyImageToBuffer&>(cmd);
+            for (const auto& r : Range(x.Regions(), x.mRegionCount)) {
+                CopyBufferImage(*x.mBuffer, *x.mImage, r, false);
+            }
+            break;
+        }
+
+        case MirvCmdOp::BlitImage: {
+            const auto& x = static_cast<const MirvCmd_BlitImage&>(cmd);
+            for (const auto& r : Range(x.Regions(), x.mRegionCount)) {
+                RunJobs(MirvBlit(*x.mSrc, *x.mDst, r, x.mFilter));
+            }
+            break;
+        }
+
+        case MirvCmdOp::GenerateMips:
+            GenerateMips(static_cast<const MirvCmd_GenerateMips&>(cmd));
+            break;
+        }
+    });
+}
+
+// --
+
+// Big enough to amortize taking one off a worker's range, small enough to balance.
+static const uint64_t kTransferPieceBytes = 256 * 1024;
+
+void
+MirvQueue_CPU::AddTransfer(uint8_t* const dst, const uint8_t* const src,
+                           const uint64_t size)
+{
+    // Piece boundaries stay 4-byte aligned, for fills.
+    for (uint64_t offset = 0; offset < size; offset += kTransferPieceBytes) {
+        const auto pieceSize = std::min(kTransferPieceBytes, size - offset);
+        mTransferPieces.push_back({ dst + offset, src ? src + offset : nullptr,
+                                    size_t(pieceSize) });
+    }
+    mTransferBytes += size;
+}
+
+// Runs and clears everything added since the last RunTransfer. Transfers too small to
+// stream run right here; handing them to the workers costs more than it saves.
+void
+MirvQueue_CPU::RunTransfer(const uint32_t fillData)
+{
+    const TransferSlab slab = {
+        mTransferPieces.data(), fillData, mTransferBytes >= kMirvStreamingBytes
+    };
+    const auto count = uint32_t(mTransferPieces.size());
+    if (slab.mStreaming && count > 1) {
+        const MirvGridJob job = { count, &RunTransferPieces, (void*)&slab };
+        mWorkers.Run(job);
+    } else {
+        RunTransferPieces((void*)&slab, 0, count);
+    }
+    mTransferPieces.clear();
+    mTransferBytes = 0;
+}
+
+/*static*/ void
+MirvQueue_CPU::RunTransferPieces(void* const slab, const uint32_t begin, const uint32_t end)
+{
+    const auto& s = *(const TransferSlab*)slab;
+    for (const auto& x : Range(s.mPieces + begin, end - begin)) {
+        if (x.mSrc) {
+            MirvCopyBytes(x.mDst, x.mSrc, x.mSize, s.mStreaming);
+        } else {
+            MirvFillBytes(x.mDst, s.mFillData, x.mSize, s.mStreaming);
+        }
+    }
+}
+
+// Buffers hold tightly packed blocks of the region's aspect, in the app's format. The
+// image holds its storage format, so the copy converts if those differ. Layers and z
+// slices are alike to the buffer: one slice after another.
+void
+MirvQueue_CPU::CopyBufferImage(const MirvBuffer& buffer, const MirvImage& image,
+                               const VkBufferImageCopy& r, const bool toImage)
+{
+    const auto& sub = r.imageSubresource;
+    const auto bufferFormat = MirvAspectFormat(image.mFormat, sub.aspectMask);
+    const auto conv = toImage ? MirvFindConversion(image.mStorageFormat, bufferFormat)
+                              : MirvFindConversion(bufferFormat, image.mStorageFormat);
+    const auto& imageBlock = toImage ? *conv.mDst : *conv.mSrc;
+    const auto& bufferBlock = toImage ? *conv.mSrc : *conv.mDst;
+    const auto bw = imageBlock.mBlockWidth;
+    const auto bh = imageBlock.mBlockHeight;
+
+    const auto rowLength = r.bufferRowLength ? r.bufferRowLength : r.imageExtent.width;
+    const auto imageHeight = r.bufferImageHeight ? r.bufferImageHeight : r.imageExtent.height;
+    const auto bufferPitch = uint64_t((rowLength + bw - 1) / bw) * bufferBlock.mBlockBytes;
+    const auto bufferSlice = bufferPitch * ((imageHeight + bh - 1) / bh);
+    const auto width = (r.imageExtent.width + bw - 1) / bw;
+    const auto height = (r.imageExtent.height + bh - 1) / bh;
+
+    const auto& level = image.mLevels[sub.mipLevel];
+    ASSERT(r.imageOffset.x % bw == 0 && r.imageOffset.y % bh == 0)
+    ASSERT(r.imageOffset.x + r.imageExtent.width <= level.mExtent.width &&
+           r.imageOffset.y + r.imageExtent.height <= level.mExtent.height &&
+           r.imageOffset.z + r.imageExtent.depth <= level.mExtent.depth)
+    ASSERT(sub.baseArrayLayer + sub.layerCount <= image.mArrayLayers)
+    ASSERT(buffer.HostPtr() && image.HostPtr())
+    const auto bufferBase = buffer.HostPtr() + r.bufferOffset;
+    const auto x0 = uint32_t(r.imageOffset.x) / bw;
+    const auto y0 = uint32_t(r.imageOffset.y) / bh;
+    const auto tiled = image.mTileShift != 0;
+
+    // Tiled images cut pieces at tile rows, counted from the slice's top.
+    const auto rowBytes = uint64_t(width) * std::max(imageBlock.mBlockBytes,
+                                                     bufferBlock.mBlockBytes);
+    const auto tileRows = 1u << image.mTileShift;
+    auto rowsPerPiece = uint32_t(std::max<uint64_t>(kTransferPieceBytes / rowBytes, 1));
+    rowsPerPiece = (rowsPerPiece + tileRows - 1) & ~(tileRows - 1);
+    for (uint32_t layer = 0; layer < sub.layerCount; layer++) {
+        for (uint32_t z = 0; z < r.imageExtent.depth; z++) {
+            const auto bufferRows = bufferBase +
+                                    (uint64_t(layer) * r.imageExtent.depth + z) * bufferSlice;
+            const auto slice = image.HostPtr() + level.mOffset +
+                               (sub.baseArrayLayer + layer) * level.mArrayPitch +
+                               (r.imageOffset.z + z) * level.mDepthPitch;
+            for (uint32_t y = 0; y < height;) {
+                const auto rows = std::min(rowsPerPiece - (y0 + y) % rowsPerPiece, height - y);
+                const auto imagePtr = tiled ? slice
+                                            : slice + (y0 + y) * level.mRowPitch +
+                                              x0 * imageBlock.mBlockBytes;
+                const auto bufferPtr = bufferRows + y * bufferPitch;
+                if (toImage) {
+                    mImagePieces.push_back({ imagePtr, bufferPtr, size_t(level.mRowPitch),
+                                             size_t(bufferPitch), x0, y0 + y, width, rows });
+                } else {
+                    mImagePieces.push_back({ bufferPtr, imagePtr, size_t(bufferPitch),
+                                             size_t(level.mRowPitch), x0, y0 + y, width,
+                                             rows });
+                }
+                y += rows;
+            }
+        }
+    }
+
+    const auto bytes = rowBytes * height * r.imageExtent.depth * sub.layerCount;
+    const ImageSlab slab = {
+        mImagePieces.data(), &conv, image.mTileShift, toImage, bytes >= kMirvStreamingBytes
+    };
+    const auto count = uint32_t(mImagePieces.size());
+    if (slab.mStreaming && count > 1) {
+        const MirvGridJob job = { count, &RunImagePieces, (void*)&slab };
+        mWorkers.Run(job);
+    } else {
+        RunImagePieces((void*)&slab, 0, count);
+    }
+    mImagePieces.clear();
+}
+
+// Stack staging for converting tiled pieces: several tiles of a tile row at a time.
+static const uint32_t kStagingBytes = 4096;
+
+/*static*/ void
+MirvQueue_CPU::RunImagePieces(void* const slab, const uint32_t begin, const uint32_t end)
+{
+    const auto& s = *(const ImageSlab*)slab;
+    const auto& conv = *s.mConversion;
+    for (const auto& x : Range(s.mPieces + begin, end - begin)) {
+        if (!s.mTileShift) {
+            MirvConvertRect(conv, x.mDst, x.mDstPitch, x.mSrc, x.mSrcPitch, x.mWidth,
+                            x.mRows, s.mStreaming);
+        } else if (conv.IsCopy()) {
+            const auto blockBytes = conv.mDst->mBlockBytes;
+            if (s.mToImage) {
+                MirvTileRect(x.mDst, x.mDstPitch, blockBytes, x.mX, x.mY, x.mSrc, x.mSrcPitch,
+                             x.mWidth, x.mRows, s.mStreaming);
+            } else {
+                MirvUntileRect(x.mDst, x.mDstPitch, x.mSrc, x.mSrcPitch, blockBytes, x.mX,
+                               x.mY, x.mWidth, x.mRows);
+            }
+        } else {
+            ConvertTiledPiece(s, x);
+        }
+    }
+}
+
+// Conversions go through row-major staging, a tile row high, in the image's format.
+/*static*/ void
+MirvQueue_CPU::ConvertTiledPiece(const ImageSlab& s, const ImagePiece& x)
+{
+    const auto& conv = *s.mConversion;
+    const auto& image = s.mToImage ? *conv.mDst : *conv.mSrc;
+    const auto& buffer = s.mToImage ? *conv.mSrc : *conv.mDst;
+    const auto tileSize = 1u << s.mTileShift;
+    const auto chunkWidth = kStagingBytes / (tileSize * image.mBlockBytes);
+    const auto pitch = chunkWidth * image.mBlockBytes;
+    alignas(16) uint8_t staging[kStagingBytes];
+
+    for (uint32_t y = 0; y < x.mRows;) {
+        const auto rows = std::min(tileSize - (x.mY + y) % tileSize, x.mRows - y);
+        for (uint32_t i = 0; i < x.mWidth; i += chunkWidth) {
+            const auto width = std::min(chunkWidth, x.mWidth - i);
+            if (s.mToImage) {
+                const auto src = x.mSrc + y * x.mSrcPitch + i * buffer.mBlockBytes;
+                // Writing one aspect keeps the other.
+                if (image.mLayout == MirvFormatLayout::DepthStencil) {
+                    MirvUntileRect(staging, pitch, x.mDst, x.mDstPitch, image.mBlockBytes,
+                                   x.mX + i, x.mY + y, width, rows);
+                }
+                MirvConvertRect(conv, staging, pitch, src, x.mSrcPitch, width, rows, false);
+                MirvTileRect(x.mDst, x.mDstPitch, image.mBlockBytes, x.mX + i, x.mY + y,
+                             staging, pitch, width, rows, s.mStreaming);
+            } else {
+                const auto dst = x.mDst + y * x.mDstPitch + i * buffer.mBlockBytes;
+                MirvUntileRect(staging, pitch, x.mSrc, x.mSrcPitch, image.mBlockBytes,
+                               x.mX + i, x.mY + y, width, rows);
+                MirvConvertRect(conv, dst, x.mDstPitch, staging, pitch, width, rows,
+                                s.mStreaming);
+            }
+        }
+        y += rows;
+    }
+}
+
+// Levels that halve go a MirvMipPass at a time, and any others a blit each.
+void
+MirvQueue_CPU::GenerateMips(const MirvCmd_GenerateMips& x)
+{
+    const auto& image = *x.mImage;
+    const auto end = x.mBaseLevel + x.mLevelCount;
+    for (auto level = x.mBaseLevel; level < end;) {
+        const auto fused = MirvMipPassLevels(image, level, end - level);
+        if (fused) {
+            RunJobs(MirvMipPass(image, level, fused, x.mBaseLayer, x.mLayerCount,
+                                x.mFilter));
+            level += fused;
+            continue;
+        }
+        const auto& from = image.mLevels[level].mExtent;
+        const auto& to = image.mLevels[level + 1].mExtent;
+        VkImageBlit r = {};
+        r.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, x.mBaseLayer, x.mLayerCount };
+        r.srcOffsets[1] = { int32_t(from.width), int32_t(from.height), 1 };
+        r.dstSubresource = r.srcSubresource;
+        r.dstSubresource.mipLevel = level + 1;
+        r.dstOffsets[1] = { int32_t(to.width), int32_t(to.height), 1 };
+        RunJobs(MirvBlit(image, image, r, x.mFilter));
+        level++;
+    }
+}
+
+// Jobs are a few KiB to tens of KiB of texels, so even two are worth the workers.
+template<typename T>
+void
+MirvQueue_CPU::RunJobs(const T& work)
+{
+    const auto count = work.JobCount();
+    if (count > 1) {
+        const MirvGridJob job = { count, &RunJobRange<T>, (void*)&work };
+        mWorkers.Run(job);
+    } else if (count) {
+        work.Run(0);
+    }
+}
+
+template<typename T>
+/*static*/ void
+MirvQueue_CPU::RunJobRange(void* const work, const uint32_t begin, const uint32_t end)
+{
+    const auto& w = *(const T*)work;
+    for (auto i = begin; i < end; i++) {
+        w.Run(i);
+    }
+}
+
+// Grids can be up to 65535^3 workgroups, but MirvGridJobs count them in 32 bits, so big
+// grids run as several jobs of whole z-layers. A layer always fits.
+// Without a pipeline the grid is still scheduled, just with nothing to run per workgroup.
+void
+MirvQueue_CPU::Dispatch(const uint32_t x, const uint32_t y, const uint32_t z)
+{
+    const auto layerSize = uint64_t(x) * y;
+    if (!layerSize || !z)
+        return;
+    const auto shader = mPipeline ? mPipeline->Shader() : nullptr;
+    const auto program = shader ? &shader->mProgram : nullptr;
+    std::vector<uint8_t*> slots;
+    if (program && !ResolveSlots(*program, &slots))
+        return;
+    const auto layersPerJob = uint32_t(std::min<uint64_t>(z, UINT32_MAX / layerSize));
+
+    for (uint32_t baseZ = 0; baseZ < z; baseZ += layersPerJob) {
+        GridSlab slab = { program, slots.data(), { x, y, z }, baseZ };
+        const auto layers = std::min(layersPerJob, z - baseZ);
+        const MirvGridJob job = { uint32_t(layerSize * layers), &RunGroups, &slab };
+        mWorkers.Run(job);
+    }
+}
+
+// Each of the program's slots, indexed by slot. False if a binding the program uses has
+// no buffer memory behind it, in which case the dispatch is skipped.
+bool
+MirvQueue_CPU::ResolveSlots(const MirvShaderProgram& program, std::vector<uint8_t*>* const out)
+{
+    out->assign(kMirvSlotFirstBinding + program.mBindings.size(), nullptr);
+    (*out)[kMirvSlotPushConstants] = mPushConstants;
+
+    const auto& setLayouts = mPipeline->mLayout->mSetLayouts;
+    for (size_t i = 0; i < program.mBindings.size(); i++) {
+        const auto& x = program.mBindings[i];
+        if (x.mSet >= setLayouts.size() || x.mSet >= kMirvMaxBoundDescriptorSets)
+            return false;
+        const auto& bound = mSets[x.mSet];
+        const auto binding = setLayouts[x.mSet]->Find(x.mBinding);
+        if (!bound.mSet || !binding)
+            return false;
+        const auto& info = bound.mSet->Descriptors()[binding->mFirst].mBuffer;
+        const auto hostPtr = info.buffer ? MirvBuffer::For(mDevice, info.buffer)->HostPtr()
+                                         : nullptr;
+        if (!hostPtr)
+            return false;
+        uint64_t offset = info.offset;
+        if (binding->mType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC ||
+            binding->mType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC) {
+            offset += bound.mDynamicOffsets[binding->mFirstDynamic];
+        }
+        (*out)[kMirvSlotFirstBinding + i] = hostPtr + offset;
+    }
+    return true;
+}
+
+/*static*/ void
+MirvQueue_CPU::RunGroups(void* const slab, const uint32_t begin, const uint32_t end)
+{
+    const auto& s = *(const GridSlab*)slab;
+    if (!s.mProgram)
+        return;
+    MirvShaderRunner runner(*s.mProgram, s.mSlots, s.mGroupCount);
+    const auto countX = s.mGroupCount[0];
+    const auto countY = s.mGroupCount[1];
+    const auto layerSize = countX * countY;
+    for (uint32_t i = begin; i < end; i++) {
+        runner.RunGroup(i % countX, i / countX % countY, s.mBaseGroupZ + i / layerSize);
+    }
+}
@@ -0,0 +1,214 @@
+#pragma once
+
+#include "mirv.h"
+
+#include <thread>
+
+struct MirvConversion;
+
+// --
+
+// A dispatch's workgroups, flattened to [0, mCount). mFn runs [begin, end) of them.
+struct MirvGridJob final
+{
+    uint32_t mCount;
+    void (*mFn)(void* ctx, uint32_t begin, uint32_t end);
+    void* mCtx;
+};
+
+// Runs dispatches for every queue on a device. The thread calling Run takes part, so
+// there are only threadCount-1 helpers, and no dispatch runs more threads than that.
+// Each participant starts with a slice of the grid and takes chunks off its front. Once
+// empty, it steals the back half of someone else's. On Linux, helpers are pinned one per
+// CPU, grouped by NUMA node, and steal from their own node first.
+class MirvWorkerPool final : public RefCounted, public MirvAllocated
+{
+    // A cache line each, so participants don't share them.
+    struct alignas(64) Slot final : public MirvAllocatedT<64> {
+        std::atomic<uint64_t> mRange; // begin | end << 32
+    };
+
+    const uint32_t mThreadCount;
+    std::unique_ptr<Slot[]> mSlots;            // Per participant. Slot 0 is Run's.
+    std::vector<std::vector<uint32_t>> mVictims; // Per participant, nearest first.
+    std::vector<std::thread> mHelpers;
+
+    std::mutex mRunMutex; // One dispatch at a time.
+    MirvGridJob mJob;
+    uint32_t mGrain;
+    std::atomic<uint32_t> mRemaining;
+    MirvFutexFlag mDone;
+
+    std::atomic<uint32_t> mSeq;    // Odd while a job is open to helpers.
+    std::atomic<uint32_t> mInside; // Helpers in the open job.
+    std::atomic<uint32_t> mSleepers;
+    std::atomic<bool> mExiting;
+
+public:
+    // `cpus`/`cpuNodes` are the CPUs we may pin to, grouped by node, or empty.
+    // Slots come from `allocator`, with DEVICE scope.
+    MirvWorkerPool(const VkAllocationCallbacks& allocator, uint32_t threadCount,
+                   const std::vector<uint32_t>& cpus, const std::vector<uint32_t>& cpuNodes);
+    ~MirvWorkerPool() override;
+
+    // False if we ran out of memory for slots, in which case we have no helpers, and
+    // mustn't Run.
+    bool Valid() const { return bool(mSlots); }
+    uint32_t ThreadCount() const { return mThreadCount; }
+
+    // Returns once every workgroup has run.
+    void Run(const MirvGridJob& job);
+
+private:
+    void HelperMain(uint32_t self);
+    void Work(uint32_t self);
+    bool TakeChunk(uint32_t self, uint32_t* out_begin, uint32_t* out_end);
+    bool Steal(uint32_t self, uint32_t* out_begin, uint32_t* out_end);
+};
+
+// --
+
+class MirvAdapter_CPU final : public MirvAdapter
+{
+public:
+    const uint32_t mThreadCount;
+    // CPUs this process may run on, grouped by NUMA node. Empty if we can't tell.
+    std::vector<uint32_t> mCpus;
+    std::vector<uint32_t> mCpuNodes;
+
+    MirvAdapter_CPU();
+    ~MirvAdapter_CPU() override;
+};
+
+// --
+
+class MirvPhysicalDevice_CPU final : public MirvPhysicalDevice
+{
+    const rp<MirvAdapter_CPU> mAdapter_CPU;
+
+public:
+    MirvPhysicalDevice_CPU(MirvInstance& instance, MirvAdapter_CPU* adapter);
+    ~MirvPhysicalDevice_CPU() override;
+
+    VkResult CreateDevice(const VkDeviceCreateInfo& createInfo,
+                          const VkAllocationCallbacks* allocator,
+                          rp<MirvDevice>* out_device) override;
+};
+
+// --
+
+class MirvDevice_CPU final : public MirvDevice
+{
+public:
+    static const size_t kMemoryAlignment = 4096;
+
+    const rp<MirvWorkerPool> mWorkers;
+
+    MirvDevice_CPU(MirvPhysicalDevice_CPU& physDev, const VkAllocationCallbacks* allocator,
+                   MirvWorkerPool* workers);
+    ~MirvDevice_CPU() override;
+
+    VkResult AddQueues(const VkDeviceQueueCreateInfo& info,
+                       const VkQueueFamilyProperties& familyInfo,
+                       std::vector<rp<MirvQueue>>* out) override;
+    VkResult AllocBlock(uint32_t typeIndex, uint64_t size,
+                        rp<MirvMemoryBlock>* out) override;
+};
+
+// --
+
+// Device memory is just page-aligned host memory.
+class MirvMemoryBlock_CPU final : public MirvMemoryBlock
+{
+public:
+    MirvMemoryBlock_CPU(uint32_t typeIndex, uint64_t size, uint8_t* mem);
+    ~MirvMemoryBlock_CPU() override;
+
+    // Our mapping is the memory itself, so there's nothing to do beyond checking what
+    // we're promised.
+    void FlushRanges(const std::vector<Range>& ranges) override { CheckRanges(ranges); }
+    void InvalidateRanges(const std::vector<Range>& ranges) override { CheckRanges(ranges); }
+
+private:
+    void CheckRanges(const std::vector<Range>& ranges) const;
+};
+
+// --
+
+// Interprets command buffers on the queue's own thread. Dispatches fan out over the
+// device's MirvWorkerPool.
+class MirvQueue_CPU final : public MirvQueue
+{
+    MirvWorkerPool& mWorkers;
+    uint8_t mPushConstants[kMirvPushConstantsSize];
+    // Bound state, which doesn't outlive its command buffer.
+    const MirvPipeline* mPipeline;
+    MirvBoundDescriptorSet mSets[kMirvMaxBoundDescriptorSets];
+
+    // One MirvGridJob's worth of a dispatch: whole z-layers from mBaseGroupZ.
+    struct GridSlab final {
+        const MirvShaderProgram* mProgram;
+        uint8_t* const* mSlots;
+        uint32_t mGroupCount[3];
+        uint32_t mBaseGroupZ;
+    };
+
+    // Copy and fill commands, cut into pieces that are MirvGridJob items.
+    struct TransferPiece final {
+        uint8_t* mDst;
+        const uint8_t* mSrc; // Null for fills.
+        size_t mSize;
+    };
+    struct TransferSlab final {
+        const TransferPiece* mPieces;
+        uint32_t mFillData;
+        bool mStreaming;
+    };
+    std::vector<TransferPiece> mTransferPieces; // Reused by every transfer.
+    uint64_t mTransferBytes;
+
+    // Buffer<->image copies, cut into runs of whole block rows. A tiled image's side is
+    // its whole slice, tile rows apart, and (mX, mY) is where the run starts in it. Runs
+    // in tiled images are whole tile rows, so no two share a tile.
+    struct ImagePiece final {
+        uint8_t* mDst;
+        const uint8_t* mSrc;
+        size_t mDstPitch;
+        size_t mSrcPitch;
+        uint32_t mX; // In blocks.
+        uint32_t mY;
+        uint32_t mWidth;
+        uint32_t mRows;
+    };
+    struct ImageSlab final {
+        const ImagePiece* mPieces;
+        const MirvConversion* mConversion;
+        uint32_t mTileShift; // The image's.
+        bool mToImage;
+        bool mStreaming;
+    };
+    std::vector<ImagePiece> mImagePieces;
+
+public:
+    MirvQueue_CPU(MirvDevice_CPU& device, const VkQueueFamilyProperties& family);
+    ~MirvQueue_CPU() override;
+
+private:
+    void Execute(const MirvCommandBuffer& cb) override;
+    void Dispatch(uint32_t x, uint32_t y, uint32_t z);
+    bool ResolveSlots(const MirvShaderProgram& program, std::vector<uint8_t*>* out);
+    static void RunGroups(void* slab, uint32_t begin, uint32_t end);
+    void AddTransfer(uint8_t* dst, const uint8_t* src, uint64_t size);
+    void RunTransfer(uint32_t fillData);
+    static void RunTransferPieces(void* slab, uint32_t begin, uint32_t end);
+    void CopyBufferImage(const MirvBuffer& buffer, const MirvImage& image,
+                         const VkBufferImageCopy& region, bool toImage);
+    static void RunImagePieces(void* slab, uint32_t begin, uint32_t end);
+    static void ConvertTiledPiece(const ImageSlab& slab, const ImagePiece& piece);
+    void GenerateMips(const MirvCmd_GenerateMips& cmd);
+    // For MirvBlit and MirvMipPass.
+    template<typename T>
+    void RunJobs(const T& work);
+    template<typename T>
+    static void RunJobRange(void* work, uint32_t begin, uint32_t end);
+};
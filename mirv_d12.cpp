@@ -9,10 +9,29 @@
 
 // --
 
-template<>
-void
-MirvInstance::AddPhysDevs<Backends::D3D12>()
+// Probing creates a D3D12 device per adapter, so all instances share one probe, redone
+// only once DXGI says the set of adapters changed.
+static std::mutex gAdaptersMutex;
+static rp<IDXGIFactory1> gAdaptersFactory;
+static std::vector<rp<MirvAdapter_D12>> gAdapters;
+
+// Indexed by Vulkan memory type.
+static const D3D12_HEAP_TYPE kHeapTypes[] = {
+    D3D12_HEAP_TYPE_DEFAULT,
+    D3D12_HEAP_TYPE_UPLOAD,
+    D3D12_HEAP_TYPE_READBACK,
+};
+
+static std::vector<rp<MirvAdapter_D12>>
+CurrentAdapters()
 {
+    const mutex_guard guard(gAdaptersMutex);
+    if (gAdaptersFactory && gAdaptersFactory->IsCurrent())
+        return gAdapters;
+
+    gAdaptersFactory = nullptr;
+    gAdapters.clear();
+
     const uint32_t flags = DXGI_CREATE_FACTORY_DEBUG;
 
     rp<IDXGIFactory1> factory;
@@ -22,7 +41,7 @@ MirvInstance::AddPhysDevs<Backends::D3D12>()
     }
 
     if (!factory)
-        return;
+        return gAdapters;
 
     std::vector<rp<IDXGIAdapter1>> adapters;
 
@@ -56,18 +75,32 @@ MirvInstance::AddPhysDevs<Backends::D3D12>()
         if (FAILED(cur->GetDesc1(&desc)))
             continue;
 
-        const auto& pd = new MirvPhysicalDevice_D12(*this, cur.get(), desc);
+        gAdapters.push_back(new MirvAdapter_D12(cur.get(), desc));
+    }
+
+    gAdaptersFactory = factory;
+    return gAdapters;
+}
+
+template<>
+void
+MirvInstance::AddPhysDevs<Backends::D3D12>()
+{
+    for (const auto& adapter : CurrentAdapters()) {
+        const auto& pd = new (mAllocator, VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE)
+                             MirvPhysicalDevice_D12(*this, adapter.get());
+        if (!pd)
+            return;
         mPhysDevs.push_back(pd);
     }
 }
 
 // -------------------------------------
 
-MirvPhysicalDevice_D12::MirvPhysicalDevice_D12(MirvInstance& instance,
-                                               IDXGIAdapter1* const adapter,
-                                               const DXGI_ADAPTER_DESC1& desc)
-    : MirvPhysicalDevice(instance)
-    , mAdapter(adapter)
+MirvAdapter_D12::MirvAdapter_D12(IDXGIAdapter1* const adapter,
+                                 const DXGI_ADAPTER_DESC1& desc)
+    : MirvAdapter(Backends::D3D12)
+    , mDxgiAdapter(adapter)
 {
     mProperties.vendorID = desc.VendorId;
     mProperties.deviceID = desc.DeviceId;
@@ -199,7 +232,7 @@ MirvPhysicalDevice_D12::MirvPhysicalDevice_D12(MirvInstance& instance,
     ////
 
     VkQueueFamilyProperties queueFamily = {};
-    queueFamily.queueCount = UINT32_MAX;
+    queueFamily.queueCount = kMirvMaxQueuesPerFamily;
     queueFamily.timestampValidBits = 0; // 0 means unsupported
     queueFamily.minImageTransferGranularity = {1,1,1};
 
@@ -217,40 +250,96 @@ MirvPhysicalDevice_D12::MirvPhysicalDevice_D12(MirvInstance& instance,
     // D3D12_COMMAND_LIST_TYPE_COPY
     queueFamily.queueFlags = VK_QUEUE_TRANSFER_BIT;
     mQueueFamilyProperties.push_back(queueFamily);
+
+    ////
+
+    // Types are in kHeapTypes order. UMA adapters have only the one heap.
+    const bool uma = !desc.DedicatedVideoMemory;
+    VkMemoryPropertyFlags sysMemFlags = 0;
+    if (uma) {
+        mMemoryProperties.memoryHeaps[0].size = desc.SharedSystemMemory;
+        mMemoryProperties.memoryHeaps[0].flags = VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+        mMemoryProperties.memoryHeapCount = 1;
+        sysMemFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    } else {
+        mMemoryProperties.memoryHeaps[0].size = desc.DedicatedVideoMemory;
+        mMemoryProperties.memoryHeaps[0].flags = VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+        mMemoryProperties.memoryHeaps[1].size = desc.SharedSystemMemory;
+        mMemoryProperties.memoryHeapCount = 2;
+    }
+    const uint32_t sysHeap = mMemoryProperties.memoryHeapCount - 1;
+
+    auto& types = mMemoryProperties.memoryTypes;
+    // D3D12_HEAP_TYPE_DEFAULT
+    types[0].propertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    types[0].heapIndex = 0;
+    // D3D12_HEAP_TYPE_UPLOAD
+    types[1].propertyFlags = (sysMemFlags |
+                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                              VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    types[1].heapIndex = sysHeap;
+    // D3D12_HEAP_TYPE_READBACK
+    types[2].propertyFlags = (sysMemFlags |
+                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                              VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
+                              VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+    types[2].heapIndex = sysHeap;
+    mMemoryProperties.memoryTypeCount = 3;
 }
 
+MirvAdapter_D12::~MirvAdapter_D12() = default;
+
+// -------------------------------------
+
+MirvPhysicalDevice_D12::MirvPhysicalDevice_D12(MirvInstance& instance,
+                                               MirvAdapter_D12* const adapter)
+    : MirvPhysicalDevice(instance, adapter)
+    , mAdapter_D12(adapter)
+{ }
+
 MirvPhysicalDevice_D12::~MirvPhysicalDevice_D12() = default;
 
 VkResult
 MirvPhysicalDevice_D12::CreateDevice(const VkDeviceCreateInfo& createInfo,
+                                     const VkAllocationCallbacks* const allocator,
                                      rp<MirvDevice>* const out_device)
 {
     const D3D_FEATURE_LEVEL featureLevel = D3D_FEATURE_LEVEL_12_0;
     rp<ID3D12Device> d3dDev;
-    const auto hr = D3D12CreateDevice(mAdapter.get(), featureLevel, __uuidof(ID3D12Device),
+    const auto hr = D3D12CreateDevice(mAdapter_D12->mDxgiAdapter.get(), featureLevel,
+                                      __uuidof(ID3D12Device),
                                       (void**)d3dDev.asOutVar());
     if (FAILED(hr))
         return VK_ERROR_INITIALIZATION_FAILED;
 
-    rp<MirvDevice_D12> dev = new MirvDevice_D12(*this, d3dDev.get());
+    rp<MirvDevice_D12> dev = new (allocator ? *allocator : MirvHeapCallbacks(),
+                                  VK_SYSTEM_ALLOCATION_SCOPE_DEVICE)
+                                 MirvDevice_D12(*this, allocator, d3dDev.get());
+    if (!dev)
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
 
     const auto res = dev->AddAllQueues(createInfo);
     if (res != VK_SUCCESS)
         return res;
 
-    *out_device = dev;
+    *out_device = std::move(dev);
     return VK_SUCCESS;
 }
 
 // -------------------------------------
 
 MirvDevice_D12::MirvDevice_D12(MirvPhysicalDevice_D12& physDev,
+                               const VkAllocationCallbacks* const allocator,
                                ID3D12Device* const device)
-    : MirvDevice(physDev)
+    : MirvDevice(physDev, allocator)
     , mDevice(device)
 { }
 
-MirvDevice_D12::~MirvDevice_D12() = default;
+MirvDevice_D12::~MirvDevice_D12()
+{
+    // Queue threads may still be using us, so stop them first.
+    mQueuesByFamily.clear();
+}
 
 VkResult
 MirvDevice_D12::AddQueues(const VkDeviceQueueCreateInfo& info,
@@ -275,12 +364,84 @@ MirvDevice_D12::AddQueues(const VkDeviceQueueCreateInfo& info,
             ASSERT(hr == E_OUTOFMEMORY)
             return VK_ERROR_INITIALIZATION_FAILED;
         }
-        const auto& mirvQueue = new MirvQueue_D12(*this, familyInfo, queue.get());
+        const auto& mirvQueue = new (mAllocator, VK_SYSTEM_ALLOCATION_SCOPE_DEVICE)
+                                    MirvQueue_D12(*this, familyInfo, queue.get());
+        if (!mirvQueue)
+            return VK_ERROR_OUT_OF_HOST_MEMORY;
         out->push_back(mirvQueue);
     }
     return VK_SUCCESS;
 }
 
+VkResult
+MirvDevice_D12::AllocBlock(const uint32_t typeIndex, const uint64_t size,
+                           rp<MirvMemoryBlock>* const out)
+{
+    const auto& heapType = kHeapTypes[typeIndex];
+
+    D3D12_HEAP_DESC desc = {};
+    desc.SizeInBytes = size;
+    desc.Properties.Type = heapType;
+    desc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+    desc.Flags = D3D12_HEAP_FLAG_ALLOW_ALL_BUFFERS_AND_TEXTURES;
+
+    rp<ID3D12Heap> heap;
+    auto hr = mDevice->CreateHeap(&desc, __uuidof(ID3D12Heap), (void**)heap.asOutVar());
+    if (FAILED(hr))
+        return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+
+    // Host-visible heaps get one buffer across the whole heap, mapped for its lifetime.
+    rp<ID3D12Resource> mapped;
+    uint8_t* hostPtr = nullptr;
+    if (heapType != D3D12_HEAP_TYPE_DEFAULT) {
+        D3D12_RESOURCE_DESC resDesc = {};
+        resDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+        resDesc.Width = size;
+        resDesc.Height = 1;
+        resDesc.DepthOrArraySize = 1;
+        resDesc.MipLevels = 1;
+        resDesc.SampleDesc.Count = 1;
+        resDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+
+        const auto state = (heapType == D3D12_HEAP_TYPE_UPLOAD
+                            ? D3D12_RESOURCE_STATE_GENERIC_READ
+                            : D3D12_RESOURCE_STATE_COPY_DEST);
+        hr = mDevice->CreatePlacedResource(heap.get(), 0, &resDesc, state, nullptr,
+                                           __uuidof(ID3D12Resource),
+                                           (void**)mapped.asOutVar());
+        if (FAILED(hr))
+            return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+
+        hr = mapped->Map(0, nullptr, (void**)&hostPtr);
+        if (FAILED(hr))
+            return VK_ERROR_MEMORY_MAP_FAILED;
+    }
+
+    *out = new (mAllocator, VK_SYSTEM_ALLOCATION_SCOPE_DEVICE)
+        MirvMemoryBlock_D12(typeIndex, size, heap.get(), mapped.get(), hostPtr);
+    if (!*out)
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    return VK_SUCCESS;
+}
+
+// -------------------------------------
+
+MirvMemoryBlock_D12::MirvMemoryBlock_D12(const uint32_t typeIndex, const uint64_t size,
+                                         ID3D12Heap* const heap,
+                                         ID3D12Resource* const mapped,
+                                         uint8_t* const hostPtr)
+    : MirvMemoryBlock(typeIndex, size, hostPtr)
+    , mHeap(heap)
+    , mMapped(mapped)
+{ }
+
+MirvMemoryBlock_D12::~MirvMemoryBlock_D12()
+{
+    if (mMapped) {
+        mMapped->Unmap(0, nullptr);
+    }
+}
+
 // -------------------------------------
 
 MirvQueue_D12::MirvQueue_D12(MirvDevice_D12& device,
@@ -288,6 +449,17 @@ MirvQueue_D12::MirvQueue_D12(MirvDevice_D12& device,
                              ID3D12CommandQueue* const queue)
     : MirvQueue(device, family)
     , mQueue(queue)
-{ }
+{
+    Start();
+}
+
+MirvQueue_D12::~MirvQueue_D12()
+{
+    Stop();
+}
 
-MirvQueue_D12::~MirvQueue_D12() = default;
+void
+MirvQueue_D12::Execute(const MirvCommandBuffer&)
+{
+    // Nothing records into D3D12 command lists yet.
+}
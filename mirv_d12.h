@@ -6,23 +6,35 @@
 
 struct ID3D12CommandQueue;
 struct ID3D12Device;
+struct ID3D12Heap;
+struct ID3D12Resource;
 struct IDXGIAdapter1;
 struct IDXGIFactory1;
 struct DXGI_ADAPTER_DESC1;
 
 // --
 
+class MirvAdapter_D12 final : public MirvAdapter
+{
+public:
+    const rp<IDXGIAdapter1> mDxgiAdapter;
+
+    MirvAdapter_D12(IDXGIAdapter1* adapter, const DXGI_ADAPTER_DESC1& desc);
+    ~MirvAdapter_D12() override;
+};
+
+// --
+
 class MirvPhysicalDevice_D12 final : public MirvPhysicalDevice
 {
-    const rp<IDXGIFactory1> mFactory;
-    const rp<IDXGIAdapter1> mAdapter;
+    const rp<MirvAdapter_D12> mAdapter_D12;
 
 public:
-    MirvPhysicalDevice_D12(MirvInstance& instance, IDXGIAdapter1* adapter,
-                           const DXGI_ADAPTER_DESC1& desc);
+    MirvPhysicalDevice_D12(MirvInstance& instance, MirvAdapter_D12* adapter);
     ~MirvPhysicalDevice_D12() override;
 
     VkResult CreateDevice(const VkDeviceCreateInfo& createInfo,
+                          const VkAllocationCallbacks* allocator,
                           rp<MirvDevice>* out_device) override;
 };
 
@@ -33,12 +45,28 @@ class MirvDevice_D12 final : public MirvDevice
     const rp<ID3D12Device> mDevice;
 
 public:
-    MirvDevice_D12(MirvPhysicalDevice_D12& physDev, ID3D12Device* device);
+    MirvDevice_D12(MirvPhysicalDevice_D12& physDev, const VkAllocationCallbacks* allocator,
+                   ID3D12Device* device);
     ~MirvDevice_D12() override;
 
     VkResult AddQueues(const VkDeviceQueueCreateInfo& info,
                        const VkQueueFamilyProperties& familyInfo,
                        std::vector<rp<MirvQueue>>* out) override;
+    VkResult AllocBlock(uint32_t typeIndex, uint64_t size,
+                        rp<MirvMemoryBlock>* out) override;
+};
+
+// --
+
+class MirvMemoryBlock_D12 final : public MirvMemoryBlock
+{
+public:
+    const rp<ID3D12Heap> mHeap;
+    const rp<ID3D12Resource> mMapped; // Null unless host-visible.
+
+    MirvMemoryBlock_D12(uint32_t typeIndex, uint64_t size, ID3D12Heap* heap,
+                        ID3D12Resource* mapped, uint8_t* hostPtr);
+    ~MirvMemoryBlock_D12() override;
 };
 
 // --
@@ -51,4 +79,7 @@ public:
     MirvQueue_D12(MirvDevice_D12& device, const VkQueueFamilyProperties& family,
                   ID3D12CommandQueue* queue);
     ~MirvQueue_D12() override;
+
+private:
+    void Execute(const MirvCommandBuffer& cb) override;
 };
\ No newline at end of file
@@ -0,0 +1,290 @@
+#include "mirv.h"
+
+#include <algorithm>
+#include <iterator>
+
+MirvDescriptorSetLayout::MirvDescriptorSetLayout(MirvDevice& device,
+                                                 const VkDescriptorSetLayoutCreateInfo& info)
+    : MirvNonDispatchableObject(device)
+    , mDescriptorCount(0)
+    , mDynamicCount(0)
+{
+    for (const auto& x : Range(info.pBindings, info.bindingCount)) {
+        ASSERT(x.descriptorType != VK_DESCRIPTOR_TYPE_SAMPLER &&
+               x.descriptorType != VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER)
+        if (x.binding >= mBindings.size()) {
+            mBindings.resize(x.binding + 1, Binding{VK_DESCRIPTOR_TYPE_MAX_ENUM, 0, 0, 0});
+        }
+        mBindings[x.binding].mType = x.descriptorType;
+        mBindings[x.binding].mCount = x.descriptorCount;
+    }
+    // Lay out in binding order, which is also the order of dynamic offsets.
+    for (auto& x : mBindings) {
+        x.mFirst = mDescriptorCount;
+        x.mFirstDynamic = mDynamicCount;
+        mDescriptorCount += x.mCount;
+        if (x.mType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC ||
+            x.mType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC) {
+            mDynamicCount += x.mCount;
+        }
+    }
+    ASSERT(mDynamicCount <= kMirvMaxDynamicBuffers)
+}
+
+// -------------------------------------
+
+static_assert(sizeof(MirvDescriptorSet) % alignof(MirvDescriptor) == 0,
+              "Descriptors must be aligned right after their set.");
+static_assert(sizeof(MirvDescriptor) == sizeof(VkDescriptorBufferInfo) &&
+              sizeof(MirvDescriptor) == sizeof(VkDescriptorImageInfo),
+              "Buffer and image infos must copy straight into descriptors.");
+
+namespace {
+
+size_t
+SetBytes(const MirvDescriptorSetLayout& layout)
+{
+    return sizeof(MirvDescriptorSet) + layout.mDescriptorCount * sizeof(MirvDescriptor);
+}
+
+// Descriptor index of (binding, arrayElement). Past the end of a binding is fine; that
+// is where the next binding's descriptors are.
+uint32_t
+DescriptorIndex(const MirvDescriptorSet& set, const uint32_t binding, const uint32_t element)
+{
+    const auto b = set.mLayout->Find(binding);
+    ASSERT(b)
+    return b->mFirst + element;
+}
+
+size_t
+PoolBytes(const VkDescriptorPoolCreateInfo& info)
+{
+    size_t ret = info.maxSets * sizeof(MirvDescriptorSet);
+    for (const auto& x : Range(info.pPoolSizes, info.poolSizeCount)) {
+        ret += x.descriptorCount * sizeof(MirvDescriptor);
+    }
+    return ret;
+}
+
+} // namespace
+
+MirvDescriptorPool::MirvDescriptorPool(MirvDevice& device,
+                                       const VkDescriptorPoolCreateInfo& info,
+                                       const VkAllocationCallbacks& allocator)
+    : MirvNonDispatchableObject(device)
+    , mFlags(info.flags)
+    , mAllocator(allocator)
+    , mCapacity(PoolBytes(info))
+    , mStorage((uint8_t*)mAllocator.pfnAllocation(mAllocator.pUserData,
+                                                  std::max(mCapacity, size_t(1)),
+                                                  alignof(MirvDescriptorSet),
+                                                  VK_SYSTEM_ALLOCATION_SCOPE_OBJECT))
+    , mUsed(0)
+{ }
+
+MirvDescriptorPool::~MirvDescriptorPool()
+{
+    if (mStorage) {
+        mAllocator.pfnFree(mAllocator.pUserData, mStorage);
+    }
+}
+
+VkResult
+MirvDescriptorPool::vkAllocateDescriptorSets(const VkDescriptorSetAllocateInfo& info,
+                                             VkDescriptorSet* const out)
+{
+    ASSERT(!info.pNext)
+
+    for (uint32_t i = 0; i < info.descriptorSetCount; i++) {
+        const auto& layout = *MirvDescriptorSetLayout::For(mDevice, info.pSetLayouts[i]);
+        const auto bytes = SetBytes(layout);
+
+        size_t offset = mUsed;
+        if (bytes <= mCapacity - mUsed) {
+            mUsed += bytes;
+        } else {
+            // First fit, among whatever sets were freed.
+            const auto itr = std::find_if(mFreeRanges.begin(), mFreeRanges.end(),
+                                          [&](const std::pair<const size_t, size_t>& x) {
+                                              return x.second >= bytes;
+                                          });
+            if (itr == mFreeRanges.end()) {
+                // All or nothing.
+                const auto res = mFreeRanges.empty() ? VK_ERROR_OUT_OF_DEVICE_MEMORY
+                                                     : VK_ERROR_FRAGMENTED_POOL;
+                while (i--) {
+                    const auto set = MirvDescriptorSet::For(out[i]);
+                    FreeRange(size_t((uint8_t*)set - mStorage), set->mBytes);
+                }
+                std::fill(out, out + info.descriptorSetCount, VkDescriptorSet(VK_NULL_HANDLE));
+                return res;
+            }
+            offset = itr->first;
+            if (itr->second > bytes) {
+                mFreeRanges[offset + bytes] = itr->second - bytes;
+            }
+            mFreeRanges.erase(itr);
+        }
+
+        const auto set = (MirvDescriptorSet*)(mStorage + offset);
+        set->mLayout = &layout;
+        set->mBytes = bytes;
+        // Unwritten descriptors are undefined, but null ones are easier to debug.
+        memset(set->Descriptors(), 0, bytes - sizeof(*set));
+        out[i] = set->Handle();
+    }
+    return VK_SUCCESS;
+}
+
+VkResult
+MirvDescriptorPool::vkFreeDescriptorSets(const uint32_t count,
+                                         const VkDescriptorSet* const handles)
+{
+    ASSERT(mFlags & VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT)
+    for (const auto& handle : Range(handles, count)) {
+        if (!handle)
+            continue;
+        const auto set = MirvDescriptorSet::For(handle);
+        ASSERT((uint8_t*)set >= mStorage && (uint8_t*)set < mStorage + mUsed)
+        FreeRange(size_t((uint8_t*)set - mStorage), set->mBytes);
+    }
+    return VK_SUCCESS;
+}
+
+VkResult
+MirvDescriptorPool::vkResetDescriptorPool(VkDescriptorPoolResetFlags)
+{
+    mUsed = 0;
+    mFreeRanges.clear();
+    return VK_SUCCESS;
+}
+
+void
+MirvDescriptorPool::FreeRange(size_t offset, size_t size)
+{
+    // Merge with our neighbors on both sides.
+    auto next = mFreeRanges.lower_bound(offset);
+    if (next != mFreeRanges.end() && offset + size == next->first) {
+        size += next->second;
+        next = mFreeRanges.erase(next);
+    }
+    if (next != mFreeRanges.begin()) {
+        const auto prev = std::prev(next);
+        if (prev->first + prev->second == offset) {
+            offset = prev->first;
+            size += prev->second;
+            mFreeRanges.erase(prev);
+        }
+    }
+
+    if (offset + size == mUsed) {
+        mUsed = offset; // Back to bump allocating.
+    } else {
+        mFreeRanges[offset] = size;
+    }
+}
+
+// -------------------------------------
+
+// All writes, then all copies, straight into the sets. Descriptors are PODs at fixed
+// indices, so nothing is looked up or allocated past the first binding of each.
+void
+MirvDevice::vkUpdateDescriptorSets(const uint32_t writeCount,
+                                   const VkWriteDescriptorSet* const writes,
+                                   const uint32_t copyCount,
+                                   const VkCopyDescriptorSet* const copies) const
+{
+    for (const auto& w : Range(writes, writeCount)) {
+        ASSERT(!w.pNext)
+        const auto set = MirvDescriptorSet::For(w.dstSet);
+        const auto first = DescriptorIndex(*set, w.dstBinding, w.dstArrayElement);
+        ASSERT(first + w.descriptorCount <= set->mLayout->mDescriptorCount)
+        const auto out = set->Descriptors() + first;
+
+        switch (w.descriptorType) {
+        case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+        case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+            for (uint32_t i = 0; i < w.descriptorCount; i++) {
+                out[i].mTexelBuffer = w.pTexelBufferView[i];
+            }
+            break;
+        case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+        case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+        case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+        case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+            memcpy(out, w.pBufferInfo, w.descriptorCount * sizeof(*out));
+            break;
+        default:
+            memcpy(out, w.pImageInfo, w.descriptorCount * sizeof(*out));
+            break;
+        }
+    }
+
+    for (const auto& c : Range(copies, copyCount)) {
+        ASSERT(!c.pNext)
+        const auto src = MirvDescriptorSet::For(c.srcSet);
+        const auto dst = MirvDescriptorSet::For(c.dstSet);
+        const auto from = DescriptorIndex(*src, c.srcBinding, c.srcArrayElement);
+        const auto to = DescriptorIndex(*dst, c.dstBinding, c.dstArrayElement);
+        ASSERT(from + c.descriptorCount <= src->mLayout->mDescriptorCount &&
+               to + c.descriptorCount <= dst->mLayout->mDescriptorCount)
+        // Copies within one set may overlap.
+        memmove(dst->Descriptors() + to, src->Descriptors() + from,
+                c.descriptorCount * sizeof(MirvDescriptor));
+    }
+}
+
+// -------------------------------------
+
+MirvDescriptorUpdateTemplate::MirvDescriptorUpdateTemplate(
+        MirvDevice& device, const VkDescriptorUpdateTemplateCreateInfoKHR& info)
+    : MirvNonDispatchableObject(device)
+{
+    ASSERT(info.templateType == VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET_KHR)
+    const auto& layout = *MirvDescriptorSetLayout::For(device, info.descriptorSetLayout);
+    mDescriptorCount = 0;
+
+    for (const auto& x : Range(info.pDescriptorUpdateEntries,
+                               info.descriptorUpdateEntryCount)) {
+        const auto binding = layout.Find(x.dstBinding);
+        ASSERT(binding)
+        const auto first = binding->mFirst + x.dstArrayElement;
+        mDescriptorCount = std::max(mDescriptorCount, first + x.descriptorCount);
+
+        // Texel buffer views fill just the front of their descriptors.
+        const bool isView = (x.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER ||
+                             x.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER);
+        const auto size = uint32_t(isView ? sizeof(VkBufferView) : sizeof(MirvDescriptor));
+        for (uint32_t i = 0; i < x.descriptorCount; i++) {
+            const Copy copy = {
+                x.offset + i * x.stride,
+                uint32_t((first + i) * sizeof(MirvDescriptor)),
+                size
+            };
+            if (!mCopies.empty()) {
+                auto& prev = mCopies.back();
+                if (prev.mSrcOffset + prev.mSize == copy.mSrcOffset &&
+                    prev.mDstOffset + prev.mSize == copy.mDstOffset)
+                {
+                    prev.mSize += copy.mSize;
+                    continue;
+                }
+            }
+            mCopies.push_back(copy);
+        }
+    }
+}
+
+void
+MirvDescriptorUpdateTemplate::vkUpdateDescriptorSetWithTemplateKHR(
+        const VkDescriptorSet handle, const void* const data) const
+{
+    const auto set = MirvDescriptorSet::For(handle);
+    ASSERT(mDescriptorCount <= set->mLayout->mDescriptorCount)
+    const auto src = (const uint8_t*)data;
+    const auto dst = (uint8_t*)set->Descriptors();
+    for (const auto& x : mCopies) {
+        memcpy(dst + x.mDstOffset, src + x.mSrcOffset, x.mSize);
+    }
+}
@@ -0,0 +1,267 @@
+#pragma once
+
+#include "vulkan.h"
+#include "mirv_ext.h"
+
+#include <cstdint>
+#include <cstring>
+
+// Every entrypoint we implement, tagged with the level vkGet*ProcAddr resolves it at.
+// (entrypoints.txt is the full list we are working towards.)
+#define MIRV_PROCS(_) \
+    _(Global, vkCreateInstance) \
+    _(Global, vkEnumerateInstanceExtensionProperties) \
+    _(Global, vkEnumerateInstanceLayerProperties) \
+    _(Global, vkGetInstanceProcAddr) \
+    \
+    _(Instance, vkDestroyInstance) \
+    _(Instance, vkEnumeratePhysicalDevices) \
+    \
+    _(PhysicalDevice, vkGetPhysicalDeviceProperties) \
+    _(PhysicalDevice, vkGetPhysicalDeviceQueueFamilyProperties) \
+    _(PhysicalDevice, vkGetPhysicalDeviceMemoryProperties) \
+    _(PhysicalDevice, vkEnumerateDeviceExtensionProperties) \
+    _(PhysicalDevice, vkCreateDevice) \
+    \
+    _(Device, vkGetDeviceProcAddr) \
+    _(Device, vkDestroyDevice) \
+    _(Device, vkGetDeviceQueue) \
+    _(Device, vkQueueSubmit) \
+    _(Device, vkQueueWaitIdle) \
+    _(Device, vkDeviceWaitIdle) \
+    _(Device, vkAllocateMemory) \
+    _(Device, vkFreeMemory) \
+    _(Device, vkMapMemory) \
+    _(Device, vkUnmapMemory) \
+    _(Device, vkFlushMappedMemoryRanges) \
+    _(Device, vkInvalidateMappedMemoryRanges) \
+    _(Device, vkCreateBuffer) \
+    _(Device, vkDestroyBuffer) \
+    _(Device, vkGetBufferMemoryRequirements) \
+    _(Device, vkBindBufferMemory) \
+    _(Device, vkCreateImage) \
+    _(Device, vkDestroyImage) \
+    _(Device, vkGetImageMemoryRequirements) \
+    _(Device, vkBindImageMemory) \
+    _(Device, vkGetImageSubresourceLayout) \
+    _(Device, vkCreateShaderModule) \
+    _(Device, vkDestroyShaderModule) \
+    _(Device, vkCreatePipelineCache) \
+    _(Device, vkDestroyPipelineCache) \
+    _(Device, vkGetPipelineCacheData) \
+    _(Device, vkMergePipelineCaches) \
+    _(Device, vkCreateDescriptorSetLayout) \
+    _(Device, vkDestroyDescriptorSetLayout) \
+    _(Device, vkCreateDescriptorPool) \
+    _(Device, vkDestroyDescriptorPool) \
+    _(Device, vkResetDescriptorPool) \
+    _(Device, vkAllocateDescriptorSets) \
+    _(Device, vkFreeDescriptorSets) \
+    _(Device, vkUpdateDescriptorSets) \
+    _(Device, vkCreateDescriptorUpdateTemplateKHR) \
+    _(Device, vkDestroyDescriptorUpdateTemplateKHR) \
+    _(Device, vkUpdateDescriptorSetWithTemplateKHR) \
+    _(Device, vkCreatePipelineLayout) \
+    _(Device, vkDestroyPipelineLayout) \
+    _(Device, vkCreateComputePipelines) \
+    _(Device, vkDestroyPipeline) \
+    _(Device, vkCreateCommandPool) \
+    _(Device, vkDestroyCommandPool) \
+    _(Device, vkResetCommandPool) \
+    _(Device, vkAllocateCommandBuffers) \
+    _(Device, vkFreeCommandBuffers) \
+    _(Device, vkBeginCommandBuffer) \
+    _(Device, vkEndCommandBuffer) \
+    _(Device, vkResetCommandBuffer) \
+    _(Device, vkCmdPushConstants) \
+    _(Device, vkCmdBindPipeline) \
+    _(Device, vkCmdBindDescriptorSets) \
+    _(Device, vkCmdDispatch) \
+    _(Device, vkCmdDispatchIndirect) \
+    _(Device, vkCmdCopyBuffer) \
+    _(Device, vkCmdFillBuffer) \
+    _(Device, vkCmdUpdateBuffer) \
+    _(Device, vkCmdCopyBufferToImage) \
+    _(Device, vkCmdCopyImageToBuffer) \
+    _(Device, vkCmdBlitImage) \
+    _(Device, vkCmdPipelineBarrier) \
+    _(Device, vkCreateFence) \
+    _(Device, vkDestroyFence) \
+    _(Device, vkResetFences) \
+    _(Device, vkGetFenceStatus) \
+    _(Device, vkWaitForFences) \
+    _(Device, vkCreateSemaphore) \
+    _(Device, vkDestroySemaphore)
+
+enum class MirvProcLevel : uint8_t {
+    Global,
+    Instance,
+    PhysicalDevice,
+    Device,
+};
+
+constexpr const char* kMirvProcNames[] = {
+#define _(L, X) #X,
+    MIRV_PROCS(_)
+#undef _
+};
+
+constexpr MirvProcLevel kMirvProcLevels[] = {
+#define _(L, X) MirvProcLevel::L,
+    MIRV_PROCS(_)
+#undef _
+};
+
+constexpr size_t kMirvProcCount = sizeof(kMirvProcNames) / sizeof(kMirvProcNames[0]);
+
+// Indexed by MirvProcIndex(). Defined next to the entrypoints themselves.
+extern const PFN_vkVoidFunction gMirvProcs[kMirvProcCount];
+
+// -------------------------------------
+// Name -> index is a hash-and-displace perfect hash, built at compile time:
+// Names hash into kBuckets buckets, and each bucket gets the first seed that drops all of
+// its names into distinct free slots. A lookup is two hashes, two loads, and one strcmp.
+
+constexpr uint32_t
+MirvProcNameHash(const char* str)
+{
+    uint32_t hash = 0x811c9dc5; // FNV-1a
+    for (; *str; str++) {
+        hash ^= uint8_t(*str);
+        hash *= 0x01000193;
+    }
+    return hash;
+}
+
+constexpr uint32_t
+MirvProcSlotHash(uint32_t hash, const uint32_t seed)
+{
+    hash ^= seed * 0x9e3779b9;
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6b;
+    hash ^= hash >> 13;
+    return hash;
+}
+
+constexpr size_t
+NextPow2(const size_t x)
+{
+    size_t ret = 1;
+    while (ret < x) {
+        ret *= 2;
+    }
+    return ret;
+}
+
+struct MirvProcHash final
+{
+    static constexpr size_t kBuckets = NextPow2(kMirvProcCount) / 4 + 1;
+    static constexpr size_t kSlots = NextPow2(kMirvProcCount) * 2;
+
+    bool ok;
+    uint32_t seeds[kBuckets];
+    uint16_t slots[kSlots]; // index+1, or 0 if empty.
+
+    static constexpr MirvProcHash Build();
+};
+
+constexpr MirvProcHash
+MirvProcHash::Build()
+{
+    MirvProcHash ret = {};
+
+    uint32_t hashes[kMirvProcCount] = {};
+    uint32_t bucketSizes[kBuckets] = {};
+    for (size_t i = 0; i < kMirvProcCount; i++) {
+        hashes[i] = MirvProcNameHash(kMirvProcNames[i]);
+        bucketSizes[hashes[i] % kBuckets]++;
+    }
+
+    // Biggest buckets first, while the table is emptiest.
+    bool bucketDone[kBuckets] = {};
+    for (size_t n = 0; n < kBuckets; n++) {
+        size_t bucket = 0;
+        uint32_t bucketSize = 0;
+        for (size_t b = 0; b < kBuckets; b++) {
+            if (!bucketDone[b] && bucketSizes[b] >= bucketSize) {
+                bucket = b;
+                bucketSize = bucketSizes[b];
+            }
+        }
+        bucketDone[bucket] = true;
+        if (!bucketSize)
+            break;
+
+        bool placedAll = false;
+        for (uint32_t seed = 1; seed < 100000 && !placedAll; seed++) {
+            size_t placed[kMirvProcCount] = {};
+            size_t placedCount = 0;
+            placedAll = true;
+            for (size_t i = 0; i < kMirvProcCount; i++) {
+                if (hashes[i] % kBuckets != bucket)
+                    continue;
+                const auto slot = MirvProcSlotHash(hashes[i], seed) % kSlots;
+                if (ret.slots[slot]) {
+                    placedAll = false;
+                    break;
+                }
+                ret.slots[slot] = uint16_t(i + 1);
+                placed[placedCount++] = slot;
+            }
+            if (placedAll) {
+                ret.seeds[bucket] = seed;
+            } else {
+                for (size_t k = 0; k < placedCount; k++) {
+                    ret.slots[placed[k]] = 0;
+                }
+            }
+        }
+        if (!placedAll)
+            return ret;
+    }
+    ret.ok = true;
+    return ret;
+}
+
+constexpr MirvProcHash kMirvProcHash = MirvProcHash::Build();
+static_assert(kMirvProcHash.ok, "No perfect hash for MIRV_PROCS.");
+
+// Returns -1 for names we don't implement.
+inline int
+MirvProcIndex(const char* const name)
+{
+    const auto hash = MirvProcNameHash(name);
+    const auto& seed = kMirvProcHash.seeds[hash % MirvProcHash::kBuckets];
+    const auto& slot = kMirvProcHash.slots[MirvProcSlotHash(hash, seed) %
+                                           MirvProcHash::kSlots];
+    if (!slot)
+        return -1;
+    const int index = slot - 1;
+    if (strcmp(kMirvProcNames[index], name) != 0)
+        return -1;
+    return index;
+}
+
+// -------------------------------------
+
+// Filled once at object creation, so vkGet*ProcAddr is a plain indexed load.
+struct MirvDispatchTable final
+{
+    PFN_vkVoidFunction mProcs[kMirvProcCount];
+
+    // Resolves the entrypoints with levels in [minLevel, maxLevel].
+    void Init(const MirvProcLevel minLevel, const MirvProcLevel maxLevel) {
+        for (size_t i = 0; i < kMirvProcCount; i++) {
+            const auto& level = kMirvProcLevels[i];
+            const bool include = (level >= minLevel && level <= maxLevel);
+            mProcs[i] = include ? gMirvProcs[i] : nullptr;
+        }
+    }
+
+    PFN_vkVoidFunction Lookup(const char* const name) const {
+        const auto index = MirvProcIndex(name);
+        if (index < 0)
+            return nullptr;
+        return mProcs[index];
+    }
+};
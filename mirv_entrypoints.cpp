@@ -7,6 +7,8 @@
 
 #ifdef _WIN32
 #define LIB_EXPORT __declspec(dllexport)
+#else
+#define LIB_EXPORT __attribute__((visibility("default")))
 #endif
 
 static std::mutex gMutex;
@@ -39,10 +41,54 @@ vkCreateInstance(const VkInstanceCreateInfo* const createInfo,
                  const VkAllocationCallbacks* const allocator,
                  VkInstance* const out)
 {
-    ASSERT(!allocator)
-    return MirvInstance::vkCreateInstance(*createInfo, MapHandle(out));
+    return MirvInstance::vkCreateInstance(*createInfo, allocator, MapHandle(out));
 }
 
+LIB_EXPORT VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL
+vkGetInstanceProcAddr(const VkInstance handle, const char* const name)
+{
+    if (handle)
+        return MapHandle(handle)->mDispatch.Lookup(name);
+
+    const auto index = MirvProcIndex(name);
+    if (index < 0 || kMirvProcLevels[index] != MirvProcLevel::Global)
+        return nullptr;
+    return gMirvProcs[index];
+}
+
+// -------------------------------------
+// Loader ICD interface
+
+LIB_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vk_icdNegotiateLoaderICDInterfaceVersion(uint32_t* const inout_version)
+{
+    // 2: Dispatchable handles start with ICD_LOADER_MAGIC.
+    // 3: vk_icdGetPhysicalDeviceProcAddr.
+    const uint32_t kMaxVersion = 3;
+    if (*inout_version < 2)
+        return VK_ERROR_INCOMPATIBLE_DRIVER;
+
+    *inout_version = std::min(*inout_version, kMaxVersion);
+    return VK_SUCCESS;
+}
+
+LIB_EXPORT VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL
+vk_icdGetInstanceProcAddr(const VkInstance handle, const char* const name)
+{
+    return vkGetInstanceProcAddr(handle, name);
+}
+
+LIB_EXPORT VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL
+vk_icdGetPhysicalDeviceProcAddr(const VkInstance handle, const char* const name)
+{
+    const auto index = MirvProcIndex(name);
+    if (index < 0 || kMirvProcLevels[index] != MirvProcLevel::PhysicalDevice)
+        return nullptr;
+    return MapHandle(handle)->mDispatch.mProcs[index];
+}
+
+// --
+
 LIB_EXPORT VKAPI_ATTR void VKAPI_CALL
 vkDestroyInstance(const VkInstance handle, const VkAllocationCallbacks*)
 {
@@ -53,8 +99,8 @@ LIB_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
 vkEnumeratePhysicalDevices(const VkInstance handle, uint32_t* const out_physicalDeviceCount,
                            VkPhysicalDevice* const out_physicalDevices)
 {
-    return MapHandle(handle)->vkEnumeratePhysicalDevices(handle, out_physicalDeviceCount,
-                                                         MapHandle(out_physicalDevices));
+    return MapHandle(handle)->vkEnumeratePhysicalDevices(out_physicalDeviceCount,
+                                                         out_physicalDevices);
 }
 
 /*
@@ -93,19 +139,38 @@ vkGetPhysicalDeviceQueueFamilyProperties(const VkPhysicalDevice handle,
     (void)VulkanArrayCopyMeme(props, out_propertyCount, out_properties);
 }
 
-/*
-VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceMemoryProperties(
-    VkPhysicalDevice                            physicalDevice,
-    VkPhysicalDeviceMemoryProperties*           pMemoryProperties);
-*/
+LIB_EXPORT VKAPI_ATTR void VKAPI_CALL
+vkGetPhysicalDeviceMemoryProperties(const VkPhysicalDevice handle,
+                                    VkPhysicalDeviceMemoryProperties* const out_properties)
+{
+    *out_properties = MapHandle(handle)->mMemoryProperties;
+}
+
+LIB_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vkEnumerateDeviceExtensionProperties(const VkPhysicalDevice handle,
+                                     const char* const layerName,
+                                     uint32_t* const out_propertyCount,
+                                     VkExtensionProperties* const out_properties)
+{
+    return MapHandle(handle)->vkEnumerateDeviceExtensionProperties(layerName,
+                                                                   out_propertyCount,
+                                                                   out_properties);
+}
 
 LIB_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
 vkCreateDevice(const VkPhysicalDevice handle,
                const VkDeviceCreateInfo* const createInfo,
-               const VkAllocationCallbacks*,
+               const VkAllocationCallbacks* const allocator,
                VkDevice* const out_device)
 {
-    return MapHandle(handle)->vkCreateDevice(*createInfo, MapHandle(out_device));
+    return MapHandle(handle)->vkCreateDevice(*createInfo, allocator,
+                                             MapHandle(out_device));
+}
+
+LIB_EXPORT VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL
+vkGetDeviceProcAddr(const VkDevice handle, const char* const name)
+{
+    return MapHandle(handle)->mDispatch.Lookup(name);
 }
 
 LIB_EXPORT VKAPI_ATTR void VKAPI_CALL
@@ -124,14 +189,537 @@ vkGetDeviceQueue(const VkDevice handle, const uint32_t queueFamilyIndex,
                                                MapHandle(out_queue));
 }
 
+LIB_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vkQueueSubmit(const VkQueue handle, const uint32_t submitCount,
+              const VkSubmitInfo* const submits, const VkFence fence)
+{
+    return MapHandle(handle)->vkQueueSubmit(submitCount, submits, fence);
+}
+
+LIB_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vkQueueWaitIdle(const VkQueue handle)
+{
+    return MapHandle(handle)->vkQueueWaitIdle();
+}
+
+LIB_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vkDeviceWaitIdle(const VkDevice handle)
+{
+    return MapHandle(handle)->vkDeviceWaitIdle();
+}
+
+// --
+
+LIB_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vkAllocateMemory(const VkDevice handle, const VkMemoryAllocateInfo* const info,
+                 const VkAllocationCallbacks* const allocator,
+                 VkDeviceMemory* const out)
+{
+    return MapHandle(handle)->vkAllocateMemory(*info, allocator, MapHandle(out));
+}
+
+LIB_EXPORT VKAPI_ATTR void VKAPI_CALL
+vkFreeMemory(const VkDevice handle, const VkDeviceMemory mem, const VkAllocationCallbacks*)
+{
+    MapHandle(handle)->vkFreeMemory(mem);
+}
+
+LIB_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vkMapMemory(const VkDevice handle, const VkDeviceMemory mem, const VkDeviceSize offset,
+            const VkDeviceSize size, const VkMemoryMapFlags flags, void** const out_data)
+{
+    const auto& dev = MapHandle(handle);
+    return dev->vkMapMemory(MapHandle(dev, mem), offset, size, flags, out_data);
+}
+
+LIB_EXPORT VKAPI_ATTR void VKAPI_CALL
+vkUnmapMemory(const VkDevice handle, const VkDeviceMemory mem)
+{
+    const auto& dev = MapHandle(handle);
+    dev->vkUnmapMemory(MapHandle(dev, mem));
+}
+
+LIB_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vkFlushMappedMemoryRanges(const VkDevice handle, const uint32_t count,
+                          const VkMappedMemoryRange* const ranges)
+{
+    return MapHandle(handle)->vkFlushMappedMemoryRanges(count, ranges);
+}
+
+LIB_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vkInvalidateMappedMemoryRanges(const VkDevice handle, const uint32_t count,
+                               const VkMappedMemoryRange* const ranges)
+{
+    return MapHandle(handle)->vkInvalidateMappedMemoryRanges(count, ranges);
+}
+
+// --
+
+LIB_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vkCreateBuffer(const VkDevice handle, const VkBufferCreateInfo* const createInfo,
+               const VkAllocationCallbacks* const allocator, VkBuffer* const out)
+{
+    return MapHandle(handle)->vkCreateBuffer(*createInfo, allocator, MapHandle(out));
+}
+
+LIB_EXPORT VKAPI_ATTR void VKAPI_CALL
+vkDestroyBuffer(const VkDevice handle, const VkBuffer buffer, const VkAllocationCallbacks*)
+{
+    MapHandle(handle)->vkDestroyBuffer(buffer);
+}
+
+LIB_EXPORT VKAPI_ATTR void VKAPI_CALL
+vkGetBufferMemoryRequirements(const VkDevice handle, const VkBuffer buffer,
+                              VkMemoryRequirements* const out)
+{
+    const auto& dev = MapHandle(handle);
+    dev->vkGetBufferMemoryRequirements(MapHandle(dev, buffer), out);
+}
+
+LIB_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vkBindBufferMemory(const VkDevice handle, const VkBuffer buffer, const VkDeviceMemory mem,
+                   const VkDeviceSize offset)
+{
+    const auto& dev = MapHandle(handle);
+    return dev->vkBindBufferMemory(MapHandle(dev, buffer), MapHandle(dev, mem), offset);
+}
+
+// --
+
+LIB_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vkCreateImage(const VkDevice handle, const VkImageCreateInfo* const createInfo,
+              const VkAllocationCallbacks* const allocator, VkImage* const out)
+{
+    return MapHandle(handle)->vkCreateImage(*createInfo, allocator, MapHandle(out));
+}
+
+LIB_EXPORT VKAPI_ATTR void VKAPI_CALL
+vkDestroyImage(const VkDevice handle, const VkImage image, const VkAllocationCallbacks*)
+{
+    MapHandle(handle)->vkDestroyImage(image);
+}
+
+LIB_EXPORT VKAPI_ATTR void VKAPI_CALL
+vkGetImageMemoryRequirements(const VkDevice handle, const VkImage image,
+                             VkMemoryRequirements* const out)
+{
+    const auto& dev = MapHandle(handle);
+    dev->vkGetImageMemoryRequirements(MapHandle(dev, image), out);
+}
+
+LIB_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vkBindImageMemory(const VkDevice handle, const VkImage image, const VkDeviceMemory mem,
+                  const VkDeviceSize offset)
+{
+    const auto& dev = MapHandle(handle);
+    return dev->vkBindImageMemory(MapHandle(dev, image), MapHandle(dev, mem), offset);
+}
+
+LIB_EXPORT VKAPI_ATTR void VKAPI_CALL
+vkGetImageSubresourceLayout(const VkDevice handle, const VkImage image,
+                            const VkImageSubresource* const subresource,
+                            VkSubresourceLayout* const out)
+{
+    const auto& dev = MapHandle(handle);
+    dev->vkGetImageSubresourceLayout(MapHandle(dev, image), *subresource, out);
+}
+
+// --
+
+LIB_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vkCreateShaderModule(const VkDevice handle, const VkShaderModuleCreateInfo* const createInfo,
+                     const VkAllocationCallbacks* const allocator, VkShaderModule* const out)
+{
+    return MapHandle(handle)->vkCreateShaderModule(*createInfo, allocator, MapHandle(out));
+}
+
+LIB_EXPORT VKAPI_ATTR void VKAPI_CALL
+vkDestroyShaderModule(const VkDevice handle, const VkShaderModule module,
+                      const VkAllocationCallbacks*)
+{
+    MapHandle(handle)->vkDestroyShaderModule(module);
+}
+
+LIB_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vkCreatePipelineCache(const VkDevice handle, const VkPipelineCacheCreateInfo* const createInfo,
+                      const VkAllocationCallbacks* const allocator, VkPipelineCache* const out)
+{
+    return MapHandle(handle)->vkCreatePipelineCache(*createInfo, allocator, MapHandle(out));
+}
+
+LIB_EXPORT VKAPI_ATTR void VKAPI_CALL
+vkDestroyPipelineCache(const VkDevice handle, const VkPipelineCache cache,
+                       const VkAllocationCallbacks*)
+{
+    MapHandle(handle)->vkDestroyPipelineCache(cache);
+}
+
+LIB_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vkGetPipelineCacheData(const VkDevice handle, const VkPipelineCache cache,
+                       size_t* const inout_size, void* const out_data)
+{
+    const auto& dev = MapHandle(handle);
+    return dev->vkGetPipelineCacheData(MapHandle(dev, cache), inout_size, out_data);
+}
+
+LIB_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vkMergePipelineCaches(const VkDevice handle, const VkPipelineCache dst,
+                      const uint32_t srcCount, const VkPipelineCache* const srcs)
+{
+    const auto& dev = MapHandle(handle);
+    return dev->vkMergePipelineCaches(MapHandle(dev, dst), srcCount, srcs);
+}
+
+LIB_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vkCreateDescriptorSetLayout(const VkDevice handle,
+                            const VkDescriptorSetLayoutCreateInfo* const createInfo,
+                            const VkAllocationCallbacks* const allocator,
+                            VkDescriptorSetLayout* const out)
+{
+    return MapHandle(handle)->vkCreateDescriptorSetLayout(*createInfo, allocator,
+                                                          MapHandle(out));
+}
+
+LIB_EXPORT VKAPI_ATTR void VKAPI_CALL
+vkDestroyDescriptorSetLayout(const VkDevice handle, const VkDescriptorSetLayout layout,
+                             const VkAllocationCallbacks*)
+{
+    MapHandle(handle)->vkDestroyDescriptorSetLayout(layout);
+}
+
+LIB_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vkCreateDescriptorPool(const VkDevice handle,
+                       const VkDescriptorPoolCreateInfo* const createInfo,
+                       const VkAllocationCallbacks* const allocator,
+                       VkDescriptorPool* const out)
+{
+    return MapHandle(handle)->vkCreateDescriptorPool(*createInfo, allocator, MapHandle(out));
+}
+
+LIB_EXPORT VKAPI_ATTR void VKAPI_CALL
+vkDestroyDescriptorPool(const VkDevice handle, const VkDescriptorPool pool,
+                        const VkAllocationCallbacks*)
+{
+    MapHandle(handle)->vkDestroyDescriptorPool(pool);
+}
+
+LIB_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vkResetDescriptorPool(const VkDevice handle, const VkDescriptorPool pool,
+                      const VkDescriptorPoolResetFlags flags)
+{
+    const auto& dev = MapHandle(handle);
+    return MapHandle(dev, pool)->vkResetDescriptorPool(flags);
+}
+
+LIB_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vkAllocateDescriptorSets(const VkDevice handle,
+                         const VkDescriptorSetAllocateInfo* const info,
+                         VkDescriptorSet* const out)
+{
+    const auto& dev = MapHandle(handle);
+    return MapHandle(dev, info->descriptorPool)->vkAllocateDescriptorSets(*info, out);
+}
+
+LIB_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vkFreeDescriptorSets(const VkDevice handle, const VkDescriptorPool pool,
+                     const uint32_t count, const VkDescriptorSet* const sets)
+{
+    const auto& dev = MapHandle(handle);
+    return MapHandle(dev, pool)->vkFreeDescriptorSets(count, sets);
+}
+
+LIB_EXPORT VKAPI_ATTR void VKAPI_CALL
+vkUpdateDescriptorSets(const VkDevice handle, const uint32_t writeCount,
+                       const VkWriteDescriptorSet* const writes, const uint32_t copyCount,
+                       const VkCopyDescriptorSet* const copies)
+{
+    MapHandle(handle)->vkUpdateDescriptorSets(writeCount, writes, copyCount, copies);
+}
+
+LIB_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vkCreateDescriptorUpdateTemplateKHR(const VkDevice handle,
+                                    const VkDescriptorUpdateTemplateCreateInfoKHR* const
+                                        createInfo,
+                                    const VkAllocationCallbacks* const allocator,
+                                    VkDescriptorUpdateTemplateKHR* const out)
+{
+    return MapHandle(handle)->vkCreateDescriptorUpdateTemplateKHR(*createInfo, allocator,
+                                                                  MapHandle(out));
+}
+
+LIB_EXPORT VKAPI_ATTR void VKAPI_CALL
+vkDestroyDescriptorUpdateTemplateKHR(const VkDevice handle,
+                                     const VkDescriptorUpdateTemplateKHR tmpl,
+                                     const VkAllocationCallbacks*)
+{
+    MapHandle(handle)->vkDestroyDescriptorUpdateTemplateKHR(tmpl);
+}
+
+LIB_EXPORT VKAPI_ATTR void VKAPI_CALL
+vkUpdateDescriptorSetWithTemplateKHR(const VkDevice handle, const VkDescriptorSet set,
+                                     const VkDescriptorUpdateTemplateKHR tmpl,
+                                     const void* const data)
+{
+    const auto& dev = MapHandle(handle);
+    MapHandle(dev, tmpl)->vkUpdateDescriptorSetWithTemplateKHR(set, data);
+}
+
+LIB_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vkCreatePipelineLayout(const VkDevice handle,
+                       const VkPipelineLayoutCreateInfo* const createInfo,
+                       const VkAllocationCallbacks* const allocator,
+                       VkPipelineLayout* const out)
+{
+    return MapHandle(handle)->vkCreatePipelineLayout(*createInfo, allocator, MapHandle(out));
+}
+
+LIB_EXPORT VKAPI_ATTR void VKAPI_CALL
+vkDestroyPipelineLayout(const VkDevice handle, const VkPipelineLayout layout,
+                        const VkAllocationCallbacks*)
+{
+    MapHandle(handle)->vkDestroyPipelineLayout(layout);
+}
+
+LIB_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vkCreateComputePipelines(const VkDevice handle, const VkPipelineCache cache,
+                         const uint32_t count,
+                         const VkComputePipelineCreateInfo* const createInfos,
+                         const VkAllocationCallbacks* const allocator,
+                         VkPipeline* const out)
+{
+    return MapHandle(handle)->vkCreateComputePipelines(cache, count, createInfos, allocator,
+                                                       out);
+}
+
+LIB_EXPORT VKAPI_ATTR void VKAPI_CALL
+vkDestroyPipeline(const VkDevice handle, const VkPipeline pipeline,
+                  const VkAllocationCallbacks*)
+{
+    MapHandle(handle)->vkDestroyPipeline(pipeline);
+}
+
 // --
 
 LIB_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
 vkCreateCommandPool(const VkDevice handle,
                     const VkCommandPoolCreateInfo* const createInfo,
-                    const VkAllocationCallbacks*, VkCommandPool* const out)
+                    const VkAllocationCallbacks* const allocator,
+                    VkCommandPool* const out)
+{
+    return MapHandle(handle)->vkCreateCommandPool(*createInfo, allocator, MapHandle(out));
+}
+
+LIB_EXPORT VKAPI_ATTR void VKAPI_CALL
+vkDestroyCommandPool(const VkDevice handle, const VkCommandPool pool,
+                     const VkAllocationCallbacks*)
+{
+    MapHandle(handle)->vkDestroyCommandPool(pool);
+}
+
+LIB_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vkResetCommandPool(const VkDevice handle, const VkCommandPool pool,
+                   const VkCommandPoolResetFlags flags)
+{
+    const auto& dev = MapHandle(handle);
+    return MapHandle(dev, pool)->vkResetCommandPool(flags);
+}
+
+LIB_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vkAllocateCommandBuffers(const VkDevice handle,
+                         const VkCommandBufferAllocateInfo* const info,
+                         VkCommandBuffer* const out)
+{
+    const auto& dev = MapHandle(handle);
+    return MapHandle(dev, info->commandPool)->vkAllocateCommandBuffers(*info, out);
+}
+
+LIB_EXPORT VKAPI_ATTR void VKAPI_CALL
+vkFreeCommandBuffers(const VkDevice handle, const VkCommandPool pool,
+                     const uint32_t count, const VkCommandBuffer* const buffers)
+{
+    const auto& dev = MapHandle(handle);
+    MapHandle(dev, pool)->vkFreeCommandBuffers(count, buffers);
+}
+
+LIB_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vkBeginCommandBuffer(const VkCommandBuffer handle,
+                     const VkCommandBufferBeginInfo* const info)
+{
+    return MapHandle(handle)->vkBeginCommandBuffer(*info);
+}
+
+LIB_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vkEndCommandBuffer(const VkCommandBuffer handle)
+{
+    return MapHandle(handle)->vkEndCommandBuffer();
+}
+
+LIB_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vkResetCommandBuffer(const VkCommandBuffer handle, const VkCommandBufferResetFlags flags)
+{
+    return MapHandle(handle)->vkResetCommandBuffer(flags);
+}
+
+// --
+
+LIB_EXPORT VKAPI_ATTR void VKAPI_CALL
+vkCmdPushConstants(const VkCommandBuffer handle, const VkPipelineLayout layout,
+                   const VkShaderStageFlags stageFlags, const uint32_t offset,
+                   const uint32_t size, const void* const values)
 {
-    return MapHandle(handle)->vkCreateCommandPool(*createInfo, MapHandle(out));
+    MapHandle(handle)->vkCmdPushConstants(layout, stageFlags, offset, size, values);
+}
+
+LIB_EXPORT VKAPI_ATTR void VKAPI_CALL
+vkCmdBindPipeline(const VkCommandBuffer handle, const VkPipelineBindPoint bindPoint,
+                  const VkPipeline pipeline)
+{
+    MapHandle(handle)->vkCmdBindPipeline(bindPoint, pipeline);
+}
+
+LIB_EXPORT VKAPI_ATTR void VKAPI_CALL
+vkCmdBindDescriptorSets(const VkCommandBuffer handle, const VkPipelineBindPoint bindPoint,
+                        const VkPipelineLayout layout, const uint32_t firstSet,
+                        const uint32_t setCount, const VkDescriptorSet* const sets,
+                        const uint32_t dynamicOffsetCount,
+                        const uint32_t* const dynamicOffsets)
+{
+    MapHandle(handle)->vkCmdBindDescriptorSets(bindPoint, layout, firstSet, setCount, sets,
+                                               dynamicOffsetCount, dynamicOffsets);
+}
+
+LIB_EXPORT VKAPI_ATTR void VKAPI_CALL
+vkCmdDispatch(const VkCommandBuffer handle, const uint32_t x, const uint32_t y,
+              const uint32_t z)
+{
+    MapHandle(handle)->vkCmdDispatch(x, y, z);
+}
+
+LIB_EXPORT VKAPI_ATTR void VKAPI_CALL
+vkCmdDispatchIndirect(const VkCommandBuffer handle, const VkBuffer buffer,
+                      const VkDeviceSize offset)
+{
+    MapHandle(handle)->vkCmdDispatchIndirect(buffer, offset);
+}
+
+LIB_EXPORT VKAPI_ATTR void VKAPI_CALL
+vkCmdCopyBuffer(const VkCommandBuffer handle, const VkBuffer src, const VkBuffer dst,
+                const uint32_t regionCount, const VkBufferCopy* const regions)
+{
+    MapHandle(handle)->vkCmdCopyBuffer(src, dst, regionCount, regions);
+}
+
+LIB_EXPORT VKAPI_ATTR void VKAPI_CALL
+vkCmdFillBuffer(const VkCommandBuffer handle, const VkBuffer dst, const VkDeviceSize offset,
+                const VkDeviceSize size, const uint32_t data)
+{
+    MapHandle(handle)->vkCmdFillBuffer(dst, offset, size, data);
+}
+
+LIB_EXPORT VKAPI_ATTR void VKAPI_CALL
+vkCmdUpdateBuffer(const VkCommandBuffer handle, const VkBuffer dst, const VkDeviceSize offset,
+                  const VkDeviceSize size, const void* const data)
+{
+    MapHandle(handle)->vkCmdUpdateBuffer(dst, offset, size, data);
+}
+
+LIB_EXPORT VKAPI_ATTR void VKAPI_CALL
+vkCmdCopyBufferToImage(const VkCommandBuffer handle, const VkBuffer src, const VkImage dst,
+                       const VkImageLayout dstLayout, const uint32_t regionCount,
+                       const VkBufferImageCopy* const regions)
+{
+    MapHandle(handle)->vkCmdCopyBufferToImage(src, dst, dstLayout, regionCount, regions);
+}
+
+LIB_EXPORT VKAPI_ATTR void VKAPI_CALL
+vkCmdCopyImageToBuffer(const VkCommandBuffer handle, const VkImage src,
+                       const VkImageLayout srcLayout, const VkBuffer dst,
+                       const uint32_t regionCount, const VkBufferImageCopy* const regions)
+{
+    MapHandle(handle)->vkCmdCopyImageToBuffer(src, srcLayout, dst, regionCount, regions);
+}
+
+LIB_EXPORT VKAPI_ATTR void VKAPI_CALL
+vkCmdBlitImage(const VkCommandBuffer handle, const VkImage src, const VkImageLayout srcLayout,
+               const VkImage dst, const VkImageLayout dstLayout, const uint32_t regionCount,
+               const VkImageBlit* const regions, const VkFilter filter)
+{
+    MapHandle(handle)->vkCmdBlitImage(src, srcLayout, dst, dstLayout, regionCount, regions,
+                                      filter);
+}
+
+LIB_EXPORT VKAPI_ATTR void VKAPI_CALL
+vkCmdPipelineBarrier(const VkCommandBuffer handle, const VkPipelineStageFlags srcStageMask,
+                     const VkPipelineStageFlags dstStageMask,
+                     const VkDependencyFlags dependencyFlags,
+                     const uint32_t memoryBarrierCount,
+                     const VkMemoryBarrier* const memoryBarriers,
+                     const uint32_t bufferBarrierCount,
+                     const VkBufferMemoryBarrier* const bufferBarriers,
+                     const uint32_t imageBarrierCount,
+                     const VkImageMemoryBarrier* const imageBarriers)
+{
+    MapHandle(handle)->vkCmdPipelineBarrier(srcStageMask, dstStageMask, dependencyFlags,
+                                            memoryBarrierCount, memoryBarriers,
+                                            bufferBarrierCount, bufferBarriers,
+                                            imageBarrierCount, imageBarriers);
+}
+
+// --
+
+LIB_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vkCreateFence(const VkDevice handle, const VkFenceCreateInfo* const createInfo,
+              const VkAllocationCallbacks* const allocator, VkFence* const out)
+{
+    return MapHandle(handle)->vkCreateFence(*createInfo, allocator, MapHandle(out));
+}
+
+LIB_EXPORT VKAPI_ATTR void VKAPI_CALL
+vkDestroyFence(const VkDevice handle, const VkFence fence, const VkAllocationCallbacks*)
+{
+    MapHandle(handle)->vkDestroyFence(fence);
+}
+
+LIB_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vkResetFences(const VkDevice handle, const uint32_t count, const VkFence* const fences)
+{
+    return MapHandle(handle)->vkResetFences(count, fences);
+}
+
+LIB_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vkGetFenceStatus(const VkDevice handle, const VkFence fence)
+{
+    const auto& dev = MapHandle(handle);
+    return dev->vkGetFenceStatus(MapHandle(dev, fence));
+}
+
+LIB_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vkWaitForFences(const VkDevice handle, const uint32_t count, const VkFence* const fences,
+                const VkBool32 waitAll, const uint64_t timeout)
+{
+    return MapHandle(handle)->vkWaitForFences(count, fences, waitAll, timeout);
+}
+
+LIB_EXPORT VKAPI_ATTR VkResult VKAPI_CALL
+vkCreateSemaphore(const VkDevice handle, const VkSemaphoreCreateInfo* const createInfo,
+                  const VkAllocationCallbacks* const allocator, VkSemaphore* const out)
+{
+    return MapHandle(handle)->vkCreateSemaphore(*createInfo, allocator, MapHandle(out));
+}
+
+LIB_EXPORT VKAPI_ATTR void VKAPI_CALL
+vkDestroySemaphore(const VkDevice handle, const VkSemaphore semaphore,
+                   const VkAllocationCallbacks*)
+{
+    MapHandle(handle)->vkDestroySemaphore(semaphore);
 }
 
 } // extern "C"
+
+// -------------------------------------
+
+const PFN_vkVoidFunction gMirvProcs[kMirvProcCount] = {
+#define _(L, X) reinterpret_cast<PFN_vkVoidFunction>(&X),
+    MIRV_PROCS(_)
+#undef _
+};
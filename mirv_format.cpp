@@ -0,0 +1,1015 @@
+#include "mirv_format.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "mirv_transfer.h"
+#include "util.h"
+
+#ifdef MIRV_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+using L = MirvFormatLayout;
+using N = MirvNumeric;
+constexpr uint8_t R = kMirvR;
+constexpr uint8_t G = kMirvG;
+constexpr uint8_t B = kMirvB;
+constexpr uint8_t A = kMirvA;
+constexpr uint8_t X = kMirvX;
+
+// Indexed by VkFormat. Packed components are listed from the LSB up, which is the
+// reverse of their names.
+const MirvFormatInfo kCoreFormats[] = {
+    { 0, 0, 0, L::Undefined, N::None, 0, {}, {} }, // UNDEFINED
+    { 1, 1, 1, L::Packed, N::UNorm, 2, {G, R}, {4, 4} }, // R4G4_UNORM_PACK8
+    { 2, 1, 1, L::Packed, N::UNorm, 4, {A, B, G, R}, {4, 4, 4, 4} }, // R4G4B4A4_UNORM_PACK16
+    { 2, 1, 1, L::Packed, N::UNorm, 4, {A, R, G, B}, {4, 4, 4, 4} }, // B4G4R4A4_UNORM_PACK16
+    { 2, 1, 1, L::Packed, N::UNorm, 3, {B, G, R}, {5, 6, 5} }, // R5G6B5_UNORM_PACK16
+    { 2, 1, 1, L::Packed, N::UNorm, 3, {R, G, B}, {5, 6, 5} }, // B5G6R5_UNORM_PACK16
+    { 2, 1, 1, L::Packed, N::UNorm, 4, {A, B, G, R}, {1, 5, 5, 5} }, // R5G5B5A1_UNORM_PACK16
+    { 2, 1, 1, L::Packed, N::UNorm, 4, {A, R, G, B}, {1, 5, 5, 5} }, // B5G5R5A1_UNORM_PACK16
+    { 2, 1, 1, L::Packed, N::UNorm, 4, {B, G, R, A}, {5, 5, 5, 1} }, // A1R5G5B5_UNORM_PACK16
+    { 1, 1, 1, L::Array, N::UNorm, 1, {R}, {8} }, // R8_UNORM
+    { 1, 1, 1, L::Array, N::SNorm, 1, {R}, {8} }, // R8_SNORM
+    { 1, 1, 1, L::Array, N::UScaled, 1, {R}, {8} }, // R8_USCALED
+    { 1, 1, 1, L::Array, N::SScaled, 1, {R}, {8} }, // R8_SSCALED
+    { 1, 1, 1, L::Array, N::UInt, 1, {R}, {8} }, // R8_UINT
+    { 1, 1, 1, L::Array, N::SInt, 1, {R}, {8} }, // R8_SINT
+    { 1, 1, 1, L::Array, N::SRGB, 1, {R}, {8} }, // R8_SRGB
+    { 2, 1, 1, L::Array, N::UNorm, 2, {R, G}, {8, 8} }, // R8G8_UNORM
+    { 2, 1, 1, L::Array, N::SNorm, 2, {R, G}, {8, 8} }, // R8G8_SNORM
+    { 2, 1, 1, L::Array, N::UScaled, 2, {R, G}, {8, 8} }, // R8G8_USCALED
+    { 2, 1, 1, L::Array, N::SScaled, 2, {R, G}, {8, 8} }, // R8G8_SSCALED
+    { 2, 1, 1, L::Array, N::UInt, 2, {R, G}, {8, 8} }, // R8G8_UINT
+    { 2, 1, 1, L::Array, N::SInt, 2, {R, G}, {8, 8} }, // R8G8_SINT
+    { 2, 1, 1, L::Array, N::SRGB, 2, {R, G}, {8, 8} }, // R8G8_SRGB
+    { 3, 1, 1, L::Array, N::UNorm, 3, {R, G, B}, {8, 8, 8} }, // R8G8B8_UNORM
+    { 3, 1, 1, L::Array, N::SNorm, 3, {R, G, B}, {8, 8, 8} }, // R8G8B8_SNORM
+    { 3, 1, 1, L::Array, N::UScaled, 3, {R, G, B}, {8, 8, 8} }, // R8G8B8_USCALED
+    { 3, 1, 1, L::Array, N::SScaled, 3, {R, G, B}, {8, 8, 8} }, // R8G8B8_SSCALED
+    { 3, 1, 1, L::Array, N::UInt, 3, {R, G, B}, {8, 8, 8} }, // R8G8B8_UINT
+    { 3, 1, 1, L::Array, N::SInt, 3, {R, G, B}, {8, 8, 8} }, // R8G8B8_SINT
+    { 3, 1, 1, L::Array, N::SRGB, 3, {R, G, B}, {8, 8, 8} }, // R8G8B8_SRGB
+    { 3, 1, 1, L::Array, N::UNorm, 3, {B, G, R}, {8, 8, 8} }, // B8G8R8_UNORM
+    { 3, 1, 1, L::Array, N::SNorm, 3, {B, G, R}, {8, 8, 8} }, // B8G8R8_SNORM
+    { 3, 1, 1, L::Array, N::UScaled, 3, {B, G, R}, {8, 8, 8} }, // B8G8R8_USCALED
+    { 3, 1, 1, L::Array, N::SScaled, 3, {B, G, R}, {8, 8, 8} }, // B8G8R8_SSCALED
+    { 3, 1, 1, L::Array, N::UInt, 3, {B, G, R}, {8, 8, 8} }, // B8G8R8_UINT
+    { 3, 1, 1, L::Array, N::SInt, 3, {B, G, R}, {8, 8, 8} }, // B8G8R8_SINT
+    { 3, 1, 1, L::Array, N::SRGB, 3, {B, G, R}, {8, 8, 8} }, // B8G8R8_SRGB
+    { 4, 1, 1, L::Array, N::UNorm, 4, {R, G, B, A}, {8, 8, 8, 8} }, // R8G8B8A8_UNORM
+    { 4, 1, 1, L::Array, N::SNorm, 4, {R, G, B, A}, {8, 8, 8, 8} }, // R8G8B8A8_SNORM
+    { 4, 1, 1, L::Array, N::UScaled, 4, {R, G, B, A}, {8, 8, 8, 8} }, // R8G8B8A8_USCALED
+    { 4, 1, 1, L::Array, N::SScaled, 4, {R, G, B, A}, {8, 8, 8, 8} }, // R8G8B8A8_SSCALED
+    { 4, 1, 1, L::Array, N::UInt, 4, {R, G, B, A}, {8, 8, 8, 8} }, // R8G8B8A8_UINT
+    { 4, 1, 1, L::Array, N::SInt, 4, {R, G, B, A}, {8, 8, 8, 8} }, // R8G8B8A8_SINT
+    { 4, 1, 1, L::Array, N::SRGB, 4, {R, G, B, A}, {8, 8, 8, 8} }, // R8G8B8A8_SRGB
+    { 4, 1, 1, L::Array, N::UNorm, 4, {B, G, R, A}, {8, 8, 8, 8} }, // B8G8R8A8_UNORM
+    { 4, 1, 1, L::Array, N::SNorm, 4, {B, G, R, A}, {8, 8, 8, 8} }, // B8G8R8A8_SNORM
+    { 4, 1, 1, L::Array, N::UScaled, 4, {B, G, R, A}, {8, 8, 8, 8} }, // B8G8R8A8_USCALED
+    { 4, 1, 1, L::Array, N::SScaled, 4, {B, G, R, A}, {8, 8, 8, 8} }, // B8G8R8A8_SSCALED
+    { 4, 1, 1, L::Array, N::UInt, 4, {B, G, R, A}, {8, 8, 8, 8} }, // B8G8R8A8_UINT
+    { 4, 1, 1, L::Array, N::SInt, 4, {B, G, R, A}, {8, 8, 8, 8} }, // B8G8R8A8_SINT
+    { 4, 1, 1, L::Array, N::SRGB, 4, {B, G, R, A}, {8, 8, 8, 8} }, // B8G8R8A8_SRGB
+    { 4, 1, 1, L::Packed, N::UNorm, 4, {R, G, B, A}, {8, 8, 8, 8} }, // A8B8G8R8_UNORM_PACK32
+    { 4, 1, 1, L::Packed, N::SNorm, 4, {R, G, B, A}, {8, 8, 8, 8} }, // A8B8G8R8_SNORM_PACK32
+    { 4, 1, 1, L::Packed, N::UScaled, 4, {R, G, B, A}, {8, 8, 8, 8} }, // A8B8G8R8_USCALED_PACK32
+    { 4, 1, 1, L::Packed, N::SScaled, 4, {R, G, B, A}, {8, 8, 8, 8} }, // A8B8G8R8_SSCALED_PACK32
+    { 4, 1, 1, L::Packed, N::UInt, 4, {R, G, B, A}, {8, 8, 8, 8} }, // A8B8G8R8_UINT_PACK32
+    { 4, 1, 1, L::Packed, N::SInt, 4, {R, G, B, A}, {8, 8, 8, 8} }, // A8B8G8R8_SINT_PACK32
+    { 4, 1, 1, L::Packed, N::SRGB, 4, {R, G, B, A}, {8, 8, 8, 8} }, // A8B8G8R8_SRGB_PACK32
+    { 4, 1, 1, L::Packed, N::UNorm, 4, {B, G, R, A}, {10, 10, 10, 2} }, // A2R10G10B10_UNORM_PACK32
+    { 4, 1, 1, L::Packed, N::SNorm, 4, {B, G, R, A}, {10, 10, 10, 2} }, // A2R10G10B10_SNORM_PACK32
+    { 4, 1, 1, L::Packed, N::UScaled, 4, {B, G, R, A}, {10, 10, 10, 2} }, // A2R10G10B10_USCALED_PACK32
+    { 4, 1, 1, L::Packed, N::SScaled, 4, {B, G, R, A}, {10, 10, 10, 2} }, // A2R10G10B10_SSCALED_PACK32
+    { 4, 1, 1, L::Packed, N::UInt, 4, {B, G, R, A}, {10, 10, 10, 2} }, // A2R10G10B10_UINT_PACK32
+    { 4, 1, 1, L::Packed, N::SInt, 4, {B, G, R, A}, {10, 10, 10, 2} }, // A2R10G10B10_SINT_PACK32
+    { 4, 1, 1, L::Packed, N::UNorm, 4, {R, G, B, A}, {10, 10, 10, 2} }, // A2B10G10R10_UNORM_PACK32
+    { 4, 1, 1, L::Packed, N::SNorm, 4, {R, G, B, A}, {10, 10, 10, 2} }, // A2B10G10R10_SNORM_PACK32
+    { 4, 1, 1, L::Packed, N::UScaled, 4, {R, G, B, A}, {10, 10, 10, 2} }, // A2B10G10R10_USCALED_PACK32
+    { 4, 1, 1, L::Packed, N::SScaled, 4, {R, G, B, A}, {10, 10, 10, 2} }, // A2B10G10R10_SSCALED_PACK32
+    { 4, 1, 1, L::Packed, N::UInt, 4, {R, G, B, A}, {10, 10, 10, 2} }, // A2B10G10R10_UINT_PACK32
+    { 4, 1, 1, L::Packed, N::SInt, 4, {R, G, B, A}, {10, 10, 10, 2} }, // A2B10G10R10_SINT_PACK32
+    { 2, 1, 1, L::Array, N::UNorm, 1, {R}, {16} }, // R16_UNORM
+    { 2, 1, 1, L::Array, N::SNorm, 1, {R}, {16} }, // R16_SNORM
+    { 2, 1, 1, L::Array, N::UScaled, 1, {R}, {16} }, // R16_USCALED
+    { 2, 1, 1, L::Array, N::SScaled, 1, {R}, {16} }, // R16_SSCALED
+    { 2, 1, 1, L::Array, N::UInt, 1, {R}, {16} }, // R16_UINT
+    { 2, 1, 1, L::Array, N::SInt, 1, {R}, {16} }, // R16_SINT
+    { 2, 1, 1, L::Array, N::SFloat, 1, {R}, {16} }, // R16_SFLOAT
+    { 4, 1, 1, L::Array, N::UNorm, 2, {R, G}, {16, 16} }, // R16G16_UNORM
+    { 4, 1, 1, L::Array, N::SNorm, 2, {R, G}, {16, 16} }, // R16G16_SNORM
+    { 4, 1, 1, L::Array, N::UScaled, 2, {R, G}, {16, 16} }, // R16G16_USCALED
+    { 4, 1, 1, L::Array, N::SScaled, 2, {R, G}, {16, 16} }, // R16G16_SSCALED
+    { 4, 1, 1, L::Array, N::UInt, 2, {R, G}, {16, 16} }, // R16G16_UINT
+    { 4, 1, 1, L::Array, N::SInt, 2, {R, G}, {16, 16} }, // R16G16_SINT
+    { 4, 1, 1, L::Array, N::SFloat, 2, {R, G}, {16, 16} }, // R16G16_SFLOAT
+    { 6, 1, 1, L::Array, N::UNorm, 3, {R, G, B}, {16, 16, 16} }, // R16G16B16_UNORM
+    { 6, 1, 1, L::Array, N::SNorm, 3, {R, G, B}, {16, 16, 16} }, // R16G16B16_SNORM
+    { 6, 1, 1, L::Array, N::UScaled, 3, {R, G, B}, {16, 16, 16} }, // R16G16B16_USCALED
+    { 6, 1, 1, L::Array, N::SScaled, 3, {R, G, B}, {16, 16, 16} }, // R16G16B16_SSCALED
+    { 6, 1, 1, L::Array, N::UInt, 3, {R, G, B}, {16, 16, 16} }, // R16G16B16_UINT
+    { 6, 1, 1, L::Array, N::SInt, 3, {R, G, B}, {16, 16, 16} }, // R16G16B16_SINT
+    { 6, 1, 1, L::Array, N::SFloat, 3, {R, G, B}, {16, 16, 16} }, // R16G16B16_SFLOAT
+    { 8, 1, 1, L::Array, N::UNorm, 4, {R, G, B, A}, {16, 16, 16, 16} }, // R16G16B16A16_UNORM
+    { 8, 1, 1, L::Array, N::SNorm, 4, {R, G, B, A}, {16, 16, 16, 16} }, // R16G16B16A16_SNORM
+    { 8, 1, 1, L::Array, N::UScaled, 4, {R, G, B, A}, {16, 16, 16, 16} }, // R16G16B16A16_USCALED
+    { 8, 1, 1, L::Array, N::SScaled, 4, {R, G, B, A}, {16, 16, 16, 16} }, // R16G16B16A16_SSCALED
+    { 8, 1, 1, L::Array, N::UInt, 4, {R, G, B, A}, {16, 16, 16, 16} }, // R16G16B16A16_UINT
+    { 8, 1, 1, L::Array, N::SInt, 4, {R, G, B, A}, {16, 16, 16, 16} }, // R16G16B16A16_SINT
+    { 8, 1, 1, L::Array, N::SFloat, 4, {R, G, B, A}, {16, 16, 16, 16} }, // R16G16B16A16_SFLOAT
+    { 4, 1, 1, L::Array, N::UInt, 1, {R}, {32} }, // R32_UINT
+    { 4, 1, 1, L::Array, N::SInt, 1, {R}, {32} }, // R32_SINT
+    { 4, 1, 1, L::Array, N::SFloat, 1, {R}, {32} }, // R32_SFLOAT
+    { 8, 1, 1, L::Array, N::UInt, 2, {R, G}, {32, 32} }, // R32G32_UINT
+    { 8, 1, 1, L::Array, N::SInt, 2, {R, G}, {32, 32} }, // R32G32_SINT
+    { 8, 1, 1, L::Array, N::SFloat, 2, {R, G}, {32, 32} }, // R32G32_SFLOAT
+    { 12, 1, 1, L::Array, N::UInt, 3, {R, G, B}, {32, 32, 32} }, // R32G32B32_UINT
+    { 12, 1, 1, L::Array, N::SInt, 3, {R, G, B}, {32, 32, 32} }, // R32G32B32_SINT
+    { 12, 1, 1, L::Array, N::SFloat, 3, {R, G, B}, {32, 32, 32} }, // R32G32B32_SFLOAT
+    { 16, 1, 1, L::Array, N::UInt, 4, {R, G, B, A}, {32, 32, 32, 32} }, // R32G32B32A32_UINT
+    { 16, 1, 1, L::Array, N::SInt, 4, {R, G, B, A}, {32, 32, 32, 32} }, // R32G32B32A32_SINT
+    { 16, 1, 1, L::Array, N::SFloat, 4, {R, G, B, A}, {32, 32, 32, 32} }, // R32G32B32A32_SFLOAT
+    { 8, 1, 1, L::Array, N::UInt, 1, {R}, {64} }, // R64_UINT
+    { 8, 1, 1, L::Array, N::SInt, 1, {R}, {64} }, // R64_SINT
+    { 8, 1, 1, L::Array, N::SFloat, 1, {R}, {64} }, // R64_SFLOAT
+    { 16, 1, 1, L::Array, N::UInt, 2, {R, G}, {64, 64} }, // R64G64_UINT
+    { 16, 1, 1, L::Array, N::SInt, 2, {R, G}, {64, 64} }, // R64G64_SINT
+    { 16, 1, 1, L::Array, N::SFloat, 2, {R, G}, {64, 64} }, // R64G64_SFLOAT
+    { 24, 1, 1, L::Array, N::UInt, 3, {R, G, B}, {64, 64, 64} }, // R64G64B64_UINT
+    { 24, 1, 1, L::Array, N::SInt, 3, {R, G, B}, {64, 64, 64} }, // R64G64B64_SINT
+    { 24, 1, 1, L::Array, N::SFloat, 3, {R, G, B}, {64, 64, 64} }, // R64G64B64_SFLOAT
+    { 32, 1, 1, L::Array, N::UInt, 4, {R, G, B, A}, {64, 64, 64, 64} }, // R64G64B64A64_UINT
+    { 32, 1, 1, L::Array, N::SInt, 4, {R, G, B, A}, {64, 64, 64, 64} }, // R64G64B64A64_SINT
+    { 32, 1, 1, L::Array, N::SFloat, 4, {R, G, B, A}, {64, 64, 64, 64} }, // R64G64B64A64_SFLOAT
+    { 4, 1, 1, L::Packed, N::UFloat, 3, {R, G, B}, {11, 11, 10} }, // B10G11R11_UFLOAT_PACK32
+    { 4, 1, 1, L::SharedExponent, N::UFloat, 3, {R, G, B}, {9, 9, 9} }, // E5B9G9R9_UFLOAT_PACK32
+    { 2, 1, 1, L::Array, N::UNorm, 1, {R}, {16} }, // D16_UNORM
+    { 4, 1, 1, L::Packed, N::UNorm, 2, {R, X}, {24, 8} }, // X8_D24_UNORM_PACK32
+    { 4, 1, 1, L::Array, N::SFloat, 1, {R}, {32} }, // D32_SFLOAT
+    { 1, 1, 1, L::Array, N::UInt, 1, {R}, {8} }, // S8_UINT
+    { 4, 1, 1, L::DepthStencil, N::UNorm, 2, {R, G}, {16, 8} }, // D16_UNORM_S8_UINT
+    { 4, 1, 1, L::DepthStencil, N::UNorm, 2, {R, G}, {24, 8} }, // D24_UNORM_S8_UINT
+    { 8, 1, 1, L::DepthStencil, N::SFloat, 2, {R, G}, {32, 8} }, // D32_SFLOAT_S8_UINT
+    { 8, 4, 4, L::Compressed, N::UNorm, 0, {}, {} }, // BC1_RGB_UNORM_BLOCK
+    { 8, 4, 4, L::Compressed, N::SRGB, 0, {}, {} }, // BC1_RGB_SRGB_BLOCK
+    { 8, 4, 4, L::Compressed, N::UNorm, 0, {}, {} }, // BC1_RGBA_UNORM_BLOCK
+    { 8, 4, 4, L::Compressed, N::SRGB, 0, {}, {} }, // BC1_RGBA_SRGB_BLOCK
+    { 16, 4, 4, L::Compressed, N::UNorm, 0, {}, {} }, // BC2_UNORM_BLOCK
+    { 16, 4, 4, L::Compressed, N::SRGB, 0, {}, {} }, // BC2_SRGB_BLOCK
+    { 16, 4, 4, L::Compressed, N::UNorm, 0, {}, {} }, // BC3_UNORM_BLOCK
+    { 16, 4, 4, L::Compressed, N::SRGB, 0, {}, {} }, // BC3_SRGB_BLOCK
+    { 8, 4, 4, L::Compressed, N::UNorm, 0, {}, {} }, // BC4_UNORM_BLOCK
+    { 8, 4, 4, L::Compressed, N::SNorm, 0, {}, {} }, // BC4_SNORM_BLOCK
+    { 16, 4, 4, L::Compressed, N::UNorm, 0, {}, {} }, // BC5_UNORM_BLOCK
+    { 16, 4, 4, L::Compressed, N::SNorm, 0, {}, {} }, // BC5_SNORM_BLOCK
+    { 16, 4, 4, L::Compressed, N::UFloat, 0, {}, {} }, // BC6H_UFLOAT_BLOCK
+    { 16, 4, 4, L::Compressed, N::SFloat, 0, {}, {} }, // BC6H_SFLOAT_BLOCK
+    { 16, 4, 4, L::Compressed, N::UNorm, 0, {}, {} }, // BC7_UNORM_BLOCK
+    { 16, 4, 4, L::Compressed, N::SRGB, 0, {}, {} }, // BC7_SRGB_BLOCK
+    { 8, 4, 4, L::Compressed, N::UNorm, 0, {}, {} }, // ETC2_R8G8B8_UNORM_BLOCK
+    { 8, 4, 4, L::Compressed, N::SRGB, 0, {}, {} }, // ETC2_R8G8B8_SRGB_BLOCK
+    { 8, 4, 4, L::Compressed, N::UNorm, 0, {}, {} }, // ETC2_R8G8B8A1_UNORM_BLOCK
+    { 8, 4, 4, L::Compressed, N::SRGB, 0, {}, {} }, // ETC2_R8G8B8A1_SRGB_BLOCK
+    { 16, 4, 4, L::Compressed, N::UNorm, 0, {}, {} }, // ETC2_R8G8B8A8_UNORM_BLOCK
+    { 16, 4, 4, L::Compressed, N::SRGB, 0, {}, {} }, // ETC2_R8G8B8A8_SRGB_BLOCK
+    { 8, 4, 4, L::Compressed, N::UNorm, 0, {}, {} }, // EAC_R11_UNORM_BLOCK
+    { 8, 4, 4, L::Compressed, N::SNorm, 0, {}, {} }, // EAC_R11_SNORM_BLOCK
+    { 16, 4, 4, L::Compressed, N::UNorm, 0, {}, {} }, // EAC_R11G11_UNORM_BLOCK
+    { 16, 4, 4, L::Compressed, N::SNorm, 0, {}, {} }, // EAC_R11G11_SNORM_BLOCK
+    { 16, 4, 4, L::Compressed, N::UNorm, 0, {}, {} }, // ASTC_4x4_UNORM_BLOCK
+    { 16, 4, 4, L::Compressed, N::SRGB, 0, {}, {} }, // ASTC_4x4_SRGB_BLOCK
+    { 16, 5, 4, L::Compressed, N::UNorm, 0, {}, {} }, // ASTC_5x4_UNORM_BLOCK
+    { 16, 5, 4, L::Compressed, N::SRGB, 0, {}, {} }, // ASTC_5x4_SRGB_BLOCK
+    { 16, 5, 5, L::Compressed, N::UNorm, 0, {}, {} }, // ASTC_5x5_UNORM_BLOCK
+    { 16, 5, 5, L::Compressed, N::SRGB, 0, {}, {} }, // ASTC_5x5_SRGB_BLOCK
+    { 16, 6, 5, L::Compressed, N::UNorm, 0, {}, {} }, // ASTC_6x5_UNORM_BLOCK
+    { 16, 6, 5, L::Compressed, N::SRGB, 0, {}, {} }, // ASTC_6x5_SRGB_BLOCK
+    { 16, 6, 6, L::Compressed, N::UNorm, 0, {}, {} }, // ASTC_6x6_UNORM_BLOCK
+    { 16, 6, 6, L::Compressed, N::SRGB, 0, {}, {} }, // ASTC_6x6_SRGB_BLOCK
+    { 16, 8, 5, L::Compressed, N::UNorm, 0, {}, {} }, // ASTC_8x5_UNORM_BLOCK
+    { 16, 8, 5, L::Compressed, N::SRGB, 0, {}, {} }, // ASTC_8x5_SRGB_BLOCK
+    { 16, 8, 6, L::Compressed, N::UNorm, 0, {}, {} }, // ASTC_8x6_UNORM_BLOCK
+    { 16, 8, 6, L::Compressed, N::SRGB, 0, {}, {} }, // ASTC_8x6_SRGB_BLOCK
+    { 16, 8, 8, L::Compressed, N::UNorm, 0, {}, {} }, // ASTC_8x8_UNORM_BLOCK
+    { 16, 8, 8, L::Compressed, N::SRGB, 0, {}, {} }, // ASTC_8x8_SRGB_BLOCK
+    { 16, 10, 5, L::Compressed, N::UNorm, 0, {}, {} }, // ASTC_10x5_UNORM_BLOCK
+    { 16, 10, 5, L::Compressed, N::SRGB, 0, {}, {} }, // ASTC_10x5_SRGB_BLOCK
+    { 16, 10, 6, L::Compressed, N::UNorm, 0, {}, {} }, // ASTC_10x6_UNORM_BLOCK
+    { 16, 10, 6, L::Compressed, N::SRGB, 0, {}, {} }, // ASTC_10x6_SRGB_BLOCK
+    { 16, 10, 8, L::Compressed, N::UNorm, 0, {}, {} }, // ASTC_10x8_UNORM_BLOCK
+    { 16, 10, 8, L::Compressed, N::SRGB, 0, {}, {} }, // ASTC_10x8_SRGB_BLOCK
+    { 16, 10, 10, L::Compressed, N::UNorm, 0, {}, {} }, // ASTC_10x10_UNORM_BLOCK
+    { 16, 10, 10, L::Compressed, N::SRGB, 0, {}, {} }, // ASTC_10x10_SRGB_BLOCK
+    { 16, 12, 10, L::Compressed, N::UNorm, 0, {}, {} }, // ASTC_12x10_UNORM_BLOCK
+    { 16, 12, 10, L::Compressed, N::SRGB, 0, {}, {} }, // ASTC_12x10_SRGB_BLOCK
+    { 16, 12, 12, L::Compressed, N::UNorm, 0, {}, {} }, // ASTC_12x12_UNORM_BLOCK
+    { 16, 12, 12, L::Compressed, N::SRGB, 0, {}, {} }, // ASTC_12x12_SRGB_BLOCK
+};
+static_assert(sizeof(kCoreFormats) / sizeof(kCoreFormats[0]) == VK_FORMAT_RANGE_SIZE,
+              "Every core format needs an entry.");
+
+// From VK_FORMAT_PVRTC1_2BPP_UNORM_BLOCK_IMG.
+const MirvFormatInfo kPvrtcFormats[] = {
+    { 8, 8, 4, L::Compressed, N::UNorm, 0, {}, {} }, // PVRTC1_2BPP_UNORM_BLOCK_IMG
+    { 8, 4, 4, L::Compressed, N::UNorm, 0, {}, {} }, // PVRTC1_4BPP_UNORM_BLOCK_IMG
+    { 8, 8, 4, L::Compressed, N::UNorm, 0, {}, {} }, // PVRTC2_2BPP_UNORM_BLOCK_IMG
+    { 8, 4, 4, L::Compressed, N::UNorm, 0, {}, {} }, // PVRTC2_4BPP_UNORM_BLOCK_IMG
+    { 8, 8, 4, L::Compressed, N::SRGB, 0, {}, {} }, // PVRTC1_2BPP_SRGB_BLOCK_IMG
+    { 8, 4, 4, L::Compressed, N::SRGB, 0, {}, {} }, // PVRTC1_4BPP_SRGB_BLOCK_IMG
+    { 8, 8, 4, L::Compressed, N::SRGB, 0, {}, {} }, // PVRTC2_2BPP_SRGB_BLOCK_IMG
+    { 8, 4, 4, L::Compressed, N::SRGB, 0, {}, {} }, // PVRTC2_4BPP_SRGB_BLOCK_IMG
+};
+
+// --
+
+enum class Lane {
+    F,
+    U,
+    I,
+};
+
+Lane
+LaneOf(const MirvNumeric numeric)
+{
+    switch (numeric) {
+    case N::UInt:
+        return Lane::U;
+    case N::SInt:
+        return Lane::I;
+    default:
+        return Lane::F;
+    }
+}
+
+uint64_t
+MaxOf(const unsigned bits)
+{
+    return bits >= 64 ? UINT64_MAX : (uint64_t(1) << bits) - 1;
+}
+
+int64_t
+SignExtend(const uint64_t raw, const unsigned bits)
+{
+    if (bits >= 64)
+        return int64_t(raw);
+    const auto sign = uint64_t(1) << (bits - 1);
+    return int64_t((raw ^ sign) - sign);
+}
+
+// NaN clamps to `lo`.
+double
+Clamp(const double x, const double lo, const double hi)
+{
+    return x > lo ? (x < hi ? x : hi) : lo;
+}
+
+// Little-endian, like every CPU we run on.
+uint64_t
+ReadBytes(const uint8_t* const src, const unsigned bytes)
+{
+    uint64_t ret = 0;
+    memcpy(&ret, src, bytes);
+    return ret;
+}
+
+void
+WriteBytes(uint8_t* const dst, const uint64_t x, const unsigned bytes)
+{
+    memcpy(dst, &x, bytes);
+}
+
+uint32_t
+FloatBits(const float f)
+{
+    uint32_t ret;
+    memcpy(&ret, &f, 4);
+    return ret;
+}
+
+float
+BitsFloat(const uint32_t x)
+{
+    float ret;
+    memcpy(&ret, &x, 4);
+    return ret;
+}
+
+// --
+
+float
+HalfToFloat(const uint16_t h)
+{
+    const uint32_t kExpMask = 0x7c00 << 13;
+    uint32_t bits = uint32_t(h & 0x7fff) << 13;
+    const auto exp = bits & kExpMask;
+    bits += (127 - 15) << 23; // Rebias.
+    if (exp == kExpMask) {
+        bits += (128 - 16) << 23; // Inf or NaN.
+    } else if (!exp) {
+        // Denormal: Renormalize by letting the FPU subtract the implicit one.
+        bits += 1 << 23;
+        bits = FloatBits(BitsFloat(bits) - BitsFloat(113 << 23));
+    }
+    return BitsFloat(bits | uint32_t(h & 0x8000) << 16);
+}
+
+// Rounds to nearest even.
+uint16_t
+FloatToHalf(const float f)
+{
+    const uint32_t kInf = 255 << 23;
+    const uint32_t kHalfOverflow = (127 + 16) << 23;
+    const uint32_t kDenormMagic = ((127 - 15) + (23 - 10) + 1) << 23;
+
+    auto bits = FloatBits(f);
+    const auto sign = bits & 0x80000000;
+    bits ^= sign;
+
+    uint32_t ret;
+    if (bits >= kHalfOverflow) {
+        ret = (bits > kInf) ? 0x7e00 : 0x7c00;
+    } else if (bits < (113 << 23)) {
+        // Denormal or zero: Adding the magic number rounds off the low bits for us.
+        ret = FloatBits(BitsFloat(bits) + BitsFloat(kDenormMagic)) - kDenormMagic;
+    } else {
+        const auto mantOdd = (bits >> 13) & 1;
+        bits += (uint32_t(15 - 127) << 23) + 0xfff;
+        bits += mantOdd;
+        ret = bits >> 13;
+    }
+    return uint16_t(ret | sign >> 16);
+}
+
+// B10G11R11's components: A 5-bit exponent biased by 15, like half's, and no sign.
+float
+UFloatToFloat(const uint32_t x, const unsigned mantBits)
+{
+    const auto exp = x >> mantBits;
+    const auto mant = x & ((1u << mantBits) - 1);
+    if (exp == 31)
+        return mant ? NAN : INFINITY;
+    if (!exp)
+        return std::ldexp(float(mant), -14 - int(mantBits));
+    return std::ldexp(float(mant | (1u << mantBits)), int(exp) - 15 - int(mantBits));
+}
+
+uint32_t
+FloatToUFloat(const float f, const unsigned mantBits)
+{
+    const auto maxFinite = (31u << mantBits) - 1;
+    if (std::isnan(f))
+        return (31u << mantBits) | 1;
+    if (!(f > 0))
+        return 0;
+    if (std::isinf(f))
+        return 31u << mantBits;
+    int exp;
+    (void)std::frexp(f, &exp);
+    const auto biased = std::max(exp + 14, 1); // Denormals share exponent 1's scale.
+    const auto mant = uint32_t(std::ldexp(double(f), int(mantBits) + 15 - biased) + 0.5);
+    // Normals carry their implicit one in `mant`, denormals don't, and rounding up
+    // carries straight into the exponent either way.
+    const auto ret = (exp + 14 >= 1) ? (uint32_t(biased) << mantBits) + mant - (1u << mantBits)
+                                     : mant;
+    return std::min(ret, maxFinite);
+}
+
+float
+SrgbToLinear(const float x)
+{
+    return (x <= 0.04045f) ? x / 12.92f : std::pow((x + 0.055f) / 1.055f, 2.4f);
+}
+
+float
+LinearToSrgb(const float x)
+{
+    return (x <= 0.0031308f) ? x * 12.92f : 1.055f * std::pow(x, 1 / 2.4f) - 0.055f;
+}
+
+uint8_t
+EncodeUNorm8(const double x)
+{
+    return uint8_t(Clamp(x, 0, 1) * 255 + 0.5);
+}
+
+struct SrgbTables final
+{
+    float mToFloat[256];
+    uint8_t mToLinear8[256];   // SRGB -> UNORM
+    uint8_t mFromLinear8[256]; // UNORM -> SRGB
+    uint8_t mIdentity[256];    // For alpha, which is linear either way.
+
+    SrgbTables() {
+        for (uint32_t i = 0; i < 256; i++) {
+            mToFloat[i] = SrgbToLinear(i / 255.0f);
+            mToLinear8[i] = EncodeUNorm8(mToFloat[i]);
+            mFromLinear8[i] = EncodeUNorm8(LinearToSrgb(i / 255.0f));
+            mIdentity[i] = uint8_t(i);
+        }
+    }
+};
+
+const SrgbTables&
+Srgb()
+{
+    static const SrgbTables sTables;
+    return sTables;
+}
+
+// --
+
+void
+DecodeComponent(const MirvFormatInfo& format, const unsigned k, const uint64_t raw,
+                 MirvTexel* const out)
+{
+    const auto ch = format.mChannels[k];
+    if (ch == X)
+        return;
+    const auto bits = format.mBits[k];
+    switch (format.mNumeric) {
+    case N::UNorm:
+        out->mF[ch] = float(raw) / float(MaxOf(bits));
+        break;
+    case N::SNorm:
+        out->mF[ch] = std::max(float(SignExtend(raw, bits)) / float(MaxOf(bits - 1)), -1.0f);
+        break;
+    case N::UScaled:
+        out->mF[ch] = float(raw);
+        break;
+    case N::SScaled:
+        out->mF[ch] = float(SignExtend(raw, bits));
+        break;
+    case N::UInt:
+        out->mU[ch] = uint32_t(std::min<uint64_t>(raw, UINT32_MAX));
+        break;
+    case N::SInt:
+        out->mI[ch] = int32_t(std::min<int64_t>(std::max<int64_t>(SignExtend(raw, bits),
+                                                                  INT32_MIN),
+                                                INT32_MAX));
+        break;
+    case N::SFloat:
+        if (bits == 16) {
+            out->mF[ch] = HalfToFloat(uint16_t(raw));
+        } else if (bits == 32) {
+            out->mF[ch] = BitsFloat(uint32_t(raw));
+        } else {
+            double d;
+            memcpy(&d, &raw, 8);
+            out->mF[ch] = float(d);
+        }
+        break;
+    case N::UFloat:
+        out->mF[ch] = UFloatToFloat(uint32_t(raw), bits - 5u);
+        break;
+    case N::SRGB:
+        out->mF[ch] = (ch == A) ? raw / 255.0f : Srgb().mToFloat[raw];
+        break;
+    case N::None:
+        ASSERT(false)
+        break;
+    }
+}
+
+uint64_t
+EncodeComponent(const MirvFormatInfo& format, const unsigned k, const MirvTexel& texel)
+{
+    const auto ch = format.mChannels[k];
+    if (ch == X)
+        return 0;
+    const auto bits = format.mBits[k];
+    const auto mask = MaxOf(bits);
+    const double f = texel.mF[ch];
+    switch (format.mNumeric) {
+    case N::UNorm:
+        return uint64_t(Clamp(f, 0, 1) * double(mask) + 0.5);
+    case N::SNorm: {
+        const auto x = Clamp(f, -1, 1) * double(MaxOf(bits - 1));
+        return uint64_t(int64_t(std::floor(x + 0.5))) & mask;
+    }
+    case N::UScaled:
+        return uint64_t(Clamp(f, 0, double(mask)) + 0.5);
+    case N::SScaled: {
+        const auto hi = double(MaxOf(bits - 1));
+        return uint64_t(int64_t(std::floor(Clamp(f, -hi - 1, hi) + 0.5))) & mask;
+    }
+    case N::UInt:
+        return std::min<uint64_t>(texel.mU[ch], mask);
+    case N::SInt: {
+        const auto hi = int64_t(MaxOf(bits - 1));
+        return uint64_t(std::min(std::max<int64_t>(texel.mI[ch], -hi - 1), hi)) & mask;
+    }
+    case N::SFloat:
+        if (bits == 16)
+            return FloatToHalf(texel.mF[ch]);
+        if (bits == 32)
+            return FloatBits(texel.mF[ch]);
+        {
+            uint64_t ret;
+            memcpy(&ret, &f, 8);
+            return ret;
+        }
+    case N::UFloat:
+        return FloatToUFloat(texel.mF[ch], bits - 5u);
+    case N::SRGB:
+        return (ch == A) ? EncodeUNorm8(f) : EncodeUNorm8(LinearToSrgb(float(Clamp(f, 0, 1))));
+    case N::None:
+        break;
+    }
+    ASSERT(false)
+    return 0;
+}
+
+// Per the spec's RGB to shared exponent conversion.
+uint32_t
+EncodeSharedExponent(const MirvTexel& texel)
+{
+    const int kMantBits = 9;
+    const int kBias = 15;
+    const double kMax = std::ldexp(511.0 / 512, 31 - kBias);
+    double c[3];
+    for (int i = 0; i < 3; i++) {
+        c[i] = Clamp(texel.mF[i], 0, kMax);
+    }
+    const auto maxC = std::max({ c[0], c[1], c[2] });
+    int exp = -kBias - 1;
+    if (maxC > 0) {
+        (void)std::frexp(maxC, &exp);
+        exp = std::max(exp - 1, -kBias - 1); // floor(log2(maxC))
+    }
+    exp += 1 + kBias;
+    if (std::floor(maxC / std::ldexp(1.0, exp - kBias - kMantBits) + 0.5) == 512) {
+        exp += 1;
+    }
+    const auto scale = std::ldexp(1.0, exp - kBias - kMantBits);
+    uint32_t ret = uint32_t(exp) << 27;
+    for (int i = 0; i < 3; i++) {
+        ret |= uint32_t(std::floor(c[i] / scale + 0.5)) << (kMantBits * i);
+    }
+    return ret;
+}
+
+void
+ConvertLanes(MirvTexel* const texels, const uint32_t count, const Lane from, const Lane to)
+{
+    for (auto& t : Range(texels, count)) {
+        for (int i = 0; i < 4; i++) {
+            if (from == Lane::F) {
+                const double f = t.mF[i];
+                if (to == Lane::U) {
+                    t.mU[i] = uint32_t(Clamp(f, 0, UINT32_MAX));
+                } else {
+                    t.mI[i] = int32_t(Clamp(f, INT32_MIN, INT32_MAX));
+                }
+            } else if (to == Lane::F) {
+                t.mF[i] = (from == Lane::U) ? float(t.mU[i]) : float(t.mI[i]);
+            } else if (to == Lane::U) {
+                t.mU[i] = uint32_t(std::max(t.mI[i], 0));
+            } else {
+                t.mI[i] = int32_t(std::min<uint32_t>(t.mU[i], INT32_MAX));
+            }
+        }
+    }
+}
+
+} // namespace
+
+// -------------------------------------
+
+const MirvFormatInfo&
+MirvGetFormatInfo(const VkFormat format)
+{
+    if (uint32_t(format) < VK_FORMAT_RANGE_SIZE)
+        return kCoreFormats[format];
+    const auto pvrtc = uint32_t(format - VK_FORMAT_PVRTC1_2BPP_UNORM_BLOCK_IMG);
+    if (pvrtc < sizeof(kPvrtcFormats) / sizeof(kPvrtcFormats[0]))
+        return kPvrtcFormats[pvrtc];
+    ASSERT(false)
+    return kCoreFormats[VK_FORMAT_UNDEFINED];
+}
+
+VkFormat
+MirvAspectFormat(const VkFormat format, const VkImageAspectFlags aspect)
+{
+    if (MirvGetFormatInfo(format).mLayout != L::DepthStencil)
+        return format;
+    if (aspect == VK_IMAGE_ASPECT_STENCIL_BIT)
+        return VK_FORMAT_S8_UINT;
+    ASSERT(aspect == VK_IMAGE_ASPECT_DEPTH_BIT)
+    switch (format) {
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+        return VK_FORMAT_D16_UNORM;
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+        return VK_FORMAT_X8_D24_UNORM_PACK32;
+    default:
+        return VK_FORMAT_D32_SFLOAT;
+    }
+}
+
+void
+MirvDecodeTexels(const MirvFormatInfo& format, const uint8_t* src, const uint32_t count,
+                 MirvTexel* const out)
+{
+    const bool isFloat = (LaneOf(format.mNumeric) == Lane::F);
+    for (auto& t : Range(out, count)) {
+        if (isFloat) {
+            t.mF[0] = t.mF[1] = t.mF[2] = 0;
+            t.mF[3] = 1;
+        } else {
+            t.mU[0] = t.mU[1] = t.mU[2] = 0;
+            t.mU[3] = 1;
+        }
+
+        switch (format.mLayout) {
+        case L::Array: {
+            unsigned offset = 0;
+            for (unsigned k = 0; k < format.mComponentCount; k++) {
+                const unsigned bytes = format.mBits[k] / 8;
+                DecodeComponent(format, k, ReadBytes(src + offset, bytes), &t);
+                offset += bytes;
+            }
+            break;
+        }
+        case L::Packed: {
+            const auto word = ReadBytes(src, format.mBlockBytes);
+            unsigned shift = 0;
+            for (unsigned k = 0; k < format.mComponentCount; k++) {
+                DecodeComponent(format, k, (word >> shift) & MaxOf(format.mBits[k]), &t);
+                shift += format.mBits[k];
+            }
+            break;
+        }
+        case L::SharedExponent: {
+            const auto word = uint32_t(ReadBytes(src, 4));
+            const auto scale = std::ldexp(1.0f, int(word >> 27) - 15 - 9);
+            for (unsigned k = 0; k < 3; k++) {
+                t.mF[k] = float((word >> (9 * k)) & 0x1ff) * scale;
+            }
+            break;
+        }
+        default:
+            ASSERT(false)
+            break;
+        }
+        src += format.mBlockBytes;
+    }
+}
+
+void
+MirvEncodeTexels(const MirvFormatInfo& format, const MirvTexel* const src,
+                 const uint32_t count, uint8_t* out)
+{
+    for (const auto& t : Range(src, count)) {
+        switch (format.mLayout) {
+        case L::Array: {
+            unsigned offset = 0;
+            for (unsigned k = 0; k < format.mComponentCount; k++) {
+                const unsigned bytes = format.mBits[k] / 8;
+                WriteBytes(out + offset, EncodeComponent(format, k, t), bytes);
+                offset += bytes;
+            }
+            break;
+        }
+        case L::Packed: {
+            uint64_t word = 0;
+            unsigned shift = 0;
+            for (unsigned k = 0; k < format.mComponentCount; k++) {
+                word |= EncodeComponent(format, k, t) << shift;
+                shift += format.mBits[k];
+            }
+            WriteBytes(out, word, format.mBlockBytes);
+            break;
+        }
+        case L::SharedExponent:
+            WriteBytes(out, EncodeSharedExponent(t), 4);
+            break;
+        default:
+            ASSERT(false)
+            break;
+        }
+        out += format.mBlockBytes;
+    }
+}
+
+// -------------------------------------
+// Conversion kernels
+
+namespace {
+
+void
+CopyBlocks(const MirvConversion& conv, uint8_t* const dst, const uint8_t* const src,
+           const uint32_t count)
+{
+    memcpy(dst, src, size_t(count) * conv.mSrc->mBlockBytes);
+}
+
+void
+DecodeEncode(const MirvConversion& conv, uint8_t* dst, const uint8_t* src, uint32_t count)
+{
+    const auto from = LaneOf(conv.mSrc->mNumeric);
+    const auto to = LaneOf(conv.mDst->mNumeric);
+    MirvTexel texels[64];
+    while (count) {
+        const auto n = std::min(count, 64u);
+        MirvDecodeTexels(*conv.mSrc, src, n, texels);
+        if (from != to) {
+            ConvertLanes(texels, n, from, to);
+        }
+        MirvEncodeTexels(*conv.mDst, texels, n, dst);
+        src += n * conv.mSrc->mBlockBytes;
+        dst += n * conv.mDst->mBlockBytes;
+        count -= n;
+    }
+}
+
+// RGBA8 <-> BGRA8, either way, of any numeric type.
+void
+SwapRB8888(const MirvConversion&, uint8_t* const dst, const uint8_t* const src,
+           const uint32_t count)
+{
+    uint32_t i = 0;
+#ifdef MIRV_SSE2
+    const auto ga = _mm_set1_epi32(int(0xff00ff00));
+    for (; i + 4 <= count; i += 4) {
+        const auto v = _mm_loadu_si128((const __m128i*)(src + i * 4));
+        // 0x00BB00RR -> 0x00RR00BB, by swapping 16-bit halves.
+        const auto rb = _mm_andnot_si128(ga, v);
+        const auto br = _mm_shufflehi_epi16(_mm_shufflelo_epi16(rb, 0xb1), 0xb1);
+        _mm_storeu_si128((__m128i*)(dst + i * 4), _mm_or_si128(_mm_and_si128(v, ga), br));
+    }
+#endif
+    for (; i < count; i++) {
+        uint32_t x;
+        memcpy(&x, src + i * 4, 4);
+        x = (x & 0xff00ff00) | ((x >> 16) & 0xff) | ((x & 0xff) << 16);
+        memcpy(dst + i * 4, &x, 4);
+    }
+}
+
+// UNORM8 <-> SRGB8, by table. mConstant is whether we're encoding to sRGB.
+void
+Srgb8(const MirvConversion& conv, uint8_t* dst, const uint8_t* src, const uint32_t count)
+{
+    const auto& tables = Srgb();
+    const uint8_t* const color = conv.mConstant ? tables.mFromLinear8 : tables.mToLinear8;
+    const uint8_t* perComponent[4];
+    const auto n = conv.mSrc->mComponentCount;
+    for (unsigned k = 0; k < n; k++) {
+        perComponent[k] = (conv.mSrc->mChannels[k] == A) ? tables.mIdentity : color;
+    }
+    for (uint32_t i = 0; i < count; i++, src += n, dst += n) {
+        for (unsigned k = 0; k < n; k++) {
+            dst[k] = perComponent[k][src[k]];
+        }
+    }
+}
+
+// 16-bit SFLOAT -> 32-bit SFLOAT, for any matching components.
+void
+HalfToFloat32(const MirvConversion& conv, uint8_t* const dst, const uint8_t* const src,
+              const uint32_t count)
+{
+    const auto n = size_t(count) * conv.mSrc->mComponentCount;
+    size_t i = 0;
+#ifdef MIRV_SSE2
+    // Shift exponent and mantissa into place and rebias by multiplying. That also
+    // renormalizes denormals. Inf and NaN just need the exponent maxed.
+    const auto noSign = _mm_set1_epi32(0x7fff);
+    const auto magic = _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23));
+    const auto maxFinite = _mm_set1_epi32(0x7bff);
+    const auto infNanExp = _mm_castsi128_ps(_mm_set1_epi32(255 << 23));
+    for (; i + 4 <= n; i += 4) {
+        const auto h = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(src + i * 2)),
+                                          _mm_setzero_si128());
+        const auto expMant = _mm_and_si128(h, noSign);
+        const auto sign = _mm_slli_epi32(_mm_xor_si128(h, expMant), 16);
+        const auto scaled = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(expMant, 13)), magic);
+        const auto isInfNan = _mm_castsi128_ps(_mm_cmpgt_epi32(expMant, maxFinite));
+        const auto high = _mm_or_ps(_mm_castsi128_ps(sign), _mm_and_ps(isInfNan, infNanExp));
+        _mm_storeu_ps((float*)(dst + i * 4), _mm_or_ps(scaled, high));
+    }
+#endif
+    for (; i < n; i++) {
+        uint16_t h;
+        memcpy(&h, src + i * 2, 2);
+        const auto f = HalfToFloat(h);
+        memcpy(dst + i * 4, &f, 4);
+    }
+}
+
+// A2B10G10R10 -> R8G8B8A8, or A2R10G10B10 -> B8G8R8A8, UNORM.
+// Rounds like DecodeEncode: No 10-bit value lands exactly between two 8-bit ones.
+void
+Unorm1010102To8888(const MirvConversion&, uint8_t* const dst, const uint8_t* const src,
+                   const uint32_t count)
+{
+    uint32_t i = 0;
+#ifdef MIRV_SSE2
+    const auto mask = _mm_set1_epi32(0x3ff);
+    const auto scale = _mm_set1_ps(255.0f / 1023);
+    const auto k85 = _mm_set1_epi32(85);
+    for (; i + 4 <= count; i += 4) {
+        const auto v = _mm_loadu_si128((const __m128i*)(src + i * 4));
+        const auto r = _mm_and_si128(v, mask);
+        const auto g = _mm_and_si128(_mm_srli_epi32(v, 10), mask);
+        const auto b = _mm_and_si128(_mm_srli_epi32(v, 20), mask);
+        const auto a = _mm_mullo_epi16(_mm_srli_epi32(v, 30), k85);
+        const auto r8 = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(r), scale));
+        const auto g8 = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(g), scale));
+        const auto b8 = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(b), scale));
+        const auto rgba = _mm_or_si128(_mm_or_si128(r8, _mm_slli_epi32(g8, 8)),
+                                       _mm_or_si128(_mm_slli_epi32(b8, 16),
+                                                    _mm_slli_epi32(a, 24)));
+        _mm_storeu_si128((__m128i*)(dst + i * 4), rgba);
+    }
+#endif
+    for (; i < count; i++) {
+        uint32_t x;
+        memcpy(&x, src + i * 4, 4);
+        const auto to8 = [](const uint32_t c) { return ((c & 0x3ff) * 255 + 511) / 1023; };
+        x = to8(x) | to8(x >> 10) << 8 | to8(x >> 20) << 16 | (x >> 30) * 85 << 24;
+        memcpy(dst + i * 4, &x, 4);
+    }
+}
+
+// RGB -> RGBA, with mConstant as alpha.
+template<typename T>
+void
+AddAlpha(const MirvConversion& conv, uint8_t* dst, const uint8_t* src, const uint32_t count)
+{
+    const auto alpha = T(conv.mConstant);
+    for (uint32_t i = 0; i < count; i++, src += 3 * sizeof(T), dst += 4 * sizeof(T)) {
+        memcpy(dst, src, 3 * sizeof(T));
+        memcpy(dst + 3 * sizeof(T), &alpha, sizeof(T));
+    }
+}
+
+// RGBA -> RGB.
+template<typename T>
+void
+DropAlpha(const MirvConversion&, uint8_t* dst, const uint8_t* src, const uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++, src += 4 * sizeof(T), dst += 3 * sizeof(T)) {
+        memcpy(dst, src, 3 * sizeof(T));
+    }
+}
+
+// One aspect out of, or into, DepthStencil texels. mConstant is the aspect's byte offset
+// in them, and its byte count << 8. Extracted texels are zero-padded, so D24 reads back
+// with its X8 clear.
+void
+ExtractAspect(const MirvConversion& conv, uint8_t* const dst, const uint8_t* const src,
+              const uint32_t count)
+{
+    const auto offset = unsigned(conv.mConstant & 0xff);
+    const auto bytes = unsigned(conv.mConstant >> 8);
+    const auto srcStride = conv.mSrc->mBlockBytes;
+    const auto dstStride = conv.mDst->mBlockBytes;
+    for (uint32_t i = 0; i < count; i++) {
+        WriteBytes(dst + i * dstStride, ReadBytes(src + i * srcStride + offset, bytes),
+                   dstStride);
+    }
+}
+
+void
+InsertAspect(const MirvConversion& conv, uint8_t* const dst, const uint8_t* const src,
+             const uint32_t count)
+{
+    const auto offset = unsigned(conv.mConstant & 0xff);
+    const auto bytes = unsigned(conv.mConstant >> 8);
+    const auto srcStride = conv.mSrc->mBlockBytes;
+    const auto dstStride = conv.mDst->mBlockBytes;
+    for (uint32_t i = 0; i < count; i++) {
+        memcpy(dst + i * dstStride + offset, src + i * srcStride, bytes);
+    }
+}
+
+bool
+SameChannels(const MirvFormatInfo& a, const MirvFormatInfo& b)
+{
+    return a.mComponentCount == b.mComponentCount &&
+           !memcmp(a.mChannels, b.mChannels, a.mComponentCount);
+}
+
+// Array formats of one numeric type and component size, with different channels.
+MirvConversion::Fn
+FindSwizzle(const MirvFormatInfo& dst, const MirvFormatInfo& src, uint64_t* const out_constant)
+{
+    const auto bits = src.mBits[0];
+    if (src.mComponentCount == 4 && dst.mComponentCount == 4 && bits == 8 &&
+        src.mChannels[0] == dst.mChannels[2] && src.mChannels[2] == dst.mChannels[0] &&
+        src.mChannels[1] == G && src.mChannels[3] == A && dst.mChannels[3] == A)
+    {
+        return &SwapRB8888;
+    }
+    if (bits > 16 || !!memcmp(src.mChannels, dst.mChannels, 3))
+        return nullptr;
+    if (src.mComponentCount == 3 && dst.mComponentCount == 4) {
+        MirvTexel one;
+        if (LaneOf(dst.mNumeric) == Lane::F) {
+            one.mF[3] = 1;
+        } else {
+            one.mU[3] = 1;
+        }
+        *out_constant = EncodeComponent(dst, 3, one);
+        return (bits == 8) ? &AddAlpha<uint8_t> : &AddAlpha<uint16_t>;
+    }
+    if (src.mComponentCount == 4 && dst.mComponentCount == 3)
+        return (bits == 8) ? &DropAlpha<uint8_t> : &DropAlpha<uint16_t>;
+    return nullptr;
+}
+
+} // namespace
+
+bool
+MirvConversion::IsCopy() const
+{
+    return mFn == &CopyBlocks;
+}
+
+MirvConversion
+MirvFindConversion(const VkFormat dstFormat, const VkFormat srcFormat)
+{
+    const auto& dst = MirvGetFormatInfo(dstFormat);
+    const auto& src = MirvGetFormatInfo(srcFormat);
+    MirvConversion ret = { &DecodeEncode, &dst, &src, 0 };
+    if (dstFormat == srcFormat) {
+        ret.mFn = &CopyBlocks;
+        return ret;
+    }
+
+    if (src.mLayout == L::DepthStencil || dst.mLayout == L::DepthStencil) {
+        const bool extract = (src.mLayout == L::DepthStencil);
+        const auto& combined = extract ? src : dst;
+        const auto aspect = extract ? dstFormat : srcFormat;
+        const unsigned depthBytes = combined.mBits[0] / 8u;
+        if (aspect == VK_FORMAT_S8_UINT) {
+            ret.mConstant = depthBytes | 1 << 8;
+        } else {
+            ASSERT(MirvAspectFormat(extract ? srcFormat : dstFormat,
+                                    VK_IMAGE_ASPECT_DEPTH_BIT) == aspect)
+            ret.mConstant = depthBytes << 8;
+        }
+        ret.mFn = extract ? &ExtractAspect : &InsertAspect;
+        return ret;
+    }
+    ASSERT(src.mLayout != L::Compressed && dst.mLayout != L::Compressed)
+
+    if (src.mLayout == L::Array && dst.mLayout == L::Array && src.mBits[0] == dst.mBits[0]) {
+        if (src.mNumeric == dst.mNumeric) {
+            const auto fn = FindSwizzle(dst, src, &ret.mConstant);
+            if (fn) {
+                ret.mFn = fn;
+            }
+        } else if (src.mBits[0] == 8 && SameChannels(src, dst) &&
+                   (src.mNumeric == N::UNorm || src.mNumeric == N::SRGB) &&
+                   (dst.mNumeric == N::UNorm || dst.mNumeric == N::SRGB))
+        {
+            ret.mFn = &Srgb8;
+            ret.mConstant = (dst.mNumeric == N::SRGB);
+        }
+        return ret;
+    }
+
+    if (src.mLayout == L::Array && dst.mLayout == L::Array && src.mBits[0] == 16 &&
+        dst.mBits[0] == 32 && src.mNumeric == N::SFloat && dst.mNumeric == N::SFloat &&
+        SameChannels(src, dst))
+    {
+        ret.mFn = &HalfToFloat32;
+        return ret;
+    }
+
+    if ((srcFormat == VK_FORMAT_A2B10G10R10_UNORM_PACK32 &&
+         dstFormat == VK_FORMAT_R8G8B8A8_UNORM) ||
+        (srcFormat == VK_FORMAT_A2R10G10B10_UNORM_PACK32 &&
+         dstFormat == VK_FORMAT_B8G8R8A8_UNORM))
+    {
+        ret.mFn = &Unorm1010102To8888;
+    }
+    return ret;
+}
+
+void
+MirvConvertRect(const MirvConversion& conv, uint8_t* dst, const size_t dstPitch,
+                const uint8_t* src, const size_t srcPitch, const uint32_t width,
+                const uint32_t height, const bool streaming)
+{
+    if (conv.IsCopy()) {
+        const auto rowBytes = size_t(width) * conv.mSrc->mBlockBytes;
+        if (dstPitch == rowBytes && srcPitch == rowBytes) {
+            MirvCopyBytes(dst, src, rowBytes * height, streaming);
+            return;
+        }
+        for (uint32_t y = 0; y < height; y++, dst += dstPitch, src += srcPitch) {
+            MirvCopyBytes(dst, src, rowBytes, streaming);
+        }
+        return;
+    }
+    for (uint32_t y = 0; y < height; y++, dst += dstPitch, src += srcPitch) {
+        conv.Run(dst, src, width);
+    }
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "vulkan.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// Every VkFormat in vulkan.h, as a table of how its texels are laid out, and conversions
+// between them. Transfers use these wherever what an image stores differs from what the
+// app reads and writes.
+
+enum class MirvFormatLayout : uint8_t {
+    Undefined,
+    Array,          // Whole-byte components, in memory order.
+    Packed,         // Bit fields of one 8, 16 or 32-bit word, from the LSB up.
+    SharedExponent, // E5B9G9R9: 9-bit R, G and B mantissas, then a 5-bit exponent.
+    DepthStencil,   // Depth, then a stencil byte at mBits[0] / 8. Copied per aspect.
+    Compressed,     // Opaque blocks.
+};
+
+enum class MirvNumeric : uint8_t {
+    None,
+    UNorm,
+    SNorm,
+    UScaled,
+    SScaled,
+    UInt,
+    SInt,
+    UFloat,
+    SFloat,
+    SRGB,
+};
+
+// Which channel a component holds. Depth and stencil read as R, like sampling them does.
+enum MirvChannel : uint8_t {
+    kMirvR,
+    kMirvG,
+    kMirvB,
+    kMirvA,
+    kMirvX, // Unused bits.
+};
+
+struct MirvFormatInfo final
+{
+    uint8_t mBlockBytes; // Texels are 1x1 blocks.
+    uint8_t mBlockWidth;
+    uint8_t mBlockHeight;
+    MirvFormatLayout mLayout;
+    MirvNumeric mNumeric;
+    uint8_t mComponentCount;
+    uint8_t mChannels[4]; // MirvChannel, per component.
+    uint8_t mBits[4];
+};
+
+const MirvFormatInfo& MirvGetFormatInfo(VkFormat format);
+
+// What a transfer reads or writes for one aspect of `format`: D24_UNORM_S8_UINT's depth
+// is X8_D24_UNORM_PACK32, say. Anything else is its own.
+VkFormat MirvAspectFormat(VkFormat format, VkImageAspectFlags aspect);
+
+// One texel, with all four channels. UInt and SInt formats use mU and mI, all others mF.
+// 64-bit components narrow to 32 bits.
+union MirvTexel {
+    float mF[4];
+    uint32_t mU[4];
+    int32_t mI[4];
+};
+
+// For Array, Packed and SharedExponent formats. Channels a format lacks decode as 0,0,0,1.
+void MirvDecodeTexels(const MirvFormatInfo& format, const uint8_t* src, uint32_t count,
+                      MirvTexel* out);
+void MirvEncodeTexels(const MirvFormatInfo& format, const MirvTexel* src, uint32_t count,
+                      uint8_t* out);
+
+// Converts runs of blocks from one format to another, chosen once per transfer: A plain
+// copy for matching formats, a dedicated kernel for common pairs, and else a decode and
+// encode through MirvTexels.
+// Between a DepthStencil format and one of its MirvAspectFormats, it moves just that
+// aspect. Writes into DepthStencil texels keep the other aspect.
+struct MirvConversion final
+{
+    typedef void (*Fn)(const MirvConversion& conv, uint8_t* dst, const uint8_t* src,
+                       uint32_t count);
+
+    Fn mFn;
+    const MirvFormatInfo* mDst;
+    const MirvFormatInfo* mSrc;
+    uint64_t mConstant; // Kernel-specific.
+
+    bool IsCopy() const;
+    void Run(uint8_t* const dst, const uint8_t* const src, const uint32_t count) const {
+        mFn(*this, dst, src, count);
+    }
+};
+
+MirvConversion MirvFindConversion(VkFormat dst, VkFormat src);
+
+// A width x height rectangle of blocks. Pitches are in bytes. `streaming` is as for
+// MirvCopyBytes.
+void MirvConvertRect(const MirvConversion& conv, uint8_t* dst, size_t dstPitch,
+                     const uint8_t* src, size_t srcPitch, uint32_t width, uint32_t height,
+                     bool streaming);
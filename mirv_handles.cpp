@@ -0,0 +1,98 @@
+#include "mirv_handles.h"
+
+#include "mirv.h"
+
+MirvHandleTable::MirvHandleTable(const VkAllocationCallbacks& allocator)
+    : mAllocator(allocator)
+    , mSlabCount(0)
+    , mFreeHead(0)
+    , mLiveCount(0)
+{
+    for (auto& x : mSlabs) {
+        x.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+MirvHandleTable::~MirvHandleTable()
+{
+    for (uint32_t i = 0; i < mSlabCount; i++) {
+        const auto slab = mSlabs[i].load(std::memory_order_relaxed);
+        for (const auto& entry : Range(slab, kSlabSize)) {
+            if (entry.mObject) {
+                entry.mObject->Release();
+            }
+        }
+        mAllocator.pfnFree(mAllocator.pUserData, slab);
+    }
+}
+
+MirvHandleTable::Entry*
+MirvHandleTable::EntryFor(const uint32_t index) const
+{
+    const auto slab = mSlabs[index >> kSlabShift].load(std::memory_order_relaxed);
+    return &slab[index & (kSlabSize - 1)];
+}
+
+uint64_t
+MirvHandleTable::Insert(RefCounted* const obj, const MirvObjectType type)
+{
+    const mutex_guard guard(mMutex);
+
+    if (!mFreeHead) {
+        if (mSlabCount == kMaxSlabs)
+            return 0;
+
+        const auto slab = (Entry*)mAllocator.pfnAllocation(mAllocator.pUserData,
+                                                           sizeof(Entry) * kSlabSize,
+                                                           alignof(Entry),
+                                                           VK_SYSTEM_ALLOCATION_SCOPE_DEVICE);
+        if (!slab)
+            return 0;
+
+        // Thread the new entries onto the free list in order, so handles stay dense.
+        const auto base = mSlabCount * kSlabSize;
+        for (uint32_t i = 0; i < kSlabSize; i++) {
+            auto& entry = slab[i];
+            entry.mObject = nullptr;
+            entry.mGeneration = 0;
+            entry.mNextFree = (i + 1 < kSlabSize) ? base + i + 2 : 0;
+        }
+        mSlabs[mSlabCount].store(slab, std::memory_order_release);
+        mSlabCount++;
+        mFreeHead = base + 1;
+    }
+
+    const auto index = mFreeHead - 1;
+    auto& entry = *EntryFor(index);
+    mFreeHead = entry.mNextFree;
+
+    obj->AddRef();
+    entry.mObject = obj;
+    entry.mType = type;
+    entry.mGeneration++;
+    mLiveCount++;
+    return (uint64_t(entry.mGeneration) << 32) | (index + 1);
+}
+
+void
+MirvHandleTable::Remove(const uint64_t handle, const MirvObjectType type)
+{
+    RefCounted* obj;
+    {
+        const mutex_guard guard(mMutex);
+
+        const auto index = uint32_t(handle) - 1;
+        auto& entry = *EntryFor(index);
+        ASSERT(entry.mGeneration == uint32_t(handle >> 32))
+        ASSERT(entry.mType == type)
+        (void)type;
+
+        obj = entry.mObject;
+        entry.mObject = nullptr;
+        entry.mGeneration++; // Stale copies of `handle` now fail the generation check.
+        entry.mNextFree = mFreeHead;
+        mFreeHead = index + 1;
+        mLiveCount--;
+    }
+    obj->Release(); // Outside the lock, since this may destroy the object.
+}
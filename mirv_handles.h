@@ -0,0 +1,85 @@
+#pragma once
+
+#include "vulkan.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+#include "util.h"
+
+template<typename RefCountT> class RefCountedT;
+class AtomicRefCount;
+typedef RefCountedT<AtomicRefCount> RefCounted;
+enum class MirvObjectType;
+
+// Per-device table behind every non-dispatchable handle.
+// A handle is (generation << 32 | (index + 1)), so VK_NULL_HANDLE is never valid.
+// Entries live in fixed-size slabs that never move once published, so lookups are a
+// lock-free shift, mask, and load. Debug builds also check the generation and type, which
+// catches use-after-destroy even once the slot has been reused.
+class MirvHandleTable final
+{
+    static const uint32_t kSlabShift = 12;
+    static const uint32_t kSlabSize = 1 << kSlabShift;
+    static const uint32_t kMaxSlabs = 1024;
+
+    struct Entry final {
+        RefCounted* mObject;
+        uint32_t mGeneration;
+        MirvObjectType mType;
+        uint32_t mNextFree; // index+1, or 0 for none.
+    };
+
+    const VkAllocationCallbacks& mAllocator;
+
+    std::mutex mMutex;
+    std::atomic<Entry*> mSlabs[kMaxSlabs];
+    uint32_t mSlabCount;
+    uint32_t mFreeHead; // index+1, or 0 for none.
+    uint32_t mLiveCount;
+
+public:
+    explicit MirvHandleTable(const VkAllocationCallbacks& allocator);
+    // Releases whatever the app leaked, then frees every slab at once.
+    ~MirvHandleTable();
+
+    uint32_t LiveCount() const { return mLiveCount; }
+
+    // Takes a reference. Returns 0 if we're out of memory or slots.
+    uint64_t Insert(RefCounted* obj, MirvObjectType type);
+    // Drops the table's reference.
+    void Remove(uint64_t handle, MirvObjectType type);
+
+    RefCounted* Lookup(const uint64_t handle, const MirvObjectType type) const {
+        const auto index = uint32_t(handle) - 1;
+        const auto slab = mSlabs[index >> kSlabShift].load(std::memory_order_acquire);
+        const auto& entry = slab[index & (kSlabSize - 1)];
+        ASSERT(entry.mGeneration == uint32_t(handle >> 32))
+        ASSERT(entry.mType == type)
+        (void)type;
+        return entry.mObject;
+    }
+
+private:
+    Entry* EntryFor(uint32_t index) const;
+};
+
+// --
+
+// Non-dispatchable handles are pointers on 64-bit platforms and uint64_t elsewhere.
+template<typename HandleT>
+inline uint64_t
+HandleBits(const HandleT handle) { return uint64_t(uintptr_t(handle)); }
+
+template<>
+inline uint64_t
+HandleBits<uint64_t>(const uint64_t handle) { return handle; }
+
+template<typename HandleT>
+inline HandleT
+FromHandleBits(const uint64_t bits) { return reinterpret_cast<HandleT>(uintptr_t(bits)); }
+
+template<>
+inline uint64_t
+FromHandleBits<uint64_t>(const uint64_t bits) { return bits; }
@@ -0,0 +1,158 @@
+#include "mirv.h"
+
+#include "mirv_format.h"
+#include "mirv_transfer.h"
+
+namespace {
+
+// Rows are aligned like optimalBufferCopyRowPitchAlignment asks buffers to be, so copies
+// from well-pitched buffers are one run per slice.
+const uint64_t kRowAlignment = 16;
+const uint64_t kLevelAlignment = 64;
+
+uint64_t
+AlignUp(const uint64_t x, const uint64_t alignment)
+{
+    return (x + alignment - 1) / alignment * alignment;
+}
+
+static_assert(VK_FORMAT_B8G8R8_SRGB - VK_FORMAT_R8G8B8_UNORM ==
+              VK_FORMAT_B8G8R8A8_SRGB - VK_FORMAT_R8G8B8A8_UNORM &&
+              VK_FORMAT_R16G16B16_SFLOAT - VK_FORMAT_R16G16B16_UNORM ==
+              VK_FORMAT_R16G16B16A16_SFLOAT - VK_FORMAT_R16G16B16A16_UNORM,
+              "3 and 4-component formats must line up.");
+
+// 24 and 48-bit texels straddle words, so OPTIMAL images keep them with alpha, and
+// transfers add or drop it. LINEAR images are addressed by the app, and MUTABLE_FORMAT
+// images' views may reinterpret texels, so both keep their format.
+VkFormat
+StorageFormat(const VkImageCreateInfo& info)
+{
+    const auto format = info.format;
+    if (info.tiling != VK_IMAGE_TILING_OPTIMAL ||
+        (info.flags & VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT))
+    {
+        return format;
+    }
+    if (format >= VK_FORMAT_R8G8B8_UNORM && format <= VK_FORMAT_B8G8R8_SRGB)
+        return VkFormat(format + (VK_FORMAT_R8G8B8A8_UNORM - VK_FORMAT_R8G8B8_UNORM));
+    if (format >= VK_FORMAT_R16G16B16_UNORM && format <= VK_FORMAT_R16G16B16_SFLOAT)
+        return VkFormat(format + (VK_FORMAT_R16G16B16A16_UNORM - VK_FORMAT_R16G16B16_UNORM));
+    return format;
+}
+
+// 1D images would be mostly padding, and odd-sized blocks have no tiling kernels.
+uint32_t
+TileShift(const VkImageCreateInfo& info, const VkFormat storageFormat)
+{
+    const auto blockBytes = MirvGetFormatInfo(storageFormat).mBlockBytes;
+    if (info.tiling != VK_IMAGE_TILING_OPTIMAL || info.imageType == VK_IMAGE_TYPE_1D ||
+        blockBytes > 16 || (blockBytes & (blockBytes - 1)))
+    {
+        return 0;
+    }
+    return MirvTileShift(blockBytes);
+}
+
+} // namespace
+
+MirvImage::MirvImage(MirvDevice& device, const VkImageCreateInfo& info)
+    : MirvNonDispatchableObject(device)
+    , mImageType(info.imageType)
+    , mFormat(info.format)
+    , mStorageFormat(StorageFormat(info))
+    , mTiling(info.tiling)
+    , mTileShift(TileShift(info, mStorageFormat))
+    , mExtent(info.extent)
+    , mMipLevels(info.mipLevels)
+    , mArrayLayers(info.arrayLayers)
+    , mSize(0)
+    , mBlockOffset(0)
+{
+    const auto& format = MirvGetFormatInfo(mStorageFormat);
+    mLevels.resize(mMipLevels);
+    for (uint32_t i = 0; i < mMipLevels; i++) {
+        auto& level = mLevels[i];
+        level.mExtent = { std::max(mExtent.width >> i, 1u),
+                          std::max(mExtent.height >> i, 1u),
+                          std::max(mExtent.depth >> i, 1u) };
+        const auto blocksWide = (level.mExtent.width + format.mBlockWidth - 1) /
+                                format.mBlockWidth;
+        const auto blocksHigh = (level.mExtent.height + format.mBlockHeight - 1) /
+                                format.mBlockHeight;
+        level.mOffset = AlignUp(mSize, kLevelAlignment);
+        if (mTileShift) {
+            // Whole tiles, even where they hang over the edges.
+            const auto tileSize = 1u << mTileShift;
+            const auto tileBytes = uint64_t(tileSize) * tileSize * format.mBlockBytes;
+            level.mRowPitch = (blocksWide + tileSize - 1) / tileSize * tileBytes;
+            level.mDepthPitch = level.mRowPitch * ((blocksHigh + tileSize - 1) / tileSize);
+        } else {
+            level.mRowPitch = AlignUp(uint64_t(blocksWide) * format.mBlockBytes,
+                                      kRowAlignment);
+            level.mDepthPitch = level.mRowPitch * blocksHigh;
+        }
+        level.mArrayPitch = level.mDepthPitch * level.mExtent.depth;
+        mSize = level.mOffset + level.mArrayPitch * mArrayLayers;
+    }
+}
+
+VkResult
+MirvDevice::vkCreateImage(const VkImageCreateInfo& createInfo,
+                          const VkAllocationCallbacks* const allocator,
+                          MirvImage** const out)
+{
+    ASSERT(!createInfo.pNext)
+    ASSERT(!(createInfo.flags & (VK_IMAGE_CREATE_SPARSE_BINDING_BIT |
+                                 VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT |
+                                 VK_IMAGE_CREATE_SPARSE_ALIASED_BIT)))
+    ASSERT(createInfo.samples == VK_SAMPLE_COUNT_1_BIT)
+    ASSERT(createInfo.mipLevels && createInfo.arrayLayers)
+    ASSERT(MirvGetFormatInfo(createInfo.format).mLayout != MirvFormatLayout::Undefined)
+    const auto& image = new (ChildAllocator(allocator), VK_SYSTEM_ALLOCATION_SCOPE_OBJECT)
+                            MirvImage(*this, createInfo);
+    return AddHandle(image, out);
+}
+
+void
+MirvDevice::vkDestroyImage(const VkImage handle)
+{
+    RemoveHandle<MirvImage>(handle);
+}
+
+void
+MirvDevice::vkGetImageMemoryRequirements(const MirvImage* const image,
+                                         VkMemoryRequirements* const out) const
+{
+    out->size = AlignUp(image->mSize, kLevelAlignment);
+    out->alignment = kLevelAlignment;
+    out->memoryTypeBits = (1u << mPhysDev.mMemoryProperties.memoryTypeCount) - 1;
+}
+
+VkResult
+MirvDevice::vkBindImageMemory(MirvImage* const image, const MirvDeviceMemory* const mem,
+                              const VkDeviceSize offset) const
+{
+    ASSERT(!image->mBlock)
+    ASSERT(offset % kLevelAlignment == 0 && offset + image->mSize <= mem->mSize)
+    image->mBlock = mem->mBlock;
+    image->mBlockOffset = mem->mOffset + offset;
+    return VK_SUCCESS;
+}
+
+void
+MirvDevice::vkGetImageSubresourceLayout(const MirvImage* const image,
+                                        const VkImageSubresource& subresource,
+                                        VkSubresourceLayout* const out) const
+{
+    // OPTIMAL layouts are ours to change; only LINEAR ones are the app's to address.
+    ASSERT(image->mTiling == VK_IMAGE_TILING_LINEAR)
+    ASSERT(subresource.mipLevel < image->mMipLevels &&
+           subresource.arrayLayer < image->mArrayLayers)
+    const auto& level = image->mLevels[subresource.mipLevel];
+    out->offset = level.mOffset + subresource.arrayLayer * level.mArrayPitch;
+    out->size = level.mArrayPitch;
+    out->rowPitch = level.mRowPitch;
+    out->arrayPitch = level.mArrayPitch;
+    out->depthPitch = level.mDepthPitch;
+}
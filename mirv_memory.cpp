@@ -0,0 +1,144 @@
+#include "mirv_memory.h"
+
+#include "util.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+
+uint32_t
+CountTrailingZeros(const uint64_t x)
+{
+#ifdef _MSC_VER
+    unsigned long ret;
+    _BitScanForward64(&ret, x);
+    return ret;
+#else
+    return __builtin_ctzll(x);
+#endif
+}
+
+} // namespace
+
+// --
+
+MirvBuddyAllocator::MirvBuddyAllocator(const uint64_t size)
+    : mTopOrder(OrderFor(size))
+    , mOrders(mTopOrder + 1)
+    , mUsed(0)
+{
+    ASSERT(size == Size())
+
+    for (uint32_t order = 0; order <= mTopOrder; order++) {
+        auto& x = mOrders[order];
+        const uint64_t nodes = uint64_t(1) << (mTopOrder - order);
+        const auto words = (nodes + 63) / 64;
+        x.mFree.resize(words);
+        x.mSummary.resize((words + 63) / 64);
+        x.mFreeCount = 0;
+    }
+    SetFree(mTopOrder, 0);
+}
+
+/*static*/ uint32_t
+MirvBuddyAllocator::OrderFor(const uint64_t size)
+{
+    uint32_t order = 0;
+    while ((kMinSize << order) < size) {
+        order++;
+    }
+    return order;
+}
+
+void
+MirvBuddyAllocator::SetFree(const uint32_t order, const uint64_t node)
+{
+    auto& x = mOrders[order];
+    const auto word = node / 64;
+    x.mFree[word] |= uint64_t(1) << (node % 64);
+    x.mSummary[word / 64] |= uint64_t(1) << (word % 64);
+    x.mFreeCount++;
+}
+
+void
+MirvBuddyAllocator::ClearFree(const uint32_t order, const uint64_t node)
+{
+    auto& x = mOrders[order];
+    const auto word = node / 64;
+    x.mFree[word] &= ~(uint64_t(1) << (node % 64));
+    if (!x.mFree[word]) {
+        x.mSummary[word / 64] &= ~(uint64_t(1) << (word % 64));
+    }
+    x.mFreeCount--;
+}
+
+bool
+MirvBuddyAllocator::IsFree(const uint32_t order, const uint64_t node) const
+{
+    const auto& x = mOrders[order];
+    return (x.mFree[node / 64] >> (node % 64)) & 1;
+}
+
+uint64_t
+MirvBuddyAllocator::FirstFree(const uint32_t order) const
+{
+    const auto& x = mOrders[order];
+    for (size_t i = 0; i < x.mSummary.size(); i++) {
+        const auto& summary = x.mSummary[i];
+        if (!summary)
+            continue;
+        const auto word = i * 64 + CountTrailingZeros(summary);
+        return word * 64 + CountTrailingZeros(x.mFree[word]);
+    }
+    ASSERT(false)
+    return 0;
+}
+
+bool
+MirvBuddyAllocator::Alloc(const uint64_t size, uint64_t* const out_offset)
+{
+    const auto order = OrderFor(size);
+
+    auto found = order;
+    while (found <= mTopOrder && !mOrders[found].mFreeCount) {
+        found++;
+    }
+    if (found > mTopOrder)
+        return false;
+
+    auto node = FirstFree(found);
+    ClearFree(found, node);
+
+    // Split down, freeing the upper half each time.
+    while (found > order) {
+        found--;
+        node *= 2;
+        SetFree(found, node + 1);
+    }
+
+    mUsed += kMinSize << order;
+    *out_offset = node << (kMinShift + order);
+    return true;
+}
+
+void
+MirvBuddyAllocator::Free(const uint64_t offset, const uint64_t size)
+{
+    auto order = OrderFor(size);
+    auto node = offset >> (kMinShift + order);
+    ASSERT(!IsFree(order, node))
+    mUsed -= kMinSize << order;
+
+    // Merge with free buddies as far up as we can.
+    while (order < mTopOrder) {
+        const auto buddy = node ^ 1;
+        if (!IsFree(order, buddy))
+            break;
+        ClearFree(order, buddy);
+        node /= 2;
+        order++;
+    }
+    SetFree(order, node);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "mirv_alloc.h"
+
+// Binary buddy allocator over the offsets of one device memory block.
+// It only hands out offsets, and keeps its bookkeeping on the host, so it works the same
+// for memory we can't map.
+// Allocations round up to a power of two of at least kMinSize, and are aligned to that.
+// Each order keeps a bitmap of its free nodes, plus a summary bit per nonzero bitmap word,
+// so finding a free node scans at most a few words, and frees coalesce in O(orders).
+// Not thread-safe; MirvDevice guards each block with its memory type's mutex.
+class MirvBuddyAllocator final : public MirvAllocated
+{
+public:
+    static const uint32_t kMinShift = 8;
+    static const uint64_t kMinSize = uint64_t(1) << kMinShift;
+
+private:
+    struct Order final {
+        std::vector<uint64_t> mFree;    // Bit per node.
+        std::vector<uint64_t> mSummary; // Bit per nonzero mFree word.
+        uint32_t mFreeCount;
+    };
+
+    const uint32_t mTopOrder; // The whole block.
+    std::vector<Order> mOrders;
+    uint64_t mUsed;
+
+public:
+    // `size` must be a power of two, at least kMinSize.
+    explicit MirvBuddyAllocator(uint64_t size);
+
+    uint64_t Size() const { return kMinSize << mTopOrder; }
+    uint64_t Used() const { return mUsed; }
+
+    // False if there's no free range big enough.
+    bool Alloc(uint64_t size, uint64_t* out_offset);
+    // `size` must be what was passed to Alloc.
+    void Free(uint64_t offset, uint64_t size);
+
+private:
+    static uint32_t OrderFor(uint64_t size);
+
+    void SetFree(uint32_t order, uint64_t node);
+    void ClearFree(uint32_t order, uint64_t node);
+    bool IsFree(uint32_t order, uint64_t node) const;
+    uint64_t FirstFree(uint32_t order) const;
+};
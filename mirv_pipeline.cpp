@@ -0,0 +1,554 @@
+#include "mirv.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <string>
+
+namespace {
+
+struct HashOf128 final
+{
+    size_t operator()(const Hash128& x) const { return size_t(x.mLo); }
+};
+
+// Every live module's code, so modules with the same words share one parse of them.
+class SharedCodeTable final
+{
+    struct Entry final {
+        rp<const MirvShaderCode> mCode;
+        size_t mUsers;
+    };
+
+public:
+    std::mutex mMutex;
+    std::unordered_map<Hash128, Entry, HashOf128> mEntries;
+
+    static SharedCodeTable& Get() {
+        static SharedCodeTable sTable;
+        return sTable;
+    }
+};
+
+Hash128
+HashWords(const uint32_t* const words, const size_t wordCount)
+{
+    Hasher128 hasher;
+    hasher.Add(words, wordCount * 4);
+    return hasher.Finish();
+}
+
+bool
+SameWords(const MirvShaderCode& code, const uint32_t* const words, const size_t wordCount)
+{
+    return code.mWords.size() == wordCount &&
+           std::equal(code.mWords.begin(), code.mWords.end(), words);
+}
+
+} // namespace
+
+MirvShaderCode::MirvShaderCode(const uint32_t* const words, const size_t wordCount,
+                               const Hash128& hash)
+    : mWords(words, words + wordCount)
+    , mHash(hash)
+    , mModule(MirvParseSpirv(mWords.data(), mWords.size()))
+{ }
+
+rp<const MirvShaderCode>
+MirvShaderCode::Share(const uint32_t* const words, const size_t wordCount)
+{
+    const auto hash = HashWords(words, wordCount);
+    auto& table = SharedCodeTable::Get();
+    {
+        const mutex_guard guard(table.mMutex);
+        const auto itr = table.mEntries.find(hash);
+        if (itr != table.mEntries.end() && SameWords(*itr->second.mCode.get(), words, wordCount)) {
+            itr->second.mUsers += 1;
+            return itr->second.mCode;
+        }
+    }
+
+    // Parse without the lock, then take whichever copy got in first.
+    const rp<const MirvShaderCode> code = new MirvShaderCode(words, wordCount, hash);
+    const mutex_guard guard(table.mMutex);
+    auto& entry = table.mEntries[hash];
+    if (!entry.mCode) {
+        entry.mCode = code;
+    } else if (!SameWords(*entry.mCode.get(), words, wordCount)) {
+        return code; // A collision. Just don't share.
+    }
+    entry.mUsers += 1;
+    return entry.mCode;
+}
+
+void
+MirvShaderCode::Unshare(const MirvShaderCode* const code)
+{
+    auto& table = SharedCodeTable::Get();
+    const mutex_guard guard(table.mMutex);
+    const auto itr = table.mEntries.find(code->mHash);
+    if (itr == table.mEntries.end() || itr->second.mCode.get() != code)
+        return;
+    itr->second.mUsers -= 1;
+    if (!itr->second.mUsers) {
+        table.mEntries.erase(itr); // Pipelines still compiling it keep their own refs.
+    }
+}
+
+MirvShaderModule::MirvShaderModule(MirvDevice& device, const VkShaderModuleCreateInfo& info)
+    : MirvNonDispatchableObject(device)
+    , mCode(MirvShaderCode::Share(info.pCode, info.codeSize / 4))
+{ }
+
+MirvShaderModule::~MirvShaderModule()
+{
+    MirvShaderCode::Unshare(mCode.get());
+}
+
+// --
+
+namespace {
+
+// Saved caches are a VkPipelineCacheHeaderVersionOne, then back-to-back entries, each a
+// SavedEntry and its MirvSaveShaderProgram bytes. Nothing needs more than 4-byte
+// alignment, and nothing points anywhere, so a blob can be used wherever it lands.
+struct SavedHeader final
+{
+    uint32_t mHeaderSize;
+    uint32_t mHeaderVersion;
+    uint32_t mVendorId;
+    uint32_t mDeviceId;
+    uint8_t mUuid[VK_UUID_SIZE];
+};
+
+struct SavedEntry final
+{
+    Hash128 mKey;
+    uint32_t mSize;
+    uint32_t mChecksum; // Of the program, since disks and apps mangle things.
+};
+
+uint32_t
+Checksum(const uint8_t* const data, const size_t size)
+{
+    Hasher128 hasher;
+    hasher.Add(data, size);
+    return uint32_t(hasher.Finish().mLo);
+}
+
+SavedHeader
+HeaderFor(const MirvDevice& device)
+{
+    const auto& props = device.mPhysDev.mProperties;
+    SavedHeader ret;
+    ret.mHeaderSize = sizeof(SavedHeader);
+    ret.mHeaderVersion = VK_PIPELINE_CACHE_HEADER_VERSION_ONE;
+    ret.mVendorId = props.vendorID;
+    ret.mDeviceId = props.deviceID;
+    memcpy(ret.mUuid, props.pipelineCacheUUID, VK_UUID_SIZE);
+    return ret;
+}
+
+} // namespace
+
+MirvPipelineCache::MirvPipelineCache(MirvDevice& device, const VkPipelineCacheCreateInfo& info,
+                                     const VkAllocationCallbacks& allocator)
+    : MirvNonDispatchableObject(device)
+    , mAllocator(allocator)
+{
+    for (auto& x : mBuckets) {
+        x.store(nullptr, std::memory_order_relaxed);
+    }
+
+    const auto data = (const uint8_t*)info.pInitialData;
+    const auto size = info.initialDataSize;
+    const auto expected = HeaderFor(device);
+    if (size < sizeof(expected) || memcmp(data, &expected, sizeof(expected)) != 0)
+        return;
+
+    // Keep everything up to the first bad entry, or until we run out of memory.
+    for (size_t pos = sizeof(expected); size - pos >= sizeof(SavedEntry);) {
+        SavedEntry entry;
+        memcpy(&entry, data + pos, sizeof(entry));
+        pos += sizeof(entry);
+        if (entry.mSize > size - pos || Checksum(data + pos, entry.mSize) != entry.mChecksum)
+            return;
+
+        // Pipelines and other caches may keep it after we die, so like compiled shaders,
+        // it lives in the device's memory.
+        const rp<MirvCompiledShader> shader = new (mDevice.mAllocator,
+                                                   VK_SYSTEM_ALLOCATION_SCOPE_DEVICE)
+                                                  MirvCompiledShader;
+        if (!shader || !MirvLoadShaderProgram(data + pos, entry.mSize, &shader->mProgram))
+            return;
+        Insert(entry.mKey, shader.get());
+        pos += entry.mSize;
+    }
+}
+
+MirvPipelineCache::~MirvPipelineCache()
+{
+    mPendingInserts.WaitForZero();
+    for (auto& x : mBuckets) {
+        auto entry = x.load(std::memory_order_relaxed);
+        while (entry) {
+            const auto next = entry->mNext;
+            delete entry;
+            entry = next;
+        }
+    }
+}
+
+template<typename F>
+void
+MirvPipelineCache::ForEachEntry(const F& fn) const
+{
+    for (const auto& x : mBuckets) {
+        for (auto entry = x.load(std::memory_order_acquire); entry; entry = entry->mNext) {
+            fn(*entry);
+        }
+    }
+}
+
+rp<const MirvCompiledShader>
+MirvPipelineCache::Find(const Hash128& key) const
+{
+    const auto& bucket = mBuckets[key.mLo % kBucketCount];
+    for (auto entry = bucket.load(std::memory_order_acquire); entry; entry = entry->mNext) {
+        if (entry->mKey == key)
+            return entry->mShader;
+    }
+    return nullptr;
+}
+
+rp<const MirvCompiledShader>
+MirvPipelineCache::Insert(const Hash128& key, const MirvCompiledShader* const shader)
+{
+    auto& bucket = mBuckets[key.mLo % kBucketCount];
+    auto head = bucket.load(std::memory_order_acquire);
+    const Entry* searched = nullptr; // From here down, the chain has no `key`.
+    std::unique_ptr<Entry> entry;
+    while (true) {
+        for (auto itr = head; itr != searched; itr = itr->mNext) {
+            if (itr->mKey == key)
+                return itr->mShader;
+        }
+        searched = head;
+
+        if (!entry) {
+            entry.reset(new (mAllocator, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT) Entry(key, shader));
+            if (!entry)
+                return shader;
+        }
+        entry->mNext = head;
+        if (bucket.compare_exchange_weak(head, entry.get(), std::memory_order_release,
+                                         std::memory_order_acquire))
+        {
+            return entry.release()->mShader;
+        }
+    }
+}
+
+// Writes whole entries until one doesn't fit, which the spec allows.
+VkResult
+MirvPipelineCache::GetData(size_t* const inout_size, void* const out_data) const
+{
+    mPendingInserts.WaitForZero();
+    const auto header = HeaderFor(mDevice);
+    if (!out_data) {
+        auto size = sizeof(header);
+        ForEachEntry([&](const Entry& entry) {
+            size += sizeof(SavedEntry) + MirvSaveShaderProgram(entry.mShader->mProgram, nullptr);
+        });
+        *inout_size = size;
+        return VK_SUCCESS;
+    }
+
+    const auto out = (uint8_t*)out_data;
+    if (*inout_size < sizeof(header)) {
+        *inout_size = 0;
+        return VK_INCOMPLETE;
+    }
+    memcpy(out, &header, sizeof(header));
+    size_t pos = sizeof(header);
+    auto res = VK_SUCCESS;
+    ForEachEntry([&](const Entry& entry) {
+        const auto& program = entry.mShader->mProgram;
+        const auto size = MirvSaveShaderProgram(program, nullptr);
+        if (res != VK_SUCCESS || *inout_size - pos < sizeof(SavedEntry) + size) {
+            res = VK_INCOMPLETE;
+            return;
+        }
+        const auto payload = out + pos + sizeof(SavedEntry);
+        MirvSaveShaderProgram(program, payload);
+        const SavedEntry saved = { entry.mKey, uint32_t(size), Checksum(payload, size) };
+        memcpy(out + pos, &saved, sizeof(saved));
+        pos += sizeof(saved) + size;
+    });
+    *inout_size = pos;
+    return res;
+}
+
+void
+MirvPipelineCache::MergeFrom(const MirvPipelineCache& src)
+{
+    src.mPendingInserts.WaitForZero();
+    src.ForEachEntry([&](const Entry& entry) {
+        Insert(entry.mKey, entry.mShader.get());
+    });
+}
+
+// --
+
+MirvPipelineLayout::MirvPipelineLayout(MirvDevice& device,
+                                       const VkPipelineLayoutCreateInfo& info)
+    : MirvNonDispatchableObject(device)
+    , mPushConstantRanges(info.pPushConstantRanges,
+                          info.pPushConstantRanges + info.pushConstantRangeCount)
+{
+    for (const auto& handle : Range(info.pSetLayouts, info.setLayoutCount)) {
+        mSetLayouts.push_back(MirvDescriptorSetLayout::For(device, handle));
+    }
+}
+
+// --
+
+MirvPipeline::MirvPipeline(MirvDevice& device, const VkPipelineBindPoint bindPoint,
+                           MirvPipelineLayout* const layout)
+    : MirvNonDispatchableObject(device)
+    , mBindPoint(bindPoint)
+    , mLayout(layout)
+{ }
+
+// -------------------------------------
+
+namespace {
+
+bool
+AsyncPipelines()
+{
+    static const bool sAsync = []() {
+        const auto env = getenv("MIRV_ASYNC_PIPELINES");
+        return env && atoi(env) != 0;
+    }();
+    return sAsync;
+}
+
+// Everything that goes into compiling a stage goes into its cache key. Compute has no
+// other pipeline state that changes the program, and layouts only matter once bound.
+Hash128
+ShaderKey(const MirvShaderCode& code, const VkPipelineShaderStageCreateInfo& stage)
+{
+    Hasher128 hasher;
+    hasher.AddPod(code.mHash);
+    hasher.Add(stage.pName, strlen(stage.pName) + 1);
+    if (const auto& spec = stage.pSpecializationInfo) {
+        for (const auto& entry : Range(spec->pMapEntries, spec->mapEntryCount)) {
+            hasher.AddPod(entry.constantID);
+            hasher.Add((const uint8_t*)spec->pData + entry.offset, entry.size);
+        }
+    }
+    return hasher.Finish();
+}
+
+// One vkCreate*Pipelines call's cache misses. Each stage is copied, since the app may
+// free or destroy everything it passed us before background compiles get to it.
+class CompileJob final : public RefCounted
+{
+    struct Item final {
+        MirvPipeline* mPipeline; // Its destruction waits for us.
+        rp<const MirvShaderCode> mCode;
+        std::string mEntryPoint;
+        std::vector<VkSpecializationMapEntry> mSpecEntries;
+        std::vector<uint8_t> mSpecData;
+        bool mHasSpec;
+        MirvPipelineCache* mCache; // Its destruction waits for us too.
+        Hash128 mKey;
+    };
+
+    MirvDevice& mDevice;
+    std::vector<Item> mItems;
+    std::atomic<uint32_t> mNext;
+
+public:
+    explicit CompileJob(MirvDevice& device)
+        : mDevice(device)
+        , mNext(0)
+    { }
+
+    uint32_t Count() const { return uint32_t(mItems.size()); }
+
+    void Add(MirvPipeline* const pipeline, const MirvShaderCode& code,
+             const VkPipelineShaderStageCreateInfo& stage, MirvPipelineCache* const cache,
+             const Hash128& key)
+    {
+        mItems.emplace_back();
+        auto& item = mItems.back();
+        item.mPipeline = pipeline;
+        item.mCode = &code;
+        item.mEntryPoint = stage.pName;
+        const auto& spec = stage.pSpecializationInfo;
+        item.mHasSpec = bool(spec);
+        if (spec) {
+            item.mSpecEntries.assign(spec->pMapEntries, spec->pMapEntries + spec->mapEntryCount);
+            const auto data = (const uint8_t*)spec->pData;
+            item.mSpecData.assign(data, data + spec->dataSize);
+        }
+        item.mCache = cache;
+        item.mKey = key;
+        if (cache) {
+            cache->mPendingInserts.Add(1);
+        }
+        mDevice.mBackgroundCompiles.Add(1);
+    }
+
+    // Compiles items until there are none left to claim.
+    void Work() {
+        uint32_t i;
+        while ((i = mNext.fetch_add(1, std::memory_order_relaxed)) < mItems.size()) {
+            Compile(mItems[i]);
+        }
+    }
+
+private:
+    void Compile(Item& item) {
+        VkSpecializationInfo spec = {
+            uint32_t(item.mSpecEntries.size()), item.mSpecEntries.data(),
+            item.mSpecData.size(), item.mSpecData.data()
+        };
+        // Shared by pipelines and caches alike, so it lives in the device's memory.
+        const rp<MirvCompiledShader> compiled = new (mDevice.mAllocator,
+                                                     VK_SYSTEM_ALLOCATION_SCOPE_DEVICE)
+                                                    MirvCompiledShader;
+        auto res = VK_ERROR_OUT_OF_HOST_MEMORY;
+        if (compiled) {
+            res = MirvCompileSpirv(*item.mCode->mModule, item.mEntryPoint.c_str(),
+                                   item.mHasSpec ? &spec : nullptr, &compiled->mProgram);
+        }
+        rp<const MirvCompiledShader> shader;
+        if (res == VK_SUCCESS) {
+            shader = compiled;
+            if (item.mCache) {
+                shader = item.mCache->Insert(item.mKey, compiled.get());
+            }
+        }
+        if (item.mCache) {
+            item.mCache->mPendingInserts.Done();
+        }
+        item.mPipeline->SetShader(std::move(shader));
+        mDevice.mBackgroundCompiles.Done();
+    }
+};
+
+// Compiles for every device in the process, since compiling only needs SPIR-V.
+// vkCreate*Pipelines callers help with their own batches, so there's one thread fewer
+// than there are cores, but always at least one for MIRV_ASYNC_PIPELINES.
+class CompilerPool final
+{
+    std::mutex mMutex;
+    std::condition_variable mCond;
+    // A job shows up once per thread it wants.
+    std::deque<rp<CompileJob>> mQueue;
+    bool mExiting;
+    std::vector<std::thread> mThreads;
+
+    CompilerPool()
+        : mExiting(false)
+    {
+        const auto count = std::max(2u, std::thread::hardware_concurrency()) - 1;
+        for (uint32_t i = 0; i < count; i++) {
+            mThreads.push_back(std::thread(&CompilerPool::ThreadMain, this));
+        }
+    }
+
+public:
+    static CompilerPool& Get() {
+        static CompilerPool sPool;
+        return sPool;
+    }
+
+    ~CompilerPool() {
+        {
+            const mutex_guard guard(mMutex);
+            mExiting = true;
+        }
+        mCond.notify_all();
+        for (auto& x : mThreads) {
+            x.join();
+        }
+    }
+
+    void Post(CompileJob* const job, const uint32_t threads) {
+        const auto count = std::min(threads, uint32_t(mThreads.size()));
+        if (!count)
+            return;
+        {
+            const mutex_guard guard(mMutex);
+            mQueue.insert(mQueue.end(), count, rp<CompileJob>(job));
+        }
+        mCond.notify_all();
+    }
+
+private:
+    void ThreadMain() {
+        while (true) {
+            rp<CompileJob> job;
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                mCond.wait(lock, [&]() { return mExiting || !mQueue.empty(); });
+                if (mQueue.empty())
+                    return;
+                job = std::move(mQueue.front());
+                mQueue.pop_front();
+            }
+            job->Work();
+        }
+    }
+};
+
+} // namespace
+
+bool
+MirvDevice::CompileComputePipelines(MirvPipelineCache* const cache, const uint32_t count,
+                                    const VkComputePipelineCreateInfo* const infos,
+                                    MirvPipeline* const* const pipelines)
+{
+    const rp<CompileJob> job = new CompileJob(*this);
+    for (uint32_t i = 0; i < count; i++) {
+        const auto& pipeline = pipelines[i];
+        if (!pipeline)
+            continue;
+        const auto& stage = infos[i].stage;
+        const auto& code = *MirvShaderModule::For(*this, stage.module)->mCode.get();
+        if (!code.mModule || !code.mModule->FindEntryPoint(stage.pName)) {
+            pipeline->SetShader(nullptr); // Nothing to compile.
+            continue;
+        }
+        Hash128 key = {};
+        if (cache) {
+            key = ShaderKey(code, stage);
+            if (auto shader = cache->Find(key)) {
+                pipeline->SetShader(std::move(shader));
+                continue;
+            }
+        }
+        job->Add(pipeline, code, stage, cache, key);
+    }
+    if (!job->Count())
+        return true;
+
+    auto& pool = CompilerPool::Get();
+    if (AsyncPipelines()) {
+        pool.Post(job.get(), job->Count());
+        return false;
+    }
+    pool.Post(job.get(), job->Count() - 1);
+    job->Work();
+    for (uint32_t i = 0; i < count; i++) {
+        if (pipelines[i]) {
+            (void)pipelines[i]->Shader(); // Helpers may still be on their last ones.
+        }
+    }
+    return true;
+}
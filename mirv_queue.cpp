@@ -0,0 +1,209 @@
+#include "mirv.h"
+
+#include <new>
+
+// One allocation per vkQueueSubmit: This header, then mOpCount Ops, which the queue
+// thread runs in order.
+struct MirvQueue::Submission final : public MirvMpscNode
+{
+    enum class OpKind : uint32_t {
+        Wait,
+        Execute,
+        Signal,
+    };
+
+    struct Op final {
+        OpKind mKind;
+        void* mObject;
+    };
+
+    // Semaphores and the fence are held by ref until we're done with them, so the app
+    // can destroy them as soon as it's seen them signaled.
+    MirvFence* mFence;
+    size_t mOpCount;
+
+    Op* Ops() { return (Op*)(this + 1); }
+};
+
+// --
+
+MirvQueue::MirvQueue(MirvDevice& device, const VkQueueFamilyProperties& family)
+    : MirvDispatchableObject(MirvObjectType::Queue)
+    , mDevice(device)
+    , mFamily(family)
+    , mSubmitCount(0)
+    , mDoneCount(0)
+    , mIdleWaiters(0)
+    , mSleeping(0)
+    , mExiting(false)
+{ }
+
+MirvQueue::~MirvQueue()
+{
+    ASSERT(!mThread.joinable()) // Backends must Stop.
+}
+
+void
+MirvQueue::Start()
+{
+    mThread = std::thread(&MirvQueue::ThreadMain, this);
+}
+
+void
+MirvQueue::Stop()
+{
+    mExiting.store(true, std::memory_order_seq_cst);
+    // No one can be waiting for idle by now, so this needn't pair with a Run.
+    mSubmitCount.fetch_add(1, std::memory_order_seq_cst);
+    MirvFutexWakeAll(mSubmitCount);
+    mThread.join();
+}
+
+VkResult
+MirvQueue::vkQueueSubmit(const uint32_t count, const VkSubmitInfo* const submits,
+                         const VkFence fenceHandle)
+{
+    typedef Submission::OpKind OpKind;
+
+    size_t opCount = 0;
+    for (const auto& x : Range(submits, count)) {
+        ASSERT(!x.pNext)
+        opCount += x.waitSemaphoreCount + x.commandBufferCount + x.signalSemaphoreCount;
+    }
+    MirvFence* fence = nullptr;
+    if (fenceHandle) {
+        fence = MirvFence::For(mDevice, fenceHandle);
+        ASSERT(!fence->mSignaled.IsSet())
+    }
+    if (!opCount && !fence)
+        return VK_SUCCESS;
+
+    const auto& allocator = mDevice.mAllocator;
+    const auto bytes = sizeof(Submission) + opCount * sizeof(Submission::Op);
+    const auto mem = allocator.pfnAllocation(allocator.pUserData, bytes,
+                                             alignof(Submission),
+                                             VK_SYSTEM_ALLOCATION_SCOPE_DEVICE);
+    if (!mem)
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+
+    const auto sub = new (mem) Submission;
+    sub->mFence = fence;
+    sub->mOpCount = opCount;
+    if (fence) {
+        fence->AddRef();
+    }
+
+    auto op = sub->Ops();
+    for (const auto& x : Range(submits, count)) {
+        for (const auto& handle : Range(x.pWaitSemaphores, x.waitSemaphoreCount)) {
+            const auto& sem = MirvSemaphore::For(mDevice, handle);
+            sem->AddRef();
+            *op++ = { OpKind::Wait, sem };
+        }
+        for (const auto& handle : Range(x.pCommandBuffers, x.commandBufferCount)) {
+            const auto& cb = MirvCommandBuffer::For(handle);
+            ASSERT(cb->mState == MirvCommandBuffer::State::Executable)
+            *op++ = { OpKind::Execute, cb };
+        }
+        for (const auto& handle : Range(x.pSignalSemaphores, x.signalSemaphoreCount)) {
+            const auto& sem = MirvSemaphore::For(mDevice, handle);
+            sem->AddRef();
+            *op++ = { OpKind::Signal, sem };
+        }
+    }
+
+    mPending.Push(sub);
+    // Pairs with ThreadMain's mSleeping store: Either it sees our bump, or we see it's
+    // asleep.
+    mSubmitCount.fetch_add(1, std::memory_order_seq_cst);
+    if (mSleeping.load(std::memory_order_seq_cst)) {
+        MirvFutexWakeAll(mSubmitCount);
+    }
+    return VK_SUCCESS;
+}
+
+VkResult
+MirvQueue::vkQueueWaitIdle()
+{
+    const auto target = mSubmitCount.load(std::memory_order_acquire);
+    while (true) {
+        const auto done = mDoneCount.load(std::memory_order_acquire);
+        if (int32_t(done - target) >= 0)
+            return VK_SUCCESS;
+
+        mIdleWaiters.fetch_add(1, std::memory_order_seq_cst);
+        (void)MirvFutexWait(mDoneCount, done, kMirvInfiniteTimeout);
+        mIdleWaiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+void
+MirvQueue::ThreadMain()
+{
+    while (true) {
+        const auto seq = mSubmitCount.load(std::memory_order_acquire);
+        // Null either when we're empty, or a push is mid-flight, in which case its
+        // mSubmitCount bump will keep us awake.
+        while (const auto node = mPending.Pop()) {
+            Run(static_cast<Submission*>(node));
+        }
+        if (mExiting.load(std::memory_order_acquire))
+            return;
+
+        mSleeping.store(1, std::memory_order_seq_cst);
+        (void)MirvFutexWait(mSubmitCount, seq, kMirvInfiniteTimeout);
+        mSleeping.store(0, std::memory_order_relaxed);
+    }
+}
+
+void
+MirvQueue::Run(Submission* const sub)
+{
+    typedef Submission::OpKind OpKind;
+
+    for (const auto& op : Range(sub->Ops(), sub->mOpCount)) {
+        switch (op.mKind) {
+        case OpKind::Wait: {
+            const auto& sem = (MirvSemaphore*)op.mObject;
+            sem->mSignaled.WaitUntil(kMirvInfiniteTimeout);
+            sem->mSignaled.Reset();
+            sem->Release();
+            break;
+        }
+        case OpKind::Execute:
+            Execute(*(const MirvCommandBuffer*)op.mObject);
+            break;
+        case OpKind::Signal: {
+            const auto& sem = (MirvSemaphore*)op.mObject;
+            sem->mSignaled.Set();
+            sem->Release();
+            break;
+        }
+        }
+    }
+    if (sub->mFence) {
+        mDevice.SignalFence(sub->mFence);
+        sub->mFence->Release();
+    }
+
+    sub->~Submission();
+    const auto& allocator = mDevice.mAllocator;
+    allocator.pfnFree(allocator.pUserData, sub);
+
+    mDoneCount.fetch_add(1, std::memory_order_seq_cst);
+    if (mIdleWaiters.load(std::memory_order_seq_cst)) {
+        MirvFutexWakeAll(mDoneCount);
+    }
+}
+
+// -------------------------------------
+
+MirvFence::MirvFence(MirvDevice& device, const VkFenceCreateInfo& info)
+    : MirvNonDispatchableObject(device)
+    , mSignaled(info.flags & VK_FENCE_CREATE_SIGNALED_BIT)
+{ }
+
+MirvSemaphore::MirvSemaphore(MirvDevice& device)
+    : MirvNonDispatchableObject(device)
+    , mSignaled(false)
+{ }
@@ -0,0 +1,670 @@
+#include "mirv_shader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cmath>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+
+// Per thread, and reused by every dispatch that thread runs.
+struct Scratch final
+{
+    std::vector<MirvLane> mRegs;
+    std::vector<MirvLane> mLocal;
+    std::vector<uint64_t> mShared;
+};
+
+thread_local Scratch tScratch;
+
+inline uint32_t
+Bits(const float f)
+{
+    MirvLane ret;
+    ret.f = f;
+    return ret.u;
+}
+
+inline uint32_t
+Mask(const bool b)
+{
+    return b ? ~0u : 0u;
+}
+
+// dst = fn(lane), in every lane, or only exec lanes if `masked`.
+template<typename F>
+inline void
+Write(MirvLane* const dst, const MirvLane* const exec, const uint32_t lanes,
+      const bool masked, const F& fn)
+{
+    if (masked) {
+        for (uint32_t l = 0; l < lanes; l += kMirvLaneStep) {
+            for (uint32_t k = l; k < l + kMirvLaneStep; k++) {
+                const auto m = exec[k].u;
+                dst[k].u = (fn(k) & m) | (dst[k].u & ~m);
+            }
+        }
+        return;
+    }
+    for (uint32_t l = 0; l < lanes; l += kMirvLaneStep) {
+        for (uint32_t k = l; k < l + kMirvLaneStep; k++) {
+            dst[k].u = fn(k);
+        }
+    }
+}
+
+inline uint32_t
+PopCount(const uint32_t x)
+{
+#ifdef _MSC_VER
+    return __popcnt(x);
+#else
+    return uint32_t(__builtin_popcount(x));
+#endif
+}
+
+// Out-of-range conversions are undefined in SPIR-V, but mustn't be in C++.
+inline uint32_t
+FloatToU32(const float f)
+{
+    if (!(f > 0.0f))
+        return 0;
+    if (f >= 4294967296.0f)
+        return UINT32_MAX;
+    return uint32_t(f);
+}
+
+inline uint32_t
+FloatToS32(const float f)
+{
+    if (f != f)
+        return 0;
+    if (f >= 2147483648.0f)
+        return uint32_t(INT32_MAX);
+    if (f <= -2147483648.0f)
+        return uint32_t(INT32_MIN);
+    return uint32_t(int32_t(f));
+}
+
+inline uint32_t
+PackUnorm8(const float f)
+{
+    const auto clamped = std::min(std::max(f, 0.0f), 1.0f);
+    return uint32_t(std::nearbyint(clamped * 255.0f));
+}
+
+inline uint32_t
+AtomicOp(uint8_t* const p, const MirvShaderAtomic kind, const uint32_t operand,
+         const uint32_t comparator)
+{
+    // Buffers are plain memory, but std::atomic<uint32_t> is just a uint32_t.
+    auto& word = *(std::atomic<uint32_t>*)p;
+    auto cur = word.load(std::memory_order_relaxed);
+    while (true) {
+        uint32_t next;
+        switch (kind) {
+        case MirvShaderAtomic::Exchange:        next = operand; break;
+        case MirvShaderAtomic::CompareExchange:
+            if (cur != comparator)
+                return cur;
+            next = operand;
+            break;
+        case MirvShaderAtomic::Add:  next = cur + operand; break;
+        case MirvShaderAtomic::Sub:  next = cur - operand; break;
+        case MirvShaderAtomic::SMin: next = uint32_t(std::min(int32_t(cur), int32_t(operand))); break;
+        case MirvShaderAtomic::UMin: next = std::min(cur, operand); break;
+        case MirvShaderAtomic::SMax: next = uint32_t(std::max(int32_t(cur), int32_t(operand))); break;
+        case MirvShaderAtomic::UMax: next = std::max(cur, operand); break;
+        case MirvShaderAtomic::And:  next = cur & operand; break;
+        case MirvShaderAtomic::Or:   next = cur | operand; break;
+        case MirvShaderAtomic::Xor:  next = cur ^ operand; break;
+        default:
+            return cur;
+        }
+        if (word.compare_exchange_weak(cur, next, std::memory_order_seq_cst,
+                                       std::memory_order_relaxed))
+        {
+            return cur;
+        }
+    }
+}
+
+// What MirvSaveShaderProgram writes ahead of the program's arrays, which follow in
+// declaration order.
+struct SavedProgram final
+{
+    uint32_t mLocalSize[3];
+    uint32_t mBatchLanes;
+    uint32_t mRegCount;
+    uint32_t mLocalWords;
+    uint32_t mSharedBytes;
+    uint32_t mEntryMask;
+    uint32_t mBuiltins[size_t(MirvShaderBuiltin::Count)];
+    uint32_t mConstantCount;
+    uint32_t mMaskCount;
+    uint32_t mBindingCount;
+    uint32_t mOpCount;
+};
+
+template<typename T>
+uint8_t*
+SaveArray(const std::vector<T>& src, uint8_t* const out)
+{
+    if (!src.empty()) { // Empty vectors' data() may be null, which memcpy can't take.
+        memcpy(out, src.data(), src.size() * sizeof(T));
+    }
+    return out + src.size() * sizeof(T);
+}
+
+template<typename T>
+const uint8_t*
+LoadArray(const uint8_t* const data, const uint32_t count, std::vector<T>* const out)
+{
+    out->resize(count);
+    if (count) {
+        memcpy(out->data(), data, count * sizeof(T));
+    }
+    return data + count * sizeof(T);
+}
+
+// Whether running `p` stays inside the memory the runner gives it, for programs we didn't
+// compile ourselves. Buffer offsets are the app's to get right, as with any shader.
+bool
+CheckProgram(const MirvShaderProgram& p)
+{
+    typedef MirvShaderOpcode Op;
+
+    const auto regs = p.mRegCount;
+    const auto IsReg = [&](const uint32_t reg) { return reg < regs; };
+    const auto AreRegs = [&](const uint32_t first, const uint32_t count) {
+        return first < regs && count <= regs - first;
+    };
+
+    const auto invocations = uint64_t(p.mLocalSize[0]) * p.mLocalSize[1] * p.mLocalSize[2];
+    if (!invocations || invocations > UINT32_MAX)
+        return false;
+    if (!IsReg(p.mEntryMask))
+        return false;
+    for (uint32_t i = 0; i < uint32_t(MirvShaderBuiltin::Count); i++) {
+        const auto width = (MirvShaderBuiltin(i) == MirvShaderBuiltin::LocalInvocationIndex ?
+                            1 : 3);
+        if (p.mBuiltins[i] && !AreRegs(p.mBuiltins[i], width))
+            return false;
+    }
+    for (const auto& x : p.mConstants) {
+        if (!IsReg(x.mReg))
+            return false;
+    }
+    for (const auto& x : p.mMasks) {
+        if (!IsReg(x))
+            return false;
+    }
+
+    const auto opCount = uint32_t(p.mOps.size());
+    const auto slotCount = kMirvSlotFirstBinding + uint32_t(p.mBindings.size());
+    if (p.mOps.back().mCode != Op::End)
+        return false;
+    for (const auto& op : p.mOps) {
+        if (op.mCode > Op::Atomic)
+            return false;
+        // Unused operands are 0, which is a register too.
+        bool ok = IsReg(op.mDst) && IsReg(op.mA) && IsReg(op.mC) && IsReg(op.mD);
+        switch (op.mCode) {
+        case Op::Block:
+        case Op::LoopBack:
+            ok &= (op.mB < opCount);
+            break;
+        case Op::UnpackUnorm4x8:
+            ok &= AreRegs(op.mDst, 4) && IsReg(op.mB);
+            break;
+        case Op::Load:
+        case Op::Store:
+        case Op::Atomic:
+            ok = IsReg(op.mDst) && op.mA < slotCount && IsReg(op.mC) && IsReg(op.mD);
+            if (op.mA < kMirvSlotFirstBinding && !op.mC) {
+                const auto size = (op.mA == kMirvSlotShared ? p.mSharedBytes
+                                                            : kMirvPushConstantsSize);
+                ok &= (size >= 4 && op.mB <= size - 4);
+            }
+            if (op.mCode == Op::Atomic) {
+                const auto kind = MirvShaderAtomic(op.mFlags >> kMirvOpAtomicShift);
+                ok &= (kind <= MirvShaderAtomic::Xor);
+            }
+            break;
+        case Op::LoadLocal:
+        case Op::StoreLocal:
+            ok &= (op.mB < p.mLocalWords);
+            break;
+        default:
+            ok &= IsReg(op.mB);
+            break;
+        }
+        if (!ok)
+            return false;
+    }
+    return true;
+}
+
+} // namespace
+
+// -------------------------------------
+
+size_t
+MirvSaveShaderProgram(const MirvShaderProgram& p, uint8_t* const out)
+{
+    static_assert(sizeof(MirvShaderOp) % 4 == 0, "Saved programs are word-aligned.");
+    const auto size = sizeof(SavedProgram) +
+                      p.mConstants.size() * sizeof(MirvShaderConstant) +
+                      p.mMasks.size() * sizeof(uint32_t) +
+                      p.mBindings.size() * sizeof(MirvShaderBinding) +
+                      p.mOps.size() * sizeof(MirvShaderOp);
+    if (!out)
+        return size;
+
+    SavedProgram saved;
+    std::copy_n(p.mLocalSize, 3, saved.mLocalSize);
+    saved.mBatchLanes = p.mBatchLanes;
+    saved.mRegCount = p.mRegCount;
+    saved.mLocalWords = p.mLocalWords;
+    saved.mSharedBytes = p.mSharedBytes;
+    saved.mEntryMask = p.mEntryMask;
+    std::copy_n(p.mBuiltins, size_t(MirvShaderBuiltin::Count), saved.mBuiltins);
+    saved.mConstantCount = uint32_t(p.mConstants.size());
+    saved.mMaskCount = uint32_t(p.mMasks.size());
+    saved.mBindingCount = uint32_t(p.mBindings.size());
+    saved.mOpCount = uint32_t(p.mOps.size());
+    memcpy(out, &saved, sizeof(saved));
+
+    auto itr = out + sizeof(saved);
+    itr = SaveArray(p.mConstants, itr);
+    itr = SaveArray(p.mMasks, itr);
+    itr = SaveArray(p.mBindings, itr);
+    itr = SaveArray(p.mOps, itr);
+    ASSERT(itr == out + size)
+    return size;
+}
+
+bool
+MirvLoadShaderProgram(const uint8_t* const data, const size_t size,
+                      MirvShaderProgram* const out)
+{
+    SavedProgram saved;
+    if (size < sizeof(saved))
+        return false;
+    memcpy(&saved, data, sizeof(saved));
+    const auto expected = sizeof(saved) +
+                          uint64_t(saved.mConstantCount) * sizeof(MirvShaderConstant) +
+                          uint64_t(saved.mMaskCount) * sizeof(uint32_t) +
+                          uint64_t(saved.mBindingCount) * sizeof(MirvShaderBinding) +
+                          uint64_t(saved.mOpCount) * sizeof(MirvShaderOp);
+    if (size != expected)
+        return false;
+    // Enough to keep the runner's scratch sizing sane. CheckProgram does the rest.
+    if (!saved.mBatchLanes || saved.mBatchLanes % kMirvLaneStep ||
+        saved.mBatchLanes > kMirvMaxBatchLanes || !saved.mRegCount || !saved.mLocalWords ||
+        !saved.mOpCount)
+    {
+        return false;
+    }
+
+    std::copy_n(saved.mLocalSize, 3, out->mLocalSize);
+    out->mBatchLanes = saved.mBatchLanes;
+    out->mRegCount = saved.mRegCount;
+    out->mLocalWords = saved.mLocalWords;
+    out->mSharedBytes = saved.mSharedBytes;
+    out->mEntryMask = saved.mEntryMask;
+    std::copy_n(saved.mBuiltins, size_t(MirvShaderBuiltin::Count), out->mBuiltins);
+
+    auto itr = data + sizeof(saved);
+    itr = LoadArray(itr, saved.mConstantCount, &out->mConstants);
+    itr = LoadArray(itr, saved.mMaskCount, &out->mMasks);
+    itr = LoadArray(itr, saved.mBindingCount, &out->mBindings);
+    itr = LoadArray(itr, saved.mOpCount, &out->mOps);
+    // Checksums only catch accidents, so this may be anything.
+    return CheckProgram(*out);
+}
+
+// -------------------------------------
+
+MirvShaderRunner::MirvShaderRunner(const MirvShaderProgram& program,
+                                   uint8_t* const* const slots,
+                                   const uint32_t (&groupCount)[3])
+    : mProgram(program)
+    , mSlots(slots)
+    , mGroupCount{ groupCount[0], groupCount[1], groupCount[2] }
+    , mLanes(program.mBatchLanes)
+{
+    auto& scratch = tScratch;
+    const auto regLanes = size_t(program.mRegCount) * mLanes;
+    if (scratch.mRegs.size() < regLanes) {
+        scratch.mRegs.resize(regLanes);
+    }
+    const auto localLanes = size_t(program.mLocalWords) * mLanes;
+    if (scratch.mLocal.size() < localLanes) {
+        scratch.mLocal.resize(localLanes);
+    }
+    const auto sharedWords = (size_t(program.mSharedBytes) + 7) / 8;
+    if (scratch.mShared.size() < sharedWords) {
+        scratch.mShared.resize(sharedWords);
+    }
+    mRegs = scratch.mRegs.data();
+    mLocal = scratch.mLocal.data();
+    mShared = (uint8_t*)scratch.mShared.data();
+
+    // Scratch may hold anything from the last program this thread ran.
+    for (const auto& x : program.mConstants) {
+        std::fill_n(Reg(x.mReg), mLanes, MirvLane{ x.mBits });
+    }
+    for (const auto& x : program.mMasks) {
+        std::fill_n(Reg(x), mLanes, MirvLane{ 0 });
+    }
+    if (const auto reg = program.mBuiltins[size_t(MirvShaderBuiltin::NumWorkgroups)]) {
+        for (uint32_t i = 0; i < 3; i++) {
+            std::fill_n(Reg(reg + i), mLanes, MirvLane{ mGroupCount[i] });
+        }
+    }
+}
+
+void
+MirvShaderRunner::RunGroup(const uint32_t x, const uint32_t y, const uint32_t z)
+{
+    const auto& p = mProgram;
+    const auto& size = p.mLocalSize;
+    const auto invocations = size[0] * size[1] * size[2];
+    const uint32_t group[3] = { x, y, z };
+
+    const auto groupReg = p.mBuiltins[size_t(MirvShaderBuiltin::WorkgroupId)];
+    if (groupReg) {
+        for (uint32_t i = 0; i < 3; i++) {
+            std::fill_n(Reg(groupReg + i), mLanes, MirvLane{ group[i] });
+        }
+    }
+
+    const auto indexReg = p.mBuiltins[size_t(MirvShaderBuiltin::LocalInvocationIndex)];
+    const auto localReg = p.mBuiltins[size_t(MirvShaderBuiltin::LocalInvocationId)];
+    const auto globalReg = p.mBuiltins[size_t(MirvShaderBuiltin::GlobalInvocationId)];
+    const auto entry = Reg(p.mEntryMask);
+
+    for (uint32_t first = 0; first < invocations; first += mLanes) {
+        for (uint32_t l = 0; l < mLanes; l++) {
+            const auto index = first + l;
+            entry[l].u = Mask(index < invocations);
+            if (indexReg) {
+                Reg(indexReg)[l].u = index;
+            }
+            if (localReg || globalReg) {
+                const uint32_t local[3] = { index % size[0],
+                                            index / size[0] % size[1],
+                                            index / (size[0] * size[1]) };
+                for (uint32_t i = 0; i < 3; i++) {
+                    if (localReg) {
+                        Reg(localReg + i)[l].u = local[i];
+                    }
+                    if (globalReg) {
+                        Reg(globalReg + i)[l].u = group[i] * size[i] + local[i];
+                    }
+                }
+            }
+        }
+        RunBatch();
+    }
+}
+
+void
+MirvShaderRunner::RunBatch()
+{
+    typedef MirvShaderOpcode Op;
+
+    const auto lanes = mLanes;
+    const auto exec = Reg(0);
+    const auto ops = mProgram.mOps.data();
+    const auto localWords = mProgram.mLocalWords;
+
+    // Only exec lanes touch memory, so other lanes' offsets may be garbage.
+    const auto Address = [&](const MirvShaderOp& op, const MirvLane* const offsets,
+                             const uint32_t l) -> uint8_t* {
+        auto ret = Slot(op.mA) + op.mB;
+        if (offsets) {
+            ret += offsets[l].u;
+        }
+        return ret;
+    };
+    const auto LocalWord = [&](const MirvShaderOp& op, const MirvLane* const offsets,
+                               const uint32_t l) -> MirvLane& {
+        auto word = op.mB;
+        if (offsets) {
+            word += offsets[l].u / 4;
+        }
+        // Out of bounds is undefined, but mustn't be our memory corruption.
+        word = std::min(word, localWords - 1);
+        return mLocal[size_t(word) * lanes + l];
+    };
+
+    uint32_t pc = 0;
+    while (true) {
+        const auto& op = ops[pc++];
+        const bool masked = (op.mFlags & kMirvOpMasked);
+        const auto d = Reg(op.mDst);
+        const auto a = Reg(op.mA);
+        const auto b = Reg(op.mB);
+        const auto c = Reg(op.mC);
+
+#define OP(Name, Expr) \
+        case Op::Name: \
+            Write(d, exec, lanes, masked, [&](const uint32_t l) -> uint32_t { return (Expr); }); \
+            break;
+#define FOP(Name, Expr) OP(Name, Bits(Expr))
+
+        switch (op.mCode) {
+        case Op::End:
+            return;
+
+        case Op::Block: {
+            uint32_t any = 0;
+            for (uint32_t l = 0; l < lanes; l++) {
+                exec[l].u = a[l].u;
+                any |= a[l].u;
+                a[l].u = 0;
+            }
+            if (!any) {
+                pc = op.mB;
+            }
+            break;
+        }
+        case Op::Branch:
+            for (uint32_t l = 0; l < lanes; l++) {
+                d[l].u |= a[l].u;
+            }
+            break;
+        case Op::BranchCond:
+            for (uint32_t l = 0; l < lanes; l++) {
+                d[l].u |= exec[l].u & a[l].u;
+                b[l].u |= exec[l].u & ~a[l].u;
+            }
+            break;
+        case Op::LoopBack: {
+            uint32_t any = 0;
+            for (uint32_t l = 0; l < lanes; l++) {
+                any |= a[l].u;
+            }
+            if (any) {
+                pc = op.mB;
+            }
+            break;
+        }
+
+        OP(Mov, a[l].u)
+        OP(MovIf, (a[l].u & c[l].u) | (d[l].u & ~c[l].u))
+        OP(Select, (b[l].u & a[l].u) | (c[l].u & ~a[l].u))
+
+        OP(IAdd, a[l].u + b[l].u)
+        OP(ISub, a[l].u - b[l].u)
+        OP(IMul, a[l].u * b[l].u)
+        OP(UDiv, b[l].u ? a[l].u / b[l].u : 0u)
+        OP(SDiv, (!b[l].i || b[l].i == -1) ? (b[l].i ? 0u - a[l].u : 0u)
+                                            : uint32_t(a[l].i / b[l].i))
+        OP(UMod, b[l].u ? a[l].u % b[l].u : 0u)
+        OP(SRem, (!b[l].i || b[l].i == -1) ? 0u : uint32_t(a[l].i % b[l].i))
+        OP(SMod, (!b[l].i || b[l].i == -1) ? 0u
+                 : uint32_t(a[l].i % b[l].i + (((a[l].i % b[l].i) && ((a[l].i % b[l].i) ^ b[l].i) < 0) ? b[l].i : 0)))
+        OP(INeg, 0u - a[l].u)
+        OP(Shl, a[l].u << (b[l].u & 31))
+        OP(ShrL, a[l].u >> (b[l].u & 31))
+        OP(ShrA, uint32_t(a[l].i >> (b[l].u & 31)))
+        OP(And, a[l].u & b[l].u)
+        OP(Or, a[l].u | b[l].u)
+        OP(Xor, a[l].u ^ b[l].u)
+        OP(Not, ~a[l].u)
+        OP(AndNot, a[l].u & ~b[l].u)
+        OP(BitCount, PopCount(a[l].u))
+        OP(IEq, Mask(a[l].u == b[l].u))
+        OP(INe, Mask(a[l].u != b[l].u))
+        OP(ULt, Mask(a[l].u < b[l].u))
+        OP(ULe, Mask(a[l].u <= b[l].u))
+        OP(SLt, Mask(a[l].i < b[l].i))
+        OP(SLe, Mask(a[l].i <= b[l].i))
+        OP(UMin, std::min(a[l].u, b[l].u))
+        OP(UMax, std::max(a[l].u, b[l].u))
+        OP(SMin, uint32_t(std::min(a[l].i, b[l].i)))
+        OP(SMax, uint32_t(std::max(a[l].i, b[l].i)))
+        OP(SAbs, a[l].i < 0 ? 0u - a[l].u : a[l].u)
+        OP(SSign, a[l].i > 0 ? 1u : a[l].i < 0 ? ~0u : 0u)
+
+        FOP(FAdd, a[l].f + b[l].f)
+        FOP(FSub, a[l].f - b[l].f)
+        FOP(FMul, a[l].f * b[l].f)
+        FOP(FDiv, a[l].f / b[l].f)
+        FOP(FRem, std::fmod(a[l].f, b[l].f))
+        FOP(FMod, a[l].f - b[l].f * std::floor(a[l].f / b[l].f))
+        OP(FNeg, a[l].u ^ 0x80000000u)
+        FOP(Fma, a[l].f * b[l].f + c[l].f)
+        OP(FOrdEq, Mask(a[l].f == b[l].f))
+        OP(FOrdNe, Mask(a[l].f < b[l].f || a[l].f > b[l].f))
+        OP(FOrdLt, Mask(a[l].f < b[l].f))
+        OP(FOrdLe, Mask(a[l].f <= b[l].f))
+        OP(FUnordEq, Mask(!(a[l].f < b[l].f || a[l].f > b[l].f)))
+        OP(FUnordNe, Mask(!(a[l].f == b[l].f)))
+        OP(FUnordLt, Mask(!(a[l].f >= b[l].f)))
+        OP(FUnordLe, Mask(!(a[l].f > b[l].f)))
+        OP(IsNan, Mask(a[l].f != a[l].f))
+        OP(IsInf, Mask((a[l].u & 0x7fffffffu) == 0x7f800000u))
+        FOP(FMin, b[l].f < a[l].f ? b[l].f : a[l].f)
+        FOP(FMax, a[l].f < b[l].f ? b[l].f : a[l].f)
+        OP(FAbs, a[l].u & 0x7fffffffu)
+        FOP(FSign, a[l].f > 0.0f ? 1.0f : a[l].f < 0.0f ? -1.0f : 0.0f)
+        FOP(Floor, std::floor(a[l].f))
+        FOP(Ceil, std::ceil(a[l].f))
+        FOP(Fract, a[l].f - std::floor(a[l].f))
+        FOP(Round, std::round(a[l].f))
+        FOP(RoundEven, std::nearbyint(a[l].f))
+        FOP(Trunc, std::trunc(a[l].f))
+        FOP(Sqrt, std::sqrt(a[l].f))
+        FOP(InvSqrt, 1.0f / std::sqrt(a[l].f))
+        FOP(Sin, std::sin(a[l].f))
+        FOP(Cos, std::cos(a[l].f))
+        FOP(Tan, std::tan(a[l].f))
+        FOP(Asin, std::asin(a[l].f))
+        FOP(Acos, std::acos(a[l].f))
+        FOP(Atan, std::atan(a[l].f))
+        FOP(Atan2, std::atan2(a[l].f, b[l].f))
+        FOP(Exp, std::exp(a[l].f))
+        FOP(Exp2, std::exp2(a[l].f))
+        FOP(Log, std::log(a[l].f))
+        FOP(Log2, std::log2(a[l].f))
+        FOP(Pow, std::pow(a[l].f, b[l].f))
+        OP(FToU, FloatToU32(a[l].f))
+        OP(FToS, FloatToS32(a[l].f))
+        FOP(SToF, float(a[l].i))
+        FOP(UToF, float(a[l].u))
+
+        case Op::PackUnorm4x8: {
+            const auto e = Reg(op.mD);
+            Write(d, exec, lanes, masked, [&](const uint32_t l) -> uint32_t {
+                return PackUnorm8(a[l].f) | (PackUnorm8(b[l].f) << 8) |
+                       (PackUnorm8(c[l].f) << 16) | (PackUnorm8(e[l].f) << 24);
+            });
+            break;
+        }
+        case Op::UnpackUnorm4x8:
+            // dst may be a, so the top byte goes last.
+            for (uint32_t i = 4; i--; ) {
+                Write(Reg(op.mDst + i), exec, lanes, masked, [&](const uint32_t l) -> uint32_t {
+                    return Bits(float((a[l].u >> (8 * i)) & 0xff) / 255.0f);
+                });
+            }
+            break;
+
+        case Op::Load: {
+            const auto offsets = op.mC ? c : nullptr;
+            if (!offsets) {
+                uint32_t val;
+                memcpy(&val, Address(op, nullptr, 0), sizeof(val));
+                Write(d, exec, lanes, masked, [&](uint32_t) { return val; });
+                break;
+            }
+            for (uint32_t l = 0; l < lanes; l++) {
+                if (exec[l].u) {
+                    memcpy(&d[l].u, Address(op, offsets, l), sizeof(uint32_t));
+                }
+            }
+            break;
+        }
+        case Op::Store: {
+            const auto offsets = op.mC ? c : nullptr;
+            const auto src = Reg(op.mD);
+            for (uint32_t l = 0; l < lanes; l++) {
+                if (exec[l].u) {
+                    memcpy(Address(op, offsets, l), &src[l].u, sizeof(uint32_t));
+                }
+            }
+            break;
+        }
+        case Op::LoadLocal: {
+            const auto offsets = op.mC ? c : nullptr;
+            if (!offsets) {
+                const auto src = mLocal + size_t(op.mB) * lanes;
+                Write(d, exec, lanes, masked, [&](const uint32_t l) { return src[l].u; });
+                break;
+            }
+            for (uint32_t l = 0; l < lanes; l++) {
+                if (exec[l].u) {
+                    d[l] = LocalWord(op, offsets, l);
+                }
+            }
+            break;
+        }
+        case Op::StoreLocal: {
+            const auto offsets = op.mC ? c : nullptr;
+            const auto src = Reg(op.mD);
+            if (!offsets) {
+                Write(mLocal + size_t(op.mB) * lanes, exec, lanes, true,
+                      [&](const uint32_t l) { return src[l].u; });
+                break;
+            }
+            for (uint32_t l = 0; l < lanes; l++) {
+                if (exec[l].u) {
+                    LocalWord(op, offsets, l) = src[l];
+                }
+            }
+            break;
+        }
+        case Op::Atomic: {
+            const auto offsets = op.mC ? c : nullptr;
+            const auto operand = Reg(op.mD);
+            const auto kind = MirvShaderAtomic(op.mFlags >> kMirvOpAtomicShift);
+            for (uint32_t l = 0; l < lanes; l++) {
+                if (exec[l].u) {
+                    d[l].u = AtomicOp(Address(op, offsets, l), kind, operand[l].u, d[l].u);
+                }
+            }
+            break;
+        }
+        }
+#undef FOP
+#undef OP
+    }
+}
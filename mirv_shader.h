@@ -0,0 +1,214 @@
+#pragma once
+
+#include "vulkan.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "util.h"
+
+// Compute shaders compile to flat programs of MirvShaderOps. Each op runs once per batch
+// of invocations, over every lane of the batch, so the per-op overhead is shared by
+// the whole batch, and the lane loops vectorize: SPMD on SIMD. A register holds one 32-bit
+// scalar per lane. Vectors and composites are just several registers.
+//
+// Divergent control flow runs under masks: Every block has a mask register that its
+// predecessors OR their taken lanes into, and only those lanes run it. Blocks are laid
+// out so predecessors come first, loops jump back while any lane takes a back edge, and
+// ops inside loops only write the lanes that are still running.
+
+// Lane loops go this many lanes at a time, so every batch is a multiple of it.
+const uint32_t kMirvLaneStep = 8;
+// Unless a shader has barriers, which need a whole workgroup per batch.
+const uint32_t kMirvMaxBatchLanes = 64;
+
+enum class MirvShaderOpcode : uint16_t {
+    End,
+    // Masks are 0 or ~0 per lane. Register 0 is exec: the lanes running this block.
+    Block,      // exec = a; a = 0; if no lanes are left, jump to op b.
+    Branch,     // dst |= a
+    BranchCond, // dst |= exec & a; b |= exec & ~a
+    LoopBack,   // If any lanes of a are set, jump to op b.
+
+    // dst = f(a, b, c), per lane.
+    Mov,
+    MovIf,  // c ? a : dst
+    Select, // a ? b : c
+    IAdd, ISub, IMul, UDiv, SDiv, UMod, SRem, SMod, INeg,
+    Shl, ShrL, ShrA, And, Or, Xor, Not, AndNot, BitCount,
+    IEq, INe, ULt, ULe, SLt, SLe,
+    UMin, UMax, SMin, SMax, SAbs, SSign,
+    FAdd, FSub, FMul, FDiv, FRem, FMod, FNeg, Fma,
+    FOrdEq, FOrdNe, FOrdLt, FOrdLe, FUnordEq, FUnordNe, FUnordLt, FUnordLe,
+    IsNan, IsInf,
+    FMin, FMax, FAbs, FSign, Floor, Ceil, Fract, Round, RoundEven, Trunc,
+    Sqrt, InvSqrt, Sin, Cos, Tan, Asin, Acos, Atan, Atan2, Exp, Exp2, Log, Log2, Pow,
+    FToU, FToS, SToF, UToF,
+    PackUnorm4x8,   // Of a, b, c, d.
+    UnpackUnorm4x8, // Into dst..dst+3.
+
+    // Memory ops address slot a, at byte offset b, plus a register of per-lane byte
+    // offsets c, unless c is 0. Only exec lanes touch memory.
+    Load,       // dst = [a + b + c]
+    Store,      // [a + b + c] = d
+    LoadLocal,  // dst = local word b + c/4
+    StoreLocal, // local word b + c/4 = d
+    Atomic,     // dst = [a + b + c], which is then combined with d, per mFlags' kind.
+                // CompareExchange compares against dst's incoming value.
+};
+
+enum class MirvShaderAtomic : uint8_t {
+    Exchange,
+    CompareExchange,
+    Add,
+    Sub,
+    SMin,
+    UMin,
+    SMax,
+    UMax,
+    And,
+    Or,
+    Xor,
+};
+
+// mFlags:
+const uint16_t kMirvOpMasked = 1; // Only write exec lanes.
+const uint32_t kMirvOpAtomicShift = 8;
+
+struct MirvShaderOp final
+{
+    MirvShaderOpcode mCode;
+    uint16_t mFlags;
+    uint32_t mDst;
+    uint32_t mA;
+    uint32_t mB;
+    uint32_t mC;
+    uint32_t mD;
+};
+
+enum class MirvShaderBuiltin : uint8_t {
+    NumWorkgroups,
+    WorkgroupId,
+    LocalInvocationId,
+    GlobalInvocationId,
+    LocalInvocationIndex,
+    Count,
+};
+
+// The memory a program addresses. Buffers are bound per dispatch.
+const uint32_t kMirvSlotPushConstants = 0;
+const uint32_t kMirvSlotShared = 1;
+const uint32_t kMirvSlotFirstBinding = 2;
+const uint32_t kMirvPushConstantsSize = 256; // maxPushConstantsSize
+
+struct MirvShaderBinding final
+{
+    uint32_t mSet;
+    uint32_t mBinding;
+};
+
+struct MirvShaderConstant final
+{
+    uint32_t mReg;
+    uint32_t mBits;
+};
+
+struct MirvShaderProgram final
+{
+    uint32_t mLocalSize[3];
+    uint32_t mBatchLanes;
+    uint32_t mRegCount;
+    uint32_t mLocalWords; // Function and Private variables, per lane.
+    uint32_t mSharedBytes;
+    uint32_t mEntryMask;
+    // The first of each builtin's registers, or 0 if unused.
+    uint32_t mBuiltins[size_t(MirvShaderBuiltin::Count)];
+
+    std::vector<MirvShaderConstant> mConstants;
+    // Block masks. They must start clear, and every batch leaves them so.
+    std::vector<uint32_t> mMasks;
+    std::vector<MirvShaderBinding> mBindings; // From kMirvSlotFirstBinding.
+    std::vector<MirvShaderOp> mOps;
+};
+
+// SPIR-V, parsed once into everything that doesn't depend on the entry point or
+// specialization: reflection up front, and the compiler's own view in mDetails.
+// Immutable, so any number of compiles share it.
+class MirvSpirvModule final
+{
+public:
+    struct EntryPoint final {
+        std::string mName;
+        uint32_t mFunction;
+        uint32_t mLocalSize[3]; // From the LocalSize mode. A WorkgroupSize constant wins.
+    };
+    struct Details;
+
+    std::vector<EntryPoint> mEntryPoints; // GLCompute ones.
+    std::vector<MirvShaderBinding> mBindings; // Every buffer variable's, used or not.
+    bool mUsesPushConstants;
+    std::unique_ptr<Details> mDetails;
+
+    MirvSpirvModule();
+    ~MirvSpirvModule();
+
+    const EntryPoint* FindEntryPoint(const char* name) const;
+};
+
+// Null for malformed SPIR-V. Anything we can't compile only fails MirvCompileSpirv.
+// `words` must outlive the result, which points into them.
+std::unique_ptr<const MirvSpirvModule> MirvParseSpirv(const uint32_t* words,
+                                                      size_t wordCount);
+
+// Returns VK_ERROR_NOT_IMPLEMENTED for SPIR-V that uses anything we can't compile yet.
+VkResult MirvCompileSpirv(const MirvSpirvModule& module, const char* entryPoint,
+                          const VkSpecializationInfo* spec, MirvShaderProgram* out);
+
+// Bump whenever MirvShaderProgram or its ops change meaning, to invalidate saved programs.
+const uint32_t kMirvShaderProgramVersion = 1;
+
+// Pipeline caches save programs as plain arrays, so they load with one copy each.
+// With a null `out`, just returns the size. Sizes are multiples of 4.
+size_t MirvSaveShaderProgram(const MirvShaderProgram& program, uint8_t* out);
+// False unless `data` is exactly one saved program.
+bool MirvLoadShaderProgram(const uint8_t* data, size_t size, MirvShaderProgram* out);
+
+// --
+
+union MirvLane
+{
+    uint32_t u;
+    int32_t i;
+    float f;
+};
+
+// Runs one dispatch's workgroups on the calling thread, in thread-local scratch.
+// `slots` are indexed by slot, with kMirvSlotShared left to us.
+class MirvShaderRunner final
+{
+    const MirvShaderProgram& mProgram;
+    uint8_t* const* const mSlots;
+    const uint32_t mGroupCount[3];
+    const uint32_t mLanes;
+
+    MirvLane* mRegs;
+    MirvLane* mLocal;
+    uint8_t* mShared;
+
+public:
+    MirvShaderRunner(const MirvShaderProgram& program, uint8_t* const* slots,
+                     const uint32_t (&groupCount)[3]);
+
+    void RunGroup(uint32_t x, uint32_t y, uint32_t z);
+
+private:
+    MirvLane* Reg(const uint32_t reg) const { return mRegs + size_t(reg) * mLanes; }
+    uint8_t* Slot(const uint32_t slot) const {
+        return slot == kMirvSlotShared ? mShared : mSlots[slot];
+    }
+
+    void RunBatch();
+};
@@ -0,0 +1,2220 @@
+#include "mirv_shader.h"
+
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+
+#include "mirv.h"
+#include "mirv_spirv.h"
+
+// Compiles SPIR-V compute shaders to MirvShaderPrograms. Functions are inlined into one
+// graph of blocks, which is laid out in a topological order of its forward edges. Loops
+// run from their header through their last back edge, then jump back while any lane is
+// still looping.
+
+namespace {
+
+typedef MirvShaderOpcode Op;
+
+const uint32_t kNone = UINT32_MAX;
+// Vulkan has no recursion, so this only stops bad SPIR-V.
+const uint32_t kMaxCallDepth = 64;
+const uint32_t kMaxInvocations = 1024; // maxComputeWorkGroupInvocations
+
+inline SpvOp OpOf(const uint32_t* const p) { return SpvOp(p[0] & 0xffff); }
+inline uint32_t WordsOf(const uint32_t* const p) { return p[0] >> 16; }
+
+inline uint32_t
+FloatBits(const float f)
+{
+    uint32_t ret;
+    memcpy(&ret, &f, sizeof(ret));
+    return ret;
+}
+
+bool
+IsTerminator(const SpvOp op)
+{
+    switch (op) {
+    case SpvOpBranch:
+    case SpvOpBranchConditional:
+    case SpvOpSwitch:
+    case SpvOpKill:
+    case SpvOpReturn:
+    case SpvOpReturnValue:
+    case SpvOpUnreachable:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Of the instructions that can be inside functions.
+bool
+HasResultType(const SpvOp op)
+{
+    switch (op) {
+    case SpvOpNop:
+    case SpvOpLine:
+    case SpvOpNoLine:
+    case SpvOpFunctionEnd:
+    case SpvOpLabel:
+    case SpvOpStore:
+    case SpvOpLoopMerge:
+    case SpvOpSelectionMerge:
+    case SpvOpControlBarrier:
+    case SpvOpMemoryBarrier:
+    case SpvOpAtomicStore:
+        return false;
+    default:
+        return !IsTerminator(op);
+    }
+}
+
+// --
+
+struct Type final
+{
+    enum class Kind : uint8_t {
+        Unsupported,
+        Void,
+        Bool,
+        Int,
+        Float,
+        Vector,
+        Array,
+        RuntimeArray,
+        Struct,
+        Pointer,
+        Function,
+    };
+
+    Kind mKind = Kind::Unsupported;
+    uint32_t mElem = 0;    // Vectors and arrays: Their element. Pointers: Their pointee.
+    uint32_t mLength = 0;  // Vectors and arrays.
+    uint32_t mStorage = 0; // Pointers.
+    std::vector<uint32_t> mMembers;
+    uint32_t mScalars = 0; // Registers, once loaded.
+    uint32_t mWords = 0;   // Without explicit layout, as in Function or Workgroup memory.
+};
+
+struct Decoration final
+{
+    uint32_t mBuiltIn = kNone;
+    uint32_t mSpecId = kNone;
+    uint32_t mSet = 0;
+    uint32_t mBinding = 0;
+    uint32_t mArrayStride = 0;
+};
+
+enum class Space : uint8_t {
+    Memory,  // A slot.
+    Local,   // Function and Private variables.
+    Builtin, // Registers.
+};
+
+struct Value final
+{
+    enum class Kind : uint8_t {
+        Undefined,
+        Regs,
+        Pointer,
+    };
+
+    Kind mKind = Kind::Undefined;
+    std::vector<uint32_t> mRegs;
+
+    // Pointers:
+    Space mSpace = Space::Memory;
+    bool mExplicitLayout = false;
+    uint32_t mType = 0;      // The pointee.
+    uint32_t mBase = 0;      // Memory: The slot. Builtin: The first register.
+    uint32_t mOffset = 0;    // In bytes.
+    uint32_t mOffsetReg = 0; // Per-lane bytes to add, or 0.
+};
+
+struct Function final
+{
+    struct Block final {
+        uint32_t mLabel;
+        const uint32_t* mBegin; // After the OpLabel.
+        const uint32_t* mEnd;   // After the terminator.
+    };
+
+    uint32_t mResultType = 0;
+    std::vector<uint32_t> mParams;
+    std::vector<Block> mBlocks;
+};
+
+// One inlined call of a function. The entry point is instance 0.
+struct Instance final
+{
+    uint32_t mReturnNode = kNone;
+    std::vector<uint32_t> mReturnRegs;
+    std::unordered_map<uint32_t, Value> mValues;
+    std::unordered_map<uint32_t, uint32_t> mNodes; // By label, the label's first node.
+};
+
+// A block, or the part of one up to and including a call.
+struct Node final
+{
+    uint32_t mInstance;
+    uint32_t mLabel;
+    const uint32_t* mBegin;
+    const uint32_t* mEnd;
+    uint32_t mCallee = kNone; // If we end in a call, its instance.
+    uint32_t mMerge = kNone;  // If we're a loop header, the merge node.
+    uint32_t mMask = 0;
+    std::vector<uint32_t> mSuccs;
+};
+
+struct SimpleOp final
+{
+    uint32_t mFrom;
+    Op mOp;
+    uint8_t mOperands;
+    bool mSwap;
+};
+
+const SimpleOp kSimpleOps[] = {
+    { SpvOpSNegate, Op::INeg, 1, false },
+    { SpvOpFNegate, Op::FNeg, 1, false },
+    { SpvOpIAdd, Op::IAdd, 2, false },
+    { SpvOpFAdd, Op::FAdd, 2, false },
+    { SpvOpISub, Op::ISub, 2, false },
+    { SpvOpFSub, Op::FSub, 2, false },
+    { SpvOpIMul, Op::IMul, 2, false },
+    { SpvOpFMul, Op::FMul, 2, false },
+    { SpvOpVectorTimesScalar, Op::FMul, 2, false },
+    { SpvOpUDiv, Op::UDiv, 2, false },
+    { SpvOpSDiv, Op::SDiv, 2, false },
+    { SpvOpFDiv, Op::FDiv, 2, false },
+    { SpvOpUMod, Op::UMod, 2, false },
+    { SpvOpSRem, Op::SRem, 2, false },
+    { SpvOpSMod, Op::SMod, 2, false },
+    { SpvOpFRem, Op::FRem, 2, false },
+    { SpvOpFMod, Op::FMod, 2, false },
+    { SpvOpConvertFToU, Op::FToU, 1, false },
+    { SpvOpConvertFToS, Op::FToS, 1, false },
+    { SpvOpConvertSToF, Op::SToF, 1, false },
+    { SpvOpConvertUToF, Op::UToF, 1, false },
+    { SpvOpIsNan, Op::IsNan, 1, false },
+    { SpvOpIsInf, Op::IsInf, 1, false },
+    { SpvOpLogicalEqual, Op::IEq, 2, false },
+    { SpvOpLogicalNotEqual, Op::INe, 2, false },
+    { SpvOpLogicalOr, Op::Or, 2, false },
+    { SpvOpLogicalAnd, Op::And, 2, false },
+    { SpvOpLogicalNot, Op::Not, 1, false },
+    { SpvOpIEqual, Op::IEq, 2, false },
+    { SpvOpINotEqual, Op::INe, 2, false },
+    { SpvOpUGreaterThan, Op::ULt, 2, true },
+    { SpvOpSGreaterThan, Op::SLt, 2, true },
+    { SpvOpUGreaterThanEqual, Op::ULe, 2, true },
+    { SpvOpSGreaterThanEqual, Op::SLe, 2, true },
+    { SpvOpULessThan, Op::ULt, 2, false },
+    { SpvOpSLessThan, Op::SLt, 2, false },
+    { SpvOpULessThanEqual, Op::ULe, 2, false },
+    { SpvOpSLessThanEqual, Op::SLe, 2, false },
+    { SpvOpFOrdEqual, Op::FOrdEq, 2, false },
+    { SpvOpFUnordEqual, Op::FUnordEq, 2, false },
+    { SpvOpFOrdNotEqual, Op::FOrdNe, 2, false },
+    { SpvOpFUnordNotEqual, Op::FUnordNe, 2, false },
+    { SpvOpFOrdLessThan, Op::FOrdLt, 2, false },
+    { SpvOpFUnordLessThan, Op::FUnordLt, 2, false },
+    { SpvOpFOrdGreaterThan, Op::FOrdLt, 2, true },
+    { SpvOpFUnordGreaterThan, Op::FUnordLt, 2, true },
+    { SpvOpFOrdLessThanEqual, Op::FOrdLe, 2, false },
+    { SpvOpFUnordLessThanEqual, Op::FUnordLe, 2, false },
+    { SpvOpFOrdGreaterThanEqual, Op::FOrdLe, 2, true },
+    { SpvOpFUnordGreaterThanEqual, Op::FUnordLe, 2, true },
+    { SpvOpShiftRightLogical, Op::ShrL, 2, false },
+    { SpvOpShiftRightArithmetic, Op::ShrA, 2, false },
+    { SpvOpShiftLeftLogical, Op::Shl, 2, false },
+    { SpvOpBitwiseOr, Op::Or, 2, false },
+    { SpvOpBitwiseXor, Op::Xor, 2, false },
+    { SpvOpBitwiseAnd, Op::And, 2, false },
+    { SpvOpNot, Op::Not, 1, false },
+    { SpvOpBitCount, Op::BitCount, 1, false },
+};
+
+const SimpleOp kGlslOps[] = {
+    { GLSLstd450Round, Op::Round, 1, false },
+    { GLSLstd450RoundEven, Op::RoundEven, 1, false },
+    { GLSLstd450Trunc, Op::Trunc, 1, false },
+    { GLSLstd450FAbs, Op::FAbs, 1, false },
+    { GLSLstd450SAbs, Op::SAbs, 1, false },
+    { GLSLstd450FSign, Op::FSign, 1, false },
+    { GLSLstd450SSign, Op::SSign, 1, false },
+    { GLSLstd450Floor, Op::Floor, 1, false },
+    { GLSLstd450Ceil, Op::Ceil, 1, false },
+    { GLSLstd450Fract, Op::Fract, 1, false },
+    { GLSLstd450Sin, Op::Sin, 1, false },
+    { GLSLstd450Cos, Op::Cos, 1, false },
+    { GLSLstd450Tan, Op::Tan, 1, false },
+    { GLSLstd450Asin, Op::Asin, 1, false },
+    { GLSLstd450Acos, Op::Acos, 1, false },
+    { GLSLstd450Atan, Op::Atan, 1, false },
+    { GLSLstd450Atan2, Op::Atan2, 2, false },
+    { GLSLstd450Pow, Op::Pow, 2, false },
+    { GLSLstd450Exp, Op::Exp, 1, false },
+    { GLSLstd450Log, Op::Log, 1, false },
+    { GLSLstd450Exp2, Op::Exp2, 1, false },
+    { GLSLstd450Log2, Op::Log2, 1, false },
+    { GLSLstd450Sqrt, Op::Sqrt, 1, false },
+    { GLSLstd450InverseSqrt, Op::InvSqrt, 1, false },
+    { GLSLstd450FMin, Op::FMin, 2, false },
+    { GLSLstd450NMin, Op::FMin, 2, false },
+    { GLSLstd450UMin, Op::UMin, 2, false },
+    { GLSLstd450SMin, Op::SMin, 2, false },
+    { GLSLstd450FMax, Op::FMax, 2, false },
+    { GLSLstd450NMax, Op::FMax, 2, false },
+    { GLSLstd450UMax, Op::UMax, 2, false },
+    { GLSLstd450SMax, Op::SMax, 2, false },
+    { GLSLstd450Fma, Op::Fma, 3, false },
+};
+
+const SimpleOp*
+FindOp(const SimpleOp* const begin, const SimpleOp* const end, const uint32_t from)
+{
+    const auto itr = std::find_if(begin, end, [&](const SimpleOp& x) { return x.mFrom == from; });
+    return (itr == end) ? nullptr : itr;
+}
+
+} // namespace
+
+// Everything about a module that's the same for every compile of it.
+struct MirvSpirvModule::Details final
+{
+    std::unordered_map<uint32_t, Decoration> mDecorations;
+    std::map<std::pair<uint32_t, uint32_t>, uint32_t> mMemberOffsets;
+    std::unordered_map<uint32_t, uint32_t> mIdTypes;
+    std::unordered_map<uint32_t, Function> mFunctions;
+    // Types, constants, and global variables, in order. Specialization changes what
+    // constants and array types come to, so each compile evaluates these itself.
+    std::vector<const uint32_t*> mGlobals;
+    uint32_t mGlsl = kNone;
+    bool mHasBarrier = false;
+};
+
+namespace {
+
+// The one pass over a module's words.
+class Parser final
+{
+    const uint32_t* const mWords;
+    const size_t mWordCount;
+    MirvSpirvModule& mOut;
+    MirvSpirvModule::Details& mDetails;
+
+public:
+    const char* mError;
+
+    Parser(const uint32_t* const words, const size_t wordCount, MirvSpirvModule* const out)
+        : mWords(words)
+        , mWordCount(wordCount)
+        , mOut(*out)
+        , mDetails(*out->mDetails)
+        , mError(nullptr)
+    { }
+
+    bool Parse();
+
+private:
+    bool Fail(const char* const error) {
+        if (!mError) {
+            mError = error;
+        }
+        return false;
+    }
+};
+
+bool
+Parser::Parse()
+{
+    if (mWordCount < kSpvHeaderWords || mWords[0] != kSpvMagic)
+        return Fail("Not SPIR-V.");
+
+    // For reflection, which needs to know what variables point to before any compile
+    // has worked out the types.
+    std::unordered_map<uint32_t, uint32_t> pointees;
+    std::vector<uint32_t> structs;
+    std::vector<const uint32_t*> variables;
+
+    const auto end = mWords + mWordCount;
+    Function* func = nullptr;
+    for (auto p = mWords + kSpvHeaderWords; p < end; p += WordsOf(p)) {
+        const auto words = WordsOf(p);
+        if (!words || words > size_t(end - p))
+            return Fail("Truncated instruction.");
+
+        switch (OpOf(p)) {
+        case SpvOpExtInstImport:
+            if (!strncmp((const char*)(p + 2), "GLSL.std.450", (words - 2) * 4)) {
+                mDetails.mGlsl = p[1];
+            }
+            break;
+
+        case SpvOpEntryPoint:
+            if (words < 4)
+                return Fail("Bad OpEntryPoint.");
+            if (p[1] == SpvExecutionModelGLCompute) {
+                const auto name = (const char*)(p + 3);
+                mOut.mEntryPoints.push_back({ std::string(name, strnlen(name, (words - 3) * 4)),
+                                              p[2], { 0, 0, 0 } });
+            }
+            break;
+        case SpvOpExecutionMode:
+            if (p[2] != SpvExecutionModeLocalSize || words < 6)
+                break;
+            for (auto& x : mOut.mEntryPoints) {
+                if (x.mFunction == p[1]) {
+                    memcpy(x.mLocalSize, p + 3, sizeof(x.mLocalSize));
+                }
+            }
+            break;
+
+        case SpvOpDecorate: {
+            if (words < 3)
+                return Fail("Bad OpDecorate.");
+            auto& dec = mDetails.mDecorations[p[1]];
+            const auto arg = (words > 3) ? p[3] : 0;
+            switch (p[2]) {
+            case SpvDecorationSpecId:       dec.mSpecId = arg; break;
+            case SpvDecorationArrayStride:  dec.mArrayStride = arg; break;
+            case SpvDecorationBuiltIn:      dec.mBuiltIn = arg; break;
+            case SpvDecorationBinding:      dec.mBinding = arg; break;
+            case SpvDecorationDescriptorSet: dec.mSet = arg; break;
+            }
+            break;
+        }
+        case SpvOpMemberDecorate:
+            if (words >= 5 && p[3] == SpvDecorationOffset) {
+                mDetails.mMemberOffsets[{ p[1], p[2] }] = p[4];
+            }
+            break;
+
+        case SpvOpFunction:
+            if (words < 5)
+                return Fail("Bad OpFunction.");
+            func = &mDetails.mFunctions[p[2]];
+            func->mResultType = p[1];
+            break;
+        case SpvOpFunctionParameter:
+            if (!func)
+                return Fail("Bad OpFunctionParameter.");
+            func->mParams.push_back(p[2]);
+            break;
+        case SpvOpLabel:
+            if (!func)
+                return Fail("Bad OpLabel.");
+            func->mBlocks.push_back({ p[1], p + words, nullptr });
+            break;
+        case SpvOpFunctionEnd:
+            func = nullptr;
+            break;
+
+        case SpvOpControlBarrier:
+            mDetails.mHasBarrier = true;
+            break;
+
+        default:
+            if (func) {
+                if (IsTerminator(OpOf(p))) {
+                    if (func->mBlocks.empty())
+                        return Fail("Terminator outside a block.");
+                    func->mBlocks.back().mEnd = p + words;
+                }
+                break;
+            }
+            // Types, constants, and global variables.
+            if ((OpOf(p) >= SpvOpTypeVoid && OpOf(p) <= SpvOpTypeForwardPointer) ||
+                (OpOf(p) >= SpvOpConstantTrue && OpOf(p) <= SpvOpSpecConstantComposite) ||
+                OpOf(p) == SpvOpUndef || OpOf(p) == SpvOpVariable)
+            {
+                if (words < 2)
+                    return Fail("Truncated instruction.");
+                mDetails.mGlobals.push_back(p);
+            }
+            if (OpOf(p) == SpvOpTypePointer && words >= 4) {
+                pointees[p[1]] = p[3];
+            } else if (OpOf(p) == SpvOpTypeStruct) {
+                structs.push_back(p[1]);
+            } else if (OpOf(p) == SpvOpVariable && words >= 4) {
+                variables.push_back(p);
+            }
+            break;
+        }
+        const bool global = (OpOf(p) == SpvOpUndef || OpOf(p) == SpvOpVariable ||
+                             (OpOf(p) >= SpvOpConstantTrue &&
+                              OpOf(p) <= SpvOpSpecConstantComposite));
+        if (words >= 3 && (global || (func && HasResultType(OpOf(p))))) {
+            mDetails.mIdTypes[p[2]] = p[1];
+        }
+    }
+
+    // Arrays of buffers aren't supported, so only buffers that are structs count.
+    for (const auto p : variables) {
+        if (p[3] == SpvStorageClassPushConstant) {
+            mOut.mUsesPushConstants = true;
+            continue;
+        }
+        if (p[3] != SpvStorageClassUniform && p[3] != SpvStorageClassStorageBuffer)
+            continue;
+        const auto pointee = pointees.find(p[1]);
+        if (pointee == pointees.end() ||
+            std::find(structs.begin(), structs.end(), pointee->second) == structs.end())
+        {
+            continue;
+        }
+        const auto dec = mDetails.mDecorations.find(p[2]);
+        const MirvShaderBinding binding = {
+            (dec == mDetails.mDecorations.end()) ? 0 : dec->second.mSet,
+            (dec == mDetails.mDecorations.end()) ? 0 : dec->second.mBinding,
+        };
+        mOut.mBindings.push_back(binding);
+    }
+    return true;
+}
+
+// -------------------------------------
+
+class Compiler final
+{
+    const MirvSpirvModule::EntryPoint* const mEntry;
+    const VkSpecializationInfo* const mSpec;
+    MirvShaderProgram& mOut;
+
+public:
+    const char* mError;
+
+private:
+    // From the module:
+    const std::unordered_map<uint32_t, Decoration>& mDecorations;
+    const std::map<std::pair<uint32_t, uint32_t>, uint32_t>& mMemberOffsets;
+    const std::unordered_map<uint32_t, uint32_t>& mIdTypes;
+    const std::unordered_map<uint32_t, Function>& mFunctions;
+    const std::vector<const uint32_t*>& mGlobalInsts;
+    const uint32_t mGlsl;
+    const bool mHasBarrier;
+
+    std::unordered_map<uint32_t, Type> mTypes;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> mConstBits;
+    std::unordered_map<uint32_t, Value> mGlobals;
+    std::unordered_map<uint32_t, uint32_t> mConstRegs; // By bits.
+    std::vector<std::pair<uint32_t, uint32_t>> mPrivateInits; // (variable, initializer)
+
+    std::vector<Instance> mInstances;
+    std::vector<Node> mNodes;
+    bool mMaskedRegion;
+
+public:
+    Compiler(const MirvSpirvModule& module, const MirvSpirvModule::EntryPoint* const entry,
+             const VkSpecializationInfo* const spec, MirvShaderProgram* const out)
+        : mEntry(entry)
+        , mSpec(spec)
+        , mOut(*out)
+        , mError(nullptr)
+        , mDecorations(module.mDetails->mDecorations)
+        , mMemberOffsets(module.mDetails->mMemberOffsets)
+        , mIdTypes(module.mDetails->mIdTypes)
+        , mFunctions(module.mDetails->mFunctions)
+        , mGlobalInsts(module.mDetails->mGlobals)
+        , mGlsl(module.mDetails->mGlsl)
+        , mHasBarrier(module.mDetails->mHasBarrier)
+        , mMaskedRegion(false)
+    { }
+
+    bool Compile();
+
+private:
+    bool Fail(const char* const error) {
+        if (!mError) {
+            mError = error;
+        }
+        return false;
+    }
+
+    bool DefineGlobals();
+    bool ParseType(const uint32_t* p);
+    bool ParseConstant(const uint32_t* p);
+    bool ParseVariable(const uint32_t* p);
+    uint32_t SpecBits(uint32_t id, uint32_t bits, bool isBool) const;
+
+    bool BuildInstance(uint32_t function, uint32_t returnNode, uint32_t depth,
+                       uint32_t* out_entry);
+    bool Order(uint32_t entry, std::vector<uint32_t>* out_order,
+               std::vector<std::pair<uint32_t, uint32_t>>* out_backEdges);
+    bool Emit(uint32_t entry);
+    bool CompileNode(uint32_t node);
+    bool CompileInst(uint32_t inst, const uint32_t* p);
+    bool CompileExtInst(uint32_t inst, const uint32_t* p);
+    bool CompileTerminator(uint32_t node, const uint32_t* p);
+
+    // --
+
+    const Type* FindType(const uint32_t id) {
+        const auto itr = mTypes.find(id);
+        if (itr == mTypes.end()) {
+            Fail("Unknown type.");
+            return nullptr;
+        }
+        return &itr->second;
+    }
+    uint32_t Scalars(const uint32_t type) {
+        const auto x = FindType(type);
+        return x ? x->mScalars : 0;
+    }
+    const std::vector<uint32_t>* ConstBits(const uint32_t id) const {
+        const auto itr = mConstBits.find(id);
+        return (itr == mConstBits.end()) ? nullptr : &itr->second;
+    }
+
+    const Value* Get(uint32_t inst, uint32_t id);
+    const std::vector<uint32_t>* Regs(uint32_t inst, uint32_t id);
+    Value& Def(const uint32_t inst, const uint32_t id) {
+        return mInstances[inst].mValues[id];
+    }
+    void DefRegs(const uint32_t inst, const uint32_t id, std::vector<uint32_t> regs) {
+        auto& x = Def(inst, id);
+        x.mKind = Value::Kind::Regs;
+        x.mRegs = std::move(regs);
+    }
+    const std::vector<uint32_t>& PhiRegs(uint32_t inst, const uint32_t* phi);
+
+    uint32_t NewRegs(const uint32_t count) {
+        const auto ret = mOut.mRegCount;
+        mOut.mRegCount += count;
+        return ret;
+    }
+    uint32_t NewReg() { return NewRegs(1); }
+    uint32_t ConstReg(uint32_t bits);
+
+    void EmitRaw(const Op code, const uint32_t dst, const uint32_t a = 0,
+                 const uint32_t b = 0, const uint32_t c = 0, const uint32_t d = 0,
+                 const uint16_t flags = 0)
+    {
+        mOut.mOps.push_back({ code, flags, dst, a, b, c, d });
+    }
+    // Into a new register, which inside loops only takes exec lanes' results.
+    uint32_t EmitValue(const Op code, const uint32_t a, const uint32_t b = 0,
+                       const uint32_t c = 0, const uint32_t d = 0)
+    {
+        const auto dst = NewReg();
+        EmitRaw(code, dst, a, b, c, d, mMaskedRegion ? kMirvOpMasked : 0);
+        return dst;
+    }
+
+    template<typename F>
+    bool PerComponent(uint32_t inst, uint32_t resultType, uint32_t resultId,
+                      const uint32_t* operands, uint32_t operandCount, const F& fn);
+    uint32_t Dot(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b);
+
+    uint32_t Stride(uint32_t arrayType, bool explicitLayout);
+    uint32_t MemberOffset(uint32_t structType, uint32_t member, bool explicitLayout);
+    template<typename F>
+    bool ForEachLeaf(uint32_t type, bool explicitLayout, uint32_t offset, const F& fn);
+    bool AccessChain(uint32_t inst, const uint32_t* p);
+    bool Load(const Value& ptr, std::vector<uint32_t>* out);
+    bool Store(const Value& ptr, const std::vector<uint32_t>& regs);
+    bool Atomic(uint32_t inst, const uint32_t* p);
+
+    uint32_t NodeFor(const uint32_t node, const uint32_t label) {
+        const auto& nodes = mInstances[mNodes[node].mInstance].mNodes;
+        const auto itr = nodes.find(label);
+        return (itr == nodes.end()) ? kNone : itr->second;
+    }
+    bool Edge(uint32_t node, uint32_t label, uint32_t mask);
+    bool PhiCopies(uint32_t node, uint32_t label, uint32_t mask);
+};
+
+// -------------------------------------
+
+bool
+Compiler::Compile()
+{
+    mOut.mRegCount = 1; // exec
+    if (!mEntry)
+        return Fail("No such GLCompute entry point.");
+    memcpy(mOut.mLocalSize, mEntry->mLocalSize, sizeof(mOut.mLocalSize));
+    if (!DefineGlobals())
+        return false;
+
+    const auto& size = mOut.mLocalSize;
+    const auto invocations = uint64_t(size[0]) * size[1] * size[2];
+    if (!invocations || invocations > kMaxInvocations)
+        return Fail("Bad workgroup size.");
+    const auto lanes = (uint32_t(invocations) + kMirvLaneStep - 1) / kMirvLaneStep *
+                       kMirvLaneStep;
+    mOut.mBatchLanes = mHasBarrier ? lanes : std::min(lanes, kMirvMaxBatchLanes);
+
+    uint32_t entry;
+    if (!BuildInstance(mEntry->mFunction, kNone, 0, &entry) || !Emit(entry))
+        return false;
+
+    // Only bindings we actually touch need descriptors.
+    const auto bindingCount = uint32_t(mOut.mBindings.size());
+    std::vector<uint32_t> remap(bindingCount, kNone);
+    std::vector<MirvShaderBinding> used;
+    for (auto& op : mOut.mOps) {
+        if (op.mCode != Op::Load && op.mCode != Op::Store && op.mCode != Op::Atomic)
+            continue;
+        if (op.mA < kMirvSlotFirstBinding)
+            continue;
+        auto& slot = remap[op.mA - kMirvSlotFirstBinding];
+        if (slot == kNone) {
+            slot = kMirvSlotFirstBinding + uint32_t(used.size());
+            used.push_back(mOut.mBindings[op.mA - kMirvSlotFirstBinding]);
+        }
+        op.mA = slot;
+    }
+    mOut.mBindings = std::move(used);
+    return true;
+}
+
+bool
+Compiler::DefineGlobals()
+{
+    for (const auto p : mGlobalInsts) {
+        switch (OpOf(p)) {
+        case SpvOpTypeVoid:
+        case SpvOpTypeBool:
+        case SpvOpTypeInt:
+        case SpvOpTypeFloat:
+        case SpvOpTypeVector:
+        case SpvOpTypeArray:
+        case SpvOpTypeRuntimeArray:
+        case SpvOpTypeStruct:
+        case SpvOpTypePointer:
+        case SpvOpTypeFunction:
+            if (!ParseType(p))
+                return false;
+            break;
+
+        case SpvOpUndef: {
+            std::vector<uint32_t> regs(Scalars(p[1]), ConstReg(0));
+            auto& x = mGlobals[p[2]];
+            x.mKind = Value::Kind::Regs;
+            x.mRegs = std::move(regs);
+            break;
+        }
+        case SpvOpVariable:
+            if (!ParseVariable(p))
+                return false;
+            break;
+
+        default:
+            if (OpOf(p) >= SpvOpConstantTrue && OpOf(p) <= SpvOpSpecConstantComposite) {
+                if (!ParseConstant(p))
+                    return false;
+            } else {
+                // Another OpType*. Harmless unless we're asked to use it.
+                mTypes[p[1]];
+            }
+            break;
+        }
+    }
+
+    // A WorkgroupSize constant beats the LocalSize mode.
+    for (const auto& x : mDecorations) {
+        if (x.second.mBuiltIn != SpvBuiltInWorkgroupSize)
+            continue;
+        const auto bits = ConstBits(x.first);
+        if (!bits || bits->size() != 3)
+            return Fail("Bad WorkgroupSize.");
+        std::copy(bits->begin(), bits->end(), mOut.mLocalSize);
+    }
+    return true;
+}
+
+bool
+Compiler::ParseType(const uint32_t* const p)
+{
+    typedef Type::Kind Kind;
+    const auto words = WordsOf(p);
+    auto& type = mTypes[p[1]];
+
+    const auto Elem = [&](const uint32_t id) -> const Type* {
+        const auto itr = mTypes.find(id);
+        if (itr == mTypes.end()) {
+            Fail("Unknown type.");
+            return nullptr;
+        }
+        return &itr->second;
+    };
+
+    switch (OpOf(p)) {
+    case SpvOpTypeVoid:
+        type.mKind = Kind::Void;
+        break;
+    case SpvOpTypeBool:
+        type.mKind = Kind::Bool;
+        type.mScalars = type.mWords = 1;
+        break;
+    case SpvOpTypeInt:
+    case SpvOpTypeFloat:
+        if (words < 3)
+            return Fail("Bad type.");
+        if (p[2] != 32)
+            break; // Unsupported.
+        type.mKind = (OpOf(p) == SpvOpTypeInt) ? Kind::Int : Kind::Float;
+        type.mScalars = type.mWords = 1;
+        break;
+
+    case SpvOpTypeVector:
+    case SpvOpTypeArray: {
+        if (words < 4)
+            return Fail("Bad type.");
+        const auto elem = Elem(p[2]);
+        if (!elem)
+            return false;
+        uint32_t length = p[3];
+        if (OpOf(p) == SpvOpTypeArray) {
+            const auto bits = ConstBits(p[3]);
+            if (!bits || bits->size() != 1)
+                return Fail("Bad array length.");
+            length = bits->at(0);
+        }
+        type.mKind = (OpOf(p) == SpvOpTypeVector) ? Kind::Vector : Kind::Array;
+        type.mElem = p[2];
+        type.mLength = length;
+        type.mScalars = elem->mScalars * length;
+        type.mWords = elem->mWords * length;
+        break;
+    }
+    case SpvOpTypeRuntimeArray:
+        type.mKind = Kind::RuntimeArray;
+        type.mElem = p[2];
+        break;
+
+    case SpvOpTypeStruct:
+        type.mKind = Kind::Struct;
+        for (uint32_t i = 2; i < words; i++) {
+            const auto member = Elem(p[i]);
+            if (!member)
+                return false;
+            type.mMembers.push_back(p[i]);
+            type.mScalars += member->mScalars;
+            type.mWords += member->mWords;
+        }
+        break;
+
+    case SpvOpTypePointer:
+        type.mKind = Kind::Pointer;
+        type.mStorage = p[2];
+        type.mElem = p[3];
+        break;
+    case SpvOpTypeFunction:
+        type.mKind = Kind::Function;
+        break;
+    default:
+        break;
+    }
+    return true;
+}
+
+uint32_t
+Compiler::SpecBits(const uint32_t id, uint32_t bits, const bool isBool) const
+{
+    const auto dec = mDecorations.find(id);
+    if (dec == mDecorations.end() || dec->second.mSpecId == kNone || !mSpec)
+        return bits;
+
+    for (const auto& x : Range(mSpec->pMapEntries, mSpec->mapEntryCount)) {
+        if (x.constantID != dec->second.mSpecId)
+            continue;
+        ASSERT(x.offset + x.size <= mSpec->dataSize)
+        bits = 0;
+        memcpy(&bits, (const uint8_t*)mSpec->pData + x.offset,
+               std::min(x.size, sizeof(bits)));
+        if (isBool) {
+            bits = bits ? ~0u : 0u;
+        }
+    }
+    return bits;
+}
+
+bool
+Compiler::ParseConstant(const uint32_t* const p)
+{
+    const auto words = WordsOf(p);
+    if (words < 3)
+        return Fail("Bad constant.");
+    const auto type = FindType(p[1]);
+    if (!type)
+        return false;
+
+    std::vector<uint32_t> bits;
+    switch (OpOf(p)) {
+    case SpvOpConstantTrue:
+    case SpvOpConstantFalse:
+    case SpvOpSpecConstantTrue:
+    case SpvOpSpecConstantFalse: {
+        const bool isTrue = (OpOf(p) == SpvOpConstantTrue ||
+                             OpOf(p) == SpvOpSpecConstantTrue);
+        bits.push_back(isTrue ? ~0u : 0u);
+        if (OpOf(p) == SpvOpSpecConstantTrue || OpOf(p) == SpvOpSpecConstantFalse) {
+            bits[0] = SpecBits(p[2], bits[0], true);
+        }
+        break;
+    }
+    case SpvOpConstant:
+    case SpvOpSpecConstant:
+        if (words != 4 || type->mScalars != 1)
+            return Fail("Unsupported constant.");
+        bits.push_back(p[3]);
+        if (OpOf(p) == SpvOpSpecConstant) {
+            bits[0] = SpecBits(p[2], bits[0], false);
+        }
+        break;
+    case SpvOpConstantComposite:
+    case SpvOpSpecConstantComposite:
+        for (uint32_t i = 3; i < words; i++) {
+            const auto part = ConstBits(p[i]);
+            if (!part)
+                return Fail("Bad constant composite.");
+            bits.insert(bits.end(), part->begin(), part->end());
+        }
+        break;
+    case SpvOpConstantNull:
+        bits.resize(type->mScalars);
+        break;
+    default:
+        return Fail("Unsupported constant.");
+    }
+    if (bits.size() != type->mScalars)
+        return Fail("Bad constant.");
+
+    auto& x = mGlobals[p[2]];
+    x.mKind = Value::Kind::Regs;
+    for (const auto& b : bits) {
+        x.mRegs.push_back(ConstReg(b));
+    }
+    mConstBits[p[2]] = std::move(bits);
+    return true;
+}
+
+bool
+Compiler::ParseVariable(const uint32_t* const p)
+{
+    const auto words = WordsOf(p);
+    if (words < 4)
+        return Fail("Bad OpVariable.");
+    const auto ptrType = FindType(p[1]);
+    if (!ptrType || ptrType->mKind != Type::Kind::Pointer)
+        return Fail("Bad OpVariable.");
+    const auto pointee = FindType(ptrType->mElem);
+    if (!pointee)
+        return false;
+
+    auto& x = mGlobals[p[2]];
+    x.mType = ptrType->mElem;
+    static const Decoration kUndecorated;
+    const auto decItr = mDecorations.find(p[2]);
+    const auto& dec = (decItr == mDecorations.end()) ? kUndecorated : decItr->second;
+
+    switch (p[3]) {
+    case SpvStorageClassUniform:
+    case SpvStorageClassStorageBuffer: {
+        if (pointee->mKind != Type::Kind::Struct)
+            return true; // Arrays of buffers aren't supported, but needn't be used.
+        const MirvShaderBinding binding = { dec.mSet, dec.mBinding };
+        auto& bindings = mOut.mBindings;
+        const auto itr = std::find_if(bindings.begin(), bindings.end(),
+                                      [&](const MirvShaderBinding& b) {
+                                          return b.mSet == binding.mSet &&
+                                                 b.mBinding == binding.mBinding;
+                                      });
+        x.mKind = Value::Kind::Pointer;
+        x.mSpace = Space::Memory;
+        x.mExplicitLayout = true;
+        x.mBase = kMirvSlotFirstBinding + uint32_t(itr - bindings.begin());
+        if (itr == bindings.end()) {
+            bindings.push_back(binding);
+        }
+        break;
+    }
+    case SpvStorageClassPushConstant:
+        x.mKind = Value::Kind::Pointer;
+        x.mSpace = Space::Memory;
+        x.mExplicitLayout = true;
+        x.mBase = kMirvSlotPushConstants;
+        break;
+    case SpvStorageClassWorkgroup:
+        x.mKind = Value::Kind::Pointer;
+        x.mSpace = Space::Memory;
+        x.mBase = kMirvSlotShared;
+        x.mOffset = (mOut.mSharedBytes + 15) & ~15u;
+        mOut.mSharedBytes = x.mOffset + pointee->mWords * 4;
+        break;
+    case SpvStorageClassPrivate:
+        x.mKind = Value::Kind::Pointer;
+        x.mSpace = Space::Local;
+        x.mOffset = mOut.mLocalWords * 4;
+        mOut.mLocalWords += pointee->mWords;
+        if (words >= 5) {
+            mPrivateInits.push_back({ p[2], p[4] });
+        }
+        break;
+    case SpvStorageClassInput: {
+        static const std::pair<uint32_t, MirvShaderBuiltin> kBuiltins[] = {
+            { SpvBuiltInNumWorkgroups, MirvShaderBuiltin::NumWorkgroups },
+            { SpvBuiltInWorkgroupId, MirvShaderBuiltin::WorkgroupId },
+            { SpvBuiltInLocalInvocationId, MirvShaderBuiltin::LocalInvocationId },
+            { SpvBuiltInGlobalInvocationId, MirvShaderBuiltin::GlobalInvocationId },
+            { SpvBuiltInLocalInvocationIndex, MirvShaderBuiltin::LocalInvocationIndex },
+        };
+        for (const auto& b : kBuiltins) {
+            if (b.first != dec.mBuiltIn)
+                continue;
+            const auto count = (b.second == MirvShaderBuiltin::LocalInvocationIndex) ? 1 : 3;
+            if (pointee->mScalars != uint32_t(count))
+                return Fail("Bad builtin type.");
+            auto& reg = mOut.mBuiltins[size_t(b.second)];
+            if (!reg) {
+                reg = NewRegs(count);
+            }
+            x.mKind = Value::Kind::Pointer;
+            x.mSpace = Space::Builtin;
+            x.mBase = reg;
+        }
+        break;
+    }
+    default:
+        break; // Images and such. Fine until something uses them.
+    }
+    return true;
+}
+
+// -------------------------------------
+
+bool
+Compiler::BuildInstance(const uint32_t function, const uint32_t returnNode,
+                        const uint32_t depth, uint32_t* const out_entry)
+{
+    if (depth > kMaxCallDepth)
+        return Fail("Calls nest too deeply.");
+    const auto funcItr = mFunctions.find(function);
+    if (funcItr == mFunctions.end() || funcItr->second.mBlocks.empty())
+        return Fail("Unknown function.");
+    const auto& func = funcItr->second;
+
+    const auto inst = uint32_t(mInstances.size());
+    mInstances.push_back(Instance());
+    mInstances[inst].mReturnNode = returnNode;
+    if (const auto scalars = Scalars(func.mResultType)) {
+        for (uint32_t i = 0; i < scalars; i++) {
+            mInstances[inst].mReturnRegs.push_back(NewReg());
+        }
+    }
+
+    const auto NewNode = [&](const uint32_t label, const uint32_t* const begin) {
+        Node node;
+        node.mInstance = inst;
+        node.mLabel = label;
+        node.mBegin = begin;
+        node.mEnd = begin;
+        node.mMask = NewReg();
+        mOut.mMasks.push_back(node.mMask);
+        mNodes.push_back(node);
+        return uint32_t(mNodes.size() - 1);
+    };
+
+    // Split blocks after each call.
+    struct Call final {
+        uint32_t mNode;
+        uint32_t mContinue;
+        uint32_t mCallee;
+    };
+    std::vector<Call> calls;
+    std::vector<uint32_t> lastNodes;
+    for (const auto& block : func.mBlocks) {
+        if (!block.mEnd)
+            return Fail("Block without a terminator.");
+        auto node = NewNode(block.mLabel, block.mBegin);
+        mInstances[inst].mNodes[block.mLabel] = node;
+        for (auto p = block.mBegin; p < block.mEnd; p += WordsOf(p)) {
+            if (OpOf(p) != SpvOpFunctionCall)
+                continue;
+            const auto next = p + WordsOf(p);
+            mNodes[node].mEnd = next;
+            const auto cont = NewNode(block.mLabel, next);
+            calls.push_back({ node, cont, p[3] });
+            node = cont;
+        }
+        mNodes[node].mEnd = block.mEnd;
+        lastNodes.push_back(node);
+    }
+
+    for (size_t i = 0; i < func.mBlocks.size(); i++) {
+        const auto& block = func.mBlocks[i];
+        const auto node = lastNodes[i];
+        const uint32_t* term = nullptr;
+        const uint32_t* loopMerge = nullptr;
+        for (auto p = mNodes[node].mBegin; p < mNodes[node].mEnd; p += WordsOf(p)) {
+            if (OpOf(p) == SpvOpLoopMerge) {
+                loopMerge = p;
+            }
+            term = p;
+        }
+        if (!term)
+            return Fail("Empty block.");
+
+        std::vector<uint32_t> labels;
+        switch (OpOf(term)) {
+        case SpvOpBranch:
+            labels.push_back(term[1]);
+            break;
+        case SpvOpBranchConditional:
+            labels.push_back(term[2]);
+            labels.push_back(term[3]);
+            break;
+        case SpvOpSwitch:
+            labels.push_back(term[2]);
+            for (uint32_t w = 4; w < WordsOf(term); w += 2) {
+                labels.push_back(term[w]);
+            }
+            break;
+        case SpvOpReturn:
+        case SpvOpReturnValue:
+            if (returnNode != kNone) {
+                mNodes[node].mSuccs.push_back(returnNode);
+            }
+            break;
+        default:
+            break;
+        }
+        for (const auto& label : labels) {
+            const auto succ = NodeFor(node, label);
+            if (succ == kNone)
+                return Fail("Unknown label.");
+            mNodes[node].mSuccs.push_back(succ);
+        }
+
+        if (loopMerge) {
+            const auto header = mInstances[inst].mNodes[block.mLabel];
+            mNodes[header].mMerge = NodeFor(node, loopMerge[1]);
+            if (mNodes[header].mMerge == kNone)
+                return Fail("Unknown label.");
+        }
+    }
+
+    const auto entry = mInstances[inst].mNodes[func.mBlocks[0].mLabel];
+    for (const auto& call : calls) {
+        const auto callee = uint32_t(mInstances.size());
+        uint32_t calleeEntry;
+        if (!BuildInstance(call.mCallee, call.mContinue, depth + 1, &calleeEntry))
+            return false;
+        mNodes[call.mNode].mCallee = callee;
+        mNodes[call.mNode].mSuccs.push_back(calleeEntry);
+    }
+    *out_entry = entry;
+    return true;
+}
+
+// Reverse postorder of the forward edges, plus edges from each loop's back-edge blocks
+// to its merge block, so that loops are laid out before whatever follows them.
+bool
+Compiler::Order(const uint32_t entry, std::vector<uint32_t>* const out_order,
+                std::vector<std::pair<uint32_t, uint32_t>>* const out_backEdges)
+{
+    enum : uint8_t { kNew, kOnStack, kDone };
+
+    std::vector<std::vector<uint32_t>> succs(mNodes.size());
+    std::vector<uint8_t> state(mNodes.size(), kNew);
+    std::vector<std::pair<uint32_t, size_t>> stack; // (node, next successor)
+
+    state[entry] = kOnStack;
+    stack.push_back({ entry, 0 });
+    while (!stack.empty()) {
+        auto& top = stack.back();
+        const auto& nodeSuccs = mNodes[top.first].mSuccs;
+        if (top.second == nodeSuccs.size()) {
+            state[top.first] = kDone;
+            stack.pop_back();
+            continue;
+        }
+        const auto from = top.first;
+        const auto to = nodeSuccs[top.second++];
+        if (state[to] == kOnStack) {
+            if (mNodes[to].mMerge == kNone)
+                return Fail("Unstructured loop.");
+            out_backEdges->push_back({ from, to });
+            succs[from].push_back(mNodes[to].mMerge);
+            continue;
+        }
+        succs[from].push_back(to);
+        if (state[to] == kNew) {
+            state[to] = kOnStack;
+            stack.push_back({ to, 0 });
+        }
+    }
+
+    std::fill(state.begin(), state.end(), kNew);
+    state[entry] = kOnStack;
+    stack.push_back({ entry, 0 });
+    while (!stack.empty()) {
+        auto& top = stack.back();
+        const auto& nodeSuccs = succs[top.first];
+        if (top.second == nodeSuccs.size()) {
+            state[top.first] = kDone;
+            out_order->push_back(top.first);
+            stack.pop_back();
+            continue;
+        }
+        const auto to = nodeSuccs[top.second++];
+        if (state[to] == kNew) {
+            state[to] = kOnStack;
+            stack.push_back({ to, 0 });
+        } else if (state[to] == kOnStack) {
+            return Fail("Irreducible control flow.");
+        }
+    }
+    std::reverse(out_order->begin(), out_order->end());
+    return true;
+}
+
+bool
+Compiler::Emit(const uint32_t entry)
+{
+    std::vector<uint32_t> order;
+    std::vector<std::pair<uint32_t, uint32_t>> backEdges;
+    if (!Order(entry, &order, &backEdges))
+        return false;
+
+    std::vector<uint32_t> pos(mNodes.size(), kNone);
+    for (uint32_t i = 0; i < order.size(); i++) {
+        pos[order[i]] = i;
+    }
+    // Each loop runs from its header through its last back edge.
+    std::map<uint32_t, uint32_t> loopEnds; // By header.
+    for (const auto& x : backEdges) {
+        auto& end = loopEnds[x.second];
+        end = std::max(end, pos[x.first]);
+    }
+    std::vector<int32_t> depthDelta(order.size() + 1, 0);
+    for (const auto& x : loopEnds) {
+        depthDelta[pos[x.first]]++;
+        depthDelta[x.second + 1]--;
+    }
+
+    mOut.mEntryMask = mNodes[entry].mMask;
+    std::vector<uint32_t> blockOps(mNodes.size(), kNone);
+    int32_t depth = 0;
+    for (uint32_t i = 0; i < order.size(); i++) {
+        const auto node = order[i];
+        depth += depthDelta[i];
+        mMaskedRegion = (depth > 0);
+
+        blockOps[node] = uint32_t(mOut.mOps.size());
+        EmitRaw(Op::Block, 0, mNodes[node].mMask);
+        if (node == entry) {
+            for (const auto& x : mPrivateInits) {
+                const auto var = Get(0, x.first);
+                const auto init = Regs(0, x.second);
+                if (!var || !init || !Store(*var, *init))
+                    return false;
+            }
+        }
+        if (!CompileNode(node))
+            return false;
+        mOut.mOps[blockOps[node]].mB = uint32_t(mOut.mOps.size());
+
+        // Loops that end here jump back, innermost first.
+        std::vector<uint32_t> headers;
+        for (const auto& x : loopEnds) {
+            if (x.second == i) {
+                headers.push_back(x.first);
+            }
+        }
+        std::sort(headers.begin(), headers.end(), [&](const uint32_t a, const uint32_t b) {
+            return pos[a] > pos[b];
+        });
+        for (const auto& header : headers) {
+            EmitRaw(Op::LoopBack, 0, mNodes[header].mMask, blockOps[header]);
+        }
+    }
+    EmitRaw(Op::End, 0);
+    return true;
+}
+
+// -------------------------------------
+
+const Value*
+Compiler::Get(const uint32_t inst, const uint32_t id)
+{
+    const auto& values = mInstances[inst].mValues;
+    const auto itr = values.find(id);
+    if (itr != values.end())
+        return &itr->second;
+    const auto global = mGlobals.find(id);
+    if (global != mGlobals.end())
+        return &global->second;
+    Fail("Unknown or unsupported value.");
+    return nullptr;
+}
+
+const std::vector<uint32_t>*
+Compiler::Regs(const uint32_t inst, const uint32_t id)
+{
+    const auto x = Get(inst, id);
+    if (!x)
+        return nullptr;
+    if (x->mKind != Value::Kind::Regs) {
+        Fail("Unsupported value.");
+        return nullptr;
+    }
+    return &x->mRegs;
+}
+
+const std::vector<uint32_t>&
+Compiler::PhiRegs(const uint32_t inst, const uint32_t* const phi)
+{
+    auto& x = Def(inst, phi[2]);
+    if (x.mKind != Value::Kind::Regs) {
+        x.mKind = Value::Kind::Regs;
+        const auto count = Scalars(phi[1]);
+        for (uint32_t i = 0; i < count; i++) {
+            x.mRegs.push_back(NewReg());
+        }
+    }
+    return x.mRegs;
+}
+
+uint32_t
+Compiler::ConstReg(const uint32_t bits)
+{
+    const auto itr = mConstRegs.find(bits);
+    if (itr != mConstRegs.end())
+        return itr->second;
+    const auto reg = NewReg();
+    mOut.mConstants.push_back({ reg, bits });
+    mConstRegs[bits] = reg;
+    return reg;
+}
+
+template<typename F>
+bool
+Compiler::PerComponent(const uint32_t inst, const uint32_t resultType,
+                       const uint32_t resultId, const uint32_t* const operands,
+                       const uint32_t operandCount, const F& fn)
+{
+    std::vector<const std::vector<uint32_t>*> regs;
+    for (uint32_t i = 0; i < operandCount; i++) {
+        const auto x = Regs(inst, operands[i]);
+        if (!x)
+            return false;
+        regs.push_back(x);
+    }
+
+    const auto count = Scalars(resultType);
+    std::vector<uint32_t> out;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t x[4] = {};
+        for (uint32_t k = 0; k < operandCount; k++) {
+            const auto& r = *regs[k];
+            if (r.size() == 1) {
+                x[k] = r[0]; // Scalars broadcast.
+            } else if (i < r.size()) {
+                x[k] = r[i];
+            } else {
+                return Fail("Mismatched operands.");
+            }
+        }
+        out.push_back(fn(x));
+    }
+    if (!count)
+        return Fail("Unsupported result type.");
+    DefRegs(inst, resultId, std::move(out));
+    return true;
+}
+
+uint32_t
+Compiler::Dot(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b)
+{
+    auto sum = EmitValue(Op::FMul, a[0], b[0]);
+    for (size_t i = 1; i < a.size(); i++) {
+        sum = EmitValue(Op::Fma, a[i], b[i], sum);
+    }
+    return sum;
+}
+
+// --
+
+uint32_t
+Compiler::Stride(const uint32_t arrayType, const bool explicitLayout)
+{
+    if (explicitLayout) {
+        const auto dec = mDecorations.find(arrayType);
+        if (dec != mDecorations.end() && dec->second.mArrayStride)
+            return dec->second.mArrayStride;
+    }
+    const auto type = FindType(arrayType);
+    const auto elem = type ? FindType(type->mElem) : nullptr;
+    return elem ? elem->mWords * 4 : 0;
+}
+
+uint32_t
+Compiler::MemberOffset(const uint32_t structType, const uint32_t member,
+                       const bool explicitLayout)
+{
+    if (explicitLayout) {
+        const auto itr = mMemberOffsets.find({ structType, member });
+        if (itr != mMemberOffsets.end())
+            return itr->second;
+    }
+    const auto type = FindType(structType);
+    uint32_t words = 0;
+    for (uint32_t i = 0; type && i < member; i++) {
+        const auto x = FindType(type->mMembers[i]);
+        words += x ? x->mWords : 0;
+    }
+    return words * 4;
+}
+
+// Calls fn(byteOffset) for each scalar of `type`, in register order.
+template<typename F>
+bool
+Compiler::ForEachLeaf(const uint32_t typeId, const bool explicitLayout, const uint32_t offset,
+                      const F& fn)
+{
+    typedef Type::Kind Kind;
+    const auto type = FindType(typeId);
+    if (!type)
+        return false;
+
+    switch (type->mKind) {
+    case Kind::Bool:
+    case Kind::Int:
+    case Kind::Float:
+        fn(offset);
+        return true;
+    case Kind::Vector:
+        for (uint32_t i = 0; i < type->mLength; i++) {
+            fn(offset + 4 * i);
+        }
+        return true;
+    case Kind::Array: {
+        const auto elem = type->mElem;
+        const auto stride = Stride(typeId, explicitLayout);
+        for (uint32_t i = 0; i < type->mLength; i++) {
+            if (!ForEachLeaf(elem, explicitLayout, offset + i * stride, fn))
+                return false;
+        }
+        return true;
+    }
+    case Kind::Struct: {
+        const auto& members = type->mMembers;
+        for (uint32_t i = 0; i < members.size(); i++) {
+            const auto memberOffset = MemberOffset(typeId, i, explicitLayout);
+            if (!ForEachLeaf(members[i], explicitLayout, offset + memberOffset, fn))
+                return false;
+        }
+        return true;
+    }
+    default:
+        return Fail("Unsupported type in memory.");
+    }
+}
+
+bool
+Compiler::AccessChain(const uint32_t inst, const uint32_t* const p)
+{
+    typedef Type::Kind Kind;
+    const auto words = WordsOf(p);
+    const auto base = Get(inst, p[3]);
+    if (!base)
+        return false;
+    if (base->mKind != Value::Kind::Pointer)
+        return Fail("Unsupported pointer.");
+    Value ret = *base;
+
+    for (uint32_t w = 4; w < words; w++) {
+        const auto type = FindType(ret.mType);
+        if (!type)
+            return false;
+        const auto index = ConstBits(p[w]);
+        if (index && index->size() != 1)
+            return Fail("Bad index.");
+
+        uint32_t stride;
+        switch (type->mKind) {
+        case Kind::Struct: {
+            if (!index || index->at(0) >= type->mMembers.size())
+                return Fail("Bad member index.");
+            const auto member = index->at(0);
+            ret.mOffset += MemberOffset(ret.mType, member, ret.mExplicitLayout);
+            ret.mType = type->mMembers[member];
+            continue;
+        }
+        case Kind::Array:
+        case Kind::RuntimeArray:
+            stride = Stride(ret.mType, ret.mExplicitLayout);
+            break;
+        case Kind::Vector:
+            stride = 4;
+            break;
+        default:
+            return Fail("Bad access chain.");
+        }
+        ret.mType = type->mElem;
+
+        if (index) {
+            ret.mOffset += index->at(0) * stride;
+            continue;
+        }
+        if (ret.mSpace == Space::Builtin)
+            return Fail("Unsupported dynamic builtin index.");
+        const auto indexRegs = Regs(inst, p[w]);
+        if (!indexRegs)
+            return false;
+        auto term = indexRegs->at(0);
+        if (stride != 1) {
+            if (!(stride & (stride - 1))) {
+                uint32_t shift = 0;
+                while ((1u << shift) != stride) {
+                    shift++;
+                }
+                term = EmitValue(Op::Shl, term, ConstReg(shift));
+            } else {
+                term = EmitValue(Op::IMul, term, ConstReg(stride));
+            }
+        }
+        ret.mOffsetReg = ret.mOffsetReg ? EmitValue(Op::IAdd, ret.mOffsetReg, term) : term;
+    }
+
+    Def(inst, p[2]) = ret;
+    return true;
+}
+
+bool
+Compiler::Load(const Value& ptr, std::vector<uint32_t>* const out)
+{
+    if (ptr.mKind != Value::Kind::Pointer)
+        return Fail("Unsupported pointer.");
+    if (ptr.mSpace == Space::Builtin) {
+        const auto count = Scalars(ptr.mType);
+        for (uint32_t i = 0; i < count; i++) {
+            out->push_back(ptr.mBase + ptr.mOffset / 4 + i);
+        }
+        return count != 0;
+    }
+    return ForEachLeaf(ptr.mType, ptr.mExplicitLayout, ptr.mOffset, [&](const uint32_t offset) {
+        if (ptr.mSpace == Space::Local) {
+            out->push_back(EmitValue(Op::LoadLocal, 0, offset / 4, ptr.mOffsetReg));
+        } else {
+            out->push_back(EmitValue(Op::Load, ptr.mBase, offset, ptr.mOffsetReg));
+        }
+    });
+}
+
+bool
+Compiler::Store(const Value& ptr, const std::vector<uint32_t>& regs)
+{
+    if (ptr.mKind != Value::Kind::Pointer || ptr.mSpace == Space::Builtin)
+        return Fail("Unsupported pointer.");
+    if (Scalars(ptr.mType) != regs.size())
+        return Fail("Mismatched store.");
+    size_t i = 0;
+    return ForEachLeaf(ptr.mType, ptr.mExplicitLayout, ptr.mOffset, [&](const uint32_t offset) {
+        if (ptr.mSpace == Space::Local) {
+            EmitRaw(Op::StoreLocal, 0, 0, offset / 4, ptr.mOffsetReg, regs[i++]);
+        } else {
+            EmitRaw(Op::Store, 0, ptr.mBase, offset, ptr.mOffsetReg, regs[i++]);
+        }
+    });
+}
+
+bool
+Compiler::Atomic(const uint32_t inst, const uint32_t* const p)
+{
+    typedef MirvShaderAtomic Kind;
+    const auto op = OpOf(p);
+    const auto ptrId = (op == SpvOpAtomicStore) ? p[1] : p[3];
+    const auto ptr = Get(inst, ptrId);
+    if (!ptr)
+        return false;
+
+    if (op == SpvOpAtomicLoad) {
+        std::vector<uint32_t> regs;
+        if (!Load(*ptr, &regs))
+            return false;
+        DefRegs(inst, p[2], std::move(regs));
+        return true;
+    }
+    if (op == SpvOpAtomicStore) {
+        const auto regs = Regs(inst, p[4]);
+        return regs && Store(*ptr, *regs);
+    }
+    if (ptr->mKind != Value::Kind::Pointer || ptr->mSpace != Space::Memory ||
+        Scalars(ptr->mType) != 1)
+    {
+        return Fail("Unsupported atomic.");
+    }
+
+    Kind kind;
+    uint32_t operand;
+    uint32_t dst = NewReg();
+    switch (op) {
+    case SpvOpAtomicIIncrement: kind = Kind::Add; operand = ConstReg(1); break;
+    case SpvOpAtomicIDecrement: kind = Kind::Sub; operand = ConstReg(1); break;
+    case SpvOpAtomicCompareExchange: {
+        const auto value = Regs(inst, p[7]);
+        const auto comparator = Regs(inst, p[8]);
+        if (!value || !comparator)
+            return false;
+        kind = Kind::CompareExchange;
+        operand = value->at(0);
+        EmitRaw(Op::Mov, dst, comparator->at(0));
+        break;
+    }
+    default: {
+        static const std::pair<SpvOp, Kind> kKinds[] = {
+            { SpvOpAtomicExchange, Kind::Exchange },
+            { SpvOpAtomicIAdd, Kind::Add },
+            { SpvOpAtomicISub, Kind::Sub },
+            { SpvOpAtomicSMin, Kind::SMin },
+            { SpvOpAtomicUMin, Kind::UMin },
+            { SpvOpAtomicSMax, Kind::SMax },
+            { SpvOpAtomicUMax, Kind::UMax },
+            { SpvOpAtomicAnd, Kind::And },
+            { SpvOpAtomicOr, Kind::Or },
+            { SpvOpAtomicXor, Kind::Xor },
+        };
+        const auto itr = std::find_if(std::begin(kKinds), std::end(kKinds),
+                                      [&](const std::pair<SpvOp, Kind>& x) {
+                                          return x.first == op;
+                                      });
+        const auto value = Regs(inst, p[6]);
+        if (itr == std::end(kKinds) || !value)
+            return Fail("Unsupported atomic.");
+        kind = itr->second;
+        operand = value->at(0);
+        break;
+    }
+    }
+    EmitRaw(Op::Atomic, dst, ptr->mBase, ptr->mOffset, ptr->mOffsetReg, operand,
+            uint16_t(uint32_t(kind) << kMirvOpAtomicShift));
+    DefRegs(inst, p[2], { dst });
+    return true;
+}
+
+// -------------------------------------
+
+bool
+Compiler::CompileNode(const uint32_t node)
+{
+    const auto inst = mNodes[node].mInstance;
+    const auto end = mNodes[node].mEnd;
+    for (auto p = mNodes[node].mBegin; p < end; p += WordsOf(p)) {
+        const auto op = OpOf(p);
+        if (IsTerminator(op)) {
+            if (!CompileTerminator(node, p))
+                return false;
+            continue;
+        }
+        if (op != SpvOpFunctionCall) {
+            if (!CompileInst(inst, p))
+                return false;
+            continue;
+        }
+
+        // Hand our arguments to the callee, and run it next.
+        const auto callee = mNodes[node].mCallee;
+        const auto funcItr = mFunctions.find(p[3]);
+        if (funcItr == mFunctions.end())
+            return Fail("Unknown function.");
+        const auto& params = funcItr->second.mParams;
+        if (params.size() != WordsOf(p) - 4)
+            return Fail("Bad call.");
+        for (uint32_t i = 0; i < params.size(); i++) {
+            const auto arg = Get(inst, p[4 + i]);
+            if (!arg)
+                return false;
+            const auto copy = *arg;
+            mInstances[callee].mValues[params[i]] = copy;
+        }
+        if (!mInstances[callee].mReturnRegs.empty()) {
+            DefRegs(inst, p[2], mInstances[callee].mReturnRegs);
+        }
+        EmitRaw(Op::Branch, mNodes[mNodes[node].mSuccs[0]].mMask, 0);
+    }
+    return true;
+}
+
+bool
+Compiler::CompileInst(const uint32_t inst, const uint32_t* const p)
+{
+    const auto op = OpOf(p);
+    const auto words = WordsOf(p);
+
+    if (const auto simple = FindOp(std::begin(kSimpleOps), std::end(kSimpleOps), op)) {
+        if (words != 3u + simple->mOperands)
+            return Fail("Bad instruction.");
+        uint32_t operands[2] = { p[3], simple->mOperands > 1 ? p[4] : 0 };
+        if (simple->mSwap) {
+            std::swap(operands[0], operands[1]);
+        }
+        return PerComponent(inst, p[1], p[2], operands, simple->mOperands,
+                            [&](const uint32_t* const x) {
+                                return EmitValue(simple->mOp, x[0], x[1]);
+                            });
+    }
+
+    switch (op) {
+    case SpvOpNop:
+    case SpvOpLine:
+    case SpvOpNoLine:
+    case SpvOpSelectionMerge:
+    case SpvOpLoopMerge:
+    case SpvOpControlBarrier: // A batch is a whole workgroup.
+    case SpvOpMemoryBarrier:  // Lanes run in lockstep.
+        return true;
+
+    case SpvOpPhi:
+        PhiRegs(inst, p);
+        return true;
+
+    case SpvOpUndef:
+        DefRegs(inst, p[2], std::vector<uint32_t>(Scalars(p[1]), ConstReg(0)));
+        return true;
+
+    case SpvOpVariable: {
+        const auto ptrType = FindType(p[1]);
+        const auto pointee = ptrType ? FindType(ptrType->mElem) : nullptr;
+        if (!pointee)
+            return false;
+        if (p[3] != SpvStorageClassFunction)
+            return Fail("Bad OpVariable.");
+        auto& x = Def(inst, p[2]);
+        x.mKind = Value::Kind::Pointer;
+        x.mSpace = Space::Local;
+        x.mType = ptrType->mElem;
+        x.mOffset = mOut.mLocalWords * 4;
+        mOut.mLocalWords += pointee->mWords;
+        if (words >= 5) {
+            const auto var = x;
+            const auto init = Regs(inst, p[4]);
+            return init && Store(var, *init);
+        }
+        return true;
+    }
+
+    case SpvOpLoad: {
+        const auto ptr = Get(inst, p[3]);
+        std::vector<uint32_t> regs;
+        if (!ptr || !Load(*ptr, &regs))
+            return false;
+        DefRegs(inst, p[2], std::move(regs));
+        return true;
+    }
+    case SpvOpStore: {
+        const auto ptr = Get(inst, p[1]);
+        const auto regs = Regs(inst, p[2]);
+        return ptr && regs && Store(*ptr, *regs);
+    }
+    case SpvOpAccessChain:
+    case SpvOpInBoundsAccessChain:
+        return AccessChain(inst, p);
+
+    case SpvOpCopyObject:
+    case SpvOpBitcast:
+    case SpvOpUConvert: // Only 32-bit types get this far.
+    case SpvOpSConvert:
+    case SpvOpFConvert: {
+        const auto x = Get(inst, p[3]);
+        if (!x)
+            return false;
+        const auto copy = *x;
+        Def(inst, p[2]) = copy;
+        return true;
+    }
+
+    case SpvOpCompositeConstruct: {
+        std::vector<uint32_t> regs;
+        for (uint32_t w = 3; w < words; w++) {
+            const auto part = Regs(inst, p[w]);
+            if (!part)
+                return false;
+            regs.insert(regs.end(), part->begin(), part->end());
+        }
+        if (regs.size() != Scalars(p[1]))
+            return Fail("Bad OpCompositeConstruct.");
+        DefRegs(inst, p[2], std::move(regs));
+        return true;
+    }
+    case SpvOpCompositeExtract:
+    case SpvOpCompositeInsert: {
+        const bool insert = (op == SpvOpCompositeInsert);
+        const auto composite = Regs(inst, p[insert ? 4 : 3]);
+        if (!composite)
+            return false;
+        // Find the part's registers.
+        const auto typeItr = mIdTypes.find(p[insert ? 4 : 3]);
+        if (typeItr == mIdTypes.end())
+            return Fail("Unknown composite type.");
+        auto type = typeItr->second;
+        uint32_t first = 0;
+        uint32_t count = uint32_t(composite->size());
+        for (uint32_t w = insert ? 5 : 4; w < words; w++) {
+            const auto index = p[w];
+            const auto t = FindType(type);
+            if (!t)
+                return false;
+            switch (t->mKind) {
+            case Type::Kind::Vector:
+            case Type::Kind::Array: {
+                const auto elemScalars = Scalars(t->mElem);
+                if (index >= t->mLength)
+                    return Fail("Bad composite index.");
+                first += index * elemScalars;
+                count = elemScalars;
+                type = t->mElem;
+                break;
+            }
+            case Type::Kind::Struct: {
+                if (index >= t->mMembers.size())
+                    return Fail("Bad composite index.");
+                for (uint32_t i = 0; i < index; i++) {
+                    first += Scalars(t->mMembers[i]);
+                }
+                count = Scalars(t->mMembers[index]);
+                type = t->mMembers[index];
+                break;
+            }
+            default:
+                return Fail("Bad composite access.");
+            }
+        }
+        if (first + count > composite->size())
+            return Fail("Bad composite access.");
+        if (!insert) {
+            DefRegs(inst, p[2], std::vector<uint32_t>(composite->begin() + first,
+                                                      composite->begin() + first + count));
+            return true;
+        }
+        const auto object = Regs(inst, p[3]);
+        if (!object || object->size() != count)
+            return false;
+        auto regs = *composite;
+        std::copy(object->begin(), object->end(), regs.begin() + first);
+        DefRegs(inst, p[2], std::move(regs));
+        return true;
+    }
+    case SpvOpVectorShuffle: {
+        const auto a = Regs(inst, p[3]);
+        const auto b = Regs(inst, p[4]);
+        if (!a || !b)
+            return false;
+        std::vector<uint32_t> regs;
+        for (uint32_t w = 5; w < words; w++) {
+            const auto index = p[w];
+            if (index == UINT32_MAX) {
+                regs.push_back(ConstReg(0));
+            } else if (index < a->size()) {
+                regs.push_back(a->at(index));
+            } else if (index - a->size() < b->size()) {
+                regs.push_back(b->at(index - a->size()));
+            } else {
+                return Fail("Bad shuffle.");
+            }
+        }
+        DefRegs(inst, p[2], std::move(regs));
+        return true;
+    }
+    case SpvOpVectorExtractDynamic:
+    case SpvOpVectorInsertDynamic: {
+        const bool insert = (op == SpvOpVectorInsertDynamic);
+        const auto vec = Regs(inst, p[3]);
+        const auto index = Regs(inst, p[insert ? 5 : 4]);
+        const auto comp = insert ? Regs(inst, p[4]) : vec;
+        if (!vec || !index || !comp)
+            return false;
+        if (!insert) {
+            auto ret = vec->at(0);
+            for (uint32_t i = 1; i < vec->size(); i++) {
+                const auto match = EmitValue(Op::IEq, index->at(0), ConstReg(i));
+                ret = EmitValue(Op::Select, match, vec->at(i), ret);
+            }
+            DefRegs(inst, p[2], { ret });
+            return true;
+        }
+        std::vector<uint32_t> regs;
+        for (uint32_t i = 0; i < vec->size(); i++) {
+            const auto match = EmitValue(Op::IEq, index->at(0), ConstReg(i));
+            regs.push_back(EmitValue(Op::Select, match, comp->at(0), vec->at(i)));
+        }
+        DefRegs(inst, p[2], std::move(regs));
+        return true;
+    }
+
+    case SpvOpSelect: {
+        const uint32_t operands[] = { p[3], p[4], p[5] };
+        return PerComponent(inst, p[1], p[2], operands, 3, [&](const uint32_t* const x) {
+            return EmitValue(Op::Select, x[0], x[1], x[2]);
+        });
+    }
+    case SpvOpDot: {
+        const auto a = Regs(inst, p[3]);
+        const auto b = Regs(inst, p[4]);
+        if (!a || !b || a->size() != b->size())
+            return Fail("Bad OpDot.");
+        DefRegs(inst, p[2], { Dot(*a, *b) });
+        return true;
+    }
+    case SpvOpAny:
+    case SpvOpAll: {
+        const auto x = Regs(inst, p[3]);
+        if (!x || x->empty())
+            return false;
+        auto ret = x->at(0);
+        for (size_t i = 1; i < x->size(); i++) {
+            ret = EmitValue((op == SpvOpAny) ? Op::Or : Op::And, ret, x->at(i));
+        }
+        DefRegs(inst, p[2], { ret });
+        return true;
+    }
+
+    case SpvOpExtInst:
+        return CompileExtInst(inst, p);
+
+    case SpvOpAtomicLoad:
+    case SpvOpAtomicStore:
+    case SpvOpAtomicExchange:
+    case SpvOpAtomicCompareExchange:
+    case SpvOpAtomicIIncrement:
+    case SpvOpAtomicIDecrement:
+    case SpvOpAtomicIAdd:
+    case SpvOpAtomicISub:
+    case SpvOpAtomicSMin:
+    case SpvOpAtomicUMin:
+    case SpvOpAtomicSMax:
+    case SpvOpAtomicUMax:
+    case SpvOpAtomicAnd:
+    case SpvOpAtomicOr:
+    case SpvOpAtomicXor:
+        return Atomic(inst, p);
+
+    default:
+        return Fail("Unsupported instruction.");
+    }
+}
+
+bool
+Compiler::CompileExtInst(const uint32_t inst, const uint32_t* const p)
+{
+    const auto words = WordsOf(p);
+    if (p[3] != mGlsl || words < 6)
+        return Fail("Unsupported extended instruction set.");
+    const auto which = p[4];
+    const auto operands = p + 5;
+    const auto operandCount = words - 5;
+    const auto resultType = p[1];
+    const auto resultId = p[2];
+
+    if (const auto simple = FindOp(std::begin(kGlslOps), std::end(kGlslOps), which)) {
+        if (operandCount != simple->mOperands)
+            return Fail("Bad extended instruction.");
+        return PerComponent(inst, resultType, resultId, operands, operandCount,
+                            [&](const uint32_t* const x) {
+                                return EmitValue(simple->mOp, x[0], x[1], x[2]);
+                            });
+    }
+
+    const auto Const = [&](const float f) { return ConstReg(FloatBits(f)); };
+    const auto Clamp = [&](const Op maxOp, const Op minOp) {
+        return PerComponent(inst, resultType, resultId, operands, 3,
+                            [&](const uint32_t* const x) {
+                                return EmitValue(minOp, EmitValue(maxOp, x[0], x[1]), x[2]);
+                            });
+    };
+
+    switch (which) {
+    case GLSLstd450Radians:
+    case GLSLstd450Degrees: {
+        const auto scale = Const((which == GLSLstd450Radians) ? 0.017453292519943295f
+                                                              : 57.29577951308232f);
+        return PerComponent(inst, resultType, resultId, operands, 1,
+                            [&](const uint32_t* const x) {
+                                return EmitValue(Op::FMul, x[0], scale);
+                            });
+    }
+    case GLSLstd450FClamp:
+    case GLSLstd450NClamp:
+        return Clamp(Op::FMax, Op::FMin);
+    case GLSLstd450UClamp:
+        return Clamp(Op::UMax, Op::UMin);
+    case GLSLstd450SClamp:
+        return Clamp(Op::SMax, Op::SMin);
+    case GLSLstd450FMix:
+        // x + (y - x) * a
+        return PerComponent(inst, resultType, resultId, operands, 3,
+                            [&](const uint32_t* const x) {
+                                return EmitValue(Op::Fma, EmitValue(Op::FSub, x[1], x[0]),
+                                                 x[2], x[0]);
+                            });
+    case GLSLstd450Step: {
+        const auto zero = Const(0.0f);
+        const auto one = Const(1.0f);
+        return PerComponent(inst, resultType, resultId, operands, 2,
+                            [&](const uint32_t* const x) {
+                                return EmitValue(Op::Select, EmitValue(Op::FOrdLt, x[1], x[0]),
+                                                 zero, one);
+                            });
+    }
+    case GLSLstd450SmoothStep: {
+        const auto zero = Const(0.0f);
+        const auto one = Const(1.0f);
+        const auto two = Const(2.0f);
+        const auto three = Const(3.0f);
+        return PerComponent(inst, resultType, resultId, operands, 3,
+                            [&](const uint32_t* const x) {
+                                // t = clamp((x - e0) / (e1 - e0), 0, 1); t * t * (3 - 2t)
+                                auto t = EmitValue(Op::FDiv, EmitValue(Op::FSub, x[2], x[0]),
+                                                   EmitValue(Op::FSub, x[1], x[0]));
+                                t = EmitValue(Op::FMin, EmitValue(Op::FMax, t, zero), one);
+                                const auto poly = EmitValue(Op::FSub, three,
+                                                            EmitValue(Op::FMul, two, t));
+                                return EmitValue(Op::FMul, EmitValue(Op::FMul, t, t), poly);
+                            });
+    }
+    case GLSLstd450Length:
+    case GLSLstd450Distance:
+    case GLSLstd450Normalize: {
+        const auto a = Regs(inst, operands[0]);
+        if (!a)
+            return false;
+        auto vec = *a;
+        if (which == GLSLstd450Distance) {
+            const auto b = (operandCount == 2) ? Regs(inst, operands[1]) : nullptr;
+            if (!b || b->size() != vec.size())
+                return Fail("Bad distance.");
+            for (size_t i = 0; i < vec.size(); i++) {
+                vec[i] = EmitValue(Op::FSub, vec[i], b->at(i));
+            }
+        }
+        const auto dot = Dot(vec, vec);
+        if (which != GLSLstd450Normalize) {
+            DefRegs(inst, resultId, { EmitValue(Op::Sqrt, dot) });
+            return true;
+        }
+        const auto scale = EmitValue(Op::InvSqrt, dot);
+        for (auto& x : vec) {
+            x = EmitValue(Op::FMul, x, scale);
+        }
+        DefRegs(inst, resultId, std::move(vec));
+        return true;
+    }
+    case GLSLstd450PackUnorm4x8: {
+        const auto x = Regs(inst, operands[0]);
+        if (!x || x->size() != 4)
+            return Fail("Bad PackUnorm4x8.");
+        DefRegs(inst, resultId, { EmitValue(Op::PackUnorm4x8, x->at(0), x->at(1), x->at(2),
+                                            x->at(3)) });
+        return true;
+    }
+    case GLSLstd450UnpackUnorm4x8: {
+        const auto x = Regs(inst, operands[0]);
+        if (!x || x->size() != 1)
+            return Fail("Bad UnpackUnorm4x8.");
+        const auto dst = NewRegs(4);
+        EmitRaw(Op::UnpackUnorm4x8, dst, x->at(0), 0, 0, 0,
+                mMaskedRegion ? kMirvOpMasked : 0);
+        DefRegs(inst, resultId, { dst, dst + 1, dst + 2, dst + 3 });
+        return true;
+    }
+    default:
+        return Fail("Unsupported GLSL.std.450 instruction.");
+    }
+}
+
+// -------------------------------------
+
+bool
+Compiler::PhiCopies(const uint32_t node, const uint32_t label, const uint32_t mask)
+{
+    const auto succ = NodeFor(node, label);
+    if (succ == kNone)
+        return Fail("Unknown label.");
+    const auto inst = mNodes[node].mInstance;
+    const auto from = mNodes[node].mLabel;
+
+    struct Copy final {
+        uint32_t mDst;
+        uint32_t mSrc;
+    };
+    std::vector<Copy> copies;
+    std::vector<uint32_t> phiRegs;
+    for (auto p = mNodes[succ].mBegin; p < mNodes[succ].mEnd && OpOf(p) == SpvOpPhi;
+         p += WordsOf(p))
+    {
+        const auto& dst = PhiRegs(inst, p);
+        phiRegs.insert(phiRegs.end(), dst.begin(), dst.end());
+        uint32_t valueId = kNone;
+        for (uint32_t w = 3; w + 1 < WordsOf(p); w += 2) {
+            if (p[w + 1] == from) {
+                valueId = p[w];
+            }
+        }
+        if (valueId == kNone)
+            return Fail("Phi without our edge.");
+        const auto src = Regs(inst, valueId);
+        if (!src || src->size() != dst.size())
+            return false;
+        for (size_t i = 0; i < dst.size(); i++) {
+            copies.push_back({ dst[i], src->at(i) });
+        }
+    }
+
+    // Phis copy in parallel, so if any reads another's register, read them all first.
+    const bool overlap = std::any_of(copies.begin(), copies.end(), [&](const Copy& x) {
+        return std::find(phiRegs.begin(), phiRegs.end(), x.mSrc) != phiRegs.end();
+    });
+    if (overlap) {
+        for (auto& x : copies) {
+            const auto temp = NewReg();
+            EmitRaw(Op::Mov, temp, x.mSrc);
+            x.mSrc = temp;
+        }
+    }
+    for (const auto& x : copies) {
+        EmitRaw(Op::MovIf, x.mDst, x.mSrc, 0, mask);
+    }
+    return true;
+}
+
+bool
+Compiler::Edge(const uint32_t node, const uint32_t label, const uint32_t mask)
+{
+    if (!PhiCopies(node, label, mask))
+        return false;
+    const auto succ = NodeFor(node, label);
+    EmitRaw(Op::Branch, mNodes[succ].mMask, mask);
+    return true;
+}
+
+bool
+Compiler::CompileTerminator(const uint32_t node, const uint32_t* const p)
+{
+    const auto inst = mNodes[node].mInstance;
+    switch (OpOf(p)) {
+    case SpvOpBranch:
+        return Edge(node, p[1], 0);
+
+    case SpvOpBranchConditional: {
+        const auto cond = Regs(inst, p[1]);
+        if (!cond)
+            return false;
+        if (p[2] == p[3])
+            return Edge(node, p[2], 0);
+
+        // Phis copy under their edge's mask: exec & cond, or exec & ~cond.
+        const uint32_t labels[] = { p[2], p[3] };
+        const Op edgeOps[] = { Op::And, Op::AndNot };
+        for (uint32_t i = 0; i < 2; i++) {
+            const auto succ = NodeFor(node, labels[i]);
+            if (succ == kNone)
+                return Fail("Unknown label.");
+            if (OpOf(mNodes[succ].mBegin) != SpvOpPhi)
+                continue;
+            const auto mask = NewReg();
+            EmitRaw(edgeOps[i], mask, 0, cond->at(0));
+            if (!PhiCopies(node, labels[i], mask))
+                return false;
+        }
+        EmitRaw(Op::BranchCond, mNodes[NodeFor(node, p[2])].mMask, cond->at(0),
+                mNodes[NodeFor(node, p[3])].mMask);
+        return true;
+    }
+
+    case SpvOpSwitch: {
+        const auto sel = Regs(inst, p[1]);
+        if (!sel)
+            return false;
+        // Cases take their lanes out of `rest`, and the default gets what's left.
+        const auto rest = NewReg();
+        EmitRaw(Op::Mov, rest, 0);
+        for (uint32_t w = 3; w + 1 < WordsOf(p); w += 2) {
+            const auto taken = NewReg();
+            EmitRaw(Op::IEq, taken, sel->at(0), ConstReg(p[w]));
+            EmitRaw(Op::And, taken, taken, rest);
+            EmitRaw(Op::AndNot, rest, rest, taken);
+            if (!Edge(node, p[w + 1], taken))
+                return false;
+        }
+        return Edge(node, p[2], rest);
+    }
+
+    case SpvOpReturn:
+    case SpvOpReturnValue: {
+        const auto& instance = mInstances[inst];
+        if (instance.mReturnNode == kNone)
+            return true; // These lanes are done.
+        if (OpOf(p) == SpvOpReturnValue) {
+            const auto value = Regs(inst, p[1]);
+            if (!value || value->size() != instance.mReturnRegs.size())
+                return Fail("Bad return value.");
+            for (size_t i = 0; i < value->size(); i++) {
+                EmitRaw(Op::MovIf, instance.mReturnRegs[i], value->at(i), 0, 0);
+            }
+        }
+        EmitRaw(Op::Branch, mNodes[instance.mReturnNode].mMask, 0);
+        return true;
+    }
+
+    default: // Kill and Unreachable
+        return true;
+    }
+}
+
+} // namespace
+
+// -------------------------------------
+
+MirvSpirvModule::MirvSpirvModule()
+    : mUsesPushConstants(false)
+    , mDetails(new Details)
+{ }
+
+MirvSpirvModule::~MirvSpirvModule() = default;
+
+const MirvSpirvModule::EntryPoint*
+MirvSpirvModule::FindEntryPoint(const char* const name) const
+{
+    for (const auto& x : mEntryPoints) {
+        if (x.mName == name)
+            return &x;
+    }
+    return nullptr;
+}
+
+std::unique_ptr<const MirvSpirvModule>
+MirvParseSpirv(const uint32_t* const words, const size_t wordCount)
+{
+    std::unique_ptr<MirvSpirvModule> ret(new MirvSpirvModule);
+    Parser parser(words, wordCount, ret.get());
+    if (!parser.Parse()) {
+#ifdef DEBUG
+        printf("mirv: Can't parse SPIR-V: %s\n", parser.mError);
+#endif
+        return nullptr;
+    }
+    return std::move(ret);
+}
+
+VkResult
+MirvCompileSpirv(const MirvSpirvModule& module, const char* const entryPoint,
+                 const VkSpecializationInfo* const spec, MirvShaderProgram* const out)
+{
+    *out = MirvShaderProgram();
+
+    Compiler compiler(module, module.FindEntryPoint(entryPoint), spec, out);
+    if (!compiler.Compile()) {
+#ifdef DEBUG
+        printf("mirv: Can't compile SPIR-V: %s\n", compiler.mError);
+#endif
+        return VK_ERROR_NOT_IMPLEMENTED;
+    }
+    // Scratch memory must stay addressable.
+    out->mLocalWords = std::max(out->mLocalWords, 1u);
+    return VK_SUCCESS;
+}
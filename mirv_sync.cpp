@@ -0,0 +1,197 @@
+#include "mirv_sync.h"
+
+#include <algorithm>
+#include <chrono>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#else
+#include <condition_variable>
+#include <mutex>
+#endif
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+              "Futexes need a plain 32-bit word.");
+
+uint64_t
+MirvNowNs()
+{
+    const auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+}
+
+// --
+
+#if defined(__linux__)
+
+bool
+MirvFutexWait(const std::atomic<uint32_t>& word, const uint32_t expected,
+              const uint64_t timeoutNs)
+{
+    timespec ts;
+    timespec* pts = nullptr;
+    if (timeoutNs != kMirvInfiniteTimeout) {
+        ts.tv_sec = time_t(timeoutNs / 1000000000);
+        ts.tv_nsec = long(timeoutNs % 1000000000);
+        pts = &ts;
+    }
+    const auto ret = syscall(SYS_futex, &word, FUTEX_WAIT_PRIVATE, expected, pts,
+                             nullptr, 0);
+    return !(ret == -1 && errno == ETIMEDOUT);
+}
+
+void
+MirvFutexWakeAll(const std::atomic<uint32_t>& word)
+{
+    syscall(SYS_futex, &word, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+}
+
+#elif defined(_WIN32)
+
+bool
+MirvFutexWait(const std::atomic<uint32_t>& word, uint32_t expected,
+              const uint64_t timeoutNs)
+{
+    DWORD ms = INFINITE;
+    if (timeoutNs != kMirvInfiniteTimeout) {
+        ms = DWORD(std::min<uint64_t>((timeoutNs + 999999) / 1000000, INFINITE - 1));
+    }
+    if (WaitOnAddress((volatile void*)&word, &expected, sizeof(expected), ms))
+        return true;
+    return GetLastError() != ERROR_TIMEOUT;
+}
+
+void
+MirvFutexWakeAll(const std::atomic<uint32_t>& word)
+{
+    WakeByAddressAll((void*)&word);
+}
+
+#else
+
+// No futex, so hash words onto a fixed set of condition variables.
+namespace {
+
+struct Bucket final {
+    std::mutex mMutex;
+    std::condition_variable mCond;
+};
+
+Bucket&
+BucketFor(const std::atomic<uint32_t>& word)
+{
+    static Bucket sBuckets[64];
+    return sBuckets[(uintptr_t(&word) / sizeof(word)) % 64];
+}
+
+} // namespace
+
+bool
+MirvFutexWait(const std::atomic<uint32_t>& word, const uint32_t expected,
+              const uint64_t timeoutNs)
+{
+    auto& bucket = BucketFor(word);
+    std::unique_lock<std::mutex> lock(bucket.mMutex);
+    if (word.load() != expected)
+        return true;
+    if (timeoutNs == kMirvInfiniteTimeout) {
+        bucket.mCond.wait(lock);
+        return true;
+    }
+    return bucket.mCond.wait_for(lock, std::chrono::nanoseconds(timeoutNs)) ==
+           std::cv_status::no_timeout;
+}
+
+void
+MirvFutexWakeAll(const std::atomic<uint32_t>& word)
+{
+    auto& bucket = BucketFor(word);
+    {
+        const std::lock_guard<std::mutex> guard(bucket.mMutex);
+    }
+    bucket.mCond.notify_all();
+}
+
+#endif
+
+// -------------------------------------
+
+bool
+MirvFutexFlag::WaitUntil(const uint64_t deadlineNs)
+{
+    while (true) {
+        auto state = mState.load(std::memory_order_acquire);
+        if (state == kSet)
+            return true;
+        if (state == kUnset) {
+            if (!mState.compare_exchange_weak(state, kUnsetWithWaiters,
+                                              std::memory_order_acquire))
+            {
+                continue;
+            }
+        }
+
+        uint64_t timeout = kMirvInfiniteTimeout;
+        if (deadlineNs != kMirvInfiniteTimeout) {
+            const auto now = MirvNowNs();
+            if (now >= deadlineNs)
+                return IsSet();
+            timeout = deadlineNs - now;
+        }
+        (void)MirvFutexWait(mState, kUnsetWithWaiters, timeout);
+    }
+}
+
+// -------------------------------------
+
+MirvMpscQueue::MirvMpscQueue()
+    : mHead(&mStub)
+    , mTail(&mStub)
+{
+    mStub.mNext.store(nullptr, std::memory_order_relaxed);
+}
+
+void
+MirvMpscQueue::Push(MirvMpscNode* const node)
+{
+    node->mNext.store(nullptr, std::memory_order_relaxed);
+    const auto prev = mHead.exchange(node, std::memory_order_acq_rel);
+    prev->mNext.store(node, std::memory_order_release);
+}
+
+MirvMpscNode*
+MirvMpscQueue::Pop()
+{
+    auto tail = mTail;
+    auto next = tail->mNext.load(std::memory_order_acquire);
+    if (tail == &mStub) {
+        if (!next)
+            return nullptr;
+        mTail = next;
+        tail = next;
+        next = next->mNext.load(std::memory_order_acquire);
+    }
+    if (next) {
+        mTail = next;
+        return tail;
+    }
+
+    if (tail != mHead.load(std::memory_order_acquire))
+        return nullptr; // A push is mid-flight.
+
+    // `tail` is the last node, so put the stub behind it, so we can pop it.
+    Push(&mStub);
+    next = tail->mNext.load(std::memory_order_acquire);
+    if (next) {
+        mTail = next;
+        return tail;
+    }
+    return nullptr;
+}
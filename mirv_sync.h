@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// --
+
+const uint64_t kMirvInfiniteTimeout = UINT64_MAX;
+
+// Futex-style waits on a 32-bit word: Blocks while `word == expected`, until woken or
+// `timeoutNs` passes. Wakeups may be spurious, so callers re-check in a loop.
+// Returns false on timeout.
+bool MirvFutexWait(const std::atomic<uint32_t>& word, uint32_t expected, uint64_t timeoutNs);
+void MirvFutexWakeAll(const std::atomic<uint32_t>& word);
+
+// Nanoseconds on a monotonic clock.
+uint64_t MirvNowNs();
+
+// --
+
+// A manual-reset event. Setting it only makes a syscall if someone is waiting.
+class MirvFutexFlag final
+{
+    enum : uint32_t {
+        kUnset,
+        kUnsetWithWaiters,
+        kSet,
+    };
+
+    std::atomic<uint32_t> mState;
+
+public:
+    explicit MirvFutexFlag(bool set = false)
+        : mState(set ? kSet : kUnset)
+    { }
+
+    bool IsSet() const { return mState.load(std::memory_order_acquire) == kSet; }
+
+    void Set() {
+        const auto was = mState.exchange(kSet, std::memory_order_acq_rel);
+        if (was == kUnsetWithWaiters) {
+            MirvFutexWakeAll(mState);
+        }
+    }
+
+    // A no-op unless set, so it never drops a waiter's kUnsetWithWaiters.
+    void Reset() {
+        auto expected = uint32_t(kSet);
+        mState.compare_exchange_strong(expected, kUnset, std::memory_order_acq_rel,
+                                       std::memory_order_relaxed);
+    }
+
+    // Waits until `deadlineNs`, on MirvNowNs's clock. Returns IsSet().
+    bool WaitUntil(uint64_t deadlineNs);
+};
+
+// --
+
+// Counts work in flight, so its owner can wait for all of it to finish.
+class MirvPendingCount final
+{
+    std::atomic<uint32_t> mCount;
+
+public:
+    MirvPendingCount() : mCount(0) {}
+
+    void Add(const uint32_t n) { mCount.fetch_add(n, std::memory_order_relaxed); }
+
+    void Done() {
+        if (mCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            MirvFutexWakeAll(mCount);
+        }
+    }
+
+    void WaitForZero() const {
+        uint32_t count;
+        while ((count = mCount.load(std::memory_order_acquire))) {
+            (void)MirvFutexWait(mCount, count, kMirvInfiniteTimeout);
+        }
+    }
+};
+
+// --
+
+struct MirvMpscNode
+{
+    std::atomic<MirvMpscNode*> mNext;
+};
+
+// Vyukov's intrusive multi-producer, single-consumer queue.
+// Pushing is wait-free: one exchange and one store. Pop is consumer-only, and may
+// briefly return null while a push is halfway done.
+class MirvMpscQueue final
+{
+    std::atomic<MirvMpscNode*> mHead; // Producers push here.
+    MirvMpscNode* mTail;              // Consumer pops here.
+    MirvMpscNode mStub;
+
+public:
+    MirvMpscQueue();
+
+    void Push(MirvMpscNode* node);
+    MirvMpscNode* Pop();
+};
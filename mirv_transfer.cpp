@@ -0,0 +1,419 @@
+#include "mirv_transfer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "util.h"
+
+#ifdef MIRV_SSE2
+
+#include <emmintrin.h>
+
+// Gets `dst` to 16-byte alignment with ordinary stores, and returns how far it went.
+static inline size_t
+HeadBytes(const uint8_t* const dst, const size_t size)
+{
+    const auto misalign = size_t(-intptr_t(dst)) & 15;
+    return misalign < size ? misalign : size;
+}
+
+void
+MirvCopyBytes(uint8_t* dst, const uint8_t* src, size_t size, const bool streaming)
+{
+    if (!streaming) {
+        memcpy(dst, src, size);
+        return;
+    }
+    const auto head = HeadBytes(dst, size);
+    memcpy(dst, src, head);
+    dst += head;
+    src += head;
+    size -= head;
+
+    for (; size >= 64; size -= 64, dst += 64, src += 64) {
+        const auto a = _mm_loadu_si128((const __m128i*)src);
+        const auto b = _mm_loadu_si128((const __m128i*)(src + 16));
+        const auto c = _mm_loadu_si128((const __m128i*)(src + 32));
+        const auto d = _mm_loadu_si128((const __m128i*)(src + 48));
+        _mm_stream_si128((__m128i*)dst, a);
+        _mm_stream_si128((__m128i*)(dst + 16), b);
+        _mm_stream_si128((__m128i*)(dst + 32), c);
+        _mm_stream_si128((__m128i*)(dst + 48), d);
+    }
+    memcpy(dst, src, size);
+    // Streaming stores aren't ordered with the release that publishes our completion.
+    _mm_sfence();
+}
+
+void
+MirvFillBytes(uint8_t* dst, const uint32_t data, size_t size, const bool streaming)
+{
+    const auto head = HeadBytes(dst, size);
+    for (size_t i = 0; i < head; i += 4) {
+        memcpy(dst + i, &data, 4);
+    }
+    dst += head;
+    size -= head;
+
+    const auto v = _mm_set1_epi32(int(data));
+    if (streaming) {
+        for (; size >= 64; size -= 64, dst += 64) {
+            _mm_stream_si128((__m128i*)dst, v);
+            _mm_stream_si128((__m128i*)(dst + 16), v);
+            _mm_stream_si128((__m128i*)(dst + 32), v);
+            _mm_stream_si128((__m128i*)(dst + 48), v);
+        }
+        _mm_sfence();
+    }
+    for (; size >= 16; size -= 16, dst += 16) {
+        _mm_store_si128((__m128i*)dst, v);
+    }
+    for (size_t i = 0; i < size; i += 4) {
+        memcpy(dst + i, &data, 4);
+    }
+}
+
+#else // MIRV_SSE2
+
+// No portable streaming stores here. memcpy and the vectorizer do fine.
+
+void
+MirvCopyBytes(uint8_t* const dst, const uint8_t* const src, const size_t size, bool)
+{
+    memcpy(dst, src, size);
+}
+
+void
+MirvFillBytes(uint8_t* const dst, const uint32_t data, const size_t size, bool)
+{
+    const auto words = size / 4;
+    uint32_t* const out = (uint32_t*)dst;
+    for (size_t i = 0; i < words; i++) {
+        out[i] = data;
+    }
+}
+
+#endif // MIRV_SSE2
+
+// -------------------------------------
+
+namespace {
+
+// Spreads the low 3 bits of `v` to the even bits, making half a Morton index.
+inline uint32_t
+Spread(const uint32_t v)
+{
+    return (v & 1) | ((v & 2) << 1) | ((v & 4) << 2);
+}
+
+// Gathers the even bits of a Morton index back.
+inline uint32_t
+Compact(const uint32_t v)
+{
+    return (v & 1) | ((v >> 1) & 2) | ((v >> 2) & 4);
+}
+
+#ifdef MIRV_SSE2
+
+inline __m128i
+Load(const uint8_t* const p)
+{
+    return _mm_loadu_si128((const __m128i*)p);
+}
+
+// Whole tiles are whole cache lines, so streaming into them doesn't leave lines half
+// written. `p` is 16-byte aligned if streaming.
+inline void
+Store(uint8_t* const p, const __m128i v, const bool streaming)
+{
+    if (streaming) {
+        _mm_stream_si128((__m128i*)p, v);
+    } else {
+        _mm_storeu_si128((__m128i*)p, v);
+    }
+}
+
+#endif // MIRV_SSE2
+
+// Into a tile, so `dst` is as aligned as `size` is.
+inline void
+MoveIntoTile(uint8_t* const dst, const uint8_t* const src, const size_t size,
+             const bool streaming)
+{
+#ifdef MIRV_SSE2
+    if (size % 16 == 0) {
+        for (size_t i = 0; i < size; i += 16) {
+            Store(dst + i, Load(src + i), streaming);
+        }
+        return;
+    }
+#endif
+    (void)streaming;
+    memcpy(dst, src, size);
+}
+
+// Whole tiles move a horizontal pair of blocks at a time, since pairs are contiguous in
+// both layouts. For blocks of 8 and 16 bytes that is already one or two vector moves.
+template <size_t B>
+struct TileKernels final
+{
+    static const uint32_t kSize = 1u << MirvTileShift(B);
+
+    static void Tile(uint8_t* const tile, const uint8_t* const rows, const size_t pitch,
+                     const bool streaming) {
+        for (uint32_t i = 0; i < kSize * kSize; i += 2) {
+            MoveIntoTile(tile + i * B, rows + Compact(i >> 1) * pitch + Compact(i) * B, 2 * B,
+                         streaming);
+        }
+    }
+    static void Untile(uint8_t* const rows, const size_t pitch, const uint8_t* const tile) {
+        for (uint32_t i = 0; i < kSize * kSize; i += 2) {
+            memcpy(rows + Compact(i >> 1) * pitch + Compact(i) * B, tile + i * B, 2 * B);
+        }
+    }
+
+    // Part of a tile, at (x, y) in it, a block at a time.
+    template <bool kTile>
+    static void Edge(uint8_t* const tile, uint8_t* const rows, const size_t pitch,
+                     const uint32_t x, const uint32_t y, const uint32_t width,
+                     const uint32_t height) {
+        for (uint32_t j = 0; j < height; j++) {
+            for (uint32_t i = 0; i < width; i++) {
+                const auto t = tile + (Spread(x + i) | Spread(y + j) << 1) * B;
+                const auto r = rows + j * pitch + i * B;
+                if (kTile) {
+                    memcpy(t, r, B);
+                } else {
+                    memcpy(r, t, B);
+                }
+            }
+        }
+    }
+};
+
+#ifdef MIRV_SSE2
+
+// Smaller blocks interleave whole rows of a 4-row band: Pairs of rows unpack into quads,
+// and for single bytes, pairs of those into 2x2 groups of quads.
+
+// Two rows of 4 bytes each back out of a quad-interleaved register.
+inline __m128i
+DeinterleaveWords(const __m128i v)
+{
+    const auto w = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(3, 1, 2, 0)),
+                                       _MM_SHUFFLE(3, 1, 2, 0));
+    return _mm_shuffle_epi32(w, _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+template <>
+inline void
+TileKernels<1>::Tile(uint8_t* const tile, const uint8_t* const rows, const size_t pitch,
+                     const bool streaming)
+{
+    for (uint32_t h = 0; h < 2; h++) {
+        const auto in = rows + h * 4 * pitch;
+        const auto r01 = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)in),
+                                            _mm_loadl_epi64((const __m128i*)(in + pitch)));
+        const auto r23 = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(in + 2 * pitch)),
+                                            _mm_loadl_epi64((const __m128i*)(in + 3 * pitch)));
+        Store(tile + h * 32, _mm_unpacklo_epi64(r01, r23), streaming);
+        Store(tile + h * 32 + 16, _mm_unpackhi_epi64(r01, r23), streaming);
+    }
+}
+
+template <>
+inline void
+TileKernels<1>::Untile(uint8_t* const rows, const size_t pitch, const uint8_t* const tile)
+{
+    for (uint32_t h = 0; h < 2; h++) {
+        const auto out = rows + h * 4 * pitch;
+        const auto a = Load(tile + h * 32);
+        const auto b = Load(tile + h * 32 + 16);
+        const auto r01 = DeinterleaveWords(_mm_unpacklo_epi64(a, b));
+        const auto r23 = DeinterleaveWords(_mm_unpackhi_epi64(a, b));
+        _mm_storel_epi64((__m128i*)out, r01);
+        _mm_storel_epi64((__m128i*)(out + pitch), _mm_unpackhi_epi64(r01, r01));
+        _mm_storel_epi64((__m128i*)(out + 2 * pitch), r23);
+        _mm_storel_epi64((__m128i*)(out + 3 * pitch), _mm_unpackhi_epi64(r23, r23));
+    }
+}
+
+template <>
+inline void
+TileKernels<2>::Tile(uint8_t* const tile, const uint8_t* const rows, const size_t pitch,
+                     const bool streaming)
+{
+    for (uint32_t h = 0; h < 2; h++) {
+        const auto in = rows + h * 4 * pitch;
+        const auto out = tile + h * 64;
+        const auto r0 = Load(in);
+        const auto r1 = Load(in + pitch);
+        const auto r2 = Load(in + 2 * pitch);
+        const auto r3 = Load(in + 3 * pitch);
+        Store(out, _mm_unpacklo_epi32(r0, r1), streaming);
+        Store(out + 16, _mm_unpacklo_epi32(r2, r3), streaming);
+        Store(out + 32, _mm_unpackhi_epi32(r0, r1), streaming);
+        Store(out + 48, _mm_unpackhi_epi32(r2, r3), streaming);
+    }
+}
+
+template <>
+inline void
+TileKernels<2>::Untile(uint8_t* const rows, const size_t pitch, const uint8_t* const tile)
+{
+    for (uint32_t h = 0; h < 4; h++) {
+        const auto out = rows + h * 2 * pitch;
+        const auto in = tile + (h >> 1) * 64 + (h & 1) * 16;
+        const auto left = _mm_shuffle_epi32(Load(in), _MM_SHUFFLE(3, 1, 2, 0));
+        const auto right = _mm_shuffle_epi32(Load(in + 32), _MM_SHUFFLE(3, 1, 2, 0));
+        Store(out, _mm_unpacklo_epi64(left, right), false);
+        Store(out + pitch, _mm_unpackhi_epi64(left, right), false);
+    }
+}
+
+template <>
+inline void
+TileKernels<4>::Tile(uint8_t* const tile, const uint8_t* const rows, const size_t pitch,
+                     const bool streaming)
+{
+    for (uint32_t q = 0; q < 4; q++) {
+        const auto in = rows + (q >> 1) * 4 * pitch + (q & 1) * 16;
+        const auto out = tile + q * 64;
+        const auto r0 = Load(in);
+        const auto r1 = Load(in + pitch);
+        const auto r2 = Load(in + 2 * pitch);
+        const auto r3 = Load(in + 3 * pitch);
+        Store(out, _mm_unpacklo_epi64(r0, r1), streaming);
+        Store(out + 16, _mm_unpackhi_epi64(r0, r1), streaming);
+        Store(out + 32, _mm_unpacklo_epi64(r2, r3), streaming);
+        Store(out + 48, _mm_unpackhi_epi64(r2, r3), streaming);
+    }
+}
+
+template <>
+inline void
+TileKernels<4>::Untile(uint8_t* const rows, const size_t pitch, const uint8_t* const tile)
+{
+    for (uint32_t q = 0; q < 8; q++) {
+        const auto out = rows + (q >> 2) * 4 * pitch + ((q >> 1) & 1) * 16 +
+                         (q & 1) * 2 * pitch;
+        const auto a = Load(tile + q * 32);
+        const auto b = Load(tile + q * 32 + 16);
+        Store(out, _mm_unpacklo_epi64(a, b), false);
+        Store(out + pitch, _mm_unpackhi_epi64(a, b), false);
+    }
+}
+
+// Here a vector is a pair of blocks, so each quad is two rows' halves.
+template <>
+inline void
+TileKernels<8>::Tile(uint8_t* const tile, const uint8_t* const rows, const size_t pitch,
+                     const bool streaming)
+{
+    for (uint32_t h = 0; h < 2; h++) {
+        const auto in = rows + h * 2 * pitch;
+        const auto out = tile + h * 64;
+        Store(out, Load(in), streaming);
+        Store(out + 16, Load(in + pitch), streaming);
+        Store(out + 32, Load(in + 16), streaming);
+        Store(out + 48, Load(in + pitch + 16), streaming);
+    }
+}
+
+template <>
+inline void
+TileKernels<8>::Untile(uint8_t* const rows, const size_t pitch, const uint8_t* const tile)
+{
+    for (uint32_t h = 0; h < 2; h++) {
+        const auto out = rows + h * 2 * pitch;
+        const auto in = tile + h * 64;
+        Store(out, Load(in), false);
+        Store(out + pitch, Load(in + 16), false);
+        Store(out + 16, Load(in + 32), false);
+        Store(out + pitch + 16, Load(in + 48), false);
+    }
+}
+
+#endif // MIRV_SSE2
+
+template <size_t B, bool kTile>
+void
+MoveRect(uint8_t* const tiles, const size_t tilePitch, const uint32_t x, const uint32_t y,
+         uint8_t* const rows, const size_t pitch, const uint32_t width,
+         const uint32_t height, const bool streaming)
+{
+    typedef TileKernels<B> K;
+    const auto shift = MirvTileShift(B);
+    const auto tileBytes = K::kSize * K::kSize * B;
+    for (uint32_t ty = y >> shift; ty <= (y + height - 1) >> shift; ty++) {
+        const auto y0 = std::max(ty << shift, y);
+        const auto y1 = std::min((ty + 1) << shift, y + height);
+        for (uint32_t tx = x >> shift; tx <= (x + width - 1) >> shift; tx++) {
+            const auto x0 = std::max(tx << shift, x);
+            const auto x1 = std::min((tx + 1) << shift, x + width);
+            const auto tile = tiles + ty * tilePitch + tx * tileBytes;
+            const auto row = rows + (y0 - y) * pitch + (x0 - x) * B;
+            if (x1 - x0 == K::kSize && y1 - y0 == K::kSize) {
+                if (kTile) {
+                    K::Tile(tile, row, pitch, streaming);
+                } else {
+                    K::Untile(row, pitch, tile);
+                }
+            } else {
+                K::template Edge<kTile>(tile, row, pitch, x0 & (K::kSize - 1),
+                                        y0 & (K::kSize - 1), x1 - x0, y1 - y0);
+            }
+        }
+    }
+}
+
+template <bool kTile>
+void
+MoveRect(uint8_t* const tiles, const size_t tilePitch, const uint32_t blockBytes,
+         const uint32_t x, const uint32_t y, uint8_t* const rows, const size_t pitch,
+         const uint32_t width, const uint32_t height, const bool streaming)
+{
+    if (!width || !height)
+        return;
+#define _(B) \
+    case B: \
+        MoveRect<B, kTile>(tiles, tilePitch, x, y, rows, pitch, width, height, streaming); \
+        break;
+    switch (blockBytes) {
+    _(1) _(2) _(4) _(8) _(16)
+    default:
+        ASSERT(false)
+        break;
+    }
+#undef _
+}
+
+} // namespace
+
+void
+MirvTileRect(uint8_t* const tiles, const size_t tilePitch, const uint32_t blockBytes,
+             const uint32_t x, const uint32_t y, const uint8_t* const src,
+             const size_t srcPitch, const uint32_t width, const uint32_t height,
+             bool streaming)
+{
+#ifdef MIRV_SSE2
+    streaming = streaming && ((uintptr_t(tiles) | tilePitch) & 15) == 0;
+    MoveRect<true>(tiles, tilePitch, blockBytes, x, y, const_cast<uint8_t*>(src), srcPitch,
+                   width, height, streaming);
+    if (streaming) {
+        _mm_sfence();
+    }
+#else
+    MoveRect<true>(tiles, tilePitch, blockBytes, x, y, const_cast<uint8_t*>(src), srcPitch,
+                   width, height, false);
+#endif
+}
+
+void
+MirvUntileRect(uint8_t* const dst, const size_t dstPitch, const uint8_t* const tiles,
+               const size_t tilePitch, const uint32_t blockBytes, const uint32_t x,
+               const uint32_t y, const uint32_t width, const uint32_t height)
+{
+    MoveRect<false>(const_cast<uint8_t*>(tiles), tilePitch, blockBytes, x, y, dst, dstPitch,
+                    width, height, false);
+}
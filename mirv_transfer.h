@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Host-side kernels for transfer commands on mapped memory.
+// Past kMirvStreamingBytes, stores bypass the cache: A copy that big would evict
+// everything else, and nobody reads it back soon. Callers split big transfers into
+// pieces across threads, but decide streaming by the size of the whole transfer.
+
+// SSE2 is baseline on x86-64. 32-bit x86 only has it if the compiler was told to.
+#if defined(__x86_64__) || defined(_M_X64) || \
+    ((defined(__i386__) || defined(_M_IX86)) && defined(__SSE2__))
+#define MIRV_SSE2 1
+#endif
+
+const size_t kMirvStreamingBytes = 1 << 20;
+
+// `src` and `dst` must not overlap.
+void MirvCopyBytes(uint8_t* dst, const uint8_t* src, size_t size, bool streaming);
+// `dst` and `size` are 4-byte aligned.
+void MirvFillBytes(uint8_t* dst, uint32_t data, size_t size, bool streaming);
+
+// OPTIMAL images are kept in square tiles of blocks, tile row by tile row. Inside a tile,
+// blocks are in Morton order: 2x2 quads, 2x2 groups of quads, and so on, so that texels
+// near each other in 2D are near each other in memory. Tiles are 8x8 blocks of up to 4
+// bytes, or 4x4 of 8 or 16 bytes: 64 to 256 bytes, a few cache lines.
+constexpr uint32_t
+MirvTileShift(const uint32_t blockBytes)
+{
+    return blockBytes <= 4 ? 3 : 2;
+}
+
+// Copy a width x height rectangle of blocks between row-major memory and a slice of tiles
+// that starts at `tiles`. (x, y) is the rectangle's first block in the slice, and
+// `tilePitch` is between rows of tiles. `blockBytes` is 1, 2, 4, 8 or 16. Writes of
+// whole tiles stream if `streaming`; partial ones, and reads, never do.
+void MirvTileRect(uint8_t* tiles, size_t tilePitch, uint32_t blockBytes, uint32_t x,
+                  uint32_t y, const uint8_t* src, size_t srcPitch, uint32_t width,
+                  uint32_t height, bool streaming);
+void MirvUntileRect(uint8_t* dst, size_t dstPitch, const uint8_t* tiles, size_t tilePitch,
+                    uint32_t blockBytes, uint32_t x, uint32_t y, uint32_t width,
+                    uint32_t height);
@@ -1,12 +1,198 @@
 #include "vulkan.h"
+#ifdef _WIN32
 #include <windows.h>
+#endif
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cmath>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <vector>
 
+#include "mirv_ext.h"
 #include "util.h"
 
+extern "C" {
+VKAPI_ATTR VkResult VKAPI_CALL vk_icdNegotiateLoaderICDInterfaceVersion(uint32_t* pVersion);
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vk_icdGetInstanceProcAddr(VkInstance instance,
+                                                                   const char* pName);
+}
+
+// The loader overwrites the first word of every dispatchable handle with its own
+// dispatch pointer, so we do the same to make sure nothing else lives there.
+template<typename T>
+void
+ActLikeLoader(const T handle)
+{
+    CHECK(handle)
+    const auto& loaderData = reinterpret_cast<uintptr_t*>(handle);
+    CHECK(*loaderData == 0x01CDC0DE) // ICD_LOADER_MAGIC
+    *loaderData = 0xDEADBEEF;
+}
+
+// --
+
+// Queue threads free submissions, so this must be thread-safe.
+struct AllocTracker final
+{
+    std::atomic<int64_t> mLive{0};
+    std::atomic<uint32_t> mScopes{0};
+};
+
+// malloc only aligns for fundamental types, so tracked allocations keep what they need
+// to be freed just below themselves.
+struct TrackedPrefix final
+{
+    void* mBase;
+    size_t mSize;
+};
+
+static void*
+TrackedMalloc(const size_t size, const size_t align)
+{
+    CHECK(align && !(align & (align - 1)))
+    const auto base = (uint8_t*)malloc(sizeof(TrackedPrefix) + align + size);
+    if (!base)
+        return nullptr;
+    auto p = base + sizeof(TrackedPrefix);
+    p += (align - uintptr_t(p) % align) % align;
+    ((TrackedPrefix*)p)[-1] = { base, size };
+    return p;
+}
+
+static void
+TrackedFree(void* const p)
+{
+    free(((TrackedPrefix*)p)[-1].mBase);
+}
+
+static VKAPI_ATTR void* VKAPI_CALL
+TrackAlloc(void* const user, const size_t size, const size_t align,
+           const VkSystemAllocationScope scope)
+{
+    const auto tracker = (AllocTracker*)user;
+    tracker->mLive++;
+    tracker->mScopes |= 1 << scope;
+    return TrackedMalloc(size, align);
+}
+
+static VKAPI_ATTR void* VKAPI_CALL
+TrackRealloc(void* const user, void* const p, const size_t size, const size_t align,
+             const VkSystemAllocationScope scope)
+{
+    const auto tracker = (AllocTracker*)user;
+    if (!p) {
+        tracker->mLive++;
+    }
+    tracker->mScopes |= 1 << scope;
+    const auto ret = TrackedMalloc(size, align);
+    if (ret && p) {
+        memcpy(ret, p, std::min(size, ((TrackedPrefix*)p)[-1].mSize));
+        TrackedFree(p);
+    }
+    return ret;
+}
+
+static VKAPI_ATTR void VKAPI_CALL
+TrackFree(void* const user, void* const p)
+{
+    if (!p)
+        return;
+    const auto tracker = (AllocTracker*)user;
+    tracker->mLive--;
+    TrackedFree(p);
+}
+
+// --
+
+// layout(local_size_x = 64) in;
+// layout(push_constant) uniform PC { uint add; };
+// shared uint s[64];
+// void main() {
+//     const uint i = gl_LocalInvocationID.x;
+//     s[i] = i + add;
+//     barrier();
+//     s[i] = s[63 - i];
+// }
+static const uint32_t kLocalShader[] = {
+    0x07230203, 0x00010000, 0x00000000, 0x0000001f, 0x00000000, 0x00020011,
+    0x00000001, 0x0003000e, 0x00000000, 0x00000001, 0x0006000f, 0x00000005,
+    0x00000001, 0x6e69616d, 0x00000000, 0x00000002, 0x00060010, 0x00000001,
+    0x00000011, 0x00000040, 0x00000001, 0x00000001, 0x00040047, 0x00000002,
+    0x0000000b, 0x0000001b, 0x00050048, 0x00000003, 0x00000000, 0x00000023,
+    0x00000000, 0x00030047, 0x00000003, 0x00000002, 0x00020013, 0x00000004,
+    0x00030021, 0x00000005, 0x00000004, 0x00040015, 0x00000006, 0x00000020,
+    0x00000000, 0x00040017, 0x00000007, 0x00000006, 0x00000003, 0x00040020,
+    0x00000008, 0x00000001, 0x00000007, 0x0004003b, 0x00000008, 0x00000002,
+    0x00000001, 0x0004002b, 0x00000006, 0x00000009, 0x00000000, 0x0004002b,
+    0x00000006, 0x0000000a, 0x00000002, 0x0004002b, 0x00000006, 0x0000000b,
+    0x0000003f, 0x0004002b, 0x00000006, 0x0000000c, 0x00000040, 0x0004002b,
+    0x00000006, 0x0000000d, 0x00000108, 0x0004001c, 0x0000000e, 0x00000006,
+    0x0000000c, 0x00040020, 0x0000000f, 0x00000004, 0x0000000e, 0x0004003b,
+    0x0000000f, 0x00000010, 0x00000004, 0x00040020, 0x00000011, 0x00000004,
+    0x00000006, 0x0003001e, 0x00000003, 0x00000006, 0x00040020, 0x00000012,
+    0x00000009, 0x00000003, 0x0004003b, 0x00000012, 0x00000013, 0x00000009,
+    0x00040020, 0x00000014, 0x00000009, 0x00000006, 0x00050036, 0x00000004,
+    0x00000001, 0x00000000, 0x00000005, 0x000200f8, 0x00000015, 0x0004003d,
+    0x00000007, 0x00000016, 0x00000002, 0x00050051, 0x00000006, 0x00000017,
+    0x00000016, 0x00000000, 0x00050041, 0x00000014, 0x00000018, 0x00000013,
+    0x00000009, 0x0004003d, 0x00000006, 0x00000019, 0x00000018, 0x00050080,
+    0x00000006, 0x0000001a, 0x00000017, 0x00000019, 0x00050041, 0x00000011,
+    0x0000001b, 0x00000010, 0x00000017, 0x0003003e, 0x0000001b, 0x0000001a,
+    0x000400e0, 0x0000000a, 0x0000000a, 0x0000000d, 0x00050082, 0x00000006,
+    0x0000001c, 0x0000000b, 0x00000017, 0x00050041, 0x00000011, 0x0000001d,
+    0x00000010, 0x0000001c, 0x0004003d, 0x00000006, 0x0000001e, 0x0000001d,
+    0x0003003e, 0x0000001b, 0x0000001e, 0x000100fd, 0x00010038,
+};
+
+// layout(local_size_x = 64) in;
+// layout(set = 0, binding = 0) buffer Dst { uint dst[]; };
+// layout(set = 1, binding = 2) buffer Src { uint src[]; };
+// layout(push_constant) uniform PC { uint add; };
+// void main() {
+//     const uint i = gl_GlobalInvocationID.x;
+//     dst[i] = src[i] * 2 + add;
+// }
+static const uint32_t kScaleShader[] = {
+    0x07230203, 0x00010000, 0x00000000, 0x0000001e, 0x00000000, 0x00020011,
+    0x00000001, 0x0003000e, 0x00000000, 0x00000001, 0x0006000f, 0x00000005,
+    0x00000001, 0x6e69616d, 0x00000000, 0x00000002, 0x00060010, 0x00000001,
+    0x00000011, 0x00000040, 0x00000001, 0x00000001, 0x00040047, 0x00000002,
+    0x0000000b, 0x0000001c, 0x00040047, 0x00000003, 0x00000006, 0x00000004,
+    0x00050048, 0x00000004, 0x00000000, 0x00000023, 0x00000000, 0x00030047,
+    0x00000004, 0x00000003, 0x00040047, 0x00000005, 0x00000022, 0x00000000,
+    0x00040047, 0x00000005, 0x00000021, 0x00000000, 0x00040047, 0x00000006,
+    0x00000022, 0x00000001, 0x00040047, 0x00000006, 0x00000021, 0x00000002,
+    0x00050048, 0x00000007, 0x00000000, 0x00000023, 0x00000000, 0x00030047,
+    0x00000007, 0x00000002, 0x00020013, 0x00000008, 0x00030021, 0x00000009,
+    0x00000008, 0x00040015, 0x0000000a, 0x00000020, 0x00000000, 0x00040017,
+    0x0000000b, 0x0000000a, 0x00000003, 0x00040020, 0x0000000c, 0x00000001,
+    0x0000000b, 0x0004003b, 0x0000000c, 0x00000002, 0x00000001, 0x0003001d,
+    0x00000003, 0x0000000a, 0x0003001e, 0x00000004, 0x00000003, 0x00040020,
+    0x0000000d, 0x00000002, 0x00000004, 0x0004003b, 0x0000000d, 0x00000005,
+    0x00000002, 0x0004003b, 0x0000000d, 0x00000006, 0x00000002, 0x0003001e,
+    0x00000007, 0x0000000a, 0x00040020, 0x0000000e, 0x00000009, 0x00000007,
+    0x0004003b, 0x0000000e, 0x0000000f, 0x00000009, 0x00040020, 0x00000010,
+    0x00000002, 0x0000000a, 0x00040020, 0x00000011, 0x00000009, 0x0000000a,
+    0x0004002b, 0x0000000a, 0x00000012, 0x00000000, 0x0004002b, 0x0000000a,
+    0x00000013, 0x00000002, 0x00050036, 0x00000008, 0x00000001, 0x00000000,
+    0x00000009, 0x000200f8, 0x00000014, 0x0004003d, 0x0000000b, 0x00000015,
+    0x00000002, 0x00050051, 0x0000000a, 0x00000016, 0x00000015, 0x00000000,
+    0x00060041, 0x00000010, 0x00000017, 0x00000006, 0x00000012, 0x00000016,
+    0x0004003d, 0x0000000a, 0x00000018, 0x00000017, 0x00050084, 0x0000000a,
+    0x00000019, 0x00000018, 0x00000013, 0x00050041, 0x00000011, 0x0000001a,
+    0x0000000f, 0x00000012, 0x0004003d, 0x0000000a, 0x0000001b, 0x0000001a,
+    0x00050080, 0x0000000a, 0x0000001c, 0x00000019, 0x0000001b, 0x00060041,
+    0x00000010, 0x0000001d, 0x00000005, 0x00000012, 0x00000016, 0x0003003e,
+    0x0000001d, 0x0000001c, 0x000100fd, 0x00010038,
+};
+
+
+// --
+
 int
 main(const int argc, const char* const argv[])
 {
@@ -24,24 +210,35 @@ main(const int argc, const char* const argv[])
         0, nullptr
     };
 
+    uint32_t icdVersion = 5;
+    auto res = vk_icdNegotiateLoaderICDInterfaceVersion(&icdVersion);
+    CHECK(res == VK_SUCCESS)
+    CHECK(icdVersion >= 2 && icdVersion <= 5)
+    CHECK(vk_icdGetInstanceProcAddr(nullptr, "vkCreateInstance") ==
+           (PFN_vkVoidFunction)&vkCreateInstance)
+
     VkInstance inst;
-    auto res = vkCreateInstance(&instCreateInfo, nullptr, &inst);
-    ASSERT(res == VK_SUCCESS)
-    ASSERT(inst)
+    res = vkCreateInstance(&instCreateInfo, nullptr, &inst);
+    CHECK(res == VK_SUCCESS)
+    ActLikeLoader(inst);
 
     std::vector<VkPhysicalDevice> physDevs;
     uint32_t numPhysDevs = 0;
     (void)vkEnumeratePhysicalDevices(inst, &numPhysDevs, nullptr);
-    ASSERT(numPhysDevs)
+    CHECK(numPhysDevs)
     printf("numPhysDevs: %u\n", numPhysDevs);
 
     physDevs.resize(numPhysDevs);
     (void)vkEnumeratePhysicalDevices(inst, &numPhysDevs, physDevs.data());
+    for (const auto& physDev : physDevs) {
+        ActLikeLoader(physDev);
+    }
 
     std::vector<VkQueueFamilyProperties> families;
 
     VkDevice dev = 0;
     VkQueue queue = 0;
+    uint32_t queueFamily = 0;
 
     for (const auto& physDev : physDevs) {
         uint32_t familyCount;
@@ -59,26 +256,1787 @@ main(const int argc, const char* const argv[])
                 i, 1,
                 priorities
             };
-            const VkDeviceCreateInfo deviceInfo = {
+            uint32_t extensionCount;
+            res = vkEnumerateDeviceExtensionProperties(physDev, nullptr, &extensionCount,
+                                                       nullptr);
+            CHECK(res == VK_SUCCESS)
+            std::vector<VkExtensionProperties> extensions(extensionCount);
+            res = vkEnumerateDeviceExtensionProperties(physDev, nullptr, &extensionCount,
+                                                       extensions.data());
+            CHECK(res == VK_SUCCESS)
+            CHECK(extensionCount == 1)
+            CHECK(!strcmp(extensions[0].extensionName,
+                           VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME))
+
+            const char* const extensionNames[] = {
+                VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME, "VK_KHR_swapchain"
+            };
+            VkDeviceCreateInfo deviceInfo = {
                 VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO, nullptr, 0,
                 1, &queueInfo,
                 0, nullptr,
-                0, nullptr,
+                2, extensionNames,
                 nullptr
             };
+            res = vkCreateDevice(physDev, &deviceInfo, nullptr, &dev);
+            CHECK(res == VK_ERROR_EXTENSION_NOT_PRESENT)
+
+            deviceInfo.enabledExtensionCount = 1;
+
+            // Queues are threads, so there aren't many, and asking for more fails.
+            CHECK(fam.queueCount && fam.queueCount <= 64)
+            const std::vector<float> morePriorities(fam.queueCount + 1, 0.5f);
+            VkDeviceQueueCreateInfo tooManyInfo = queueInfo;
+            tooManyInfo.queueCount = fam.queueCount + 1;
+            tooManyInfo.pQueuePriorities = morePriorities.data();
+            deviceInfo.pQueueCreateInfos = &tooManyInfo;
+            res = vkCreateDevice(physDev, &deviceInfo, nullptr, &dev);
+            CHECK(res == VK_ERROR_INITIALIZATION_FAILED)
+            deviceInfo.pQueueCreateInfos = &queueInfo;
 
             res = vkCreateDevice(physDev, &deviceInfo, nullptr, &dev);
-            ASSERT(res == VK_SUCCESS)
+            CHECK(res == VK_SUCCESS)
             if (dev) {
+                ActLikeLoader(dev);
                 vkGetDeviceQueue(dev, i, 0, &queue);
+                ActLikeLoader(queue);
+                queueFamily = i;
                 break;
             }
         }
         if (dev)
             break;
     }
-    ASSERT(dev);
-    ASSERT(queue);
+    CHECK(dev);
+    CHECK(queue);
+
+    CHECK(vkGetInstanceProcAddr(nullptr, "vkCreateInstance") ==
+           (PFN_vkVoidFunction)&vkCreateInstance)
+    CHECK(!vkGetInstanceProcAddr(nullptr, "vkCreateDevice"))
+    CHECK(vkGetInstanceProcAddr(inst, "vkCreateDevice") ==
+           (PFN_vkVoidFunction)&vkCreateDevice)
+    CHECK(vkGetDeviceProcAddr(dev, "vkGetDeviceQueue") ==
+           (PFN_vkVoidFunction)&vkGetDeviceQueue)
+    CHECK(!vkGetDeviceProcAddr(dev, "vkCreateDevice"))
+    CHECK(!vkGetDeviceProcAddr(dev, "vkNotARealFunction"))
+
+    {
+        VkCommandPoolCreateInfo poolInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, nullptr, 0,
+            queueFamily
+        };
+        VkCommandPool pools[2];
+        res = vkCreateCommandPool(dev, &poolInfo, nullptr, &pools[0]);
+        CHECK(res == VK_SUCCESS)
+        CHECK(pools[0])
+        vkDestroyCommandPool(dev, pools[0], nullptr);
+
+        // The slot is reused, but the handle value isn't.
+        res = vkCreateCommandPool(dev, &poolInfo, nullptr, &pools[1]);
+        CHECK(res == VK_SUCCESS)
+        CHECK(pools[1] != pools[0])
+
+        vkDestroyCommandPool(dev, VK_NULL_HANDLE, nullptr);
+
+        VkCommandBuffer cbs[4];
+        const VkCommandBufferAllocateInfo cbInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, nullptr,
+            pools[1], VK_COMMAND_BUFFER_LEVEL_PRIMARY, 4
+        };
+        res = vkAllocateCommandBuffers(dev, &cbInfo, cbs);
+        CHECK(res == VK_SUCCESS)
+        for (const auto& cb : cbs) {
+            ActLikeLoader(cb);
+        }
+
+        const VkCommandBufferBeginInfo beginInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr,
+            VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, nullptr
+        };
+        uint8_t constants[256] = {};
+        for (uint32_t pass = 0; pass < 2; pass++) {
+            for (const auto& cb : cbs) {
+                res = vkBeginCommandBuffer(cb, &beginInfo);
+                CHECK(res == VK_SUCCESS)
+                // Enough to span several chunks.
+                for (uint32_t i = 0; i < 2000; i++) {
+                    vkCmdPushConstants(cb, VK_NULL_HANDLE, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                                       1 + i % sizeof(constants), constants);
+                }
+                res = vkEndCommandBuffer(cb);
+                CHECK(res == VK_SUCCESS)
+            }
+            res = vkResetCommandPool(dev, pools[1], 0);
+            CHECK(res == VK_SUCCESS)
+        }
+
+        {
+            const VkFenceCreateInfo signaledInfo = {
+                VK_STRUCTURE_TYPE_FENCE_CREATE_INFO, nullptr, VK_FENCE_CREATE_SIGNALED_BIT
+            };
+            VkFence fence;
+            res = vkCreateFence(dev, &signaledInfo, nullptr, &fence);
+            CHECK(res == VK_SUCCESS)
+            CHECK(vkGetFenceStatus(dev, fence) == VK_SUCCESS)
+            res = vkWaitForFences(dev, 1, &fence, VK_TRUE, 0);
+            CHECK(res == VK_SUCCESS)
+            res = vkResetFences(dev, 1, &fence);
+            CHECK(res == VK_SUCCESS)
+            CHECK(vkGetFenceStatus(dev, fence) == VK_NOT_READY)
+            res = vkWaitForFences(dev, 1, &fence, VK_TRUE, 1000 * 1000);
+            CHECK(res == VK_TIMEOUT)
+
+            // Submitted twice, so not one-time.
+            const VkCommandBufferBeginInfo reusableInfo = {
+                VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr, 0, nullptr
+            };
+            for (const auto& cb : cbs) {
+                res = vkBeginCommandBuffer(cb, &reusableInfo);
+                CHECK(res == VK_SUCCESS)
+                for (uint32_t i = 0; i < 2000; i++) {
+                    vkCmdPushConstants(cb, VK_NULL_HANDLE, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                                       1 + i % sizeof(constants), constants);
+                }
+                res = vkEndCommandBuffer(cb);
+                CHECK(res == VK_SUCCESS)
+            }
+            const VkSubmitInfo submitInfo = {
+                VK_STRUCTURE_TYPE_SUBMIT_INFO, nullptr,
+                0, nullptr, nullptr,
+                4, cbs,
+                0, nullptr
+            };
+            res = vkQueueSubmit(queue, 1, &submitInfo, fence);
+            CHECK(res == VK_SUCCESS)
+            res = vkWaitForFences(dev, 1, &fence, VK_TRUE, UINT64_MAX);
+            CHECK(res == VK_SUCCESS)
+            CHECK(vkGetFenceStatus(dev, fence) == VK_SUCCESS)
+
+            // Fence-only and empty submits.
+            res = vkResetFences(dev, 1, &fence);
+            CHECK(res == VK_SUCCESS)
+            res = vkQueueSubmit(queue, 0, nullptr, fence);
+            CHECK(res == VK_SUCCESS)
+            res = vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+            CHECK(res == VK_SUCCESS)
+            res = vkQueueWaitIdle(queue);
+            CHECK(res == VK_SUCCESS)
+            CHECK(vkGetFenceStatus(dev, fence) == VK_SUCCESS)
+            res = vkDeviceWaitIdle(dev);
+            CHECK(res == VK_SUCCESS)
+
+            vkDestroyFence(dev, fence, nullptr);
+            vkDestroyFence(dev, VK_NULL_HANDLE, nullptr);
+        }
+
+        vkFreeCommandBuffers(dev, pools[1], 2, &cbs[1]);
+        res = vkResetCommandPool(dev, pools[1], VK_COMMAND_POOL_RESET_RELEASE_RESOURCES_BIT);
+        CHECK(res == VK_SUCCESS)
+        // pools[1], with cbs[0] and cbs[3], is left for vkDestroyDevice to clean up.
+
+        poolInfo.queueFamilyIndex = 1000;
+        res = vkCreateCommandPool(dev, &poolInfo, nullptr, &pools[0]);
+        CHECK(res != VK_SUCCESS)
+    }
+
+    {
+        VkPhysicalDeviceMemoryProperties memProps;
+        vkGetPhysicalDeviceMemoryProperties(physDevs[0], &memProps);
+        CHECK(memProps.memoryTypeCount)
+        CHECK(memProps.memoryHeapCount)
+
+        uint32_t hostType = UINT32_MAX;
+        uint32_t coherentType = UINT32_MAX;
+        for (uint32_t i = 0; i < memProps.memoryTypeCount; i++) {
+            const auto& type = memProps.memoryTypes[i];
+            CHECK(type.heapIndex < memProps.memoryHeapCount)
+            if (!(type.propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
+                continue;
+            if (hostType == UINT32_MAX) {
+                hostType = i;
+            }
+            if (coherentType == UINT32_MAX &&
+                (type.propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+            {
+                coherentType = i;
+            }
+        }
+        CHECK(hostType != UINT32_MAX)
+        CHECK(coherentType != UINT32_MAX) // The spec requires one.
+
+        // Plenty to share a block, a few odd sizes, and one too big to share.
+        const VkDeviceSize sizes[] = { 1, 256, 1000, 4096, 65536, 3 << 20, 64 };
+        std::vector<VkDeviceMemory> mems;
+        for (uint32_t i = 0; i < 1000; i++) {
+            const VkMemoryAllocateInfo info = {
+                VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, nullptr,
+                sizes[i % (sizeof(sizes) / sizeof(sizes[0]))], hostType
+            };
+            VkDeviceMemory mem;
+            res = vkAllocateMemory(dev, &info, nullptr, &mem);
+            CHECK(res == VK_SUCCESS)
+            mems.push_back(mem);
+        }
+        // Free every other one, then the rest, to exercise merging.
+        for (size_t i = 0; i < mems.size(); i += 2) {
+            vkFreeMemory(dev, mems[i], nullptr);
+        }
+        for (size_t i = 1; i < mems.size(); i += 2) {
+            vkFreeMemory(dev, mems[i], nullptr);
+        }
+        vkFreeMemory(dev, VK_NULL_HANDLE, nullptr);
+
+        {
+            const VkMemoryAllocateInfo info = {
+                VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, nullptr,
+                4096, hostType
+            };
+            VkDeviceMemory mem;
+            res = vkAllocateMemory(dev, &info, nullptr, &mem);
+            CHECK(res == VK_SUCCESS)
+
+            uint8_t* ptr;
+            res = vkMapMemory(dev, mem, 0, VK_WHOLE_SIZE, 0, (void**)&ptr);
+            CHECK(res == VK_SUCCESS)
+            memset(ptr, 0xab, 4096);
+            const VkMappedMemoryRange ranges[] = {
+                { VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, nullptr, mem, 0, 256 },
+                { VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, nullptr, mem, 128, VK_WHOLE_SIZE },
+            };
+            res = vkFlushMappedMemoryRanges(dev, 2, ranges);
+            CHECK(res == VK_SUCCESS)
+            vkUnmapMemory(dev, mem);
+
+            // Remapping at an offset gives the same memory back.
+            uint8_t* ptr2;
+            res = vkMapMemory(dev, mem, 1024, 1024, 0, (void**)&ptr2);
+            CHECK(res == VK_SUCCESS)
+            CHECK(ptr2 == ptr + 1024)
+            res = vkInvalidateMappedMemoryRanges(dev, 1, ranges);
+            CHECK(res == VK_SUCCESS)
+            CHECK(ptr2[0] == 0xab)
+            vkUnmapMemory(dev, mem);
+
+            vkFreeMemory(dev, mem, nullptr);
+        }
+
+        {
+            // Unsorted, overlapping, and touching ranges, over allocations that share a
+            // block, plus some on a coherent type, all in one call.
+            VkDeviceMemory mems[3];
+            const uint32_t types[] = { hostType, hostType, coherentType };
+            for (uint32_t i = 0; i < 3; i++) {
+                const VkMemoryAllocateInfo info = {
+                    VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, nullptr,
+                    4096, types[i]
+                };
+                res = vkAllocateMemory(dev, &info, nullptr, &mems[i]);
+                CHECK(res == VK_SUCCESS)
+                void* ptr;
+                res = vkMapMemory(dev, mems[i], 0, VK_WHOLE_SIZE, 0, &ptr);
+                CHECK(res == VK_SUCCESS)
+            }
+            const VkMappedMemoryRange ranges[] = {
+                { VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, nullptr, mems[1], 512, 256 },
+                { VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, nullptr, mems[0], 1024, VK_WHOLE_SIZE },
+                { VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, nullptr, mems[2], 0, VK_WHOLE_SIZE },
+                { VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, nullptr, mems[1], 0, 512 },
+                { VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, nullptr, mems[0], 0, 2048 },
+                { VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, nullptr, mems[1], 2048, 64 },
+            };
+            const auto count = uint32_t(sizeof(ranges) / sizeof(ranges[0]));
+            res = vkFlushMappedMemoryRanges(dev, count, ranges);
+            CHECK(res == VK_SUCCESS)
+            res = vkInvalidateMappedMemoryRanges(dev, count, ranges);
+            CHECK(res == VK_SUCCESS)
+            for (const auto& mem : mems) {
+                vkFreeMemory(dev, mem, nullptr);
+            }
+        }
+
+        const VkMemoryAllocateInfo badInfo = {
+            VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, nullptr,
+            256, memProps.memoryTypeCount
+        };
+        VkDeviceMemory mem;
+        res = vkAllocateMemory(dev, &badInfo, nullptr, &mem);
+        CHECK(res != VK_SUCCESS)
+    }
+
+    {
+        const VkBufferCreateInfo bufferInfo = {
+            VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, nullptr, 0,
+            3 * sizeof(uint32_t), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VK_SHARING_MODE_EXCLUSIVE, 0, nullptr
+        };
+        VkBuffer buffer;
+        res = vkCreateBuffer(dev, &bufferInfo, nullptr, &buffer);
+        CHECK(res == VK_SUCCESS)
+
+        VkMemoryRequirements reqs;
+        vkGetBufferMemoryRequirements(dev, buffer, &reqs);
+        CHECK(reqs.size >= bufferInfo.size)
+        CHECK(reqs.memoryTypeBits & 1)
+
+        const VkMemoryAllocateInfo memInfo = {
+            VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, nullptr,
+            2 * reqs.size, 0
+        };
+        VkDeviceMemory mem;
+        res = vkAllocateMemory(dev, &memInfo, nullptr, &mem);
+        CHECK(res == VK_SUCCESS)
+        res = vkBindBufferMemory(dev, buffer, mem, reqs.size);
+        CHECK(res == VK_SUCCESS)
+
+        uint32_t* args;
+        res = vkMapMemory(dev, mem, reqs.size, VK_WHOLE_SIZE, 0, (void**)&args);
+        CHECK(res == VK_SUCCESS)
+        args[0] = 1000;
+        args[1] = 3;
+        args[2] = 1;
+        vkUnmapMemory(dev, mem);
+
+        const VkCommandPoolCreateInfo poolInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, nullptr, 0,
+            queueFamily
+        };
+        VkCommandPool pool;
+        res = vkCreateCommandPool(dev, &poolInfo, nullptr, &pool);
+        CHECK(res == VK_SUCCESS)
+        const VkCommandBufferAllocateInfo cbInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, nullptr,
+            pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1
+        };
+        VkCommandBuffer cb;
+        res = vkAllocateCommandBuffers(dev, &cbInfo, &cb);
+        CHECK(res == VK_SUCCESS)
+        ActLikeLoader(cb);
+
+        const VkCommandBufferBeginInfo beginInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr, 0, nullptr
+        };
+        res = vkBeginCommandBuffer(cb, &beginInfo);
+        CHECK(res == VK_SUCCESS)
+        // Empty, tiny, odd, and huge grids. The last is too big for one job.
+        vkCmdDispatch(cb, 0, 1, 1);
+        vkCmdDispatch(cb, 1, 1, 1);
+        vkCmdDispatch(cb, 7, 3, 5);
+        vkCmdDispatch(cb, 1024, 1024, 1);
+        vkCmdDispatch(cb, 65535, 65535, 2);
+        vkCmdDispatchIndirect(cb, buffer, 0);
+        res = vkEndCommandBuffer(cb);
+        CHECK(res == VK_SUCCESS)
+
+        const VkSubmitInfo submitInfo = {
+            VK_STRUCTURE_TYPE_SUBMIT_INFO, nullptr,
+            0, nullptr, nullptr,
+            1, &cb,
+            0, nullptr
+        };
+        res = vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+        CHECK(res == VK_SUCCESS)
+        res = vkQueueWaitIdle(queue);
+        CHECK(res == VK_SUCCESS)
+
+        vkDestroyCommandPool(dev, pool, nullptr);
+        vkDestroyBuffer(dev, buffer, nullptr);
+        vkFreeMemory(dev, mem, nullptr);
+    }
+    {
+        const VkShaderModuleCreateInfo moduleInfo = {
+            VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, nullptr, 0,
+            sizeof(kLocalShader), kLocalShader
+        };
+        VkShaderModule module;
+        res = vkCreateShaderModule(dev, &moduleInfo, nullptr, &module);
+        CHECK(res == VK_SUCCESS)
+
+        const uint32_t badCode[] = { 0xDEADBEEF, 0x00010000, 0, 1, 0 };
+        const VkShaderModuleCreateInfo badModuleInfo = {
+            VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, nullptr, 0,
+            sizeof(badCode), badCode
+        };
+        VkShaderModule badModule;
+        res = vkCreateShaderModule(dev, &badModuleInfo, nullptr, &badModule);
+        CHECK(res == VK_SUCCESS)
+
+        // Layouts may declare more than a shader uses.
+        const VkDescriptorSetLayoutBinding binding = {
+            0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr
+        };
+        const VkDescriptorSetLayoutCreateInfo setLayoutInfo = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO, nullptr, 0,
+            1, &binding
+        };
+        VkDescriptorSetLayout setLayout;
+        res = vkCreateDescriptorSetLayout(dev, &setLayoutInfo, nullptr, &setLayout);
+        CHECK(res == VK_SUCCESS)
+
+        const VkPushConstantRange pushRange = { VK_SHADER_STAGE_COMPUTE_BIT, 0, 4 };
+        const VkPipelineLayoutCreateInfo layoutInfo = {
+            VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO, nullptr, 0,
+            1, &setLayout,
+            1, &pushRange
+        };
+        VkPipelineLayout layout;
+        res = vkCreatePipelineLayout(dev, &layoutInfo, nullptr, &layout);
+        CHECK(res == VK_SUCCESS)
+        // Pipelines hold on to what they need.
+        vkDestroyDescriptorSetLayout(dev, setLayout, nullptr);
+
+        VkComputePipelineCreateInfo pipelineInfos[2] = {};
+        for (auto& x : pipelineInfos) {
+            x.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+            x.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            x.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+            x.stage.module = module;
+            x.stage.pName = "main";
+            x.layout = layout;
+        }
+        pipelineInfos[1].stage.module = badModule;
+        VkPipeline pipelines[2];
+        res = vkCreateComputePipelines(dev, VK_NULL_HANDLE, 2, pipelineInfos, nullptr,
+                                       pipelines);
+        CHECK(pipelines[0] != VK_NULL_HANDLE)
+        // Even async compiles know up front that this one can't parse.
+        CHECK(res != VK_SUCCESS)
+        CHECK(pipelines[1] == VK_NULL_HANDLE)
+        vkDestroyShaderModule(dev, badModule, nullptr);
+
+        // Modules with the same words share one parse, which outlives them.
+        VkShaderModule twin;
+        res = vkCreateShaderModule(dev, &moduleInfo, nullptr, &twin);
+        CHECK(res == VK_SUCCESS)
+        VkComputePipelineCreateInfo twinInfo = pipelineInfos[0];
+        twinInfo.stage.module = twin;
+        VkPipeline twinPipeline;
+        res = vkCreateComputePipelines(dev, VK_NULL_HANDLE, 1, &twinInfo, nullptr,
+                                       &twinPipeline);
+        CHECK(res == VK_SUCCESS)
+        vkDestroyShaderModule(dev, twin, nullptr);
+        vkDestroyPipeline(dev, twinPipeline, nullptr);
+        // Reflection already knows every entry point.
+        twinInfo.stage.module = module;
+        twinInfo.stage.pName = "nope";
+        res = vkCreateComputePipelines(dev, VK_NULL_HANDLE, 1, &twinInfo, nullptr,
+                                       &twinPipeline);
+        CHECK(res != VK_SUCCESS)
+
+        // Batches compile in parallel.
+        std::vector<VkComputePipelineCreateInfo> batchInfos(16, pipelineInfos[0]);
+        std::vector<VkPipeline> batch(batchInfos.size());
+        res = vkCreateComputePipelines(dev, VK_NULL_HANDLE, uint32_t(batch.size()),
+                                       batchInfos.data(), nullptr, batch.data());
+        CHECK(res == VK_SUCCESS)
+        for (const auto& x : batch) {
+            CHECK(x != VK_NULL_HANDLE)
+            vkDestroyPipeline(dev, x, nullptr);
+        }
+
+        // Fill a cache, save it, and load it back.
+        VkPipelineCacheCreateInfo cacheInfo = {
+            VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO, nullptr, 0,
+            0, nullptr
+        };
+        VkPipelineCache cache;
+        res = vkCreatePipelineCache(dev, &cacheInfo, nullptr, &cache);
+        CHECK(res == VK_SUCCESS)
+        VkPipeline cached;
+        res = vkCreateComputePipelines(dev, cache, 1, pipelineInfos, nullptr, &cached);
+        CHECK(res == VK_SUCCESS)
+        vkDestroyPipeline(dev, cached, nullptr);
+
+        size_t cacheSize;
+        res = vkGetPipelineCacheData(dev, cache, &cacheSize, nullptr);
+        CHECK(res == VK_SUCCESS)
+        CHECK(cacheSize > 32)
+        std::vector<uint8_t> cacheData(cacheSize);
+        size_t partialSize = cacheSize - 1;
+        res = vkGetPipelineCacheData(dev, cache, &partialSize, cacheData.data());
+        CHECK(res == VK_INCOMPLETE)
+        CHECK(partialSize == 32) // Just the header.
+        res = vkGetPipelineCacheData(dev, cache, &cacheSize, cacheData.data());
+        CHECK(res == VK_SUCCESS)
+        CHECK(cacheSize == cacheData.size())
+        vkDestroyPipelineCache(dev, cache, nullptr);
+
+        cacheInfo.initialDataSize = cacheData.size();
+        cacheInfo.pInitialData = cacheData.data();
+        res = vkCreatePipelineCache(dev, &cacheInfo, nullptr, &cache);
+        CHECK(res == VK_SUCCESS)
+        size_t loadedSize;
+        res = vkGetPipelineCacheData(dev, cache, &loadedSize, nullptr);
+        CHECK(res == VK_SUCCESS)
+        CHECK(loadedSize == cacheData.size())
+
+        // Mangled data loads as an empty cache.
+        cacheData.back() ^= 1;
+        VkPipelineCache mangledCache;
+        res = vkCreatePipelineCache(dev, &cacheInfo, nullptr, &mangledCache);
+        CHECK(res == VK_SUCCESS)
+        res = vkGetPipelineCacheData(dev, mangledCache, &loadedSize, nullptr);
+        CHECK(res == VK_SUCCESS)
+        CHECK(loadedSize == 32)
+        res = vkMergePipelineCaches(dev, mangledCache, 1, &cache);
+        CHECK(res == VK_SUCCESS)
+        res = vkGetPipelineCacheData(dev, mangledCache, &loadedSize, nullptr);
+        CHECK(res == VK_SUCCESS)
+        CHECK(loadedSize == cacheData.size())
+        vkDestroyPipelineCache(dev, mangledCache, nullptr);
+        cacheData.back() ^= 1;
+
+        // Checksums only catch accidents. Programs that would run outside their memory
+        // load as nothing too, even with good checksums. Our one entry's program follows
+        // the header and a 24-byte entry header, and starts with 17 words of counts and
+        // such. Its ops are 24 bytes each, and the first is a Block.
+        {
+            const auto Word = [&](const std::vector<uint8_t>& data, const size_t offset) {
+                uint32_t ret;
+                memcpy(&ret, &data[offset], sizeof(ret));
+                return ret;
+            };
+            const size_t program = 32 + 24;
+            const auto programSize = Word(cacheData, 32 + 16);
+            CHECK(program + programSize == cacheData.size())
+            const auto opCount = Word(cacheData, program + 16 * 4);
+            const auto firstOp = program + 17 * 4 + 8 * Word(cacheData, program + 13 * 4) +
+                                 4 * Word(cacheData, program + 14 * 4) +
+                                 8 * Word(cacheData, program + 15 * 4);
+            const auto lastOp = cacheData.size() - 24;
+            CHECK(firstOp + 24 * opCount == cacheData.size())
+
+            const struct {
+                size_t mOffset;
+                uint32_t mValue;
+            } crafts[] = {
+                { firstOp + 12, opCount },  // Branch target.
+                { lastOp + 4, 1 << 20 },    // Register.
+                { lastOp, 0xffff },         // Opcode, which also leaves no End.
+            };
+            for (const auto& craft : crafts) {
+                auto crafted = cacheData;
+                memcpy(&crafted[craft.mOffset], &craft.mValue,
+                       craft.mOffset == lastOp ? 2 : 4);
+                Hasher128 hasher;
+                hasher.Add(&crafted[program], programSize);
+                const auto checksum = uint32_t(hasher.Finish().mLo);
+                memcpy(&crafted[32 + 20], &checksum, sizeof(checksum));
+
+                VkPipelineCacheCreateInfo craftedInfo = cacheInfo;
+                craftedInfo.initialDataSize = crafted.size();
+                craftedInfo.pInitialData = crafted.data();
+                VkPipelineCache craftedCache;
+                res = vkCreatePipelineCache(dev, &craftedInfo, nullptr, &craftedCache);
+                CHECK(res == VK_SUCCESS)
+                res = vkGetPipelineCacheData(dev, craftedCache, &loadedSize, nullptr);
+                CHECK(res == VK_SUCCESS)
+                CHECK(loadedSize == 32)
+                vkDestroyPipelineCache(dev, craftedCache, nullptr);
+            }
+        }
+
+        // Hits still give working pipelines.
+        vkDestroyPipeline(dev, pipelines[0], nullptr);
+        res = vkCreateComputePipelines(dev, cache, 1, pipelineInfos, nullptr, pipelines);
+        CHECK(res == VK_SUCCESS)
+        vkDestroyPipelineCache(dev, cache, nullptr);
+        vkDestroyShaderModule(dev, module, nullptr);
+
+        const VkCommandPoolCreateInfo poolInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, nullptr, 0,
+            queueFamily
+        };
+        VkCommandPool pool;
+        res = vkCreateCommandPool(dev, &poolInfo, nullptr, &pool);
+        CHECK(res == VK_SUCCESS)
+        const VkCommandBufferAllocateInfo cbInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, nullptr,
+            pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1
+        };
+        VkCommandBuffer cb;
+        res = vkAllocateCommandBuffers(dev, &cbInfo, &cb);
+        CHECK(res == VK_SUCCESS)
+        ActLikeLoader(cb);
+
+        const VkCommandBufferBeginInfo beginInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr, 0, nullptr
+        };
+        res = vkBeginCommandBuffer(cb, &beginInfo);
+        CHECK(res == VK_SUCCESS)
+        const uint32_t add = 100;
+        vkCmdPushConstants(cb, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(add), &add);
+        vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines[0]);
+        vkCmdDispatch(cb, 7, 3, 5);
+        res = vkEndCommandBuffer(cb);
+        CHECK(res == VK_SUCCESS)
+
+        const VkSubmitInfo submitInfo = {
+            VK_STRUCTURE_TYPE_SUBMIT_INFO, nullptr,
+            0, nullptr, nullptr,
+            1, &cb,
+            0, nullptr
+        };
+        res = vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+        CHECK(res == VK_SUCCESS)
+        res = vkQueueWaitIdle(queue);
+        CHECK(res == VK_SUCCESS)
+
+        vkDestroyCommandPool(dev, pool, nullptr);
+        vkDestroyPipeline(dev, pipelines[0], nullptr);
+        vkDestroyPipelineLayout(dev, layout, nullptr);
+    }
+
+    {
+        const VkDescriptorSetLayoutBinding bindings[] = {
+            { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+            { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+        };
+        const VkDescriptorSetLayoutCreateInfo setLayoutInfo = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO, nullptr, 0,
+            2, bindings
+        };
+        VkDescriptorSetLayout setLayout;
+        res = vkCreateDescriptorSetLayout(dev, &setLayoutInfo, nullptr, &setLayout);
+        CHECK(res == VK_SUCCESS)
+        const VkDescriptorSetLayout setLayouts[] = { setLayout, setLayout, setLayout, setLayout };
+
+        // Linear pools hand back the same sets after every reset.
+        const VkDescriptorPoolSize poolSize = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 12 };
+        VkDescriptorPoolCreateInfo poolInfo = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO, nullptr, 0,
+            4, 1, &poolSize
+        };
+        VkDescriptorPool pool;
+        res = vkCreateDescriptorPool(dev, &poolInfo, nullptr, &pool);
+        CHECK(res == VK_SUCCESS)
+        VkDescriptorSetAllocateInfo allocInfo = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, nullptr,
+            pool, 4, setLayouts
+        };
+        VkDescriptorSet sets[4];
+        res = vkAllocateDescriptorSets(dev, &allocInfo, sets);
+        CHECK(res == VK_SUCCESS)
+        VkDescriptorSet extra;
+        allocInfo.descriptorSetCount = 1;
+        res = vkAllocateDescriptorSets(dev, &allocInfo, &extra);
+        CHECK(res != VK_SUCCESS)
+        CHECK(extra == VK_NULL_HANDLE)
+
+        res = vkResetDescriptorPool(dev, pool, 0);
+        CHECK(res == VK_SUCCESS)
+        VkDescriptorSet again[4];
+        allocInfo.descriptorSetCount = 3;
+        res = vkAllocateDescriptorSets(dev, &allocInfo, again);
+        CHECK(res == VK_SUCCESS)
+        CHECK(!memcmp(again, sets, 3 * sizeof(sets[0])))
+        // All or nothing.
+        allocInfo.descriptorSetCount = 2;
+        res = vkAllocateDescriptorSets(dev, &allocInfo, again + 2);
+        CHECK(res != VK_SUCCESS)
+        CHECK(again[2] == VK_NULL_HANDLE && again[3] == VK_NULL_HANDLE)
+        allocInfo.descriptorSetCount = 1;
+        res = vkAllocateDescriptorSets(dev, &allocInfo, again + 3);
+        CHECK(res == VK_SUCCESS)
+        CHECK(again[3] == sets[3])
+        vkDestroyDescriptorPool(dev, pool, nullptr);
+
+        // Freed sets are reused.
+        poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+        res = vkCreateDescriptorPool(dev, &poolInfo, nullptr, &pool);
+        CHECK(res == VK_SUCCESS)
+        allocInfo.descriptorPool = pool;
+        allocInfo.descriptorSetCount = 4;
+        res = vkAllocateDescriptorSets(dev, &allocInfo, sets);
+        CHECK(res == VK_SUCCESS)
+        res = vkFreeDescriptorSets(dev, pool, 2, sets + 1);
+        CHECK(res == VK_SUCCESS)
+        allocInfo.descriptorSetCount = 2;
+        res = vkAllocateDescriptorSets(dev, &allocInfo, again);
+        CHECK(res == VK_SUCCESS)
+        CHECK(again[0] == sets[1] && again[1] == sets[2])
+        vkDestroyDescriptorPool(dev, pool, nullptr);
+        vkDestroyDescriptorSetLayout(dev, setLayout, nullptr);
+    }
+
+    {
+        // src is 1024 uints, dst 256.
+        VkBufferCreateInfo bufferInfo = {
+            VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, nullptr, 0,
+            1024 * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_SHARING_MODE_EXCLUSIVE, 0, nullptr
+        };
+        VkBuffer src, dst;
+        res = vkCreateBuffer(dev, &bufferInfo, nullptr, &src);
+        CHECK(res == VK_SUCCESS)
+        bufferInfo.size = 256 * sizeof(uint32_t);
+        res = vkCreateBuffer(dev, &bufferInfo, nullptr, &dst);
+        CHECK(res == VK_SUCCESS)
+
+        VkMemoryRequirements reqs;
+        vkGetBufferMemoryRequirements(dev, src, &reqs);
+        const VkMemoryAllocateInfo memInfo = {
+            VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, nullptr,
+            reqs.size + bufferInfo.size, 0
+        };
+        VkDeviceMemory mem;
+        res = vkAllocateMemory(dev, &memInfo, nullptr, &mem);
+        CHECK(res == VK_SUCCESS)
+        res = vkBindBufferMemory(dev, src, mem, 0);
+        CHECK(res == VK_SUCCESS)
+        res = vkBindBufferMemory(dev, dst, mem, reqs.size);
+        CHECK(res == VK_SUCCESS)
+        uint32_t* data;
+        res = vkMapMemory(dev, mem, 0, VK_WHOLE_SIZE, 0, (void**)&data);
+        CHECK(res == VK_SUCCESS)
+        for (uint32_t i = 0; i < 1024; i++) {
+            data[i] = i * 3;
+        }
+
+        // Set 1 has a hole at binding 1, and a dynamic buffer the shader doesn't use
+        // ahead of the one it does.
+        const VkDescriptorSetLayoutBinding dstBinding = {
+            0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr
+        };
+        const VkDescriptorSetLayoutBinding srcBindings[] = {
+            { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_COMPUTE_BIT,
+              nullptr },
+            { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_COMPUTE_BIT,
+              nullptr },
+        };
+        VkDescriptorSetLayoutCreateInfo setLayoutInfo = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO, nullptr, 0,
+            1, &dstBinding
+        };
+        VkDescriptorSetLayout setLayouts[3];
+        res = vkCreateDescriptorSetLayout(dev, &setLayoutInfo, nullptr, &setLayouts[0]);
+        CHECK(res == VK_SUCCESS)
+        setLayouts[1] = setLayouts[0];
+        setLayoutInfo.bindingCount = 2;
+        setLayoutInfo.pBindings = srcBindings;
+        res = vkCreateDescriptorSetLayout(dev, &setLayoutInfo, nullptr, &setLayouts[2]);
+        CHECK(res == VK_SUCCESS)
+
+        const VkDescriptorPoolSize poolSizes[] = {
+            { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 },
+            { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 2 },
+        };
+        const VkDescriptorPoolCreateInfo poolInfo = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO, nullptr, 0,
+            3, 2, poolSizes
+        };
+        VkDescriptorPool descriptorPool;
+        res = vkCreateDescriptorPool(dev, &poolInfo, nullptr, &descriptorPool);
+        CHECK(res == VK_SUCCESS)
+        const VkDescriptorSetAllocateInfo allocInfo = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, nullptr,
+            descriptorPool, 3, setLayouts
+        };
+        VkDescriptorSet sets[3];
+        res = vkAllocateDescriptorSets(dev, &allocInfo, sets);
+        CHECK(res == VK_SUCCESS)
+
+        // The second write runs on from binding 0 into binding 2. The copy moves the
+        // dst descriptor to the set that actually gets bound.
+        const VkDescriptorBufferInfo bufferInfos[] = {
+            { dst, 0, VK_WHOLE_SIZE },
+            { dst, 0, VK_WHOLE_SIZE },
+            { src, 0, 256 * sizeof(uint32_t) },
+        };
+        VkWriteDescriptorSet writes[2] = {};
+        for (auto& x : writes) {
+            x.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        }
+        writes[0].dstSet = sets[0];
+        writes[0].descriptorCount = 1;
+        writes[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[0].pBufferInfo = bufferInfos;
+        writes[1].dstSet = sets[2];
+        writes[1].descriptorCount = 2;
+        writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+        writes[1].pBufferInfo = bufferInfos + 1;
+        VkCopyDescriptorSet copy = {};
+        copy.sType = VK_STRUCTURE_TYPE_COPY_DESCRIPTOR_SET;
+        copy.srcSet = sets[0];
+        copy.dstSet = sets[1];
+        copy.descriptorCount = 1;
+        vkUpdateDescriptorSets(dev, 2, writes, 1, &copy);
+
+        const VkPushConstantRange pushRange = { VK_SHADER_STAGE_COMPUTE_BIT, 0, 4 };
+        const VkPipelineLayoutCreateInfo layoutInfo = {
+            VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO, nullptr, 0,
+            2, setLayouts + 1,
+            1, &pushRange
+        };
+        VkPipelineLayout layout;
+        res = vkCreatePipelineLayout(dev, &layoutInfo, nullptr, &layout);
+        CHECK(res == VK_SUCCESS)
+
+        const VkShaderModuleCreateInfo moduleInfo = {
+            VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, nullptr, 0,
+            sizeof(kScaleShader), kScaleShader
+        };
+        VkShaderModule module;
+        res = vkCreateShaderModule(dev, &moduleInfo, nullptr, &module);
+        CHECK(res == VK_SUCCESS)
+        VkComputePipelineCreateInfo pipelineInfo = {};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = module;
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.layout = layout;
+        VkPipeline pipeline;
+        res = vkCreateComputePipelines(dev, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr,
+                                       &pipeline);
+        CHECK(res == VK_SUCCESS)
+        vkDestroyShaderModule(dev, module, nullptr);
+
+        const VkCommandPoolCreateInfo cmdPoolInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, nullptr, 0,
+            queueFamily
+        };
+        VkCommandPool cmdPool;
+        res = vkCreateCommandPool(dev, &cmdPoolInfo, nullptr, &cmdPool);
+        CHECK(res == VK_SUCCESS)
+        const VkCommandBufferAllocateInfo cbInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, nullptr,
+            cmdPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1
+        };
+        VkCommandBuffer cb;
+        res = vkAllocateCommandBuffers(dev, &cbInfo, &cb);
+        CHECK(res == VK_SUCCESS)
+        ActLikeLoader(cb);
+
+        const VkCommandBufferBeginInfo beginInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr, 0, nullptr
+        };
+        res = vkBeginCommandBuffer(cb, &beginInfo);
+        CHECK(res == VK_SUCCESS)
+        const uint32_t add = 5;
+        vkCmdPushConstants(cb, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(add), &add);
+        vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+        const uint32_t dynamicOffsets[] = { 0, 256 * sizeof(uint32_t) };
+        vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, 2, sets + 1,
+                                2, dynamicOffsets);
+        vkCmdDispatch(cb, 4, 1, 1);
+        res = vkEndCommandBuffer(cb);
+        CHECK(res == VK_SUCCESS)
+
+        const VkSubmitInfo submitInfo = {
+            VK_STRUCTURE_TYPE_SUBMIT_INFO, nullptr,
+            0, nullptr, nullptr,
+            1, &cb,
+            0, nullptr
+        };
+        res = vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+        CHECK(res == VK_SUCCESS)
+        res = vkQueueWaitIdle(queue);
+        CHECK(res == VK_SUCCESS)
+        const auto dstData = (const uint32_t*)((const uint8_t*)data + reqs.size);
+        for (uint32_t i = 0; i < 256; i++) {
+            CHECK(dstData[i] == (256 + i) * 3 * 2 + add)
+        }
+
+        // Sets are read at submission, so a template update retargets the same commands.
+        // This entry also runs on from binding 0 into binding 2.
+        const auto createTemplate = (PFN_vkCreateDescriptorUpdateTemplateKHR)
+            vkGetDeviceProcAddr(dev, "vkCreateDescriptorUpdateTemplateKHR");
+        const auto destroyTemplate = (PFN_vkDestroyDescriptorUpdateTemplateKHR)
+            vkGetDeviceProcAddr(dev, "vkDestroyDescriptorUpdateTemplateKHR");
+        const auto updateWithTemplate = (PFN_vkUpdateDescriptorSetWithTemplateKHR)
+            vkGetDeviceProcAddr(dev, "vkUpdateDescriptorSetWithTemplateKHR");
+        CHECK(createTemplate && destroyTemplate && updateWithTemplate)
+        const VkDescriptorUpdateTemplateEntryKHR entry = {
+            0, 0, 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+            0, sizeof(VkDescriptorBufferInfo)
+        };
+        VkDescriptorUpdateTemplateCreateInfoKHR templateInfo = {};
+        templateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO_KHR;
+        templateInfo.descriptorUpdateEntryCount = 1;
+        templateInfo.pDescriptorUpdateEntries = &entry;
+        templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET_KHR;
+        templateInfo.descriptorSetLayout = setLayouts[2];
+        VkDescriptorUpdateTemplateKHR updateTemplate;
+        res = createTemplate(dev, &templateInfo, nullptr, &updateTemplate);
+        CHECK(res == VK_SUCCESS)
+        const VkDescriptorBufferInfo templateData[] = {
+            { dst, 0, VK_WHOLE_SIZE },
+            { src, 512 * sizeof(uint32_t), VK_WHOLE_SIZE },
+        };
+        updateWithTemplate(dev, sets[2], updateTemplate, templateData);
+        destroyTemplate(dev, updateTemplate, nullptr);
+
+        res = vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+        CHECK(res == VK_SUCCESS)
+        res = vkQueueWaitIdle(queue);
+        CHECK(res == VK_SUCCESS)
+        for (uint32_t i = 0; i < 256; i++) {
+            CHECK(dstData[i] == (768 + i) * 3 * 2 + add)
+        }
+
+        vkDestroyCommandPool(dev, cmdPool, nullptr);
+        vkDestroyPipeline(dev, pipeline, nullptr);
+        vkDestroyPipelineLayout(dev, layout, nullptr);
+        vkDestroyDescriptorPool(dev, descriptorPool, nullptr);
+        vkDestroyDescriptorSetLayout(dev, setLayouts[0], nullptr);
+        vkDestroyDescriptorSetLayout(dev, setLayouts[2], nullptr);
+        vkUnmapMemory(dev, mem);
+        vkDestroyBuffer(dev, src, nullptr);
+        vkDestroyBuffer(dev, dst, nullptr);
+        vkFreeMemory(dev, mem, nullptr);
+    }
+
+    {
+        // Two 4MiB buffers, big enough for streaming stores and threads.
+        const uint64_t kSize = 4 << 20;
+        const VkBufferCreateInfo bufferInfo = {
+            VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, nullptr, 0,
+            kSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_SHARING_MODE_EXCLUSIVE, 0, nullptr
+        };
+        VkBuffer buffers[2];
+        for (auto& x : buffers) {
+            res = vkCreateBuffer(dev, &bufferInfo, nullptr, &x);
+            CHECK(res == VK_SUCCESS)
+        }
+        const VkMemoryAllocateInfo memInfo = {
+            VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, nullptr,
+            2 * kSize, 0
+        };
+        VkDeviceMemory mem;
+        res = vkAllocateMemory(dev, &memInfo, nullptr, &mem);
+        CHECK(res == VK_SUCCESS)
+        res = vkBindBufferMemory(dev, buffers[0], mem, 0);
+        CHECK(res == VK_SUCCESS)
+        res = vkBindBufferMemory(dev, buffers[1], mem, kSize);
+        CHECK(res == VK_SUCCESS)
+        uint32_t* data;
+        res = vkMapMemory(dev, mem, 0, VK_WHOLE_SIZE, 0, (void**)&data);
+        CHECK(res == VK_SUCCESS)
+        memset(data, 0, 2 * kSize);
+
+        const VkCommandPoolCreateInfo poolInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, nullptr, 0,
+            queueFamily
+        };
+        VkCommandPool pool;
+        res = vkCreateCommandPool(dev, &poolInfo, nullptr, &pool);
+        CHECK(res == VK_SUCCESS)
+        const VkCommandBufferAllocateInfo cbInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, nullptr,
+            pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1
+        };
+        VkCommandBuffer cb;
+        res = vkAllocateCommandBuffers(dev, &cbInfo, &cb);
+        CHECK(res == VK_SUCCESS)
+        ActLikeLoader(cb);
+
+        const VkCommandBufferBeginInfo beginInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr, 0, nullptr
+        };
+        res = vkBeginCommandBuffer(cb, &beginInfo);
+        CHECK(res == VK_SUCCESS)
+        // Big fills stream; small ones start off 16-byte alignment.
+        vkCmdFillBuffer(cb, buffers[0], 0, VK_WHOLE_SIZE, 0x01020304);
+        vkCmdFillBuffer(cb, buffers[0], (3 << 20) + 4, 40, 7);
+        uint32_t words[64];
+        for (uint32_t i = 0; i < 64; i++) {
+            words[i] = 1000 + i;
+        }
+        vkCmdUpdateBuffer(cb, buffers[0], 1024, sizeof(words), words);
+        // The first three abut in both buffers, so they become one big copy.
+        const VkBufferCopy regions[] = {
+            { 1 << 20, (1 << 20) + 4, 1 << 20 },
+            { 0, 4, 1 << 20 },
+            { 2 << 20, (2 << 20) + 4, 8 },
+            { (3 << 20) + 4, kSize - 40, 40 },
+        };
+        vkCmdCopyBuffer(cb, buffers[0], buffers[1], 4, regions);
+        res = vkEndCommandBuffer(cb);
+        CHECK(res == VK_SUCCESS)
+
+        const VkSubmitInfo submitInfo = {
+            VK_STRUCTURE_TYPE_SUBMIT_INFO, nullptr,
+            0, nullptr, nullptr,
+            1, &cb,
+            0, nullptr
+        };
+        res = vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+        CHECK(res == VK_SUCCESS)
+        res = vkQueueWaitIdle(queue);
+        CHECK(res == VK_SUCCESS)
+
+        const auto src = data;
+        const auto dst = data + kSize / 4;
+        const auto filled = src + (3 << 20) / 4;
+        CHECK(filled[0] == 0x01020304)
+        for (uint32_t i = 1; i <= 10; i++) {
+            CHECK(filled[i] == 7)
+        }
+        CHECK(filled[11] == 0x01020304)
+        for (uint32_t i = 0; i < 64; i++) {
+            CHECK(src[256 + i] == 1000 + i)
+        }
+        CHECK(src[kSize / 4 - 1] == 0x01020304)
+
+        CHECK(dst[0] == 0)
+        CHECK(dst[1] == 0x01020304)
+        CHECK(dst[2] == 0x01020304)
+        for (uint32_t i = 0; i < 10; i++) {
+            CHECK(dst[kSize / 4 - 10 + i] == 7)
+        }
+        for (uint32_t i = 0; i < 64; i++) {
+            CHECK(dst[257 + i] == 1000 + i)
+        }
+        CHECK(dst[(2 << 20) / 4] == 0x01020304)
+        CHECK(dst[(2 << 20) / 4 + 2] == 0x01020304)
+        CHECK(dst[(2 << 20) / 4 + 3] == 0)
+
+        vkUnmapMemory(dev, mem);
+        vkDestroyCommandPool(dev, pool, nullptr);
+        for (const auto& x : buffers) {
+            vkDestroyBuffer(dev, x, nullptr);
+        }
+        vkFreeMemory(dev, mem, nullptr);
+    }
+
+    {
+        // Buffer<->image copies. OPTIMAL RGB8 is kept as RGBA8, D24S8 copies per aspect,
+        // and BC1 by blocks.
+        const VkBufferCreateInfo bufferInfo = {
+            VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, nullptr, 0,
+            64 << 10, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_SHARING_MODE_EXCLUSIVE, 0, nullptr
+        };
+        VkBuffer buffers[2];
+        for (auto& x : buffers) {
+            res = vkCreateBuffer(dev, &bufferInfo, nullptr, &x);
+            CHECK(res == VK_SUCCESS)
+        }
+
+        VkImageCreateInfo imageInfo = {
+            VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO, nullptr, 0,
+            VK_IMAGE_TYPE_2D, VK_FORMAT_R8G8B8_UNORM, { 37, 19, 1 }, 2, 2,
+            VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+            VK_SHARING_MODE_EXCLUSIVE, 0, nullptr, VK_IMAGE_LAYOUT_UNDEFINED
+        };
+        VkImage images[4];
+        res = vkCreateImage(dev, &imageInfo, nullptr, &images[0]);
+        CHECK(res == VK_SUCCESS)
+        imageInfo.format = VK_FORMAT_D24_UNORM_S8_UINT;
+        imageInfo.extent = { 8, 8, 1 };
+        imageInfo.mipLevels = imageInfo.arrayLayers = 1;
+        res = vkCreateImage(dev, &imageInfo, nullptr, &images[1]);
+        CHECK(res == VK_SUCCESS)
+        imageInfo.format = VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+        imageInfo.extent = { 16, 8, 1 };
+        res = vkCreateImage(dev, &imageInfo, nullptr, &images[2]);
+        CHECK(res == VK_SUCCESS)
+        imageInfo.imageType = VK_IMAGE_TYPE_3D;
+        imageInfo.format = VK_FORMAT_R8_UNORM;
+        imageInfo.extent = { 5, 3, 4 };
+        res = vkCreateImage(dev, &imageInfo, nullptr, &images[3]);
+        CHECK(res == VK_SUCCESS)
+
+        const VkMemoryAllocateInfo memInfo = {
+            VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, nullptr,
+            1 << 20, 0
+        };
+        VkDeviceMemory mem;
+        res = vkAllocateMemory(dev, &memInfo, nullptr, &mem);
+        CHECK(res == VK_SUCCESS)
+        res = vkBindBufferMemory(dev, buffers[0], mem, 0);
+        CHECK(res == VK_SUCCESS)
+        res = vkBindBufferMemory(dev, buffers[1], mem, 64 << 10);
+        CHECK(res == VK_SUCCESS)
+        VkDeviceSize memOffset = 128 << 10;
+        for (const auto& x : images) {
+            VkMemoryRequirements reqs;
+            vkGetImageMemoryRequirements(dev, x, &reqs);
+            CHECK(reqs.memoryTypeBits & 1)
+            memOffset = (memOffset + reqs.alignment - 1) / reqs.alignment * reqs.alignment;
+            res = vkBindImageMemory(dev, x, mem, memOffset);
+            CHECK(res == VK_SUCCESS)
+            memOffset += reqs.size;
+        }
+        CHECK(memOffset <= memInfo.allocationSize)
+        uint8_t* data;
+        res = vkMapMemory(dev, mem, 0, VK_WHOLE_SIZE, 0, (void**)&data);
+        CHECK(res == VK_SUCCESS)
+        memset(data, 0, memInfo.allocationSize);
+
+        const auto src = data;
+        const auto dst = data + (64 << 10);
+        const auto rgb = [](const uint32_t x, const uint32_t y, const uint32_t c) {
+            return uint8_t(x * 7 + y * 13 + c * 29 + 1);
+        };
+        for (uint32_t y = 0; y < 19; y++) {
+            for (uint32_t x = 0; x < 40; x++) {
+                for (uint32_t c = 0; c < 3; c++) {
+                    src[(y * 40 + x) * 3 + c] = rgb(x, y, c);
+                    src[8192 + (y * 5 + x) * 3 + c] = rgb(x, y, c) | 1;
+                }
+            }
+        }
+        for (uint32_t i = 0; i < 64; i++) {
+            const auto depth = 0xab000000 | (i * 1000);
+            memcpy(src + 12288 + i * 4, &depth, 4);
+            src[12800 + i] = uint8_t(i * 3);
+            src[13312 + i] = uint8_t(i + 100);
+        }
+        for (uint32_t i = 0; i < 128; i++) {
+            src[16384 + i] = uint8_t(i ^ 0x5a);
+        }
+
+        const VkCommandPoolCreateInfo poolInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, nullptr, 0,
+            queueFamily
+        };
+        VkCommandPool pool;
+        res = vkCreateCommandPool(dev, &poolInfo, nullptr, &pool);
+        CHECK(res == VK_SUCCESS)
+        const VkCommandBufferAllocateInfo cbInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, nullptr,
+            pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1
+        };
+        VkCommandBuffer cb;
+        res = vkAllocateCommandBuffers(dev, &cbInfo, &cb);
+        CHECK(res == VK_SUCCESS)
+        ActLikeLoader(cb);
+
+        const VkCommandBufferBeginInfo beginInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr, 0, nullptr
+        };
+        res = vkBeginCommandBuffer(cb, &beginInfo);
+        CHECK(res == VK_SUCCESS)
+        const auto color = VK_IMAGE_ASPECT_COLOR_BIT;
+        const auto stencil = VK_IMAGE_ASPECT_STENCIL_BIT;
+        const auto depth = VK_IMAGE_ASPECT_DEPTH_BIT;
+        const VkImageLayout layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        // bufferOffset, bufferRowLength, bufferImageHeight,
+        // {aspectMask, mipLevel, baseArrayLayer, layerCount}, imageOffset, imageExtent
+        const VkBufferImageCopy rgbUploads[] = {
+            { 0, 40, 0, { color, 0, 1, 1 }, { 0, 0, 0 }, { 37, 19, 1 } },
+            { 4096, 0, 0, { color, 1, 0, 1 }, { 0, 0, 0 }, { 18, 9, 1 } },
+            { 8192, 0, 0, { color, 1, 0, 1 }, { 3, 2, 0 }, { 5, 4, 1 } },
+        };
+        vkCmdCopyBufferToImage(cb, buffers[0], images[0], layout, 3, rgbUploads);
+        const VkBufferImageCopy rgbReadbacks[] = {
+            { 0, 0, 0, { color, 0, 1, 1 }, { 0, 0, 0 }, { 37, 19, 1 } },
+            { 4096, 0, 0, { color, 1, 0, 1 }, { 0, 0, 0 }, { 18, 9, 1 } },
+        };
+        vkCmdCopyImageToBuffer(cb, images[0], layout, buffers[1], 2, rgbReadbacks);
+
+        const VkBufferImageCopy depthUploads[] = {
+            { 12288, 0, 0, { depth, 0, 0, 1 }, { 0, 0, 0 }, { 8, 8, 1 } },
+            { 12800, 0, 0, { stencil, 0, 0, 1 }, { 0, 0, 0 }, { 8, 8, 1 } },
+        };
+        vkCmdCopyBufferToImage(cb, buffers[0], images[1], layout, 2, depthUploads);
+        const VkBufferImageCopy depthReadbacks[] = {
+            { 12288, 0, 0, { depth, 0, 0, 1 }, { 0, 0, 0 }, { 8, 8, 1 } },
+            { 12800, 0, 0, { stencil, 0, 0, 1 }, { 0, 0, 0 }, { 8, 8, 1 } },
+        };
+        vkCmdCopyImageToBuffer(cb, images[1], layout, buffers[1], 2, depthReadbacks);
+
+        const VkBufferImageCopy bc1Upload = {
+            13312, 0, 0, { color, 0, 0, 1 }, { 0, 0, 0 }, { 16, 8, 1 }
+        };
+        vkCmdCopyBufferToImage(cb, buffers[0], images[2], layout, 1, &bc1Upload);
+        const VkBufferImageCopy bc1Readback = {
+            13312, 0, 0, { color, 0, 0, 1 }, { 8, 4, 0 }, { 8, 4, 1 }
+        };
+        vkCmdCopyImageToBuffer(cb, images[2], layout, buffers[1], 1, &bc1Readback);
+
+        // Padded rows and slices in, tight ones out.
+        const VkBufferImageCopy volumeUpload = {
+            16384, 8, 4, { color, 0, 0, 1 }, { 0, 0, 0 }, { 5, 3, 4 }
+        };
+        vkCmdCopyBufferToImage(cb, buffers[0], images[3], layout, 1, &volumeUpload);
+        const VkBufferImageCopy volumeReadback = {
+            16384, 0, 0, { color, 0, 0, 1 }, { 0, 0, 1 }, { 5, 3, 2 }
+        };
+        vkCmdCopyImageToBuffer(cb, images[3], layout, buffers[1], 1, &volumeReadback);
+        res = vkEndCommandBuffer(cb);
+        CHECK(res == VK_SUCCESS)
+
+        const VkSubmitInfo submitInfo = {
+            VK_STRUCTURE_TYPE_SUBMIT_INFO, nullptr,
+            0, nullptr, nullptr,
+            1, &cb,
+            0, nullptr
+        };
+        res = vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+        CHECK(res == VK_SUCCESS)
+        res = vkQueueWaitIdle(queue);
+        CHECK(res == VK_SUCCESS)
+
+        for (uint32_t y = 0; y < 19; y++) {
+            for (uint32_t x = 0; x < 37; x++) {
+                for (uint32_t c = 0; c < 3; c++) {
+                    CHECK(dst[(y * 37 + x) * 3 + c] == rgb(x, y, c))
+                }
+            }
+        }
+        for (uint32_t y = 0; y < 9; y++) {
+            for (uint32_t x = 0; x < 18; x++) {
+                const bool inside = (x >= 3 && x < 8 && y >= 2 && y < 6);
+                for (uint32_t c = 0; c < 3; c++) {
+                    const auto expected = inside ? (rgb(x - 3, y - 2, c) | 1) : 0;
+                    CHECK(dst[4096 + (y * 18 + x) * 3 + c] == expected)
+                }
+            }
+        }
+        for (uint32_t i = 0; i < 64; i++) {
+            uint32_t depthWord;
+            memcpy(&depthWord, dst + 12288 + i * 4, 4);
+            CHECK(depthWord == i * 1000)
+            CHECK(dst[12800 + i] == i * 3)
+        }
+        // Blocks (2,1) and (3,1) of 4x2.
+        for (uint32_t i = 0; i < 16; i++) {
+            CHECK(dst[13312 + i] == 100 + 48 + i)
+        }
+        for (uint32_t z = 0; z < 2; z++) {
+            for (uint32_t y = 0; y < 3; y++) {
+                for (uint32_t x = 0; x < 5; x++) {
+                    const auto i = ((z + 1) * 4 + y) * 8 + x;
+                    CHECK(dst[16384 + (z * 3 + y) * 5 + x] == uint8_t(i ^ 0x5a))
+                }
+            }
+        }
+
+        vkUnmapMemory(dev, mem);
+        vkDestroyCommandPool(dev, pool, nullptr);
+        for (const auto& x : images) {
+            vkDestroyImage(dev, x, nullptr);
+        }
+        for (const auto& x : buffers) {
+            vkDestroyBuffer(dev, x, nullptr);
+        }
+        vkFreeMemory(dev, mem, nullptr);
+    }
+
+    {
+        // OPTIMAL images are tiled, so copies in and out have to agree for every block size,
+        // over whole tiles and parts of them. LINEAR images are where the app is told.
+        const VkBufferCreateInfo bufferInfo = {
+            VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, nullptr, 0,
+            128 << 10, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_SHARING_MODE_EXCLUSIVE, 0, nullptr
+        };
+        VkBuffer buffers[2];
+        for (auto& x : buffers) {
+            res = vkCreateBuffer(dev, &bufferInfo, nullptr, &x);
+            CHECK(res == VK_SUCCESS)
+        }
+
+        const VkFormat formats[] = {
+            VK_FORMAT_R8_UNORM, VK_FORMAT_R8G8_UNORM, VK_FORMAT_R8G8B8A8_UNORM,
+            VK_FORMAT_R16G16B16A16_UNORM, VK_FORMAT_R32G32B32A32_UINT, VK_FORMAT_R8G8B8A8_UNORM
+        };
+        const uint32_t blockBytes[] = { 1, 2, 4, 8, 16, 4 };
+        VkImageCreateInfo imageInfo = {
+            VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO, nullptr, 0,
+            VK_IMAGE_TYPE_2D, VK_FORMAT_UNDEFINED, { 29, 23, 1 }, 1, 1,
+            VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+            VK_SHARING_MODE_EXCLUSIVE, 0, nullptr, VK_IMAGE_LAYOUT_UNDEFINED
+        };
+        VkImage images[6];
+        for (uint32_t i = 0; i < 6; i++) {
+            imageInfo.format = formats[i];
+            if (i == 5) {
+                imageInfo.tiling = VK_IMAGE_TILING_LINEAR;
+                imageInfo.extent = { 13, 5, 1 };
+                imageInfo.arrayLayers = 2;
+            }
+            res = vkCreateImage(dev, &imageInfo, nullptr, &images[i]);
+            CHECK(res == VK_SUCCESS)
+        }
+
+        const VkMemoryAllocateInfo memInfo = {
+            VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, nullptr,
+            1 << 20, 0
+        };
+        VkDeviceMemory mem;
+        res = vkAllocateMemory(dev, &memInfo, nullptr, &mem);
+        CHECK(res == VK_SUCCESS)
+        res = vkBindBufferMemory(dev, buffers[0], mem, 0);
+        CHECK(res == VK_SUCCESS)
+        res = vkBindBufferMemory(dev, buffers[1], mem, 128 << 10);
+        CHECK(res == VK_SUCCESS)
+        VkDeviceSize memOffset = 256 << 10;
+        VkDeviceSize linearOffset = 0;
+        for (const auto& x : images) {
+            VkMemoryRequirements reqs;
+            vkGetImageMemoryRequirements(dev, x, &reqs);
+            memOffset = (memOffset + reqs.alignment - 1) / reqs.alignment * reqs.alignment;
+            res = vkBindImageMemory(dev, x, mem, memOffset);
+            CHECK(res == VK_SUCCESS)
+            linearOffset = memOffset;
+            memOffset += reqs.size;
+        }
+        CHECK(memOffset <= memInfo.allocationSize)
+        uint8_t* data;
+        res = vkMapMemory(dev, mem, 0, VK_WHOLE_SIZE, 0, (void**)&data);
+        CHECK(res == VK_SUCCESS)
+        memset(data, 0, memInfo.allocationSize);
+
+        const auto src = data;
+        const auto dst = data + (128 << 10);
+        const auto pattern = [](const uint32_t image, const uint32_t i) {
+            return uint8_t(i * 7 + i / 251 + image * 31 + 3);
+        };
+        for (uint32_t i = 0; i < 6; i++) {
+            for (uint32_t j = 0; j < 16384; j++) {
+                src[i * 16384 + j] = pattern(i, j);
+            }
+        }
+
+        const VkCommandPoolCreateInfo poolInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, nullptr, 0,
+            queueFamily
+        };
+        VkCommandPool pool;
+        res = vkCreateCommandPool(dev, &poolInfo, nullptr, &pool);
+        CHECK(res == VK_SUCCESS)
+        const VkCommandBufferAllocateInfo cbInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, nullptr,
+            pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1
+        };
+        VkCommandBuffer cb;
+        res = vkAllocateCommandBuffers(dev, &cbInfo, &cb);
+        CHECK(res == VK_SUCCESS)
+        ActLikeLoader(cb);
+
+        const VkCommandBufferBeginInfo beginInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr, 0, nullptr
+        };
+        res = vkBeginCommandBuffer(cb, &beginInfo);
+        CHECK(res == VK_SUCCESS)
+        const auto color = VK_IMAGE_ASPECT_COLOR_BIT;
+        const VkImageLayout layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        for (uint32_t i = 0; i < 5; i++) {
+            const VkBufferImageCopy upload = {
+                i * 16384, 0, 0, { color, 0, 0, 1 }, { 0, 0, 0 }, { 29, 23, 1 }
+            };
+            vkCmdCopyBufferToImage(cb, buffers[0], images[i], layout, 1, &upload);
+            const VkBufferImageCopy readbacks[] = {
+                { i * 16384, 0, 0, { color, 0, 0, 1 }, { 0, 0, 0 }, { 29, 23, 1 } },
+                { 81920 + i * 8192, 0, 0, { color, 0, 0, 1 }, { 5, 3, 0 }, { 19, 17, 1 } },
+            };
+            vkCmdCopyImageToBuffer(cb, images[i], layout, buffers[1], 2, readbacks);
+        }
+        const VkBufferImageCopy linearUpload = {
+            5 * 16384, 0, 0, { color, 0, 0, 2 }, { 0, 0, 0 }, { 13, 5, 1 }
+        };
+        vkCmdCopyBufferToImage(cb, buffers[0], images[5], layout, 1, &linearUpload);
+        res = vkEndCommandBuffer(cb);
+        CHECK(res == VK_SUCCESS)
+
+        const VkSubmitInfo submitInfo = {
+            VK_STRUCTURE_TYPE_SUBMIT_INFO, nullptr,
+            0, nullptr, nullptr,
+            1, &cb,
+            0, nullptr
+        };
+        res = vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+        CHECK(res == VK_SUCCESS)
+        res = vkQueueWaitIdle(queue);
+        CHECK(res == VK_SUCCESS)
+
+        for (uint32_t i = 0; i < 5; i++) {
+            const auto bytes = blockBytes[i];
+            for (uint32_t j = 0; j < 29 * 23 * bytes; j++) {
+                CHECK(dst[i * 16384 + j] == pattern(i, j))
+            }
+            for (uint32_t y = 0; y < 17; y++) {
+                for (uint32_t j = 0; j < 19 * bytes; j++) {
+                    const auto from = ((y + 3) * 29 + 5) * bytes + j;
+                    CHECK(dst[81920 + i * 8192 + y * 19 * bytes + j] == pattern(i, from))
+                }
+            }
+        }
+        for (uint32_t layer = 0; layer < 2; layer++) {
+            const VkImageSubresource subresource = { color, 0, layer };
+            VkSubresourceLayout texels;
+            vkGetImageSubresourceLayout(dev, images[5], &subresource, &texels);
+            CHECK(texels.rowPitch >= 13 * 4 && texels.size >= texels.rowPitch * 5)
+            const auto image = data + linearOffset + texels.offset;
+            for (uint32_t y = 0; y < 5; y++) {
+                for (uint32_t j = 0; j < 13 * 4; j++) {
+                    const auto from = (layer * 5 + y) * 13 * 4 + j;
+                    CHECK(image[y * texels.rowPitch + j] == pattern(5, from))
+                }
+            }
+        }
+
+        vkUnmapMemory(dev, mem);
+        vkDestroyCommandPool(dev, pool, nullptr);
+        for (const auto& x : images) {
+            vkDestroyImage(dev, x, nullptr);
+        }
+        for (const auto& x : buffers) {
+            vkDestroyBuffer(dev, x, nullptr);
+        }
+        vkFreeMemory(dev, mem, nullptr);
+    }
+
+    {
+        // Blits: nearest and mirrored into another format, linear and magnified, and mip
+        // chains. A chain recorded a level per blit, with barriers between, is made in
+        // fused passes; the same blits cut in two regions each aren't, and must agree.
+        const VkBufferCreateInfo bufferInfo = {
+            VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, nullptr, 0,
+            256 << 10, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_SHARING_MODE_EXCLUSIVE, 0, nullptr
+        };
+        VkBuffer buffers[2];
+        for (auto& x : buffers) {
+            res = vkCreateBuffer(dev, &bufferInfo, nullptr, &x);
+            CHECK(res == VK_SUCCESS)
+        }
+
+        // Then a pair of each chain format, per filter.
+        const VkFormat chainFormats[] = {
+            VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_R16G16B16A16_UNORM, VK_FORMAT_R8_UNORM
+        };
+        const VkFilter chainFilters[] = {
+            VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_FILTER_NEAREST
+        };
+        const uint32_t chainBytes[] = { 4, 8, 1 };
+        VkImageCreateInfo imageInfo = {
+            VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO, nullptr, 0,
+            VK_IMAGE_TYPE_2D, VK_FORMAT_R8G8B8A8_UNORM, { 4, 4, 1 }, 1, 1,
+            VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+            VK_SHARING_MODE_EXCLUSIVE, 0, nullptr, VK_IMAGE_LAYOUT_UNDEFINED
+        };
+        VkImage images[9];
+        for (uint32_t i = 0; i < 9; i++) {
+            if (i == 1) {
+                imageInfo.format = VK_FORMAT_B8G8R8A8_UNORM;
+            } else if (i == 2) {
+                imageInfo.extent = { 8, 8, 1 };
+            } else if (i >= 3) {
+                imageInfo.format = chainFormats[(i - 3) / 2];
+                imageInfo.extent = { 64, 48, 1 };
+                imageInfo.mipLevels = 7;
+                imageInfo.arrayLayers = 2;
+            }
+            res = vkCreateImage(dev, &imageInfo, nullptr, &images[i]);
+            CHECK(res == VK_SUCCESS)
+        }
+
+        const VkMemoryAllocateInfo memInfo = {
+            VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, nullptr,
+            1 << 20, 0
+        };
+        VkDeviceMemory mem;
+        res = vkAllocateMemory(dev, &memInfo, nullptr, &mem);
+        CHECK(res == VK_SUCCESS)
+        res = vkBindBufferMemory(dev, buffers[0], mem, 0);
+        CHECK(res == VK_SUCCESS)
+        res = vkBindBufferMemory(dev, buffers[1], mem, 256 << 10);
+        CHECK(res == VK_SUCCESS)
+        VkDeviceSize memOffset = 512 << 10;
+        for (const auto& x : images) {
+            VkMemoryRequirements reqs;
+            vkGetImageMemoryRequirements(dev, x, &reqs);
+            memOffset = (memOffset + reqs.alignment - 1) / reqs.alignment * reqs.alignment;
+            res = vkBindImageMemory(dev, x, mem, memOffset);
+            CHECK(res == VK_SUCCESS)
+            memOffset += reqs.size;
+        }
+        CHECK(memOffset <= memInfo.allocationSize)
+        uint8_t* data;
+        res = vkMapMemory(dev, mem, 0, VK_WHOLE_SIZE, 0, (void**)&data);
+        CHECK(res == VK_SUCCESS)
+        memset(data, 0, memInfo.allocationSize);
+
+        const auto src = data;
+        const auto dst = data + (256 << 10);
+        // Texel (x, y) of the 4x4 source is (x*48, y*48, 7, 255).
+        for (uint32_t y = 0; y < 4; y++) {
+            for (uint32_t x = 0; x < 4; x++) {
+                const uint8_t texel[] = { uint8_t(x * 48), uint8_t(y * 48), 7, 255 };
+                memcpy(src + (y * 4 + x) * 4, texel, 4);
+            }
+        }
+        const auto pattern = [](const uint32_t chain, const uint32_t i) {
+            return uint8_t(i * 7 + i / 251 + chain * 31 + 3);
+        };
+        for (uint32_t chain = 0; chain < 3; chain++) {
+            for (uint32_t i = 0; i < 64 * 48 * 2 * chainBytes[chain]; i++) {
+                src[(16 + chain * 48) * 1024 + i] = pattern(chain, i);
+            }
+        }
+
+        const VkCommandPoolCreateInfo poolInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, nullptr, 0,
+            queueFamily
+        };
+        VkCommandPool pool;
+        res = vkCreateCommandPool(dev, &poolInfo, nullptr, &pool);
+        CHECK(res == VK_SUCCESS)
+        const VkCommandBufferAllocateInfo cbInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, nullptr,
+            pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1
+        };
+        VkCommandBuffer cb;
+        res = vkAllocateCommandBuffers(dev, &cbInfo, &cb);
+        CHECK(res == VK_SUCCESS)
+        ActLikeLoader(cb);
+
+        const VkCommandBufferBeginInfo beginInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr, 0, nullptr
+        };
+        res = vkBeginCommandBuffer(cb, &beginInfo);
+        CHECK(res == VK_SUCCESS)
+        const auto color = VK_IMAGE_ASPECT_COLOR_BIT;
+        const VkImageLayout layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        const VkBufferImageCopy upload = {
+            0, 0, 0, { color, 0, 0, 1 }, { 0, 0, 0 }, { 4, 4, 1 }
+        };
+        vkCmdCopyBufferToImage(cb, buffers[0], images[0], layout, 1, &upload);
+        const VkImageBlit mirror = {
+            { color, 0, 0, 1 }, { { 0, 0, 0 }, { 4, 4, 1 } },
+            { color, 0, 0, 1 }, { { 4, 0, 0 }, { 0, 4, 1 } },
+        };
+        vkCmdBlitImage(cb, images[0], layout, images[1], layout, 1, &mirror,
+                       VK_FILTER_NEAREST);
+        const VkImageBlit magnify = {
+            { color, 0, 0, 1 }, { { 0, 0, 0 }, { 4, 4, 1 } },
+            { color, 0, 0, 1 }, { { 0, 0, 0 }, { 8, 8, 1 } },
+        };
+        vkCmdBlitImage(cb, images[0], layout, images[2], layout, 1, &magnify,
+                       VK_FILTER_LINEAR);
+        const VkBufferImageCopy readbacks[] = {
+            { 0, 0, 0, { color, 0, 0, 1 }, { 0, 0, 0 }, { 4, 4, 1 } },
+            { 1024, 0, 0, { color, 0, 0, 1 }, { 0, 0, 0 }, { 8, 8, 1 } },
+        };
+        vkCmdCopyImageToBuffer(cb, images[1], layout, buffers[1], 1, &readbacks[0]);
+        vkCmdCopyImageToBuffer(cb, images[2], layout, buffers[1], 1, &readbacks[1]);
+
+        // Where each chain image's levels read back to, and where the last ends.
+        uint32_t readbackOffsets[10] = {};
+        uint32_t readbackOffset = 16 << 10;
+        for (uint32_t i = 3; i < 9; i++) {
+            readbackOffsets[i] = readbackOffset;
+            const auto chain = (i - 3) / 2;
+            const auto filter = chainFilters[chain];
+            const VkBufferImageCopy base = {
+                (16 + chain * 48) * 1024, 0, 0, { color, 0, 0, 2 }, { 0, 0, 0 }, { 64, 48, 1 }
+            };
+            vkCmdCopyBufferToImage(cb, buffers[0], images[i], layout, 1, &base);
+            for (uint32_t level = 1; level < 7; level++) {
+                const int32_t w = std::max(64 >> level, 1);
+                const int32_t h = std::max(48 >> level, 1);
+                const int32_t pw = std::max(64 >> (level - 1), 1);
+                const int32_t ph = std::max(48 >> (level - 1), 1);
+                const VkImageBlit step = {
+                    { color, level - 1, 0, 2 }, { { 0, 0, 0 }, { pw, ph, 1 } },
+                    { color, level, 0, 2 }, { { 0, 0, 0 }, { w, h, 1 } },
+                };
+                if ((i - 3) % 2 == 0) {
+                    const VkImageMemoryBarrier barrier = {
+                        VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER, nullptr,
+                        VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                        layout, layout, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+                        images[i], { color, level - 1, 1, 0, 2 }
+                    };
+                    vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                                         nullptr, 1, &barrier);
+                    vkCmdBlitImage(cb, images[i], layout, images[i], layout, 1, &step,
+                                   filter);
+                } else {
+                    // Left and right halves, or the whole level twice once it's 1 wide.
+                    VkImageBlit halves[] = { step, step };
+                    if (w > 1) {
+                        halves[0].srcOffsets[1].x = halves[1].srcOffsets[0].x = w;
+                        halves[0].dstOffsets[1].x = halves[1].dstOffsets[0].x = w / 2;
+                    }
+                    vkCmdBlitImage(cb, images[i], layout, images[i], layout, 2, halves,
+                                   filter);
+                }
+            }
+            for (uint32_t level = 0; level < 7; level++) {
+                const uint32_t w = std::max(64u >> level, 1u);
+                const uint32_t h = std::max(48u >> level, 1u);
+                const VkBufferImageCopy readback = {
+                    readbackOffset, 0, 0, { color, level, 0, 2 }, { 0, 0, 0 }, { w, h, 1 }
+                };
+                vkCmdCopyImageToBuffer(cb, images[i], layout, buffers[1], 1, &readback);
+                readbackOffset += w * h * 2 * chainBytes[chain];
+            }
+        }
+        readbackOffsets[9] = readbackOffset;
+        CHECK(readbackOffset <= bufferInfo.size)
+        res = vkEndCommandBuffer(cb);
+        CHECK(res == VK_SUCCESS)
+
+        const VkSubmitInfo submitInfo = {
+            VK_STRUCTURE_TYPE_SUBMIT_INFO, nullptr,
+            0, nullptr, nullptr,
+            1, &cb,
+            0, nullptr
+        };
+        res = vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+        CHECK(res == VK_SUCCESS)
+        res = vkQueueWaitIdle(queue);
+        CHECK(res == VK_SUCCESS)
+
+        // BGRA, mirrored in x.
+        for (uint32_t y = 0; y < 4; y++) {
+            for (uint32_t x = 0; x < 4; x++) {
+                const uint8_t texel[] = { 7, uint8_t(y * 48), uint8_t((3 - x) * 48), 255 };
+                CHECK(memcmp(dst + (y * 4 + x) * 4, texel, 4) == 0)
+            }
+        }
+        // Each channel varies along one axis only, between texel centers, clamped at the
+        // edges. Weights are quarters of multiples of 48, so results are exact.
+        const auto lerp = [](const uint32_t i) {
+            const auto u = i / 2.0f - 0.25f;
+            const auto base = std::floor(u);
+            const auto f = u - base;
+            const auto a = std::min(std::max(base, 0.0f), 3.0f);
+            const auto b = std::min(std::max(base + 1.0f, 0.0f), 3.0f);
+            return uint8_t(((1.0f - f) * a + f * b) * 48.0f + 0.5f);
+        };
+        for (uint32_t y = 0; y < 8; y++) {
+            for (uint32_t x = 0; x < 8; x++) {
+                const uint8_t texel[] = { 7, lerp(y), lerp(x), 255 };
+                CHECK(memcmp(dst + 1024 + (y * 8 + x) * 4, texel, 4) == 0)
+            }
+        }
+        for (uint32_t chain = 0; chain < 3; chain++) {
+            const auto fused = dst + readbackOffsets[3 + chain * 2];
+            const auto split = dst + readbackOffsets[4 + chain * 2];
+            for (uint32_t j = 0; j < 64 * 48 * 2 * chainBytes[chain]; j++) {
+                CHECK(fused[j] == pattern(chain, j))
+            }
+            CHECK(memcmp(fused, split, readbackOffsets[5 + chain * 2] -
+                                        readbackOffsets[4 + chain * 2]) == 0)
+        }
+        // Level 1 of the RGBA8 chain averages the 2x2 below each texel.
+        const auto level1 = dst + (16 << 10) + 64 * 48 * 2 * 4;
+        for (uint32_t c = 0; c < 4; c++) {
+            const auto sum = pattern(0, c) + pattern(0, 4 + c) + pattern(0, 256 + c) +
+                             pattern(0, 260 + c);
+            CHECK(std::abs(int(level1[c]) - sum / 4) <= 1)
+        }
+
+        vkUnmapMemory(dev, mem);
+        vkDestroyCommandPool(dev, pool, nullptr);
+        for (const auto& x : images) {
+            vkDestroyImage(dev, x, nullptr);
+        }
+        for (const auto& x : buffers) {
+            vkDestroyBuffer(dev, x, nullptr);
+        }
+        vkFreeMemory(dev, mem, nullptr);
+    }
+
+    vkDestroyDevice(dev, nullptr);
+
+    {
+        AllocTracker tracker;
+        const VkAllocationCallbacks callbacks = {
+            &tracker,
+            &TrackAlloc,
+            &TrackRealloc,
+            &TrackFree,
+            nullptr,
+            nullptr
+        };
+
+        VkInstance trackedInst;
+        res = vkCreateInstance(&instCreateInfo, &callbacks, &trackedInst);
+        CHECK(res == VK_SUCCESS)
+
+        VkPhysicalDevice physDev;
+        uint32_t count = 1;
+        (void)vkEnumeratePhysicalDevices(trackedInst, &count, &physDev);
+
+        const float priorities[] = { 0.5f, 0.5f };
+        const VkDeviceQueueCreateInfo queueInfo = {
+            VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO, nullptr, 0,
+            0, 2,
+            priorities
+        };
+        const VkDeviceCreateInfo deviceInfo = {
+            VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO, nullptr, 0,
+            1, &queueInfo,
+            0, nullptr,
+            0, nullptr,
+            nullptr
+        };
+        VkDevice trackedDev;
+        res = vkCreateDevice(physDev, &deviceInfo, &callbacks, &trackedDev);
+        CHECK(res == VK_SUCCESS)
+
+        CHECK(tracker.mLive > 0)
+        CHECK(tracker.mScopes & (1 << VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE))
+        CHECK(tracker.mScopes & (1 << VK_SYSTEM_ALLOCATION_SCOPE_DEVICE))
+
+        // queues[1] waits on queues[0], via a semaphore.
+        VkQueue queues[2];
+        vkGetDeviceQueue(trackedDev, 0, 0, &queues[0]);
+        vkGetDeviceQueue(trackedDev, 0, 1, &queues[1]);
+
+        const VkSemaphoreCreateInfo semInfo = {
+            VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO, nullptr, 0
+        };
+        VkSemaphore sem;
+        res = vkCreateSemaphore(trackedDev, &semInfo, &callbacks, &sem);
+        CHECK(res == VK_SUCCESS)
+
+        const VkFenceCreateInfo fenceInfo = {
+            VK_STRUCTURE_TYPE_FENCE_CREATE_INFO, nullptr, 0
+        };
+        VkFence fences[2];
+        for (auto& x : fences) {
+            res = vkCreateFence(trackedDev, &fenceInfo, &callbacks, &x);
+            CHECK(res == VK_SUCCESS)
+        }
+
+        const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        const VkSubmitInfo waitSubmit = {
+            VK_STRUCTURE_TYPE_SUBMIT_INFO, nullptr,
+            1, &sem, &waitStage,
+            0, nullptr,
+            0, nullptr
+        };
+        res = vkQueueSubmit(queues[1], 1, &waitSubmit, fences[1]);
+        CHECK(res == VK_SUCCESS)
+        res = vkWaitForFences(trackedDev, 2, fences, VK_FALSE, 1000 * 1000);
+        CHECK(res == VK_TIMEOUT)
+
+        const VkSubmitInfo signalSubmit = {
+            VK_STRUCTURE_TYPE_SUBMIT_INFO, nullptr,
+            0, nullptr, nullptr,
+            0, nullptr,
+            1, &sem
+        };
+        res = vkQueueSubmit(queues[0], 1, &signalSubmit, fences[0]);
+        CHECK(res == VK_SUCCESS)
+        res = vkWaitForFences(trackedDev, 2, fences, VK_FALSE, UINT64_MAX);
+        CHECK(res == VK_SUCCESS)
+        res = vkWaitForFences(trackedDev, 2, fences, VK_TRUE, UINT64_MAX);
+        CHECK(res == VK_SUCCESS)
+
+        // Destroyed while the queue threads may still hold refs.
+        vkDestroySemaphore(trackedDev, sem, &callbacks);
+        for (const auto& x : fences) {
+            vkDestroyFence(trackedDev, x, &callbacks);
+        }
+
+        vkDestroyDevice(trackedDev, &callbacks);
+        vkDestroyInstance(trackedInst, &callbacks);
+        CHECK(tracker.mLive == 0)
+    }
 
     printf("OK!\n");
     return 0;
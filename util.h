@@ -1,5 +1,10 @@
 #pragma once
 
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
 // --
 
 #ifdef DEBUG
@@ -12,6 +17,14 @@
 #define ASSERT(x)
 #endif
 
+// Like ASSERT, but in every build, for tests and benchmarks.
+#define CHECK(x) \
+    if (!(x)) { \
+        printf("CHECK(%s): %s:%u\n", #x, __FILE__, __LINE__); \
+        fflush(stdout); /* abort() won't. */ \
+        abort(); \
+    }
+
 // --
 
 #ifdef DEBUG
@@ -70,3 +83,62 @@ Range(T* const begin, const size_t n)
 {
     return RangeImpl<T>(begin, begin + n);
 }
+
+// --
+
+struct Hash128 final
+{
+    uint64_t mLo;
+    uint64_t mHi;
+
+    bool operator==(const Hash128& x) const { return mLo == x.mLo && mHi == x.mHi; }
+    bool operator!=(const Hash128& x) const { return !(*this == x); }
+};
+
+// A fast content hash, for cache keys. Not for anything adversarial.
+class Hasher128 final
+{
+    uint64_t mA = 0x9e3779b97f4a7c15;
+    uint64_t mB = 0xc2b2ae3d27d4eb4f;
+    uint64_t mLen = 0;
+
+    static uint64_t Rotl(const uint64_t x, const int n) { return (x << n) | (x >> (64 - n)); }
+
+    static uint64_t Mix(uint64_t x) {
+        x ^= x >> 32;
+        x *= 0xd6e8feb86659fd93;
+        x ^= x >> 32;
+        x *= 0xd6e8feb86659fd93;
+        x ^= x >> 32;
+        return x;
+    }
+
+    void Word(const uint64_t w) {
+        mA = Rotl((mA ^ w) * 0x9fb21c651e98df25, 29);
+        mB = Rotl((mB + w) * 0xff51afd7ed558ccd, 31) ^ mA;
+    }
+
+public:
+    void Add(const void* const data, const size_t size) {
+        const auto bytes = (const uint8_t*)data;
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            uint64_t w;
+            memcpy(&w, bytes + i, 8);
+            Word(w);
+        }
+        if (i < size) {
+            uint64_t w = 0;
+            memcpy(&w, bytes + i, size - i);
+            Word(w ^ (uint64_t(size - i) << 56));
+        }
+        mLen += size;
+    }
+
+    template<typename T>
+    void AddPod(const T& x) { Add(&x, sizeof(x)); }
+
+    Hash128 Finish() const {
+        return { Mix(mA ^ mLen), Mix(mB + Rotl(mA, 17)) };
+    }
+};